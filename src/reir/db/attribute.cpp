@@ -81,4 +81,19 @@ void Attribute::deserialize(std::istream& s) {
 
 Attribute::~Attribute() {}
 
+std::vector<size_t> key_order(const std::vector<Attribute::AttrProperty>& props) {
+  std::vector<size_t> ret;
+  for (size_t i = 0; i < props.size(); ++i) {
+    if ((props[i] & Attribute::KEY) && (props[i] & Attribute::PARTITION)) {
+      ret.push_back(i);
+    }
+  }
+  for (size_t i = 0; i < props.size(); ++i) {
+    if ((props[i] & Attribute::KEY) && !(props[i] & Attribute::PARTITION)) {
+      ret.push_back(i);
+    }
+  }
+  return ret;
+}
+
 }  // namespace reir
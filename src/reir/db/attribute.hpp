@@ -14,6 +14,7 @@ struct Attribute {
     NULLABLE = 0x00000001,
     KEY      = 0x00000002,
     UNIQUE   = 0x00000004,
+    PARTITION = 0x00000008,  // the key column the rows are partitioned by
   };
   Attribute() : type_("unknown"), property_(NONE) {}
   Attribute(std::string name, AttrType type, AttrProperty prop = NONE)
@@ -29,6 +30,9 @@ struct Attribute {
   bool is_key() const {
     return property_ & AttrProperty::KEY;
   }
+  bool is_partition() const {
+    return property_ & AttrProperty::PARTITION;
+  }
   const AttrType& type() const {
     return type_;
   }
@@ -66,6 +70,9 @@ struct Attribute {
     if (s.property_ & AttrProperty::UNIQUE) {
       o << " UNIQUE";
     }
+    if (s.property_ & AttrProperty::PARTITION) {
+      o << " PARTITION";
+    }
     return o;
   }
 
@@ -74,6 +81,10 @@ struct Attribute {
   AttrProperty property_;
 };
 
+// indexes of the key columns in the order they are laid out in the key. the
+// partition column comes first, so the rows of a partition are next to each other
+std::vector<size_t> key_order(const std::vector<Attribute::AttrProperty>& props);
+
 }  // namespace reir
 
 #endif  // REIR_ATTRIBUTE_HPP_
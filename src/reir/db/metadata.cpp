@@ -38,10 +38,11 @@ void MetaData::show_tables() const {
   }
 }
 
-void MetaData::create_table(const std::string& name, std::vector<Attribute>&& attr) {
+void MetaData::create_table(const std::string& name, std::vector<Attribute>&& attr,
+                            StorageKind storage, uint64_t storage_size) {
   std::stringstream key;
   key << "table:global_schema:" << name;
-  Schema new_schema(name, std::move(attr));
+  Schema new_schema(name, std::move(attr), storage, storage_size);
   tables_.insert(std::make_pair(key.str(), new_schema));
   {
     std::string value;
@@ -68,6 +69,15 @@ Schema MetaData::get_schema(const std::string& name) {
   }
 }
 
+void MetaData::create_index(const IndexDef& index) {
+  std::stringstream key;
+  key << "table:global_index:" << index.name;
+  indexes_[key.str()] = index;
+  std::string value;
+  index.serialize(value);
+  db_->Put(leveldb::WriteOptions(), key.str(), value);
+}
+
 MetaData::~MetaData() {
   delete db_;
 }
@@ -18,11 +18,14 @@ class MetaData {
   MetaData();
   ~MetaData();
   void show_tables() const;
-  void create_table(const std::string& name, std::vector<Attribute>&& columns);
+  void create_table(const std::string& name, std::vector<Attribute>&& columns,
+                    StorageKind storage = StorageKind::MASSTREE, uint64_t storage_size = 0);
   void drop_table(const std::string& name);
   Schema get_schema(const std::string& name);
+  void create_index(const IndexDef& index);
  private:
   std::unordered_map<std::string, Schema> tables_;
+  std::unordered_map<std::string, IndexDef> indexes_;
   leveldb::DB* db_;
 };
 
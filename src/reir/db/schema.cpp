@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 #include "schema.hpp"
 
 namespace reir {
@@ -8,6 +10,10 @@ Schema::~Schema() {}
 void Schema::serialize(std::string& buf) const {
   std::stringstream ss;
   ss << name_ << ":";
+  if (storage_ != StorageKind::MASSTREE) {
+    // attributes start at the first '(', so older readers skip this
+    ss << static_cast<int>(storage_) << " " << storage_size_;
+  }
   for (const auto& a : attrs_) {
     a.serialize(ss);
   }
@@ -23,6 +29,15 @@ void Schema::deserialize(const std::string& buf) {
   while (*it != ':') name << *it++;
   name_ = name.str();
   ++it;
+  storage_ = StorageKind::MASSTREE;
+  storage_size_ = 0;
+  if (it != std::istreambuf_iterator<char>() && *it != '(') {
+    std::stringstream storage;
+    while (it != std::istreambuf_iterator<char>() && *it != '(') storage << *it++;
+    int kind;
+    storage >> kind >> storage_size_;
+    storage_ = static_cast<StorageKind>(kind);
+  }
   for (;;) {
     std::istreambuf_iterator<char> i(ss), end;
     if (i == end) {
@@ -34,5 +49,51 @@ void Schema::deserialize(const std::string& buf) {
   }
 }
 
+std::vector<size_t> Schema::index_columns(const IndexDef& index) const {
+  std::vector<size_t> ret(index.columns);
+  for (auto k : key_columns()) {
+    if (std::find(ret.begin(), ret.end(), k) == ret.end()) {
+      ret.push_back(k);
+    }
+  }
+  return ret;
+}
+
+Schema Schema::index_schema(const IndexDef& index) const {
+  // no partition column, the entries are laid out in index order
+  std::vector<Attribute> attrs;
+  for (auto i : index_columns(index)) {
+    if (attrs_.size() <= i) {
+      throw std::runtime_error("index " + index.name + " names a column " + name_ + " does not have");
+    }
+    attrs.emplace_back(attrs_[i].name_, attrs_[i].type_, Attribute::AttrProperty::KEY);
+  }
+  return Schema(index.name, std::move(attrs));
+}
+
+void IndexDef::serialize(std::string& buf) const {
+  std::stringstream ss;
+  ss << name << ":" << table << ":";
+  for (size_t i = 0; i < columns.size(); ++i) {
+    ss << (i == 0 ? "" : ",") << columns[i];
+  }
+  buf = ss.str();
+}
+
+void IndexDef::deserialize(const std::string& buf) {
+  const auto first = buf.find(':');
+  const auto second = buf.find(':', first + 1);
+  if (first == std::string::npos || second == std::string::npos) {
+    throw std::runtime_error("broken index definition: " + buf);
+  }
+  name = buf.substr(0, first);
+  table = buf.substr(first + 1, second - first - 1);
+  columns.clear();
+  std::stringstream ss(buf.substr(second + 1));
+  std::string column;
+  while (std::getline(ss, column, ',')) {
+    columns.push_back(std::stoull(column));
+  }
+}
 
 }  // namespace reir
@@ -12,12 +12,46 @@
 
 namespace reir {
 
+// the storage a table lives in. masstree tables share one ordered storage, the
+// others get a storage of their own named after the table
+enum class StorageKind : uint8_t {
+  MASSTREE,
+  ARRAY,       // dense integer key, the key is the offset in the array
+  HASH,        // point lookups on the whole key only
+  SEQUENTIAL,  // append only, scanned in no particular order
+};
+
+inline const char* storage_kind_name(StorageKind kind) {
+  switch (kind) {
+    case StorageKind::MASSTREE: return "masstree";
+    case StorageKind::ARRAY: return "array";
+    case StorageKind::HASH: return "hash";
+    case StorageKind::SEQUENTIAL: return "sequential";
+  }
+  return "unknown";
+}
+
+// a secondary index on columns of a table. its entries are keys of their own,
+// the indexed columns followed by the rest of the primary key, with no value
+struct IndexDef {
+  std::string name;
+  std::string table;
+  std::vector<size_t> columns;  // columns of the table, in index order
+
+  void serialize(std::string& buf) const;
+  void deserialize(const std::string& buf);
+  bool operator==(const IndexDef& rhs) const {
+    return name == rhs.name && table == rhs.table && columns == rhs.columns;
+  }
+};
+
 class Schema {
 public:
   Schema() {}
 
-  Schema(std::string name, std::vector<Attribute> attrs)
-      : name_(std::move(name)), attrs_(std::move(attrs)) {}
+  Schema(std::string name, std::vector<Attribute> attrs,
+         StorageKind storage = StorageKind::MASSTREE, uint64_t storage_size = 0)
+      : name_(std::move(name)), attrs_(std::move(attrs)), storage_(storage), storage_size_(storage_size) {}
   Schema(const Schema& o) = default;
 
   ~Schema();
@@ -73,6 +107,50 @@ public:
     return attrs_[idx].is_key();
   }
 
+  StorageKind storage() const {
+    return storage_;
+  }
+
+  // records of an array, expected records of a hash, 0 otherwise
+  uint64_t storage_size() const {
+    return storage_size_;
+  }
+
+  const std::string& name() const {
+    return name_;
+  }
+
+  // the column the rows are partitioned by, -1 if not partitioned
+  int partition_column() const {
+    for (size_t i = 0; i < attrs_.size(); ++i) {
+      if (attrs_[i].is_partition()) {
+        return static_cast<int>(i);
+      }
+    }
+    return -1;
+  }
+
+  // key columns in the order they are laid out in the key
+  std::vector<size_t> key_columns() const {
+    std::vector<Attribute::AttrProperty> props;
+    for (const auto& attr : attrs_) {
+      props.push_back(attr.property_);
+    }
+    return key_order(props);
+  }
+
+  // where key column idx starts in a fixed length key, after the prefix
+  size_t key_offset(size_t idx) const {
+    size_t ret = 0;
+    for (auto k : key_columns()) {
+      if (k == idx) {
+        return ret;
+      }
+      ret += attrs_[k].default_size();
+    }
+    throw std::runtime_error("not a key column");
+  }
+
   void add_column(const Attribute& attr) {
     attrs_.emplace_back(attr);
   }
@@ -119,6 +197,11 @@ public:
   void serialize(std::string& buf) const;
   void deserialize(const std::string& buf);
 
+  // column of this table for every column of an entry of index
+  std::vector<size_t> index_columns(const IndexDef& index) const;
+  // the entries of index as a masstree table of their own, every column is a key
+  Schema index_schema(const IndexDef& index) const;
+
   size_t key_length(const std::vector<MaybeValue>& tuple) const {
     std::vector<size_t> keys;
       for (size_t i = 0; i < attrs_.size(); ++i) {
@@ -155,12 +238,10 @@ public:
     std::memcpy(buff, name_.data(), name_.length());
     buff[name_.length()] = ':';
     size_t offset = name_.length() + 1;
-    for (size_t i = 0; i < attrs_.size(); ++i) {
-      if (attrs_[i].is_key()) {
-        const size_t advance = attrs_[i].encoded_length(tuple[i]);
-        attrs_[i].encode(tuple[i], &buff[offset]);
-        offset += advance;
-      }
+    for (auto i : key_columns()) {
+      const size_t advance = attrs_[i].encoded_length(tuple[i]);
+      attrs_[i].encode(tuple[i], &buff[offset]);
+      offset += advance;
     }
   }
 
@@ -208,6 +289,12 @@ public:
       o << s.attrs_[i];
     }
     o << ")";
+    if (s.storage_ != StorageKind::MASSTREE) {
+      o << " using " << storage_kind_name(s.storage_);
+      if (s.storage_size_ != 0) {
+        o << " " << s.storage_size_;
+      }
+    }
     return o;
   }
 
@@ -218,7 +305,8 @@ public:
   }
 
   bool operator==(const Schema& rhs) const {
-    return name_ == rhs.name_ && attrs_ == rhs.attrs_;
+    return name_ == rhs.name_ && attrs_ == rhs.attrs_ &&
+        storage_ == rhs.storage_ && storage_size_ == rhs.storage_size_;
   }
   bool operator!=(const Schema& rhs) const {
     return !this->operator==(rhs);
@@ -228,6 +316,8 @@ public:
   std::string name_;
   std::vector<Attribute> attrs_;
   std::vector<size_t> keys_;
+  StorageKind storage_ = StorageKind::MASSTREE;
+  uint64_t storage_size_ = 0;
 };
 
 }  // namespace reir
@@ -0,0 +1,41 @@
+#include <utility>
+#include <vector>
+
+#include "attempt.hpp"
+
+namespace reir {
+
+namespace {
+
+struct Attempt {
+  bool running = false;
+  std::vector<std::function<void(bool)>> deferred;
+};
+
+thread_local Attempt attempt;
+
+}  // anonymous namespace
+
+void attempt_begin() {
+  attempt.running = true;
+  attempt.deferred.clear();
+}
+
+void attempt_end(bool committed) {
+  attempt.running = false;
+  auto deferred = std::move(attempt.deferred);
+  attempt.deferred.clear();
+  for (auto& f : deferred) {
+    f(committed);
+  }
+}
+
+void attempt_defer(std::function<void(bool committed)> f) {
+  if (!attempt.running) {
+    f(true);
+    return;
+  }
+  attempt.deferred.emplace_back(std::move(f));
+}
+
+}  // namespace reir
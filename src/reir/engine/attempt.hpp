@@ -0,0 +1,21 @@
+#ifndef REIR_ATTEMPT_HPP_
+#define REIR_ATTEMPT_HPP_
+
+#include <functional>
+
+namespace reir {
+
+// an engine that retries a transaction runs it as attempts, and only the last
+// one commits. what a body hands out meanwhile, like its emitted rows, is held
+// back with attempt_defer until the engine knows how the attempt ended.
+// every call is about the attempt of the calling thread
+void attempt_begin();
+// committed is false when the attempt aborted, the transaction may then be
+// run again. runs what was deferred, in order
+void attempt_end(bool committed);
+// f(committed) once the attempt ends, right away with true outside of one
+void attempt_defer(std::function<void(bool committed)> f);
+
+}  // namespace reir
+
+#endif  // REIR_ATTEMPT_HPP_
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <utility>
+
+#include "btree.hpp"
+
+namespace reir {
+
+namespace {
+
+// the first slot with a key not less than key
+int lower_slot(const BTree::Node* node, const std::string& key) {
+  return static_cast<int>(std::lower_bound(node->keys, node->keys + node->n, key) - node->keys);
+}
+
+// the child holding key, separators are the first keys of their right subtree
+int child_slot(const BTree::Node* node, const std::string& key) {
+  return static_cast<int>(std::upper_bound(node->keys, node->keys + node->n, key) - node->keys);
+}
+
+}  // anonymous namespace
+
+void BTree::Position::next() {
+  if (++pos < leaf->n) {
+    return;
+  }
+  // skip to a leaf with records, only the root leaf can be empty
+  do {
+    leaf = leaf->next;
+  } while (leaf != nullptr && leaf->n == 0);
+  pos = 0;
+}
+
+BTree::BTree() : root_(new Leaf), size_(0), version_(0) {}
+
+BTree::~BTree() {
+  destroy(root_);
+}
+
+void BTree::destroy(Node* node) {
+  if (node->leaf) {
+    delete static_cast<Leaf*>(node);
+    return;
+  }
+  auto* inner = static_cast<Inner*>(node);
+  for (int i = 0; i <= inner->n; ++i) {
+    destroy(inner->children[i]);
+  }
+  delete inner;
+}
+
+bool BTree::insert(const std::string& key, const char* value, size_t value_len) {
+  Node* right = nullptr;
+  std::string separator;
+  if (!insert(root_, key, value, value_len, &right, &separator)) {
+    return false;
+  }
+  if (right != nullptr) {
+    auto* root = new Inner;
+    root->n = 1;
+    root->keys[0] = std::move(separator);
+    root->children[0] = root_;
+    root->children[1] = right;
+    root_ = root;
+  }
+  ++size_;
+  ++version_;
+  return true;
+}
+
+bool BTree::insert(Node* node, const std::string& key, const char* value, size_t value_len,
+                   Node** right, std::string* separator) {
+  if (node->leaf) {
+    auto* leaf = static_cast<Leaf*>(node);
+    const int slot = lower_slot(leaf, key);
+    if (slot < leaf->n && leaf->keys[slot] == key) {
+      return false;
+    }
+    std::move_backward(leaf->keys + slot, leaf->keys + leaf->n, leaf->keys + leaf->n + 1);
+    std::move_backward(leaf->values + slot, leaf->values + leaf->n, leaf->values + leaf->n + 1);
+    leaf->keys[slot] = key;
+    leaf->values[slot].reset(new std::string(value, value_len));
+    if (++leaf->n <= kFanout) {
+      return true;
+    }
+    auto* sibling = new Leaf;
+    const int half = leaf->n / 2;
+    sibling->n = leaf->n - half;
+    std::move(leaf->keys + half, leaf->keys + leaf->n, sibling->keys);
+    std::move(leaf->values + half, leaf->values + leaf->n, sibling->values);
+    leaf->n = half;
+    sibling->next = leaf->next;
+    leaf->next = sibling;
+    *separator = sibling->keys[0];
+    *right = sibling;
+    return true;
+  }
+
+  auto* inner = static_cast<Inner*>(node);
+  const int slot = child_slot(inner, key);
+  Node* child_right = nullptr;
+  std::string child_separator;
+  if (!insert(inner->children[slot], key, value, value_len, &child_right, &child_separator)) {
+    return false;
+  }
+  if (child_right == nullptr) {
+    return true;
+  }
+  std::move_backward(inner->keys + slot, inner->keys + inner->n, inner->keys + inner->n + 1);
+  std::move_backward(inner->children + slot + 1, inner->children + inner->n + 1, inner->children + inner->n + 2);
+  inner->keys[slot] = std::move(child_separator);
+  inner->children[slot + 1] = child_right;
+  if (++inner->n <= kFanout) {
+    return true;
+  }
+  // the middle key moves up, the keys and children after it go to the sibling
+  auto* sibling = new Inner;
+  const int mid = inner->n / 2;
+  sibling->n = inner->n - mid - 1;
+  std::move(inner->keys + mid + 1, inner->keys + inner->n, sibling->keys);
+  std::copy(inner->children + mid + 1, inner->children + inner->n + 1, sibling->children);
+  *separator = std::move(inner->keys[mid]);
+  inner->n = mid;
+  *right = sibling;
+  return true;
+}
+
+BTree::Leaf* BTree::find_leaf(const std::string& key) const {
+  Node* node = root_;
+  while (!node->leaf) {
+    auto* inner = static_cast<Inner*>(node);
+    node = inner->children[child_slot(inner, key)];
+  }
+  return static_cast<Leaf*>(node);
+}
+
+void BTree::overwrite(const std::string& key, const char* value, size_t value_len) {
+  Leaf* leaf = find_leaf(key);
+  const int slot = lower_slot(leaf, key);
+  if (slot < leaf->n && leaf->keys[slot] == key) {
+    // no record moves, positions stay valid
+    leaf->values[slot]->assign(value, value_len);
+    return;
+  }
+  insert(key, value, value_len);
+}
+
+const std::string* BTree::find(const std::string& key) const {
+  const Leaf* leaf = find_leaf(key);
+  const int slot = lower_slot(leaf, key);
+  if (slot < leaf->n && leaf->keys[slot] == key) {
+    return leaf->values[slot].get();
+  }
+  return nullptr;
+}
+
+BTree::Position BTree::lower_bound(const std::string& key) const {
+  Position p{find_leaf(key), 0};
+  p.pos = lower_slot(p.leaf, key);
+  if (p.leaf->n <= p.pos) {
+    // every key of the leaf is less, the next leaf starts after key
+    p.pos = p.leaf->n - 1;
+    p.next();
+  }
+  return p;
+}
+
+BTree::Position BTree::upper_bound(const std::string& key) const {
+  Position p = lower_bound(key);
+  if (!p.end() && p.key() == key) {
+    p.next();
+  }
+  return p;
+}
+
+}  // namespace reir
@@ -0,0 +1,91 @@
+#ifndef REIR_BTREE_HPP_
+#define REIR_BTREE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace reir {
+
+// an in-memory B+-tree of byte string keys, for a single thread. a node keeps its
+// keys in one array so a search stays in a few cache lines, and leaves are
+// chained for scans. values live out of the leaves so pointers to them stay valid
+// while later inserts shift and split the leaves
+class BTree {
+ public:
+  static const int kFanout = 32;
+
+  struct Node {
+    explicit Node(bool l) : leaf(l), n(0) {}
+    bool leaf;
+    int n;
+    std::string keys[kFanout + 1];  // one over, a node splits after it overflows
+  };
+  struct Leaf : public Node {
+    Leaf() : Node(true), next(nullptr) {}
+    std::unique_ptr<std::string> values[kFanout + 1];
+    Leaf* next;
+  };
+  struct Inner : public Node {
+    Inner() : Node(false) {}
+    Node* children[kFanout + 2];
+  };
+
+  // a record, or the end when leaf is null
+  struct Position {
+    Leaf* leaf;
+    int pos;
+    bool end() const {
+      return leaf == nullptr;
+    }
+    const std::string& key() const {
+      return leaf->keys[pos];
+    }
+    const std::string& value() const {
+      return *leaf->values[pos];
+    }
+    void next();
+  };
+
+  BTree();
+  ~BTree();
+  BTree(const BTree&) = delete;
+  BTree& operator=(const BTree&) = delete;
+
+  // false if the key is there already
+  bool insert(const std::string& key, const char* value, size_t value_len);
+  // replaces the value of key in place, or inserts it when it is not there
+  void overwrite(const std::string& key, const char* value, size_t value_len);
+  // null if not found
+  const std::string* find(const std::string& key) const;
+  // the first record with a key not less than key
+  Position lower_bound(const std::string& key) const;
+  // the first record with a key greater than key
+  Position upper_bound(const std::string& key) const;
+
+  size_t size() const {
+    return size_;
+  }
+  // changes at every insert of a new key. a position taken under another version may point
+  // at a moved record and has to be searched again
+  uint64_t version() const {
+    return version_;
+  }
+
+ private:
+  // inserts under node. when node splits, the new right sibling and the
+  // separator go to right and separator
+  bool insert(Node* node, const std::string& key, const char* value, size_t value_len,
+              Node** right, std::string* separator);
+  Leaf* find_leaf(const std::string& key) const;
+  void destroy(Node* node);
+
+  Node* root_;
+  size_t size_;
+  uint64_t version_;
+};
+
+}  // namespace reir
+
+#endif  // REIR_BTREE_HPP_
@@ -4,7 +4,7 @@
 namespace reir {
 
 DBHandle::DBHandle(const std::string& name) : name_(name) {
-  if (name == "foedus") {
+  if (name == "foedus" || name == "leveldb" || name == "memory") {
   } else {
     throw std::runtime_error("unknown db type: " + name);
   }
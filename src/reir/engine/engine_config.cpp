@@ -0,0 +1,170 @@
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include "engine_config.hpp"
+
+namespace reir {
+
+namespace {
+
+std::string trim(const std::string& s) {
+  const auto begin = s.find_first_not_of(" \t\r");
+  if (begin == std::string::npos) {
+    return "";
+  }
+  const auto end = s.find_last_not_of(" \t\r");
+  return s.substr(begin, end - begin + 1);
+}
+
+uint32_t parse_uint(const std::string& key, const std::string& value) {
+  size_t pos = 0;
+  unsigned long long v = 0;
+  try {
+    v = std::stoull(value, &pos);
+  } catch (const std::exception&) {
+    pos = 0;
+  }
+  if (pos == 0 || pos != value.size() || value[0] == '-' ||
+      std::numeric_limits<uint32_t>::max() < v) {
+    throw std::runtime_error("engine config: " + key + " needs a non-negative integer, got '" + value + "'");
+  }
+  return static_cast<uint32_t>(v);
+}
+
+bool parse_bool(const std::string& key, const std::string& value) {
+  if (value == "true" || value == "1" || value == "on") {
+    return true;
+  }
+  if (value == "false" || value == "0" || value == "off") {
+    return false;
+  }
+  throw std::runtime_error("engine config: " + key + " needs true or false, got '" + value + "'");
+}
+
+}  // anonymous namespace
+
+void EngineConfig::set(const std::string& key, const std::string& value) {
+  auto uint_field = [&](uint32_t EngineConfig::* field) {
+    return [this, field](const std::string& k, const std::string& v) { this->*field = parse_uint(k, v); };
+  };
+  auto bool_field = [&](bool EngineConfig::* field) {
+    return [this, field](const std::string& k, const std::string& v) { this->*field = parse_bool(k, v); };
+  };
+  auto string_field = [&](std::string EngineConfig::* field) {
+    return [this, field](const std::string&, const std::string& v) { this->*field = v; };
+  };
+  const std::map<std::string, std::function<void(const std::string&, const std::string&)>> setters = {
+      {"page_pool_size_mb_per_node", uint_field(&EngineConfig::page_pool_size_mb_per_node)},
+      {"private_page_pool_initial_grab", uint_field(&EngineConfig::private_page_pool_initial_grab)},
+      {"snapshot_cache_size_mb_per_node", uint_field(&EngineConfig::snapshot_cache_size_mb_per_node)},
+      {"private_snapshot_cache_initial_grab", uint_field(&EngineConfig::private_snapshot_cache_initial_grab)},
+      {"use_numa_alloc", bool_field(&EngineConfig::use_numa_alloc)},
+      {"log_dir", string_field(&EngineConfig::log_dir)},
+      {"snapshot_dir", string_field(&EngineConfig::snapshot_dir)},
+      {"log_buffer_kb", uint_field(&EngineConfig::log_buffer_kb)},
+      {"loggers_per_node", uint_field(&EngineConfig::loggers_per_node)},
+      {"flush_at_shutdown", bool_field(&EngineConfig::flush_at_shutdown)},
+      {"log_mapper_io_buffer_mb", uint_field(&EngineConfig::log_mapper_io_buffer_mb)},
+      {"log_reducer_buffer_mb", uint_field(&EngineConfig::log_reducer_buffer_mb)},
+      {"log_reducer_dump_io_buffer_mb", uint_field(&EngineConfig::log_reducer_dump_io_buffer_mb)},
+      {"snapshot_writer_page_pool_size_mb", uint_field(&EngineConfig::snapshot_writer_page_pool_size_mb)},
+      {"snapshot_writer_intermediate_pool_size_mb",
+       uint_field(&EngineConfig::snapshot_writer_intermediate_pool_size_mb)},
+      {"threads", uint_field(&EngineConfig::threads)},
+      {"thread_groups", uint_field(&EngineConfig::thread_groups)},
+      {"max_read_set_size", uint_field(&EngineConfig::max_read_set_size)},
+      {"max_write_set_size", uint_field(&EngineConfig::max_write_set_size)},
+      {"max_storages", uint_field(&EngineConfig::max_storages)},
+      {"backend", string_field(&EngineConfig::backend)},
+      {"leveldb_dir", string_field(&EngineConfig::leveldb_dir)},
+      {"leveldb_block_cache_mb", uint_field(&EngineConfig::leveldb_block_cache_mb)},
+      {"leveldb_bloom_bits", uint_field(&EngineConfig::leveldb_bloom_bits)},
+      {"leveldb_write_buffer_mb", uint_field(&EngineConfig::leveldb_write_buffer_mb)},
+      {"leveldb_sync", bool_field(&EngineConfig::leveldb_sync)},
+  };
+  auto it = setters.find(key);
+  if (it == setters.end()) {
+    throw std::runtime_error("engine config: unknown option '" + key + "'");
+  }
+  it->second(key, value);
+}
+
+void EngineConfig::load_file(const std::string& path) {
+  std::ifstream in(path);
+  if (!in.is_open()) {
+    throw std::runtime_error("engine config: can not open " + path);
+  }
+  std::string line;
+  for (int lineno = 1; std::getline(in, line); ++lineno) {
+    const auto comment = line.find('#');
+    if (comment != std::string::npos) {
+      line.resize(comment);
+    }
+    line = trim(line);
+    if (line.empty()) {
+      continue;
+    }
+    const auto eq = line.find('=');
+    if (eq == std::string::npos) {
+      throw std::runtime_error("engine config: " + path + ":" + std::to_string(lineno) + ": expected key = value");
+    }
+    set(trim(line.substr(0, eq)), trim(line.substr(eq + 1)));
+  }
+}
+
+void EngineConfig::validate() const {
+  std::stringstream errors;
+  auto check = [&](bool ok, const std::string& message) {
+    if (!ok) {
+      errors << "\n  " << message;
+    }
+  };
+  if (backend == "leveldb") {
+    check(!leveldb_dir.empty(), "leveldb_dir is empty");
+    check(1 <= leveldb_write_buffer_mb, "leveldb_write_buffer_mb must be at least 1");
+    check(leveldb_bloom_bits <= 64, "leveldb_bloom_bits can not exceed 64");
+    const auto message = errors.str();
+    if (!message.empty()) {
+      throw std::runtime_error("invalid engine config:" + message);
+    }
+    return;
+  }
+  if (backend == "memory") {
+    return;  // nothing to size
+  }
+  check(backend == "foedus", "backend must be foedus, leveldb or memory");
+  check(1 <= threads, "threads must be at least 1");
+  check(thread_groups <= threads, "thread_groups can not exceed threads");
+  if (threads != 0) {
+    const uint32_t groups = thread_groups == 0 ? 1 : thread_groups;
+    // a thread is addressed by an 8 bit ordinal inside its group
+    check((threads + groups - 1) / groups <= 255, "at most 255 threads per thread group");
+  }
+  // the engine needs some pages besides what the workers grab for themselves
+  check(8 <= page_pool_size_mb_per_node, "page_pool_size_mb_per_node must be at least 8");
+  const uint64_t grab_mb = uint64_t(private_page_pool_initial_grab) * 4 * threads / 1024;
+  check(grab_mb < page_pool_size_mb_per_node,
+        "private_page_pool_initial_grab of every thread does not fit in page_pool_size_mb_per_node");
+  check(1 <= private_page_pool_initial_grab, "private_page_pool_initial_grab must be at least 1");
+  check(2 <= snapshot_cache_size_mb_per_node, "snapshot_cache_size_mb_per_node must be at least 2");
+  check(256 <= log_buffer_kb, "log_buffer_kb must be at least 256");
+  check(1 <= loggers_per_node, "loggers_per_node must be at least 1");
+  check(!log_dir.empty(), "log_dir is empty");
+  check(!snapshot_dir.empty(), "snapshot_dir is empty");
+  check(1 <= log_mapper_io_buffer_mb && 1 <= log_reducer_buffer_mb && 1 <= log_reducer_dump_io_buffer_mb &&
+        1 <= snapshot_writer_page_pool_size_mb && 1 <= snapshot_writer_intermediate_pool_size_mb,
+        "snapshot buffers must be at least 1MB");
+  check(1 <= max_read_set_size, "max_read_set_size must be at least 1");
+  check(1 <= max_write_set_size, "max_write_set_size must be at least 1");
+  check(1 <= max_storages, "max_storages must be at least 1");
+  const auto message = errors.str();
+  if (!message.empty()) {
+    throw std::runtime_error("invalid engine config:" + message);
+  }
+}
+
+}  // namespace reir
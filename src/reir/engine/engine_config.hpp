@@ -0,0 +1,63 @@
+#ifndef REIR_ENGINE_CONFIG_HPP_
+#define REIR_ENGINE_CONFIG_HPP_
+
+#include <cstdint>
+#include <string>
+
+namespace reir {
+
+// how the storage engine is sized and laid out. the defaults fit a server
+// with a few GB per NUMA node, tests and small runs can shrink the pools.
+// every field can be set by name with set(), from a file or from reirc flags.
+struct EngineConfig {
+  // memory, per NUMA node
+  uint32_t page_pool_size_mb_per_node = 1024;
+  uint32_t private_page_pool_initial_grab = 64;  // pages a worker takes from the pool at a time
+  uint32_t snapshot_cache_size_mb_per_node = 256;
+  uint32_t private_snapshot_cache_initial_grab = 64;
+  bool use_numa_alloc = true;
+
+  // log and snapshot folders. per node and logger folders are made under them
+  std::string log_dir = "./log";
+  std::string snapshot_dir = "./snapshot";
+  uint32_t log_buffer_kb = 64 * 1024;
+  uint32_t loggers_per_node = 1;
+  bool flush_at_shutdown = true;
+
+  // buffers of the snapshot writer
+  uint32_t log_mapper_io_buffer_mb = 64;
+  uint32_t log_reducer_buffer_mb = 256;
+  uint32_t log_reducer_dump_io_buffer_mb = 64;
+  uint32_t snapshot_writer_page_pool_size_mb = 128;
+  uint32_t snapshot_writer_intermediate_pool_size_mb = 16;
+
+  // threads. one worker runs the query, the others are there for parallel for and scan
+  uint32_t threads = 1;
+  uint32_t thread_groups = 0;  // 0 means one per NUMA node, as long as there are threads for them
+
+  // transactions
+  uint32_t max_read_set_size = 32 * 1024;
+  uint32_t max_write_set_size = 16 * 1024;
+  uint32_t max_storages = 128;
+
+  // foedus, leveldb or memory. leveldb keeps the tables in a LevelDB database, for
+  // small machines where the page pools above are overkill. memory keeps them in a
+  // B+-tree that goes away with the process. both ignore the options above
+  std::string backend = "foedus";
+  std::string leveldb_dir = "./reir.ldb";
+  uint32_t leveldb_block_cache_mb = 64;
+  uint32_t leveldb_bloom_bits = 10;  // bits per key of the bloom filters, 0 turns them off
+  uint32_t leveldb_write_buffer_mb = 4;
+  bool leveldb_sync = false;  // fsync the log at every commit
+
+  // key = value, throws on an unknown key or a malformed value
+  void set(const std::string& key, const std::string& value);
+  // one key = value per line, # starts a comment
+  void load_file(const std::string& path);
+  // throws with every problem found, called by the engine at startup
+  void validate() const;
+};
+
+}  // namespace reir
+
+#endif  // REIR_ENGINE_CONFIG_HPP_
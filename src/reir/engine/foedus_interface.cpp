@@ -2,21 +2,532 @@
 #include <foedus/storage/masstree/masstree_storage.hpp>
 #include <foedus/storage/masstree/masstree_cursor.hpp>
 #include <foedus/xct/xct_manager.hpp>
+#include <foedus/thread/thread.hpp>
+#include <foedus/thread/thread_pool.hpp>
+#include <foedus/thread/impersonate_session.hpp>
+#include <foedus/storage/masstree/masstree_id.hpp>
+#include <foedus/storage/array/array_storage.hpp>
+#include <foedus/storage/hash/hash_storage.hpp>
+#include <foedus/storage/hash/hash_hashinate.hpp>
+#include <foedus/storage/sequential/sequential_cursor.hpp>
+#include <foedus/storage/sequential/sequential_id.hpp>
+#include <foedus/storage/sequential/sequential_storage.hpp>
+#include <foedus/assorted/endianness.hpp>
 #include <foedus/engine.hpp>
-#include <iostream>
+#include <foedus/engine_options.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "foedus_interface.hpp"
+#include "attempt.hpp"
+#include "parallel_range.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+namespace reir {
+
+// every cursor handed to the generated code derives from this, so a single
+// destroy frees a cursor of any storage
+struct FoedusCursorBase {
+  virtual ~FoedusCursorBase() = default;
+};
+
+struct FoedusScanCursor : public FoedusCursorBase {
+  FoedusScanCursor(::foedus::storage::masstree::MasstreeStorage& storage,
+                   ::foedus::thread::Thread* context)
+      : cursor_(storage, context), key_ready_(false) {}
+
+  ::foedus::storage::masstree::MasstreeCursor cursor_;
+  bool key_ready_;
+  char key_[::foedus::storage::masstree::kMaxKeyLength];
+};
+
+namespace {
+
+// integer key columns are big-endian with the sign bit flipped, see encode_key_column
+int64_t decode_integer(const char* p) {
+  return static_cast<int64_t>(::foedus::assorted::read_bigendian<uint64_t>(p) ^ (1ULL << 63));
+}
+
+void encode_integer(int64_t v, char* p) {
+  ::foedus::assorted::write_bigendian<uint64_t>(static_cast<uint64_t>(v) ^ (1ULL << 63), p);
+}
+
+// the offset of an array row is its integer key
+bool array_offset(const ::foedus::storage::array::ArrayStorage& array, uint64_t prefix_len,
+                  const char* key, uint64_t key_len, ::foedus::storage::array::ArrayOffset* offset) {
+  if (key_len < prefix_len + 8) {
+    return false;
+  }
+  const int64_t k = decode_integer(key + prefix_len);
+  if (k < 0 || static_cast<uint64_t>(k) >= array.get_array_size()) {
+    return false;
+  }
+  *offset = static_cast<::foedus::storage::array::ArrayOffset>(k);
+  return true;
+}
+
+// the offsets in [from, to), bounds as built by Scan::build_range_key. a bound
+// of just the prefix is open, one padded with 0xff past the integer sorts after
+// that key and a bare one before it
+void array_range(const ::foedus::storage::array::ArrayStorage& array, uint64_t prefix_len,
+                 const char* from, uint64_t from_len, const char* to, uint64_t to_len,
+                 uint64_t* begin, uint64_t* end) {
+  const auto size = static_cast<int64_t>(array.get_array_size());
+  auto bound = [&](const char* key, uint64_t len, int64_t open) {
+    if (len < prefix_len + 8) {
+      return open;
+    }
+    const int64_t k = decode_integer(key + prefix_len);
+    const bool after = prefix_len + 8 < len;
+    return after && k < std::numeric_limits<int64_t>::max() ? k + 1 : k;
+  };
+  const int64_t b = std::min(std::max<int64_t>(bound(from, from_len, 0), 0), size);
+  const int64_t e = std::min(std::max<int64_t>(bound(to, to_len, size), b), size);
+  *begin = static_cast<uint64_t>(b);
+  *end = static_cast<uint64_t>(e);
+}
+
+int compare_key(const char* key, uint64_t len, const std::string& bound) {
+  const int c = std::memcmp(key, bound.data(), std::min<uint64_t>(len, bound.size()));
+  if (c != 0) {
+    return c;
+  }
+  return len < bound.size() ? -1 : (bound.size() < len ? 1 : 0);
+}
+
+// the rows of a batch in the order they are written, rows that sort together go
+// one after another and mostly land in the same page. stable, so of two rows with
+// the same key the one written first is still the one given first
+template <typename Less>
+std::vector<uint32_t> write_order(uint64_t n, Less less) {
+  std::vector<uint32_t> order(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), less);
+  return order;
+}
+
+}  // anonymous namespace
+
+// walks the offsets of an array, every offset is a row
+struct FoedusArrayCursor : public FoedusCursorBase {
+  FoedusArrayCursor(::foedus::Engine* engine, ::foedus::storage::StorageId storage,
+                    ::foedus::thread::Thread* context, uint64_t prefix_len)
+      : array_(engine, storage), context_(context), prefix_len_(prefix_len),
+        current_(0), end_(0), payload_(nullptr), zeros_(array_.get_payload_size()) {}
+
+  void open(const char* from, uint64_t from_len, const char* to, uint64_t to_len) {
+    // prefix, the offset as a key column and the zero byte every key ends with
+    key_.assign(from, prefix_len_);
+    key_.resize(prefix_len_ + 9, '\0');
+    array_range(array_, prefix_len_, from, from_len, to, to_len, &current_, &end_);
+    payload_ = nullptr;
+  }
+
+  const char* key() {
+    encode_integer(static_cast<int64_t>(current_), &key_[prefix_len_]);
+    return key_.data();
+  }
+
+  // points into the record page, read on first use
+  const char* value() {
+    if (payload_ == nullptr) {
+      auto ret = array_.get_record_payload(context_, current_, &payload_);
+      if (ret != ::foedus::kErrorCodeOk) {
+        REIR_TRACE_ERROR("foedus error:[array cursor]: %s", ::foedus::get_error_message(ret));
+        payload_ = zeros_.data();
+      }
+    }
+    return static_cast<const char*>(payload_);
+  }
+
+  void next() {
+    ++current_;
+    payload_ = nullptr;
+  }
+
+  ::foedus::storage::array::ArrayStorage array_;
+  ::foedus::thread::Thread* context_;
+  uint64_t prefix_len_;
+  uint64_t current_;
+  uint64_t end_;
+  const void* payload_;
+  std::vector<char> zeros_;
+  std::string key_;
+};
+
+// a sequential storage is read in no particular order, rows outside [from, to) are skipped.
+// a record is the key followed by the value
+struct FoedusSequentialCursor : public FoedusCursorBase {
+  static const uint64_t kBufferSize = 1 << 20;  // snapshot pages are read into it
+
+  FoedusSequentialCursor(::foedus::Engine* engine, ::foedus::storage::StorageId storage,
+                         ::foedus::thread::Thread* context, uint64_t key_len)
+      : storage_(engine, storage), context_(context), key_len_(key_len),
+        buffer_(new char[kBufferSize]), valid_(false) {}
+
+  void open(const char* from, uint64_t from_len, const char* to, uint64_t to_len) {
+    from_.assign(from, from_len);
+    to_.assign(to, to_len);
+    cursor_.reset(new ::foedus::storage::sequential::SequentialCursor(context_, storage_, buffer_.get(),
+                                                                      kBufferSize));
+    records_ = ::foedus::storage::sequential::SequentialRecordIterator();
+    valid_ = true;
+    skip();
+  }
+
+  // stays on the current record if it is in the range, else moves to the next one that is
+  void skip() {
+    for (;;) {
+      while (records_.is_valid()) {
+        const char* key = records_.get_cur_record_raw();
+        if (0 <= compare_key(key, key_len_, from_) && compare_key(key, key_len_, to_) < 0) {
+          return;
+        }
+        records_.next();
+      }
+      if (!cursor_->is_valid()) {
+        valid_ = false;
+        return;
+      }
+      auto ret = cursor_->next_batch(&records_);
+      if (ret != ::foedus::kErrorCodeOk) {
+        REIR_TRACE_ERROR("foedus error:[sequential cursor]: %s", ::foedus::get_error_message(ret));
+        valid_ = false;
+        return;
+      }
+    }
+  }
+
+  void next() {
+    records_.next();
+    skip();
+  }
+
+  ::foedus::storage::sequential::SequentialStorage storage_;
+  ::foedus::thread::Thread* context_;
+  uint64_t key_len_;
+  std::string from_;
+  std::string to_;
+  std::unique_ptr<char[]> buffer_;
+  std::unique_ptr<::foedus::storage::sequential::SequentialCursor> cursor_;
+  ::foedus::storage::sequential::SequentialRecordIterator records_;
+  bool valid_;
+};
+
+typedef void (*ParallelBody)(foedus::proc::ProcArguments* proc, void* env, int64_t i);
+typedef void (*MorselBody)(foedus::proc::ProcArguments* proc, void* env,
+                           const char* from, uint64_t from_len,
+                           const char* to, uint64_t to_len);
+
+// work shared by the workers of a parallel for or a parallel scan
+struct ParallelTask {
+  virtual ~ParallelTask() = default;
+  // the stats procedure of the caller, the workers record into it too
+  StatsProcedure* stats_ = nullptr;
+
+  // runs the next piece of work of the worker's own node, false once there is none left
+  virtual bool run_one(foedus::proc::ProcArguments* proc, ::foedus::Epoch* last_commit) = 0;
+  // runs the next piece of work of any node, own first
+  virtual bool run_any(foedus::proc::ProcArguments* proc, ::foedus::Epoch* last_commit) {
+    return run_one(proc, last_commit);
+  }
+  virtual bool done() const = 0;
+  // true if a worker only takes the work of its own NUMA node
+  virtual bool pinned() const { return false; }
+  virtual bool done_on(uint16_t node) const { return done(); }
+
+  // the first error of any worker, the others stop at their next piece of work
+  // and dispatch throws it once they are all back
+  void fail(const char* what, ::foedus::ErrorCode ret) {
+    REIR_TRACE_ERROR("foedus error:[%s]: %s", what, ::foedus::get_error_message(ret));
+    std::lock_guard<std::mutex> lk(error_mutex_);
+    if (!failed_.load()) {
+      error_ = std::string(what) + ": " + ::foedus::get_error_message(ret);
+      failed_.store(true);
+    }
+  }
+  bool failed() const { return failed_.load(); }
+  const std::string& error() const { return error_; }
+
+  // runs body in a transaction, again when it lost a race with another worker.
+  // what an attempt emits is only merged once it commits.
+  // false if it failed for any other reason
+  template <typename Body>
+  bool run_xct(foedus::proc::ProcArguments* proc, ::foedus::Epoch* last_commit, Body body) {
+    auto* xct_manager = proc->engine_->get_xct_manager();
+    for (;;) {
+      auto ret = xct_manager->begin_xct(proc->context_, ::foedus::xct::kSerializable);
+      if (ret != ::foedus::kErrorCodeOk) {
+        fail("parallel begin_xct", ret);
+        return false;
+      }
+      stats_xct_begin();
+      attempt_begin();
+      body();
+      ::foedus::Epoch commit_epoch;
+      ret = xct_manager->precommit_xct(proc->context_, &commit_epoch);
+      attempt_end(ret == ::foedus::kErrorCodeOk);
+      if (ret == ::foedus::kErrorCodeOk) {
+        stats_xct_committed();
+        last_commit->store_max(commit_epoch);
+        return true;
+      }
+      stats_xct_aborted(::foedus::get_error_name(ret));
+      if (ret != ::foedus::kErrorCodeXctRaceAbort) {
+        fail("parallel precommit", ret);
+        return false;
+      }
+      stats_xct_retried();
+    }
+  }
+
+  void run(foedus::proc::ProcArguments* proc) {
+    ::foedus::Epoch last_commit;
+    while (!failed() && run_one(proc, &last_commit)) {}
+    // no idle worker may have been found for some node, its work is left to
+    // whoever is done with its own
+    while (!failed() && run_any(proc, &last_commit)) {}
+    // group commit, wait for the log once per worker instead of once per transaction.
+    // only the last transaction of the worker gets a commit to durable sample
+    if (last_commit.is_valid()) {
+      proc->engine_->get_xct_manager()->wait_for_commit(last_commit);
+      stats_xct_durable();
+    }
+  }
+
+ private:
+  std::atomic<bool> failed_{false};
+  std::mutex error_mutex_;
+  std::string error_;
+};
+
+// workers take batch iterations at a time, each iteration is a transaction.
+// partitioned, iteration i belongs to NUMA node i mod nodes and workers take the
+// ones of their node first, so the pages it allocates come from that node's pool
+struct ParallelLoop : public ParallelTask {
+  ParallelBody body_;
+  void* env_;
+  ParallelRange range_;  // nodes is 1 unless partitioned
+
+  ParallelLoop(ParallelBody body, void* env, int64_t from, int64_t to, int64_t batch, uint16_t nodes)
+      : body_(body), env_(env), range_(from, to, batch, nodes) {}
+
+  bool run_batch(foedus::proc::ProcArguments* proc, int64_t first, int64_t count,
+                 ::foedus::Epoch* last_commit) {
+    for (int64_t k = 0; k < count; ++k) {
+      if (!run_iteration(proc, first + k * range_.nodes(), last_commit)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  uint16_t node_of(foedus::proc::ProcArguments* proc) const {
+    return range_.nodes() == 1 ? 0 : static_cast<uint16_t>(proc->context_->get_numa_node() % range_.nodes());
+  }
+
+  bool run_one(foedus::proc::ProcArguments* proc, ::foedus::Epoch* last_commit) override {
+    int64_t first;
+    int64_t count;
+    return range_.take(node_of(proc), &first, &count) && run_batch(proc, first, count, last_commit);
+  }
+
+  bool run_any(foedus::proc::ProcArguments* proc, ::foedus::Epoch* last_commit) override {
+    int64_t first;
+    int64_t count;
+    return range_.take_any(node_of(proc), &first, &count) && run_batch(proc, first, count, last_commit);
+  }
+
+  bool pinned() const override {
+    return 1 < range_.nodes();
+  }
+
+  bool done_on(uint16_t node) const override {
+    return range_.done_on(node);
+  }
+
+  bool done() const override {
+    return range_.done();
+  }
+
+  bool run_iteration(foedus::proc::ProcArguments* proc, int64_t i, ::foedus::Epoch* last_commit) {
+    return run_xct(proc, last_commit, [&] { body_(proc, env_, i); });
+  }
+};
+
+// workers take one morsel, a key range between two bounds, at a time. the
+// caller reads its morsels in its own transaction, the others in one per morsel
+struct ParallelScan : public ParallelTask {
+  MorselBody body_;
+  void* env_;
+  foedus::proc::ProcArguments* caller_;
+  std::vector<std::string> bounds_;
+  std::atomic<uint64_t> next_;
+
+  bool run_one(foedus::proc::ProcArguments* proc, ::foedus::Epoch* last_commit) override {
+    const uint64_t i = next_.fetch_add(1);
+    if (bounds_.size() <= i + 1) {
+      return false;
+    }
+    const auto& from = bounds_[i];
+    const auto& to = bounds_[i + 1];
+    if (proc == caller_) {
+      body_(proc, env_, from.data(), from.size(), to.data(), to.size());
+      return true;
+    }
+    return run_xct(proc, last_commit, [&] {
+      body_(proc, env_, from.data(), from.size(), to.data(), to.size());
+    });
+  }
+
+  bool done() const override {
+    return bounds_.size() <= next_.load() + 1;
+  }
+};
+
+namespace {
+
+// runs task on idle workers and this thread until it is done. the JIT compiles
+// a body on its first call, so this thread makes that call before the others
+// can run into the same stub
+void dispatch(foedus::proc::ProcArguments* proc, ParallelTask& task) {
+  ::foedus::Epoch first_commit;
+  // its own node may own nothing, then one remote piece is better than none
+  if (!task.run_any(proc, &first_commit)) {
+    if (task.failed()) {
+      throw std::runtime_error(task.error());
+    }
+    return;
+  }
+  auto* pool = proc->engine_->get_thread_pool();
+  std::vector<::foedus::thread::ImpersonateSession> sessions;
+  task.stats_ = stats_current_procedure();
+  ParallelTask* shared = &task;
+  if (task.pinned()) {
+    const uint16_t nodes = proc->engine_->get_options().thread_.group_count_;
+    for (uint16_t node = 0; node < nodes; ++node) {
+      while (!task.done_on(node)) {
+        ::foedus::thread::ImpersonateSession session;
+        if (!pool->impersonate_on_numa_node(node, "reir_parallel", &shared, sizeof(shared), &session)) {
+          break;  // no idle worker left on this node
+        }
+        sessions.emplace_back(std::move(session));
+      }
+    }
+  } else {
+    while (!task.done()) {
+      ::foedus::thread::ImpersonateSession session;
+      if (!pool->impersonate("reir_parallel", &shared, sizeof(shared), &session)) {
+        break;  // no idle worker left
+      }
+      sessions.emplace_back(std::move(session));
+    }
+  }
+  task.run(proc);  // this thread takes its share too
+  for (auto& session : sessions) {
+    auto result = session.get_result();
+    if (result.is_error()) {
+      std::stringstream message;
+      message << result;
+      REIR_TRACE_ERROR("foedus error:[parallel worker]: %s", message.str().c_str());
+    }
+    session.release();
+  }
+  if (first_commit.is_valid()) {
+    proc->engine_->get_xct_manager()->wait_for_commit(first_commit);
+    stats_xct_durable();
+  }
+  if (task.failed()) {
+    throw std::runtime_error(task.error());
+  }
+}
+
+// morsel bounds for [from, to). the range is cut at the border pages of the
+// masstree layer below the common prefix, so every morsel is made of whole
+// leaves, then neighbours are merged down to about max_morsels
+std::vector<std::string> split_range(foedus::proc::ProcArguments* proc,
+                                     const char* from, uint64_t from_len,
+                                     const char* to, uint64_t to_len,
+                                     uint32_t max_morsels) {
+  namespace masstree = ::foedus::storage::masstree;
+  static const uint32_t kMaxBoundaries = 4096;
+  std::vector<std::string> bounds{std::string(from, from_len)};
+
+  uint64_t common = 0;
+  while (common < from_len && common < to_len && from[common] == to[common]) {
+    ++common;
+  }
+  const auto layer = static_cast<uint32_t>(common / sizeof(masstree::KeySlice));
+  std::vector<masstree::KeySlice> prefix_slices(layer);
+  for (uint32_t i = 0; i < layer; ++i) {
+    prefix_slices[i] = masstree::slice_layer(from, static_cast<masstree::KeyLength>(from_len), i);
+  }
+  std::vector<masstree::KeySlice> found(kMaxBoundaries);
+  uint32_t found_count = 0;
+  masstree::MasstreeStorage::PeekBoundariesArguments args = {
+      prefix_slices.data(),
+      layer,
+      kMaxBoundaries,
+      masstree::slice_layer(from, static_cast<masstree::KeyLength>(from_len), layer),
+      masstree::slice_layer(to, static_cast<masstree::KeyLength>(to_len), layer),
+      found.data(),
+      &found_count};
+  masstree::MasstreeStorage db(proc->engine_, "db");
+  auto ret = db.peek_volatile_page_boundaries(proc->engine_, args);
+  if (ret != ::foedus::kErrorCodeOk) {
+    REIR_TRACE_ERROR("foedus error:[peek_boundaries]: %s", ::foedus::get_error_message(ret));
+    found_count = 0;
+  }
+
+  const std::string end(to, to_len);
+  const uint32_t step = found_count / std::max<uint32_t>(max_morsels, 1) + 1;
+  for (uint32_t i = step - 1; i < found_count; i += step) {
+    std::string bound(from, layer * sizeof(masstree::KeySlice));
+    char slice[sizeof(masstree::KeySlice)];
+    ::foedus::assorted::write_bigendian<masstree::KeySlice>(found[i], slice);
+    bound.append(slice, sizeof(slice));
+    if (bounds.back() < bound && bound < end) {
+      bounds.emplace_back(std::move(bound));
+    }
+  }
+  bounds.emplace_back(end);
+  return bounds;
+}
+
+}  // anonymous namespace
+
+foedus::ErrorStack foedus_parallel_worker(const foedus::proc::ProcArguments& arg) {
+  ParallelTask* task;
+  std::memcpy(&task, arg.input_buffer_, sizeof(task));
+  StatsScope scope(task->stats_);
+  task->run(const_cast<foedus::proc::ProcArguments*>(&arg));
+  return foedus::kRetOk;
+}
+
+}  // namespace reir
 
 bool begin_xct(foedus::proc::ProcArguments *proc) {
-  std::cout << "FOEDUS transaction started " << std::endl;
+  REIR_TRACE_DEBUG("begin_xct");
   auto* engine = proc->engine_;
   auto* ctx = proc->context_;
   auto* xct_manager = engine->get_xct_manager();
   auto ret = xct_manager->begin_xct(ctx, ::foedus::xct::kSerializable);
   if (ret == ::foedus::kErrorCodeOk) {
+    reir::stats_xct_begin();
     return true;
   } else {
-    std::cout << "foedus error:[begin_xct]: "<< ::foedus::get_error_message(ret) << "\n";
+    REIR_TRACE_ERROR("foedus error:[begin_xct]: %s", ::foedus::get_error_message(ret));
     return false;
   }
 }
@@ -30,61 +541,492 @@ bool foedus_insert(foedus::proc::ProcArguments* proc,
                               key, static_cast<foedus::storage::masstree::KeyLength>(key_len),
                               value, static_cast<foedus::storage::masstree::PayloadLength>(value_len));
   if (ret != ::foedus::kErrorCodeOk) {
-    std::cout << "foedus error:[insert]: "<< ::foedus::get_error_message(ret) << "\n";
+    REIR_TRACE_ERROR("foedus error:[insert]: %s", ::foedus::get_error_message(ret));
     return false;
   } else {
+    reir::stats_rows_written();
     return true;
   }
 }
 
-foedus::storage::masstree::MasstreeCursor* foedus_generate_cursor(foedus::proc::ProcArguments* proc,
+uint64_t foedus_insert_batch(foedus::proc::ProcArguments* proc,
+                             const char* keys, uint64_t key_len,
+                             const char* values, uint64_t value_len,
+                             uint64_t n) {
+  auto* engine = proc->engine_;
+  ::foedus::storage::masstree::MasstreeStorage db(engine, "db");
+
+  // insert in key order, consecutive inserts then mostly land in the same border page
+  auto order = reir::write_order(n, [&](uint32_t a, uint32_t b) {
+    return std::memcmp(keys + a * key_len, keys + b * key_len, key_len) < 0;
+  });
+
+  uint64_t inserted = 0;
+  for (auto i : order) {
+    auto ret = db.insert_record(proc->context_,
+                                keys + i * key_len,
+                                static_cast<foedus::storage::masstree::KeyLength>(key_len),
+                                values + i * value_len,
+                                static_cast<foedus::storage::masstree::PayloadLength>(value_len));
+    if (ret != ::foedus::kErrorCodeOk) {
+      REIR_TRACE_ERROR("foedus error:[insert_batch]: %s", ::foedus::get_error_message(ret));
+    } else {
+      ++inserted;
+    }
+  }
+  reir::stats_rows_written(inserted);
+  return inserted;
+}
+
+void foedus_parallel_for(foedus::proc::ProcArguments* proc, void* body, void* env,
+                         int64_t from, int64_t to, int64_t batch) {
+  reir::ParallelLoop loop(reinterpret_cast<reir::ParallelBody>(body), env, from, to, batch, 1);
+  reir::dispatch(proc, loop);
+}
+
+void foedus_parallel_for_partitioned(foedus::proc::ProcArguments* proc, void* body, void* env,
+                                     int64_t from, int64_t to, int64_t batch) {
+  const uint16_t nodes = proc->engine_->get_options().thread_.group_count_;
+  reir::ParallelLoop loop(reinterpret_cast<reir::ParallelBody>(body), env, from, to, batch, nodes);
+  reir::dispatch(proc, loop);
+}
+
+void foedus_parallel_scan(foedus::proc::ProcArguments* proc, void* body, void* env,
+                          const char* from, uint64_t from_len,
+                          const char* to, uint64_t to_len) {
+  // a few morsels per worker, so a slow morsel does not hold up the whole scan
+  const uint32_t threads = proc->engine_->get_options().thread_.get_total_thread_count();
+  reir::ParallelScan scan;
+  scan.body_ = reinterpret_cast<reir::MorselBody>(body);
+  scan.env_ = env;
+  scan.caller_ = proc;
+  scan.bounds_ = reir::split_range(proc, from, from_len, to, to_len, threads * 4);
+  scan.next_ = 0;
+  reir::dispatch(proc, scan);
+}
+
+reir::FoedusScanCursor* foedus_generate_cursor(foedus::proc::ProcArguments* proc,
                             const char* from, uint64_t from_len,
                             const char* to, uint64_t to_len) {
   auto* engine = proc->engine_;
   ::foedus::storage::masstree::MasstreeStorage db(engine, "db");
 
-  auto* cursor = new foedus::storage::masstree::MasstreeCursor(db, proc->context_);
-  auto ret = cursor->open(from, static_cast<foedus::storage::masstree::KeyLength>(from_len),
+  auto* cursor = new reir::FoedusScanCursor(db, proc->context_);
+  auto ret = cursor->cursor_.open(from, static_cast<foedus::storage::masstree::KeyLength>(from_len),
                to, static_cast<foedus::storage::masstree::KeyLength>(to_len));
   if (ret != foedus::kErrorCodeOk) {
-    std::cout << "foedus error:[open_cursor]: " << ::foedus::get_error_message(ret) << "\n";
+    REIR_TRACE_ERROR("foedus error:[open_cursor]: %s", ::foedus::get_error_message(ret));
   }
   return cursor;
 }
 
-bool foedus_cursor_is_valid(foedus::storage::masstree::MasstreeCursor* cursor) {
-  return cursor->is_valid_record();
+reir::FoedusScanCursor* foedus_reopen_cursor(foedus::proc::ProcArguments* proc,
+                                             reir::FoedusScanCursor* cursor,
+                                             const char* from, uint64_t from_len,
+                                             const char* to, uint64_t to_len) {
+  if (cursor == nullptr) {
+    return foedus_generate_cursor(proc, from, from_len, to, to_len);
+  }
+  // open() resets the cursor and reuses its route buffer, so an inner scan
+  // costs no allocation per outer row
+  cursor->key_ready_ = false;
+  auto ret = cursor->cursor_.open(from, static_cast<foedus::storage::masstree::KeyLength>(from_len),
+                                  to, static_cast<foedus::storage::masstree::KeyLength>(to_len));
+  if (ret != foedus::kErrorCodeOk) {
+    REIR_TRACE_ERROR("foedus error:[reopen_cursor]: %s", ::foedus::get_error_message(ret));
+  }
+  return cursor;
 }
 
-bool foedus_next_cursor(foedus::storage::masstree::MasstreeCursor* c) {
-  c->next();
-  return c->is_valid_record();
+bool foedus_lookup(foedus::proc::ProcArguments* proc,
+                   const char* key, uint64_t key_len,
+                   char* value, uint64_t value_len) {
+  auto* engine = proc->engine_;
+  ::foedus::storage::masstree::MasstreeStorage db(engine, "db");
+  auto capacity = static_cast<foedus::storage::masstree::PayloadLength>(value_len);
+  auto ret = db.get_record(proc->context_,
+                           key, static_cast<foedus::storage::masstree::KeyLength>(key_len),
+                           value, &capacity, true);
+  if (ret == ::foedus::kErrorCodeStrKeyNotFound) {
+    return false;
+  } else if (ret != ::foedus::kErrorCodeOk) {
+    REIR_TRACE_ERROR("foedus error:[lookup]: %s", ::foedus::get_error_message(ret));
+    return false;
+  }
+  reir::stats_rows_read();
+  return true;
 }
 
-bool foedus_cursor_next(foedus::storage::masstree::MasstreeCursor* cursor) {
-  cursor->next();
-  return cursor->is_valid_record();
+bool foedus_cursor_is_valid(reir::FoedusScanCursor* cursor) {
+  return cursor->cursor_.is_valid_record();
+}
+
+bool foedus_cursor_next(reir::FoedusScanCursor* cursor) {
+  reir::stats_rows_read();
+  cursor->cursor_.next();
+  cursor->key_ready_ = false;
+  return cursor->cursor_.is_valid_record();
 }
 
-void foedus_cursor_copy_key(foedus::storage::masstree::MasstreeCursor* cursor, char* buff){
-  cursor->copy_combined_key(buff);
+void foedus_cursor_copy_key(reir::FoedusScanCursor* cursor, char* buff){
+  cursor->cursor_.copy_combined_key(buff);
 }
 
-void foedus_cursor_copy_value(foedus::storage::masstree::MasstreeCursor* cursor, char* buff) {
-  const auto* payload = cursor->get_payload();
-  size_t len = cursor->get_payload_length();
+void foedus_cursor_copy_value(reir::FoedusScanCursor* cursor, char* buff) {
+  const auto* payload = cursor->cursor_.get_payload();
+  size_t len = cursor->cursor_.get_payload_length();
   memcpy(buff, payload, len);
 }
 
-void foedus_cursor_destroy(foedus::storage::masstree::MasstreeCursor* cursor) {
+const char* foedus_cursor_get_key(reir::FoedusScanCursor* cursor) {
+  // masstree keeps the key split into slices across layers, so the combined key
+  // has to be materialized once per record. it is cached until the cursor moves.
+  if (!cursor->key_ready_) {
+    cursor->cursor_.copy_combined_key(cursor->key_);
+    cursor->key_ready_ = true;
+  }
+  return cursor->key_;
+}
+
+uint64_t foedus_cursor_get_key_length(reir::FoedusScanCursor* cursor) {
+  return cursor->cursor_.get_key_length();
+}
+
+const char* foedus_cursor_get_value(reir::FoedusScanCursor* cursor) {
+  // points directly into the record page
+  return cursor->cursor_.get_payload();
+}
+
+uint64_t foedus_cursor_get_value_length(reir::FoedusScanCursor* cursor) {
+  return cursor->cursor_.get_payload_length();
+}
+
+uint64_t foedus_cursor_next_batch(reir::FoedusScanCursor* cursor,
+                                  char* keys, uint64_t key_stride,
+                                  char* values, uint64_t value_stride,
+                                  uint64_t n) {
+  // fills up to n rows at fixed strides and leaves the cursor on the first
+  // record not copied, so one call replaces is_valid/copy_key/copy_value/next per row
+  auto& c = cursor->cursor_;
+  uint64_t filled = 0;
+  while (filled < n && c.is_valid_record()) {
+    c.copy_combined_key(keys + filled * key_stride);
+    memcpy(values + filled * value_stride, c.get_payload(), c.get_payload_length());
+    ++filled;
+    c.next();
+  }
+  cursor->key_ready_ = false;
+  reir::stats_rows_read(filled);
+  return filled;
+}
+
+void foedus_cursor_destroy(reir::FoedusCursorBase* cursor) {
   delete cursor;
 }
 
-bool foedus_destroy_cursor(foedus::storage::masstree::MasstreeCursor* c) {
-  delete c;
+bool foedus_array_insert(foedus::proc::ProcArguments* proc, uint32_t storage, uint64_t prefix_len,
+                         const char* key, uint64_t key_len,
+                         const char* value, uint64_t value_len) {
+  // every offset of an array exists, so an insert overwrites it
+  ::foedus::storage::array::ArrayStorage array(proc->engine_, storage);
+  ::foedus::storage::array::ArrayOffset offset;
+  if (!reir::array_offset(array, prefix_len, key, key_len, &offset)) {
+    REIR_TRACE_ERROR("foedus error:[array insert]: key out of the array");
+    return false;
+  }
+  auto ret = array.overwrite_record(proc->context_, offset, value, 0, static_cast<uint16_t>(value_len));
+  if (ret != ::foedus::kErrorCodeOk) {
+    REIR_TRACE_ERROR("foedus error:[array insert]: %s", ::foedus::get_error_message(ret));
+    return false;
+  }
+  reir::stats_rows_written();
+  return true;
+}
+
+uint64_t foedus_array_insert_batch(foedus::proc::ProcArguments* proc, uint32_t storage, uint64_t prefix_len,
+                                   const char* keys, uint64_t key_len,
+                                   const char* values, uint64_t value_len,
+                                   uint64_t n) {
+  // the key is the offset big-endian, in key order the writes walk the array pages in order
+  auto order = reir::write_order(n, [&](uint32_t a, uint32_t b) {
+    return std::memcmp(keys + a * key_len, keys + b * key_len, key_len) < 0;
+  });
+  uint64_t inserted = 0;
+  for (auto i : order) {
+    if (foedus_array_insert(proc, storage, prefix_len, keys + i * key_len, key_len,
+                            values + i * value_len, value_len)) {
+      ++inserted;
+    }
+  }
+  return inserted;
+}
+
+bool foedus_array_lookup(foedus::proc::ProcArguments* proc, uint32_t storage, uint64_t prefix_len,
+                         const char* key, uint64_t key_len,
+                         char* value, uint64_t value_len) {
+  ::foedus::storage::array::ArrayStorage array(proc->engine_, storage);
+  ::foedus::storage::array::ArrayOffset offset;
+  if (!reir::array_offset(array, prefix_len, key, key_len, &offset)) {
+    return false;
+  }
+  auto ret = array.get_record(proc->context_, offset, value, 0, static_cast<uint16_t>(value_len));
+  if (ret != ::foedus::kErrorCodeOk) {
+    REIR_TRACE_ERROR("foedus error:[array lookup]: %s", ::foedus::get_error_message(ret));
+    return false;
+  }
+  reir::stats_rows_read();
   return true;
 }
 
+reir::FoedusArrayCursor* foedus_array_generate_cursor(foedus::proc::ProcArguments* proc,
+                                                      uint32_t storage, uint64_t prefix_len,
+                                                      const char* from, uint64_t from_len,
+                                                      const char* to, uint64_t to_len) {
+  return foedus_array_reopen_cursor(proc, storage, prefix_len, nullptr, from, from_len, to, to_len);
+}
+
+reir::FoedusArrayCursor* foedus_array_reopen_cursor(foedus::proc::ProcArguments* proc,
+                                                    uint32_t storage, uint64_t prefix_len,
+                                                    reir::FoedusArrayCursor* cursor,
+                                                    const char* from, uint64_t from_len,
+                                                    const char* to, uint64_t to_len) {
+  if (cursor == nullptr) {
+    cursor = new reir::FoedusArrayCursor(proc->engine_, storage, proc->context_, prefix_len);
+  }
+  cursor->open(from, from_len, to, to_len);
+  return cursor;
+}
+
+void foedus_array_parallel_scan(foedus::proc::ProcArguments* proc, uint32_t storage, uint64_t prefix_len,
+                                void* body, void* env,
+                                const char* from, uint64_t from_len,
+                                const char* to, uint64_t to_len) {
+  // the offsets are dense, so the range is just cut into equal morsels
+  ::foedus::storage::array::ArrayStorage array(proc->engine_, storage);
+  uint64_t begin;
+  uint64_t end;
+  reir::array_range(array, prefix_len, from, from_len, to, to_len, &begin, &end);
+  const uint64_t morsels = proc->engine_->get_options().thread_.get_total_thread_count() * 4;
+  const uint64_t step = std::max<uint64_t>((end - begin + morsels - 1) / morsels, 1);
+
+  reir::ParallelScan scan;
+  scan.body_ = reinterpret_cast<reir::MorselBody>(body);
+  scan.env_ = env;
+  scan.caller_ = proc;
+  scan.bounds_.emplace_back(from, from_len);
+  for (uint64_t offset = begin + step; offset < end; offset += step) {
+    std::string bound(from, prefix_len);
+    bound.resize(prefix_len + 8);
+    reir::encode_integer(static_cast<int64_t>(offset), &bound[prefix_len]);
+    scan.bounds_.emplace_back(std::move(bound));
+  }
+  scan.bounds_.emplace_back(to, to_len);
+  scan.next_ = 0;
+  reir::dispatch(proc, scan);
+}
+
+bool foedus_array_cursor_is_valid(reir::FoedusArrayCursor* cursor) {
+  return cursor->current_ < cursor->end_;
+}
+
+bool foedus_array_cursor_next(reir::FoedusArrayCursor* cursor) {
+  reir::stats_rows_read();
+  cursor->next();
+  return cursor->current_ < cursor->end_;
+}
+
+void foedus_array_cursor_copy_key(reir::FoedusArrayCursor* cursor, char* buff) {
+  std::memcpy(buff, cursor->key(), cursor->key_.size());
+}
+
+void foedus_array_cursor_copy_value(reir::FoedusArrayCursor* cursor, char* buff) {
+  std::memcpy(buff, cursor->value(), cursor->zeros_.size());
+}
+
+const char* foedus_array_cursor_get_key(reir::FoedusArrayCursor* cursor) {
+  return cursor->key();
+}
+
+uint64_t foedus_array_cursor_get_key_length(reir::FoedusArrayCursor* cursor) {
+  return cursor->key_.size();
+}
+
+const char* foedus_array_cursor_get_value(reir::FoedusArrayCursor* cursor) {
+  return cursor->value();
+}
+
+uint64_t foedus_array_cursor_get_value_length(reir::FoedusArrayCursor* cursor) {
+  return cursor->zeros_.size();
+}
+
+uint64_t foedus_array_cursor_next_batch(reir::FoedusArrayCursor* cursor,
+                                        char* keys, uint64_t key_stride,
+                                        char* values, uint64_t value_stride,
+                                        uint64_t n) {
+  uint64_t filled = 0;
+  while (filled < n && cursor->current_ < cursor->end_) {
+    foedus_array_cursor_copy_key(cursor, keys + filled * key_stride);
+    foedus_array_cursor_copy_value(cursor, values + filled * value_stride);
+    ++filled;
+    cursor->next();
+  }
+  reir::stats_rows_read(filled);
+  return filled;
+}
+
+bool foedus_hash_insert(foedus::proc::ProcArguments* proc, uint32_t storage,
+                        const char* key, uint64_t key_len,
+                        const char* value, uint64_t value_len) {
+  ::foedus::storage::hash::HashStorage hash(proc->engine_, storage);
+  auto ret = hash.insert_record(proc->context_,
+                                key, static_cast<uint16_t>(key_len),
+                                value, static_cast<uint16_t>(value_len));
+  if (ret != ::foedus::kErrorCodeOk) {
+    REIR_TRACE_ERROR("foedus error:[hash insert]: %s", ::foedus::get_error_message(ret));
+    return false;
+  }
+  reir::stats_rows_written();
+  return true;
+}
+
+uint64_t foedus_hash_insert_batch(foedus::proc::ProcArguments* proc, uint32_t storage,
+                                  const char* keys, uint64_t key_len,
+                                  const char* values, uint64_t value_len,
+                                  uint64_t n) {
+  // the bin of a key is the top bits of its hash, in hash order the writes walk the bins in order
+  std::vector<::foedus::storage::hash::HashValue> hashes(n);
+  for (uint64_t i = 0; i < n; ++i) {
+    hashes[i] = ::foedus::storage::hash::hashinate(keys + i * key_len, static_cast<uint16_t>(key_len));
+  }
+  auto order = reir::write_order(n, [&](uint32_t a, uint32_t b) { return hashes[a] < hashes[b]; });
+  uint64_t inserted = 0;
+  for (auto i : order) {
+    if (foedus_hash_insert(proc, storage, keys + i * key_len, key_len, values + i * value_len, value_len)) {
+      ++inserted;
+    }
+  }
+  return inserted;
+}
+
+bool foedus_hash_lookup(foedus::proc::ProcArguments* proc, uint32_t storage,
+                        const char* key, uint64_t key_len,
+                        char* value, uint64_t value_len) {
+  ::foedus::storage::hash::HashStorage hash(proc->engine_, storage);
+  auto capacity = static_cast<uint16_t>(value_len);
+  auto ret = hash.get_record(proc->context_, key, static_cast<uint16_t>(key_len), value, &capacity, true);
+  if (ret == ::foedus::kErrorCodeStrKeyNotFound) {
+    return false;
+  } else if (ret != ::foedus::kErrorCodeOk) {
+    REIR_TRACE_ERROR("foedus error:[hash lookup]: %s", ::foedus::get_error_message(ret));
+    return false;
+  }
+  reir::stats_rows_read();
+  return true;
+}
+
+bool foedus_sequential_append(foedus::proc::ProcArguments* proc, uint32_t storage,
+                              const char* key, uint64_t key_len,
+                              const char* value, uint64_t value_len) {
+  char record[::foedus::storage::sequential::kMaxPayload];
+  if (sizeof(record) < key_len + value_len) {
+    REIR_TRACE_ERROR("foedus error:[sequential append]: row too long");
+    return false;
+  }
+  std::memcpy(record, key, key_len);
+  std::memcpy(record + key_len, value, value_len);
+  ::foedus::storage::sequential::SequentialStorage sequential(proc->engine_, storage);
+  auto ret = sequential.append_record(proc->context_, record, static_cast<uint16_t>(key_len + value_len));
+  if (ret != ::foedus::kErrorCodeOk) {
+    REIR_TRACE_ERROR("foedus error:[sequential append]: %s", ::foedus::get_error_message(ret));
+    return false;
+  }
+  reir::stats_rows_written();
+  return true;
+}
+
+uint64_t foedus_sequential_append_batch(foedus::proc::ProcArguments* proc, uint32_t storage,
+                                        const char* keys, uint64_t key_len,
+                                        const char* values, uint64_t value_len,
+                                        uint64_t n) {
+  uint64_t appended = 0;
+  for (uint64_t i = 0; i < n; ++i) {
+    if (foedus_sequential_append(proc, storage, keys + i * key_len, key_len,
+                                 values + i * value_len, value_len)) {
+      ++appended;
+    }
+  }
+  return appended;
+}
+
+reir::FoedusSequentialCursor* foedus_sequential_generate_cursor(foedus::proc::ProcArguments* proc,
+                                                                uint32_t storage, uint64_t key_len,
+                                                                const char* from, uint64_t from_len,
+                                                                const char* to, uint64_t to_len) {
+  return foedus_sequential_reopen_cursor(proc, storage, key_len, nullptr, from, from_len, to, to_len);
+}
+
+reir::FoedusSequentialCursor* foedus_sequential_reopen_cursor(foedus::proc::ProcArguments* proc,
+                                                              uint32_t storage, uint64_t key_len,
+                                                              reir::FoedusSequentialCursor* cursor,
+                                                              const char* from, uint64_t from_len,
+                                                              const char* to, uint64_t to_len) {
+  if (cursor == nullptr) {
+    cursor = new reir::FoedusSequentialCursor(proc->engine_, storage, proc->context_, key_len);
+  }
+  cursor->open(from, from_len, to, to_len);
+  return cursor;
+}
+
+bool foedus_sequential_cursor_is_valid(reir::FoedusSequentialCursor* cursor) {
+  return cursor->valid_;
+}
+
+bool foedus_sequential_cursor_next(reir::FoedusSequentialCursor* cursor) {
+  reir::stats_rows_read();
+  cursor->next();
+  return cursor->valid_;
+}
+
+void foedus_sequential_cursor_copy_key(reir::FoedusSequentialCursor* cursor, char* buff) {
+  std::memcpy(buff, cursor->records_.get_cur_record_raw(), cursor->key_len_);
+}
+
+void foedus_sequential_cursor_copy_value(reir::FoedusSequentialCursor* cursor, char* buff) {
+  std::memcpy(buff, cursor->records_.get_cur_record_raw() + cursor->key_len_,
+              cursor->records_.get_cur_record_length() - cursor->key_len_);
+}
+
+const char* foedus_sequential_cursor_get_key(reir::FoedusSequentialCursor* cursor) {
+  return cursor->records_.get_cur_record_raw();
+}
+
+uint64_t foedus_sequential_cursor_get_key_length(reir::FoedusSequentialCursor* cursor) {
+  return cursor->key_len_;
+}
+
+const char* foedus_sequential_cursor_get_value(reir::FoedusSequentialCursor* cursor) {
+  return cursor->records_.get_cur_record_raw() + cursor->key_len_;
+}
+
+uint64_t foedus_sequential_cursor_get_value_length(reir::FoedusSequentialCursor* cursor) {
+  return cursor->records_.get_cur_record_length() - cursor->key_len_;
+}
+
+uint64_t foedus_sequential_cursor_next_batch(reir::FoedusSequentialCursor* cursor,
+                                             char* keys, uint64_t key_stride,
+                                             char* values, uint64_t value_stride,
+                                             uint64_t n) {
+  uint64_t filled = 0;
+  while (filled < n && cursor->valid_) {
+    foedus_sequential_cursor_copy_key(cursor, keys + filled * key_stride);
+    foedus_sequential_cursor_copy_value(cursor, values + filled * value_stride);
+    ++filled;
+    cursor->next();
+  }
+  reir::stats_rows_read(filled);
+  return filled;
+}
+
 bool foedus_scan(foedus::proc::ProcArguments* proc,
                  const char* key, uint64_t key_len) {
   return true;
@@ -100,27 +1042,32 @@ bool foedus_update(foedus::proc::ProcArguments* proc,
                                  value,
                                  0,  // zero offset
                                  value_len);
-  std::cout << "update invoked" << std::endl;
+  REIR_TRACE_DEBUG("update");
   if (ret != ::foedus::kErrorCodeOk) {
     throw std::runtime_error(::foedus::get_error_message(ret));
   } else {
+    reir::stats_rows_written();
     return true;
   }
 }
 
 void precommit_xct(foedus::proc::ProcArguments *proc) {
-  std::cout << "FOEDUS commit" << std::endl;
   auto* engine = proc->engine_;
   auto* ctx = proc->context_;
   auto* xct_manager = engine->get_xct_manager();
   ::foedus::Epoch commit_epoch;
   auto ret = xct_manager->precommit_xct(ctx, &commit_epoch);
   if (ret != foedus::kErrorCodeOk) {
-    std::cout << ret << "\n";
+    REIR_TRACE_ERROR("foedus error:[precommit_xct]: %s", ::foedus::get_error_message(ret));
+    reir::stats_xct_aborted(::foedus::get_error_name(ret));
   } else {
-    std::cout << "success.\n";
+    REIR_TRACE_DEBUG("precommit_xct");
+    reir::stats_xct_committed();
   }
 
   xct_manager->wait_for_commit(commit_epoch);  // FIXME: eliminate it
+  if (ret == foedus::kErrorCodeOk) {
+    reir::stats_xct_durable();
+  }
 }
 
@@ -4,6 +4,7 @@
 #include "util/slice.hpp"
 
 namespace foedus {
+class ErrorStack;
 namespace proc {
 class ProcArguments;
 }
@@ -14,6 +15,16 @@ class MasstreeCursor;
 }
 }
 
+namespace reir {
+struct FoedusCursorBase;
+struct FoedusScanCursor;
+struct FoedusArrayCursor;
+struct FoedusSequentialCursor;
+
+// the procedure "reir_parallel", a worker of a parallel for or a parallel scan
+foedus::ErrorStack foedus_parallel_worker(const foedus::proc::ProcArguments& arg);
+}
+
 extern "C" {
 
 bool begin_xct(foedus::proc::ProcArguments *proc);
@@ -22,18 +33,138 @@ bool foedus_insert(foedus::proc::ProcArguments* proc,
                    const char* key, uint64_t key_len,
                    const char* value, uint64_t value_len);
 
+// n rows in fixed stride buffers, returns the number of rows inserted
+uint64_t foedus_insert_batch(foedus::proc::ProcArguments* proc,
+                             const char* keys, uint64_t key_len,
+                             const char* values, uint64_t value_len,
+                             uint64_t n);
+
 void precommit_xct(foedus::proc::ProcArguments *proc);
 
-foedus::storage::masstree::MasstreeCursor* foedus_generate_cursor(
+// runs body(proc, env, i) for i in [from, to) on idle workers and this thread,
+// each iteration in a transaction of its own
+void foedus_parallel_for(foedus::proc::ProcArguments* proc, void* body, void* env,
+                         int64_t from, int64_t to, int64_t batch);
+
+// same, but i is a partition key and runs on a worker of the NUMA node owning it,
+// i mod the number of nodes
+void foedus_parallel_for_partitioned(foedus::proc::ProcArguments* proc, void* body, void* env,
+                                     int64_t from, int64_t to, int64_t batch);
+
+// cuts [from, to) into morsels and runs body(proc, env, morsel from, len, morsel to, len)
+// for each of them on idle workers and this thread
+void foedus_parallel_scan(foedus::proc::ProcArguments* proc, void* body, void* env,
+                          const char* from, uint64_t from_len,
+                          const char* to, uint64_t to_len);
+
+reir::FoedusScanCursor* foedus_generate_cursor(
+    foedus::proc::ProcArguments* proc,
+    const char* from, uint64_t from_len,
+    const char* to, uint64_t to_len);
+
+reir::FoedusScanCursor* foedus_reopen_cursor(
     foedus::proc::ProcArguments* proc,
+    reir::FoedusScanCursor* cursor,
     const char* from, uint64_t from_len,
     const char* to, uint64_t to_len);
 
-bool foedus_cursor_next(foedus::storage::masstree::MasstreeCursor* cursor);
-bool foedus_cursor_is_valid(foedus::storage::masstree::MasstreeCursor* cursor);
-void foedus_cursor_copy_key(foedus::storage::masstree::MasstreeCursor* cursor, char* buff);
-void foedus_cursor_copy_value(foedus::storage::masstree::MasstreeCursor* cursor, char* buff);
-void foedus_cursor_destroy(foedus::storage::masstree::MasstreeCursor* cursor);
+bool foedus_lookup(foedus::proc::ProcArguments* proc,
+                   const char* key, uint64_t key_len,
+                   char* value, uint64_t value_len);
+
+bool foedus_cursor_next(reir::FoedusScanCursor* cursor);
+bool foedus_cursor_is_valid(reir::FoedusScanCursor* cursor);
+void foedus_cursor_copy_key(reir::FoedusScanCursor* cursor, char* buff);
+void foedus_cursor_copy_value(reir::FoedusScanCursor* cursor, char* buff);
+const char* foedus_cursor_get_key(reir::FoedusScanCursor* cursor);
+uint64_t foedus_cursor_get_key_length(reir::FoedusScanCursor* cursor);
+const char* foedus_cursor_get_value(reir::FoedusScanCursor* cursor);
+uint64_t foedus_cursor_get_value_length(reir::FoedusScanCursor* cursor);
+uint64_t foedus_cursor_next_batch(reir::FoedusScanCursor* cursor,
+                                  char* keys, uint64_t key_stride,
+                                  char* values, uint64_t value_stride,
+                                  uint64_t n);
+// frees a cursor of any storage
+void foedus_cursor_destroy(reir::FoedusCursorBase* cursor);
+
+// array tables, the integer key after prefix_len bytes of the key is the offset
+bool foedus_array_insert(foedus::proc::ProcArguments* proc, uint32_t storage, uint64_t prefix_len,
+                         const char* key, uint64_t key_len,
+                         const char* value, uint64_t value_len);
+uint64_t foedus_array_insert_batch(foedus::proc::ProcArguments* proc, uint32_t storage, uint64_t prefix_len,
+                                   const char* keys, uint64_t key_len,
+                                   const char* values, uint64_t value_len,
+                                   uint64_t n);
+bool foedus_array_lookup(foedus::proc::ProcArguments* proc, uint32_t storage, uint64_t prefix_len,
+                         const char* key, uint64_t key_len,
+                         char* value, uint64_t value_len);
+reir::FoedusArrayCursor* foedus_array_generate_cursor(foedus::proc::ProcArguments* proc,
+                                                      uint32_t storage, uint64_t prefix_len,
+                                                      const char* from, uint64_t from_len,
+                                                      const char* to, uint64_t to_len);
+reir::FoedusArrayCursor* foedus_array_reopen_cursor(foedus::proc::ProcArguments* proc,
+                                                    uint32_t storage, uint64_t prefix_len,
+                                                    reir::FoedusArrayCursor* cursor,
+                                                    const char* from, uint64_t from_len,
+                                                    const char* to, uint64_t to_len);
+void foedus_array_parallel_scan(foedus::proc::ProcArguments* proc, uint32_t storage, uint64_t prefix_len,
+                                void* body, void* env,
+                                const char* from, uint64_t from_len,
+                                const char* to, uint64_t to_len);
+bool foedus_array_cursor_is_valid(reir::FoedusArrayCursor* cursor);
+bool foedus_array_cursor_next(reir::FoedusArrayCursor* cursor);
+void foedus_array_cursor_copy_key(reir::FoedusArrayCursor* cursor, char* buff);
+void foedus_array_cursor_copy_value(reir::FoedusArrayCursor* cursor, char* buff);
+const char* foedus_array_cursor_get_key(reir::FoedusArrayCursor* cursor);
+uint64_t foedus_array_cursor_get_key_length(reir::FoedusArrayCursor* cursor);
+const char* foedus_array_cursor_get_value(reir::FoedusArrayCursor* cursor);
+uint64_t foedus_array_cursor_get_value_length(reir::FoedusArrayCursor* cursor);
+uint64_t foedus_array_cursor_next_batch(reir::FoedusArrayCursor* cursor,
+                                        char* keys, uint64_t key_stride,
+                                        char* values, uint64_t value_stride,
+                                        uint64_t n);
+
+// hash tables, point lookups on the whole key only
+bool foedus_hash_insert(foedus::proc::ProcArguments* proc, uint32_t storage,
+                        const char* key, uint64_t key_len,
+                        const char* value, uint64_t value_len);
+uint64_t foedus_hash_insert_batch(foedus::proc::ProcArguments* proc, uint32_t storage,
+                                  const char* keys, uint64_t key_len,
+                                  const char* values, uint64_t value_len,
+                                  uint64_t n);
+bool foedus_hash_lookup(foedus::proc::ProcArguments* proc, uint32_t storage,
+                        const char* key, uint64_t key_len,
+                        char* value, uint64_t value_len);
+
+// sequential tables, a record is the key followed by the value
+bool foedus_sequential_append(foedus::proc::ProcArguments* proc, uint32_t storage,
+                              const char* key, uint64_t key_len,
+                              const char* value, uint64_t value_len);
+uint64_t foedus_sequential_append_batch(foedus::proc::ProcArguments* proc, uint32_t storage,
+                                        const char* keys, uint64_t key_len,
+                                        const char* values, uint64_t value_len,
+                                        uint64_t n);
+reir::FoedusSequentialCursor* foedus_sequential_generate_cursor(foedus::proc::ProcArguments* proc,
+                                                                uint32_t storage, uint64_t key_len,
+                                                                const char* from, uint64_t from_len,
+                                                                const char* to, uint64_t to_len);
+reir::FoedusSequentialCursor* foedus_sequential_reopen_cursor(foedus::proc::ProcArguments* proc,
+                                                              uint32_t storage, uint64_t key_len,
+                                                              reir::FoedusSequentialCursor* cursor,
+                                                              const char* from, uint64_t from_len,
+                                                              const char* to, uint64_t to_len);
+bool foedus_sequential_cursor_is_valid(reir::FoedusSequentialCursor* cursor);
+bool foedus_sequential_cursor_next(reir::FoedusSequentialCursor* cursor);
+void foedus_sequential_cursor_copy_key(reir::FoedusSequentialCursor* cursor, char* buff);
+void foedus_sequential_cursor_copy_value(reir::FoedusSequentialCursor* cursor, char* buff);
+const char* foedus_sequential_cursor_get_key(reir::FoedusSequentialCursor* cursor);
+uint64_t foedus_sequential_cursor_get_key_length(reir::FoedusSequentialCursor* cursor);
+const char* foedus_sequential_cursor_get_value(reir::FoedusSequentialCursor* cursor);
+uint64_t foedus_sequential_cursor_get_value_length(reir::FoedusSequentialCursor* cursor);
+uint64_t foedus_sequential_cursor_next_batch(reir::FoedusSequentialCursor* cursor,
+                                             char* keys, uint64_t key_stride,
+                                             char* values, uint64_t value_stride,
+                                             uint64_t n);
 
 void link_test() {
   std::cout << "link test success" << std::endl;
@@ -1,4 +1,6 @@
-#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
 #include "foedus_runner.hpp"
 #include <numa.h>
 
@@ -10,9 +12,13 @@
 #include <foedus/storage/masstree/masstree_metadata.hpp>
 
 #include "reir/exec/db_interface.hpp"
+#include "trace.hpp"
 
 namespace reir {
 
+// in foedus_interface.cpp, its header can only be included once
+foedus::ErrorStack foedus_parallel_worker(const foedus::proc::ProcArguments& arg);
+
 foedus::ErrorStack trampoline(const foedus::proc::ProcArguments& arg) {
   FoedusRunner* ptr;
   std::memcpy(&ptr, arg.input_buffer_, sizeof(FoedusRunner*));
@@ -21,55 +27,79 @@ foedus::ErrorStack trampoline(const foedus::proc::ProcArguments& arg) {
   return foedus::kRetOk;
 }
 
-FoedusRunner::FoedusRunner() {
-  // FIXME: too hard coded, make them parameter
+namespace {
+EngineConfig with_threads(int threads) {
+  if (threads < 1) {
+    throw std::runtime_error("foedus needs at least one thread");
+  }
+  EngineConfig config;
+  config.threads = static_cast<uint32_t>(threads);
+  return config;
+}
+}  // anonymous namespace
+
+FoedusRunner::FoedusRunner(int threads) : FoedusRunner(with_threads(threads)) {}
+
+FoedusRunner::FoedusRunner(const EngineConfig& config) {
+  config.validate();
   foedus::EngineOptions options;
   options.debugging_.debug_log_min_threshold_ =
     foedus::debugging::DebuggingOptions::kDebugLogError;
   //foedus::debugging::DebuggingOptions::kDebugLogInfo;
-  options.memory_.use_numa_alloc_ = true;
-  options.memory_.page_pool_size_mb_per_node_ = 32;
-  options.memory_.private_page_pool_initial_grab_ = 8;
+  options.memory_.use_numa_alloc_ = config.use_numa_alloc;
+  options.memory_.page_pool_size_mb_per_node_ = config.page_pool_size_mb_per_node;
+  options.memory_.private_page_pool_initial_grab_ = config.private_page_pool_initial_grab;
 
-  std::string path = "./";
-  if (path[path.size() - 1] != '/') {
-    path += "/";
-  }
-  const std::string snapshot_folder_path_pattern = path + "snapshot/node_$NODE$";
+  const std::string snapshot_folder_path_pattern = config.snapshot_dir + "/node_$NODE$";
   options.snapshot_.folder_path_pattern_ = snapshot_folder_path_pattern.c_str();
-  const std::string log_folder_path_pattern = path + "log/node_$NODE$/logger_$LOGGER$";
+  const std::string log_folder_path_pattern = config.log_dir + "/node_$NODE$/logger_$LOGGER$";
   options.log_.folder_path_pattern_ = log_folder_path_pattern.c_str();
 
-  int threads = 1;
-  const int cpus = numa_num_task_cpus();
-  const int use_nodes = (threads - 1) / cpus + 1;
+  // a thread group on every NUMA node as long as there are threads for them,
+  // so a partitioned parallel for finds workers next to each partition's memory
+  const int threads = static_cast<int>(config.threads);
+  const int nodes = numa_available() < 0 ? 1 : numa_num_configured_nodes();
+  int use_nodes = std::max(1, std::min(nodes, threads));
+  if (config.thread_groups != 0) {
+    if (nodes < static_cast<int>(config.thread_groups)) {
+      throw std::runtime_error("thread_groups " + std::to_string(config.thread_groups) +
+                               " exceeds the " + std::to_string(nodes) + " NUMA nodes of this machine");
+    }
+    use_nodes = static_cast<int>(config.thread_groups);
+  }
   const int threads_per_node = (threads + (use_nodes - 1)) / use_nodes;
 
   options.thread_.group_count_ = (uint16_t)use_nodes;
   options.thread_.thread_count_per_group_ = (foedus::thread::ThreadLocalOrdinal)threads_per_node;
 
-  options.log_.log_buffer_kb_ = 512;
-  options.log_.flush_at_shutdown_ = true;
+  options.log_.log_buffer_kb_ = config.log_buffer_kb;
+  options.log_.loggers_per_node_ = (uint16_t)config.loggers_per_node;
+  options.log_.flush_at_shutdown_ = config.flush_at_shutdown;
 
-  options.cache_.snapshot_cache_size_mb_per_node_ = 2;
-  options.cache_.private_snapshot_cache_initial_grab_ = 16;
+  options.cache_.snapshot_cache_size_mb_per_node_ = config.snapshot_cache_size_mb_per_node;
+  options.cache_.private_snapshot_cache_initial_grab_ = config.private_snapshot_cache_initial_grab;
 
-  options.xct_.max_write_set_size_ = 4096;
+  options.xct_.max_read_set_size_ = config.max_read_set_size;
+  options.xct_.max_write_set_size_ = config.max_write_set_size;
 
-  options.snapshot_.log_mapper_io_buffer_mb_ = 2;
-  options.snapshot_.log_reducer_buffer_mb_ = 2;
-  options.snapshot_.log_reducer_dump_io_buffer_mb_ = 4;
-  options.snapshot_.snapshot_writer_page_pool_size_mb_ = 4;
-  options.snapshot_.snapshot_writer_intermediate_pool_size_mb_ = 2;
-  options.storage_.max_storages_ = 128;
+  options.snapshot_.log_mapper_io_buffer_mb_ = config.log_mapper_io_buffer_mb;
+  options.snapshot_.log_reducer_buffer_mb_ = config.log_reducer_buffer_mb;
+  options.snapshot_.log_reducer_dump_io_buffer_mb_ = config.log_reducer_dump_io_buffer_mb;
+  options.snapshot_.snapshot_writer_page_pool_size_mb_ = config.snapshot_writer_page_pool_size_mb;
+  options.snapshot_.snapshot_writer_intermediate_pool_size_mb_ = config.snapshot_writer_intermediate_pool_size_mb;
+  options.storage_.max_storages_ = config.max_storages;
 
   engine_ = std::make_shared<foedus::Engine>(options);
-  std::cout << "engine initialized" << std::endl;
+  REIR_TRACE_INFO("engine initialized");
 
   engine_
     ->get_proc_manager()
     ->pre_register("func",
                    trampoline);
+  engine_
+    ->get_proc_manager()
+    ->pre_register("reir_parallel",
+                   foedus_parallel_worker);
   COERCE_ERROR(engine_->initialize());
   foedus::storage::masstree::MasstreeMetadata meta("db");
   if (!engine_->get_storage_manager()->get_pimpl()->exists("db")) {
@@ -77,7 +107,7 @@ FoedusRunner::FoedusRunner() {
     engine_->get_storage_manager()
         ->create_storage(&meta, &create_epoch);
   } else {
-    std::cout << "massstree already exist" << std::endl;
+    REIR_TRACE_INFO("masstree already exists");
   }
 }
 
@@ -90,7 +120,7 @@ void FoedusRunner::run(std::function<void(DBInterface&)> f) {
 
 FoedusRunner::~FoedusRunner() {
   engine_->uninitialize();
-  std::cout << "foedus engine successfully uninitialized.\n";
+  REIR_TRACE_INFO("foedus engine uninitialized");
 }
 
 }  // namespace reir
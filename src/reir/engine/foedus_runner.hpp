@@ -6,17 +6,21 @@
 #include <memory>
 #include <foedus/engine.hpp>
 #include <foedus/proc/proc_id.hpp>
+#include "engine_config.hpp"
+#include "runner.hpp"
 
 namespace reir {
 
 // foedus::ErrorStack trampoline(const foedus::proc::ProcArguments& arg);
 
 class DBInterface;
-class FoedusRunner {
+class FoedusRunner : public Runner {
  public:
-  FoedusRunner();
-  void run(std::function<void(DBInterface&)> f);
-  ~FoedusRunner();
+  // the default config with that many threads
+  explicit FoedusRunner(int threads = 1);
+  explicit FoedusRunner(const EngineConfig& config);
+  void run(std::function<void(DBInterface&)> f) override;
+  ~FoedusRunner() override;
  private:
   std::shared_ptr<foedus::Engine> engine_;
   std::function<void(DBInterface&)> f_;
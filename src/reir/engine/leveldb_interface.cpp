@@ -0,0 +1,312 @@
+#include <leveldb/db.h>
+#include <leveldb/iterator.h>
+#include <leveldb/write_batch.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "leveldb_interface.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+namespace reir {
+
+// merges the snapshot with the writes of the open transaction, a pending write
+// shadows the record of the same key in the snapshot
+struct LevelDBCursor {
+  LevelDBHandle* handle_;
+  const leveldb::Snapshot* snapshot_;
+  std::unique_ptr<leveldb::Iterator> it_;
+  std::string to_;
+  std::map<std::string, std::string>::const_iterator pending_;
+  std::map<std::string, std::string>::const_iterator pending_end_;
+  bool in_range_;      // it_ is on a record before to_
+  bool from_pending_;  // the current record is pending_
+  bool valid_;
+
+  explicit LevelDBCursor(LevelDBHandle* h)
+      : handle_(h), snapshot_(nullptr), in_range_(false), from_pending_(false), valid_(false) {}
+
+  void open(const char* from, uint64_t from_len, const char* to, uint64_t to_len) {
+    // an iterator reads the snapshot it was made with, a reopen in another transaction needs a new one
+    if (!it_ || snapshot_ != handle_->snapshot) {
+      leveldb::ReadOptions options;
+      options.snapshot = handle_->snapshot;
+      it_.reset(handle_->db->NewIterator(options));
+      snapshot_ = handle_->snapshot;
+    }
+    to_.assign(to, to_len);
+    it_->Seek(leveldb::Slice(from, from_len));
+    pending_ = handle_->pending.lower_bound(std::string(from, from_len));
+    pending_end_ = handle_->pending.lower_bound(to_);
+    settle();
+  }
+
+  void settle() {
+    in_range_ = it_->Valid() && it_->key().compare(to_) < 0;
+    const bool has_pending = pending_ != pending_end_;
+    valid_ = in_range_ || has_pending;
+    from_pending_ = has_pending && (!in_range_ || it_->key().compare(pending_->first) >= 0);
+  }
+
+  void next() {
+    if (from_pending_) {
+      if (in_range_ && it_->key().compare(pending_->first) == 0) {
+        it_->Next();
+      }
+      ++pending_;
+    } else {
+      it_->Next();
+    }
+    settle();
+  }
+
+  leveldb::Slice key() const {
+    return from_pending_ ? leveldb::Slice(pending_->first) : it_->key();
+  }
+
+  leveldb::Slice value() const {
+    return from_pending_ ? leveldb::Slice(pending_->second) : it_->value();
+  }
+};
+
+namespace {
+
+leveldb::ReadOptions read_options(const LevelDBHandle* h) {
+  leveldb::ReadOptions options;
+  options.snapshot = h->snapshot;
+  return options;
+}
+
+leveldb::WriteOptions write_options(const LevelDBHandle* h) {
+  leveldb::WriteOptions options;
+  options.sync = h->sync;
+  return options;
+}
+
+void report(const char* op, const leveldb::Status& s) {
+  REIR_TRACE_ERROR("leveldb error:[%s]: %s", op, s.ToString().c_str());
+}
+
+// the bloom filters make a miss cheap, which is the common case of an insert
+bool exists(LevelDBHandle* h, const std::string& key) {
+  if (h->pending.count(key) != 0) {
+    return true;
+  }
+  std::string value;
+  return h->db->Get(read_options(h), key, &value).ok();
+}
+
+// outside a transaction every write is applied right away
+bool put(LevelDBHandle* h, std::string k, const char* value, uint64_t value_len) {
+  if (h->depth == 0) {
+    auto s = h->db->Put(write_options(h), k, leveldb::Slice(value, value_len));
+    if (!s.ok()) {
+      report("insert", s);
+      return false;
+    }
+    stats_rows_written();
+    return true;
+  }
+  h->batch.Put(k, leveldb::Slice(value, value_len));
+  h->pending[std::move(k)].assign(value, value_len);
+  stats_rows_written();
+  return true;
+}
+
+}  // anonymous namespace
+
+}  // namespace reir
+
+extern "C" {
+
+bool reir_leveldb_begin_xct(reir::LevelDBHandle* h) {
+  if (h->depth++ == 0) {
+    h->snapshot = h->db->GetSnapshot();
+    reir::stats_xct_begin();
+  }
+  return true;
+}
+
+bool reir_leveldb_precommit_xct(reir::LevelDBHandle* h) {
+  if (h->depth == 0 || --h->depth != 0) {
+    return true;
+  }
+  auto s = h->db->Write(reir::write_options(h), &h->batch);
+  h->db->ReleaseSnapshot(h->snapshot);
+  h->snapshot = nullptr;
+  h->batch.Clear();
+  h->pending.clear();
+  if (!s.ok()) {
+    reir::report("precommit", s);
+    reir::stats_xct_aborted(s.IsIOError() ? "IOError" : "error");
+    return false;
+  }
+  reir::stats_xct_committed();
+  if (h->sync) {
+    reir::stats_xct_durable();  // the write returned after the fsync
+  }
+  return true;
+}
+
+bool reir_leveldb_insert(reir::LevelDBHandle* h,
+                         const char* key, uint64_t key_len,
+                         const char* value, uint64_t value_len) {
+  std::string k(key, key_len);
+  if (reir::exists(h, k)) {
+    REIR_TRACE_ERROR("leveldb error:[insert]: key exists");
+    return false;
+  }
+  return reir::put(h, std::move(k), value, value_len);
+}
+
+uint64_t reir_leveldb_insert_batch(reir::LevelDBHandle* h,
+                                   const char* keys, uint64_t key_len,
+                                   const char* values, uint64_t value_len,
+                                   uint64_t n) {
+  uint64_t inserted = 0;
+  for (uint64_t i = 0; i < n; ++i) {
+    if (reir_leveldb_insert(h, keys + i * key_len, key_len, values + i * value_len, value_len)) {
+      ++inserted;
+    }
+  }
+  return inserted;
+}
+
+bool reir_leveldb_overwrite(reir::LevelDBHandle* h,
+                            const char* key, uint64_t key_len,
+                            const char* value, uint64_t value_len) {
+  return reir::put(h, std::string(key, key_len), value, value_len);
+}
+
+uint64_t reir_leveldb_overwrite_batch(reir::LevelDBHandle* h,
+                                      const char* keys, uint64_t key_len,
+                                      const char* values, uint64_t value_len,
+                                      uint64_t n) {
+  uint64_t written = 0;
+  for (uint64_t i = 0; i < n; ++i) {
+    if (reir_leveldb_overwrite(h, keys + i * key_len, key_len, values + i * value_len, value_len)) {
+      ++written;
+    }
+  }
+  return written;
+}
+
+bool reir_leveldb_lookup(reir::LevelDBHandle* h,
+                         const char* key, uint64_t key_len,
+                         char* value, uint64_t value_len) {
+  std::string k(key, key_len);
+  auto it = h->pending.find(k);
+  if (it != h->pending.end()) {
+    std::memcpy(value, it->second.data(), std::min<uint64_t>(value_len, it->second.size()));
+    reir::stats_rows_read();
+    return true;
+  }
+  std::string found;
+  auto s = h->db->Get(reir::read_options(h), k, &found);
+  if (s.IsNotFound()) {
+    return false;
+  } else if (!s.ok()) {
+    reir::report("lookup", s);
+    return false;
+  }
+  std::memcpy(value, found.data(), std::min<uint64_t>(value_len, found.size()));
+  reir::stats_rows_read();
+  return true;
+}
+
+reir::LevelDBCursor* reir_leveldb_generate_cursor(reir::LevelDBHandle* h,
+                                                  const char* from, uint64_t from_len,
+                                                  const char* to, uint64_t to_len) {
+  auto* cursor = new reir::LevelDBCursor(h);
+  cursor->open(from, from_len, to, to_len);
+  return cursor;
+}
+
+reir::LevelDBCursor* reir_leveldb_reopen_cursor(reir::LevelDBHandle* h, reir::LevelDBCursor* cursor,
+                                                const char* from, uint64_t from_len,
+                                                const char* to, uint64_t to_len) {
+  if (cursor == nullptr) {
+    return reir_leveldb_generate_cursor(h, from, from_len, to, to_len);
+  }
+  cursor->open(from, from_len, to, to_len);
+  return cursor;
+}
+
+bool reir_leveldb_cursor_is_valid(reir::LevelDBCursor* cursor) {
+  return cursor->valid_;
+}
+
+bool reir_leveldb_cursor_next(reir::LevelDBCursor* cursor) {
+  reir::stats_rows_read();
+  cursor->next();
+  return cursor->valid_;
+}
+
+void reir_leveldb_cursor_copy_key(reir::LevelDBCursor* cursor, char* buffer) {
+  const auto key = cursor->key();
+  std::memcpy(buffer, key.data(), key.size());
+}
+
+void reir_leveldb_cursor_copy_value(reir::LevelDBCursor* cursor, char* buffer) {
+  const auto value = cursor->value();
+  std::memcpy(buffer, value.data(), value.size());
+}
+
+const char* reir_leveldb_cursor_get_key(reir::LevelDBCursor* cursor) {
+  return cursor->key().data();
+}
+
+uint64_t reir_leveldb_cursor_get_key_length(reir::LevelDBCursor* cursor) {
+  return cursor->key().size();
+}
+
+const char* reir_leveldb_cursor_get_value(reir::LevelDBCursor* cursor) {
+  return cursor->value().data();
+}
+
+uint64_t reir_leveldb_cursor_get_value_length(reir::LevelDBCursor* cursor) {
+  return cursor->value().size();
+}
+
+uint64_t reir_leveldb_cursor_next_batch(reir::LevelDBCursor* cursor,
+                                        char* keys, uint64_t key_stride,
+                                        char* values, uint64_t value_stride,
+                                        uint64_t n) {
+  uint64_t filled = 0;
+  while (filled < n && cursor->valid_) {
+    const auto key = cursor->key();
+    const auto value = cursor->value();
+    std::memcpy(keys + filled * key_stride, key.data(), std::min<uint64_t>(key.size(), key_stride));
+    std::memcpy(values + filled * value_stride, value.data(), std::min<uint64_t>(value.size(), value_stride));
+    ++filled;
+    cursor->next();
+  }
+  reir::stats_rows_read(filled);
+  return filled;
+}
+
+void reir_leveldb_cursor_destroy(reir::LevelDBCursor* cursor) {
+  delete cursor;
+}
+
+void reir_leveldb_parallel_for(reir::LevelDBHandle* h, void* body, void* env,
+                               int64_t from, int64_t to, int64_t batch) {
+  auto* f = reinterpret_cast<void (*)(reir::LevelDBHandle*, void*, int64_t)>(body);
+  for (int64_t i = from; i < to; ++i) {
+    reir_leveldb_begin_xct(h);
+    f(h, env, i);
+    reir_leveldb_precommit_xct(h);
+  }
+}
+
+void reir_leveldb_parallel_scan(reir::LevelDBHandle* h, void* body, void* env,
+                                const char* from, uint64_t from_len,
+                                const char* to, uint64_t to_len) {
+  auto* f = reinterpret_cast<void (*)(reir::LevelDBHandle*, void*,
+                                      const char*, uint64_t, const char*, uint64_t)>(body);
+  f(h, env, from, from_len, to, to_len);
+}
+
+}
@@ -0,0 +1,90 @@
+#ifndef REIR_LEVELDB_INTERFACE_HPP_
+#define REIR_LEVELDB_INTERFACE_HPP_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <leveldb/write_batch.h>
+
+namespace leveldb {
+class DB;
+class Snapshot;
+}
+
+namespace reir {
+struct LevelDBCursor;
+
+// what the generated code gets as its engine handle. a transaction reads a
+// snapshot of the database and its own writes, which wait in a WriteBatch and
+// are applied atomically at precommit. there is no conflict detection, so
+// transactions are not serializable against other writers of the database
+struct LevelDBHandle {
+  leveldb::DB* db = nullptr;
+  bool sync = false;  // fsync the log at every commit
+  uint32_t depth = 0;  // nested transactions commit with the outermost one
+  const leveldb::Snapshot* snapshot = nullptr;
+  leveldb::WriteBatch batch;
+  std::map<std::string, std::string> pending;  // the writes of batch, to read them back
+};
+}
+
+// the runtime the generated code calls through HandleInterface, same signatures
+// as the foedus_ functions.
+// prefixed with reir_ not to clash with the C API of leveldb
+extern "C" {
+
+bool reir_leveldb_begin_xct(reir::LevelDBHandle* h);
+bool reir_leveldb_precommit_xct(reir::LevelDBHandle* h);
+
+// fails if the key exists, like a masstree insert
+bool reir_leveldb_insert(reir::LevelDBHandle* h,
+                         const char* key, uint64_t key_len,
+                         const char* value, uint64_t value_len);
+uint64_t reir_leveldb_insert_batch(reir::LevelDBHandle* h,
+                                   const char* keys, uint64_t key_len,
+                                   const char* values, uint64_t value_len,
+                                   uint64_t n);
+// replaces the value or inserts the key, like an array overwrite
+bool reir_leveldb_overwrite(reir::LevelDBHandle* h,
+                            const char* key, uint64_t key_len,
+                            const char* value, uint64_t value_len);
+uint64_t reir_leveldb_overwrite_batch(reir::LevelDBHandle* h,
+                                      const char* keys, uint64_t key_len,
+                                      const char* values, uint64_t value_len,
+                                      uint64_t n);
+bool reir_leveldb_lookup(reir::LevelDBHandle* h,
+                         const char* key, uint64_t key_len,
+                         char* value, uint64_t value_len);
+
+// keys in [from, to)
+reir::LevelDBCursor* reir_leveldb_generate_cursor(reir::LevelDBHandle* h,
+                                                  const char* from, uint64_t from_len,
+                                                  const char* to, uint64_t to_len);
+reir::LevelDBCursor* reir_leveldb_reopen_cursor(reir::LevelDBHandle* h, reir::LevelDBCursor* cursor,
+                                                const char* from, uint64_t from_len,
+                                                const char* to, uint64_t to_len);
+bool reir_leveldb_cursor_is_valid(reir::LevelDBCursor* cursor);
+bool reir_leveldb_cursor_next(reir::LevelDBCursor* cursor);
+void reir_leveldb_cursor_copy_key(reir::LevelDBCursor* cursor, char* buffer);
+void reir_leveldb_cursor_copy_value(reir::LevelDBCursor* cursor, char* buffer);
+const char* reir_leveldb_cursor_get_key(reir::LevelDBCursor* cursor);
+uint64_t reir_leveldb_cursor_get_key_length(reir::LevelDBCursor* cursor);
+const char* reir_leveldb_cursor_get_value(reir::LevelDBCursor* cursor);
+uint64_t reir_leveldb_cursor_get_value_length(reir::LevelDBCursor* cursor);
+uint64_t reir_leveldb_cursor_next_batch(reir::LevelDBCursor* cursor,
+                                        char* keys, uint64_t key_stride,
+                                        char* values, uint64_t value_stride,
+                                        uint64_t n);
+void reir_leveldb_cursor_destroy(reir::LevelDBCursor* cursor);
+
+// there is a single thread: every iteration runs here, each in a transaction
+// of its own, and the scan body gets the whole range as one morsel
+void reir_leveldb_parallel_for(reir::LevelDBHandle* h, void* body, void* env,
+                               int64_t from, int64_t to, int64_t batch);
+void reir_leveldb_parallel_scan(reir::LevelDBHandle* h, void* body, void* env,
+                                const char* from, uint64_t from_len,
+                                const char* to, uint64_t to_len);
+
+}
+
+#endif  // REIR_LEVELDB_INTERFACE_HPP_
@@ -0,0 +1,45 @@
+#include <stdexcept>
+#include <leveldb/cache.h>
+#include <leveldb/db.h>
+#include <leveldb/filter_policy.h>
+
+#include "leveldb_runner.hpp"
+#include "trace.hpp"
+#include "reir/exec/handle_interface.hpp"
+
+namespace reir {
+
+LevelDBRunner::LevelDBRunner(const EngineConfig& config) {
+  config.validate();
+  leveldb::Options options;
+  options.create_if_missing = true;
+  options.write_buffer_size = static_cast<size_t>(config.leveldb_write_buffer_mb) << 20;
+  // keys of a table share a prefix and are read in ranges, so blocks compress and cache well
+  if (config.leveldb_block_cache_mb != 0) {
+    cache_.reset(leveldb::NewLRUCache(static_cast<size_t>(config.leveldb_block_cache_mb) << 20));
+    options.block_cache = cache_.get();
+  }
+  // point lookups and the existence check of every insert skip the files without the key
+  if (config.leveldb_bloom_bits != 0) {
+    filter_.reset(leveldb::NewBloomFilterPolicy(static_cast<int>(config.leveldb_bloom_bits)));
+    options.filter_policy = filter_.get();
+  }
+  auto s = leveldb::DB::Open(options, config.leveldb_dir, &handle_.db);
+  if (!s.ok()) {
+    throw std::runtime_error("could not open leveldb at " + config.leveldb_dir + ": " + s.ToString());
+  }
+  handle_.sync = config.leveldb_sync;
+  REIR_TRACE_INFO("leveldb opened at %s", config.leveldb_dir.c_str());
+}
+
+void LevelDBRunner::run(std::function<void(DBInterface&)> f) {
+  HandleInterface d("LevelDB", &handle_, "reir_leveldb");
+  f(d);
+}
+
+LevelDBRunner::~LevelDBRunner() {
+  // the database goes before the cache and the filter it uses
+  delete handle_.db;
+}
+
+}  // namespace reir
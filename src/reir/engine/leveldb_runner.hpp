@@ -0,0 +1,31 @@
+#ifndef REIR_LEVELDB_RUNNER_HPP_
+#define REIR_LEVELDB_RUNNER_HPP_
+
+#include <functional>
+#include <memory>
+#include "engine_config.hpp"
+#include "leveldb_interface.hpp"
+#include "runner.hpp"
+
+namespace leveldb {
+class Cache;
+class FilterPolicy;
+}
+
+namespace reir {
+
+// a single threaded engine on a LevelDB database in config.leveldb_dir
+class LevelDBRunner : public Runner {
+ public:
+  explicit LevelDBRunner(const EngineConfig& config);
+  void run(std::function<void(DBInterface&)> f) override;
+  ~LevelDBRunner() override;
+ private:
+  std::unique_ptr<leveldb::Cache> cache_;
+  std::unique_ptr<const leveldb::FilterPolicy> filter_;
+  LevelDBHandle handle_;
+};
+
+}  // namespace reir
+
+#endif  // REIR_LEVELDB_RUNNER_HPP_
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "memory_interface.hpp"
+#include "stats.hpp"
+
+namespace reir {
+
+// a position in the tree with the key it is on. an insert made while the cursor
+// is open can move records around, the cursor then finds its place again by key
+struct MemoryCursor {
+  const BTree* tree_;
+  BTree::Position at_;
+  uint64_t version_;
+  std::string key_;
+  std::string to_;
+  bool valid_;
+
+  explicit MemoryCursor(const BTree* tree) : tree_(tree), at_{nullptr, 0}, version_(0), valid_(false) {}
+
+  void open(const char* from, uint64_t from_len, const char* to, uint64_t to_len) {
+    to_.assign(to, to_len);
+    at_ = tree_->lower_bound(std::string(from, from_len));
+    settle();
+  }
+
+  void settle() {
+    valid_ = !at_.end() && at_.key() < to_;
+    if (valid_) {
+      key_ = at_.key();
+    }
+    version_ = tree_->version();
+  }
+
+  void next() {
+    if (version_ != tree_->version()) {
+      at_ = tree_->upper_bound(key_);
+    } else {
+      at_.next();
+    }
+    settle();
+  }
+
+  // the value is not moved by inserts, the key is read from the copy
+  const std::string& value() const {
+    return at_.value();
+  }
+};
+
+}  // namespace reir
+
+extern "C" {
+
+bool reir_memory_begin_xct(reir::MemoryHandle* h) {
+  if (h->depth++ == 0) {
+    reir::stats_xct_begin();
+  }
+  return true;
+}
+
+bool reir_memory_precommit_xct(reir::MemoryHandle* h) {
+  if (h->depth != 0 && --h->depth == 0) {
+    reir::stats_xct_committed();
+  }
+  return true;
+}
+
+bool reir_memory_insert(reir::MemoryHandle* h,
+                        const char* key, uint64_t key_len,
+                        const char* value, uint64_t value_len) {
+  if (!h->tree.insert(std::string(key, key_len), value, value_len)) {
+    return false;
+  }
+  reir::stats_rows_written();
+  return true;
+}
+
+uint64_t reir_memory_insert_batch(reir::MemoryHandle* h,
+                                  const char* keys, uint64_t key_len,
+                                  const char* values, uint64_t value_len,
+                                  uint64_t n) {
+  uint64_t inserted = 0;
+  std::string key;
+  for (uint64_t i = 0; i < n; ++i) {
+    key.assign(keys + i * key_len, key_len);
+    if (h->tree.insert(key, values + i * value_len, value_len)) {
+      ++inserted;
+    }
+  }
+  reir::stats_rows_written(inserted);
+  return inserted;
+}
+
+bool reir_memory_overwrite(reir::MemoryHandle* h,
+                           const char* key, uint64_t key_len,
+                           const char* value, uint64_t value_len) {
+  h->tree.overwrite(std::string(key, key_len), value, value_len);
+  reir::stats_rows_written();
+  return true;
+}
+
+uint64_t reir_memory_overwrite_batch(reir::MemoryHandle* h,
+                                     const char* keys, uint64_t key_len,
+                                     const char* values, uint64_t value_len,
+                                     uint64_t n) {
+  std::string key;
+  for (uint64_t i = 0; i < n; ++i) {
+    key.assign(keys + i * key_len, key_len);
+    h->tree.overwrite(key, values + i * value_len, value_len);
+  }
+  reir::stats_rows_written(n);
+  return n;
+}
+
+bool reir_memory_lookup(reir::MemoryHandle* h,
+                        const char* key, uint64_t key_len,
+                        char* value, uint64_t value_len) {
+  const auto* found = h->tree.find(std::string(key, key_len));
+  if (found == nullptr) {
+    return false;
+  }
+  std::memcpy(value, found->data(), std::min<uint64_t>(value_len, found->size()));
+  reir::stats_rows_read();
+  return true;
+}
+
+reir::MemoryCursor* reir_memory_generate_cursor(reir::MemoryHandle* h,
+                                                const char* from, uint64_t from_len,
+                                                const char* to, uint64_t to_len) {
+  auto* cursor = new reir::MemoryCursor(&h->tree);
+  cursor->open(from, from_len, to, to_len);
+  return cursor;
+}
+
+reir::MemoryCursor* reir_memory_reopen_cursor(reir::MemoryHandle* h, reir::MemoryCursor* cursor,
+                                              const char* from, uint64_t from_len,
+                                              const char* to, uint64_t to_len) {
+  if (cursor == nullptr) {
+    return reir_memory_generate_cursor(h, from, from_len, to, to_len);
+  }
+  cursor->open(from, from_len, to, to_len);
+  return cursor;
+}
+
+bool reir_memory_cursor_is_valid(reir::MemoryCursor* cursor) {
+  return cursor->valid_;
+}
+
+bool reir_memory_cursor_next(reir::MemoryCursor* cursor) {
+  reir::stats_rows_read();
+  cursor->next();
+  return cursor->valid_;
+}
+
+void reir_memory_cursor_copy_key(reir::MemoryCursor* cursor, char* buffer) {
+  std::memcpy(buffer, cursor->key_.data(), cursor->key_.size());
+}
+
+void reir_memory_cursor_copy_value(reir::MemoryCursor* cursor, char* buffer) {
+  const auto& value = cursor->value();
+  std::memcpy(buffer, value.data(), value.size());
+}
+
+const char* reir_memory_cursor_get_key(reir::MemoryCursor* cursor) {
+  return cursor->key_.data();
+}
+
+uint64_t reir_memory_cursor_get_key_length(reir::MemoryCursor* cursor) {
+  return cursor->key_.size();
+}
+
+const char* reir_memory_cursor_get_value(reir::MemoryCursor* cursor) {
+  return cursor->value().data();
+}
+
+uint64_t reir_memory_cursor_get_value_length(reir::MemoryCursor* cursor) {
+  return cursor->value().size();
+}
+
+uint64_t reir_memory_cursor_next_batch(reir::MemoryCursor* cursor,
+                                       char* keys, uint64_t key_stride,
+                                       char* values, uint64_t value_stride,
+                                       uint64_t n) {
+  uint64_t filled = 0;
+  while (filled < n && cursor->valid_) {
+    const auto& key = cursor->key_;
+    const auto& value = cursor->value();
+    std::memcpy(keys + filled * key_stride, key.data(), std::min<uint64_t>(key.size(), key_stride));
+    std::memcpy(values + filled * value_stride, value.data(), std::min<uint64_t>(value.size(), value_stride));
+    ++filled;
+    cursor->next();
+  }
+  reir::stats_rows_read(filled);
+  return filled;
+}
+
+void reir_memory_cursor_destroy(reir::MemoryCursor* cursor) {
+  delete cursor;
+}
+
+void reir_memory_parallel_for(reir::MemoryHandle* h, void* body, void* env,
+                              int64_t from, int64_t to, int64_t batch) {
+  auto* f = reinterpret_cast<void (*)(reir::MemoryHandle*, void*, int64_t)>(body);
+  for (int64_t i = from; i < to; ++i) {
+    reir_memory_begin_xct(h);
+    f(h, env, i);
+    reir_memory_precommit_xct(h);
+  }
+}
+
+void reir_memory_parallel_scan(reir::MemoryHandle* h, void* body, void* env,
+                               const char* from, uint64_t from_len,
+                               const char* to, uint64_t to_len) {
+  auto* f = reinterpret_cast<void (*)(reir::MemoryHandle*, void*,
+                                      const char*, uint64_t, const char*, uint64_t)>(body);
+  f(h, env, from, from_len, to, to_len);
+}
+
+}
@@ -0,0 +1,76 @@
+#ifndef REIR_MEMORY_INTERFACE_HPP_
+#define REIR_MEMORY_INTERFACE_HPP_
+
+#include <cstdint>
+#include "btree.hpp"
+
+namespace reir {
+struct MemoryCursor;
+
+// what the generated code gets as its engine handle. every table lives in one
+// B+-tree. transactions only count their nesting: writes apply right away and
+// are never rolled back, and nothing is written to disk
+struct MemoryHandle {
+  BTree tree;
+  uint32_t depth = 0;
+};
+}
+
+// the runtime the generated code calls through HandleInterface, same signatures
+// as the foedus_ functions
+extern "C" {
+
+bool reir_memory_begin_xct(reir::MemoryHandle* h);
+bool reir_memory_precommit_xct(reir::MemoryHandle* h);
+
+// fails if the key exists, like a masstree insert
+bool reir_memory_insert(reir::MemoryHandle* h,
+                        const char* key, uint64_t key_len,
+                        const char* value, uint64_t value_len);
+uint64_t reir_memory_insert_batch(reir::MemoryHandle* h,
+                                  const char* keys, uint64_t key_len,
+                                  const char* values, uint64_t value_len,
+                                  uint64_t n);
+// replaces the value or inserts the key, like an array overwrite
+bool reir_memory_overwrite(reir::MemoryHandle* h,
+                           const char* key, uint64_t key_len,
+                           const char* value, uint64_t value_len);
+uint64_t reir_memory_overwrite_batch(reir::MemoryHandle* h,
+                                     const char* keys, uint64_t key_len,
+                                     const char* values, uint64_t value_len,
+                                     uint64_t n);
+bool reir_memory_lookup(reir::MemoryHandle* h,
+                        const char* key, uint64_t key_len,
+                        char* value, uint64_t value_len);
+
+// keys in [from, to)
+reir::MemoryCursor* reir_memory_generate_cursor(reir::MemoryHandle* h,
+                                                const char* from, uint64_t from_len,
+                                                const char* to, uint64_t to_len);
+reir::MemoryCursor* reir_memory_reopen_cursor(reir::MemoryHandle* h, reir::MemoryCursor* cursor,
+                                              const char* from, uint64_t from_len,
+                                              const char* to, uint64_t to_len);
+bool reir_memory_cursor_is_valid(reir::MemoryCursor* cursor);
+bool reir_memory_cursor_next(reir::MemoryCursor* cursor);
+void reir_memory_cursor_copy_key(reir::MemoryCursor* cursor, char* buffer);
+void reir_memory_cursor_copy_value(reir::MemoryCursor* cursor, char* buffer);
+const char* reir_memory_cursor_get_key(reir::MemoryCursor* cursor);
+uint64_t reir_memory_cursor_get_key_length(reir::MemoryCursor* cursor);
+const char* reir_memory_cursor_get_value(reir::MemoryCursor* cursor);
+uint64_t reir_memory_cursor_get_value_length(reir::MemoryCursor* cursor);
+uint64_t reir_memory_cursor_next_batch(reir::MemoryCursor* cursor,
+                                       char* keys, uint64_t key_stride,
+                                       char* values, uint64_t value_stride,
+                                       uint64_t n);
+void reir_memory_cursor_destroy(reir::MemoryCursor* cursor);
+
+// a single thread, as in the leveldb runtime
+void reir_memory_parallel_for(reir::MemoryHandle* h, void* body, void* env,
+                              int64_t from, int64_t to, int64_t batch);
+void reir_memory_parallel_scan(reir::MemoryHandle* h, void* body, void* env,
+                               const char* from, uint64_t from_len,
+                               const char* to, uint64_t to_len);
+
+}
+
+#endif  // REIR_MEMORY_INTERFACE_HPP_
@@ -0,0 +1,15 @@
+#include "memory_runner.hpp"
+#include "reir/exec/handle_interface.hpp"
+
+namespace reir {
+
+MemoryRunner::MemoryRunner(const EngineConfig& config) {
+  config.validate();
+}
+
+void MemoryRunner::run(std::function<void(DBInterface&)> f) {
+  HandleInterface d("Memory", &handle_, "reir_memory");
+  f(d);
+}
+
+}  // namespace reir
@@ -0,0 +1,23 @@
+#ifndef REIR_MEMORY_RUNNER_HPP_
+#define REIR_MEMORY_RUNNER_HPP_
+
+#include <functional>
+#include "engine_config.hpp"
+#include "memory_interface.hpp"
+#include "runner.hpp"
+
+namespace reir {
+
+// a single threaded engine keeping the tables in memory, nothing to set up and
+// nothing left behind. for tests and for timing the compiler alone
+class MemoryRunner : public Runner {
+ public:
+  explicit MemoryRunner(const EngineConfig& config);
+  void run(std::function<void(DBInterface&)> f) override;
+ private:
+  MemoryHandle handle_;
+};
+
+}  // namespace reir
+
+#endif  // REIR_MEMORY_RUNNER_HPP_
@@ -0,0 +1,58 @@
+#include <algorithm>
+
+#include "parallel_range.hpp"
+
+namespace reir {
+
+ParallelRange::ParallelRange(int64_t from, int64_t to, int64_t batch, uint16_t nodes)
+    : from_(from), to_(to), batch_(std::max<int64_t>(batch, 1)), nodes_(std::max<uint16_t>(nodes, 1)),
+      taken_(new std::atomic<int64_t>[nodes_]) {
+  for (uint16_t n = 0; n < nodes_; ++n) {
+    taken_[n] = 0;
+  }
+}
+
+int64_t ParallelRange::first_of(uint16_t node) const {
+  const int64_t rem = ((from_ % nodes_) + nodes_) % nodes_;
+  return from_ + (node - rem + nodes_) % nodes_;
+}
+
+int64_t ParallelRange::count_of(uint16_t node) const {
+  const int64_t first = first_of(node);
+  return first < to_ ? (to_ - first + nodes_ - 1) / nodes_ : 0;
+}
+
+bool ParallelRange::take(uint16_t node, int64_t* first, int64_t* count) {
+  const int64_t total = count_of(node);
+  const int64_t begin = taken_[node].fetch_add(batch_);
+  if (total <= begin) {
+    return false;
+  }
+  *first = first_of(node) + begin * nodes_;
+  *count = std::min(total, begin + batch_) - begin;
+  return true;
+}
+
+bool ParallelRange::take_any(uint16_t own, int64_t* first, int64_t* count) {
+  for (uint16_t n = 0; n < nodes_; ++n) {
+    if (take(static_cast<uint16_t>((own + n) % nodes_), first, count)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ParallelRange::done_on(uint16_t node) const {
+  return count_of(node) <= taken_[node].load();
+}
+
+bool ParallelRange::done() const {
+  for (uint16_t n = 0; n < nodes_; ++n) {
+    if (!done_on(n)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace reir
@@ -0,0 +1,41 @@
+#ifndef REIR_PARALLEL_RANGE_HPP_
+#define REIR_PARALLEL_RANGE_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace reir {
+
+// hands out the iterations [from, to) of a parallel for, batch_ at a time, to any
+// number of threads. partitioned, iteration i belongs to node i mod nodes and a
+// thread asks for the iterations of a node
+class ParallelRange {
+ public:
+  ParallelRange(int64_t from, int64_t to, int64_t batch, uint16_t nodes);
+
+  uint16_t nodes() const { return nodes_; }
+  // the next batch of node: count iterations, first, first + nodes(), ...
+  // false once node has none left
+  bool take(uint16_t node, int64_t* first, int64_t* count);
+  // a batch of own, or else of the next node with iterations left. the nodes no
+  // worker could be found for are drained this way
+  bool take_any(uint16_t own, int64_t* first, int64_t* count);
+  bool done_on(uint16_t node) const;
+  bool done() const;
+
+ private:
+  int64_t first_of(uint16_t node) const;
+  int64_t count_of(uint16_t node) const;
+
+  int64_t from_;
+  int64_t to_;
+  int64_t batch_;
+  uint16_t nodes_;
+  // per node, how many of its iterations were taken
+  std::unique_ptr<std::atomic<int64_t>[]> taken_;
+};
+
+}  // namespace reir
+
+#endif  // REIR_PARALLEL_RANGE_HPP_
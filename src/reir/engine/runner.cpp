@@ -0,0 +1,22 @@
+#include <stdexcept>
+#include "runner.hpp"
+#include "foedus_runner.hpp"
+#include "leveldb_runner.hpp"
+#include "memory_runner.hpp"
+
+namespace reir {
+
+std::shared_ptr<Runner> make_runner(const EngineConfig& config) {
+  if (config.backend == "leveldb") {
+    return std::make_shared<LevelDBRunner>(config);
+  }
+  if (config.backend == "memory") {
+    return std::make_shared<MemoryRunner>(config);
+  }
+  if (config.backend == "foedus") {
+    return std::make_shared<FoedusRunner>(config);
+  }
+  throw std::runtime_error("unknown backend: " + config.backend);
+}
+
+}  // namespace reir
@@ -0,0 +1,25 @@
+#ifndef REIR_RUNNER_HPP_
+#define REIR_RUNNER_HPP_
+
+#include <functional>
+#include <memory>
+#include "engine_config.hpp"
+
+namespace reir {
+
+class DBInterface;
+
+// owns a storage engine and runs compiled code against it
+class Runner {
+ public:
+  virtual ~Runner() = default;
+  // calls f with the interface code is generated for, on a thread of the engine
+  virtual void run(std::function<void(DBInterface&)> f) = 0;
+};
+
+// the runner of config.backend
+std::shared_ptr<Runner> make_runner(const EngineConfig& config);
+
+}  // namespace reir
+
+#endif  // REIR_RUNNER_HPP_
@@ -0,0 +1,418 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <ostream>
+
+#include "stats.hpp"
+
+namespace reir {
+
+LatencyHistogram::LatencyHistogram() : counts_(kBuckets), count_(0), sum_(0), max_(0) {}
+
+size_t LatencyHistogram::bucket_of(uint64_t nanos) {
+  if (nanos < (uint64_t(1) << kSubBits)) {
+    return static_cast<size_t>(nanos);
+  }
+  const int msb = 63 - __builtin_clzll(nanos);
+  if (kMaxBits <= msb) {
+    return kBuckets - 1;
+  }
+  const uint64_t sub = (nanos >> (msb - kSubBits)) & ((uint64_t(1) << kSubBits) - 1);
+  return (size_t(msb - kSubBits + 1) << kSubBits) + sub;
+}
+
+uint64_t LatencyHistogram::highest_of(size_t bucket) {
+  if (bucket < (size_t(1) << kSubBits)) {
+    return bucket;
+  }
+  const int msb = static_cast<int>(bucket >> kSubBits) + kSubBits - 1;
+  const uint64_t sub = bucket & ((size_t(1) << kSubBits) - 1);
+  const uint64_t lowest = (uint64_t(1) << msb) | (sub << (msb - kSubBits));
+  return lowest + (uint64_t(1) << (msb - kSubBits)) - 1;
+}
+
+void LatencyHistogram::record(uint64_t nanos) {
+  ++counts_[bucket_of(nanos)];
+  add_totals(1, nanos, nanos);
+}
+
+void LatencyHistogram::add_totals(uint64_t count, uint64_t sum, uint64_t max) {
+  count_ += count;
+  sum_ += sum;
+  max_ = std::max(max_, max);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& o) {
+  for (size_t i = 0; i < kBuckets; ++i) {
+    counts_[i] += o.counts_[i];
+  }
+  add_totals(o.count_, o.sum_, o.max_);
+}
+
+double LatencyHistogram::mean() const {
+  return count_ == 0 ? 0.0 : static_cast<double>(sum_) / count_;
+}
+
+uint64_t LatencyHistogram::percentile(double q) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q / 100.0 * count_)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    seen += counts_[i];
+    if (rank <= seen) {
+      return std::min(highest_of(i), max_);
+    }
+  }
+  return max_;
+}
+
+uint64_t TxnStats::total_aborts() const {
+  uint64_t n = 0;
+  for (const auto& a : aborts) {
+    n += a.second;
+  }
+  return n;
+}
+
+void TxnStats::merge(const TxnStats& o) {
+  commits += o.commits;
+  retries += o.retries;
+  rows_read += o.rows_read;
+  rows_written += o.rows_written;
+  for (const auto& a : o.aborts) {
+    aborts[a.first] += a.second;
+  }
+  begin_to_commit.merge(o.begin_to_commit);
+  commit_to_durable.merge(o.commit_to_durable);
+}
+
+namespace {
+
+std::string duration(uint64_t nanos) {
+  char buf[32];
+  if (nanos < 1000) {
+    std::snprintf(buf, sizeof(buf), "%lluns", static_cast<unsigned long long>(nanos));
+  } else if (nanos < 1000 * 1000) {
+    std::snprintf(buf, sizeof(buf), "%.1fus", nanos / 1e3);
+  } else if (nanos < 1000 * 1000 * 1000) {
+    std::snprintf(buf, sizeof(buf), "%.1fms", nanos / 1e6);
+  } else {
+    std::snprintf(buf, sizeof(buf), "%.2fs", nanos / 1e9);
+  }
+  return buf;
+}
+
+void print_latency(std::ostream& o, const char* name, const LatencyHistogram& h) {
+  o << "  " << name << ": count " << h.count();
+  if (h.count() != 0) {
+    o << " p50 " << duration(h.percentile(50))
+      << " p99 " << duration(h.percentile(99))
+      << " p99.9 " << duration(h.percentile(99.9))
+      << " max " << duration(h.max());
+  }
+  o << "\n";
+}
+
+}  // anonymous namespace
+
+void TxnStats::print(std::ostream& o) const {
+  o << "  commits " << commits << " aborts " << total_aborts() << " retries " << retries
+    << " rows read " << rows_read << " rows written " << rows_written << "\n";
+  for (const auto& a : aborts) {
+    o << "  aborted by " << a.first << ": " << a.second << "\n";
+  }
+  print_latency(o, "begin to commit", begin_to_commit);
+  print_latency(o, "commit to durable", commit_to_durable);
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+int64_t now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// a shard has a single writer, so a counter is bumped with a plain load and
+// store instead of a locked add. readers may see it a little behind
+void bump(std::atomic<uint64_t>& a, uint64_t n) {
+  a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+struct ShardHistogram {
+  std::atomic<uint64_t> counts[LatencyHistogram::kBuckets];
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> sum;
+  std::atomic<uint64_t> max;
+
+  ShardHistogram() {
+    reset();
+  }
+
+  void record(uint64_t nanos) {
+    bump(counts[LatencyHistogram::bucket_of(nanos)], 1);
+    bump(count, 1);
+    bump(sum, nanos);
+    if (max.load(std::memory_order_relaxed) < nanos) {
+      max.store(nanos, std::memory_order_relaxed);
+    }
+  }
+
+  void read(LatencyHistogram* h) const {
+    for (size_t i = 0; i < LatencyHistogram::kBuckets; ++i) {
+      const uint64_t n = counts[i].load(std::memory_order_relaxed);
+      if (n != 0) {
+        h->add(i, n);
+      }
+    }
+    h->add_totals(count.load(std::memory_order_relaxed), sum.load(std::memory_order_relaxed),
+                  max.load(std::memory_order_relaxed));
+  }
+
+  void reset() {
+    for (auto& c : counts) {
+      c.store(0, std::memory_order_relaxed);
+    }
+    count.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+  }
+};
+
+// what one thread recorded for one procedure
+struct StatsShard {
+  std::atomic<uint64_t> commits{0};
+  std::atomic<uint64_t> retries{0};
+  std::atomic<uint64_t> rows_read{0};
+  std::atomic<uint64_t> rows_written{0};
+  ShardHistogram begin_to_commit;
+  ShardHistogram commit_to_durable;
+  std::mutex aborts_mutex;  // aborts are rare enough to lock
+  std::map<std::string, uint64_t> aborts;
+
+  void read(TxnStats* s) {
+    s->commits += commits.load(std::memory_order_relaxed);
+    s->retries += retries.load(std::memory_order_relaxed);
+    s->rows_read += rows_read.load(std::memory_order_relaxed);
+    s->rows_written += rows_written.load(std::memory_order_relaxed);
+    begin_to_commit.read(&s->begin_to_commit);
+    commit_to_durable.read(&s->commit_to_durable);
+    std::lock_guard<std::mutex> lock(aborts_mutex);
+    for (const auto& a : aborts) {
+      s->aborts[a.first] += a.second;
+    }
+  }
+
+  // a writer in the middle of a bump can bring back what it read before
+  void reset() {
+    commits.store(0, std::memory_order_relaxed);
+    retries.store(0, std::memory_order_relaxed);
+    rows_read.store(0, std::memory_order_relaxed);
+    rows_written.store(0, std::memory_order_relaxed);
+    begin_to_commit.reset();
+    commit_to_durable.reset();
+    std::lock_guard<std::mutex> lock(aborts_mutex);
+    aborts.clear();
+  }
+};
+
+}  // anonymous namespace
+
+struct StatsProcedure {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<StatsShard>> shards;  // one per thread that recorded
+};
+
+namespace {
+
+using Procedure = StatsProcedure;
+
+struct Registry {
+  std::mutex mutex;
+  std::map<std::string, std::unique_ptr<Procedure>> procedures;
+};
+
+// never destroyed, workers may still record while the process exits
+Registry& registry() {
+  static Registry* r = new Registry;
+  return *r;
+}
+
+struct ThreadState {
+  Procedure* current = nullptr;  // of the innermost scope
+  Procedure* named = nullptr;  // set by stats_set_procedure, dropped by scopes
+  Procedure* procedure = nullptr;  // of shard
+  StatsShard* shard = nullptr;
+  std::map<Procedure*, StatsShard*> shards;
+  std::map<std::string, Procedure*> names;  // looked up by stats_set_procedure
+  int64_t begin = 0;   // of the running transaction
+  int64_t commit = 0;  // of the last committed one, until it is durable
+};
+
+ThreadState& thread_state() {
+  thread_local ThreadState state;
+  return state;
+}
+
+// the shard of this thread for the current procedure, nullptr outside of a scope
+StatsShard* shard() {
+  auto& state = thread_state();
+  if (state.current == nullptr) {
+    return nullptr;
+  }
+  Procedure* p = state.named != nullptr ? state.named : state.current;
+  if (state.procedure != p) {
+    auto it = state.shards.find(p);
+    if (it == state.shards.end()) {
+      std::lock_guard<std::mutex> lock(p->mutex);
+      p->shards.emplace_back(new StatsShard);
+      it = state.shards.emplace(p, p->shards.back().get()).first;
+    }
+    state.procedure = p;
+    state.shard = it->second;
+  }
+  return state.shard;
+}
+
+Procedure* procedure_of(const std::string& name) {
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  auto& slot = r.procedures[name];
+  if (!slot) {
+    slot.reset(new Procedure);
+  }
+  return slot.get();
+}
+
+}  // anonymous namespace
+
+void stats_xct_begin() {
+  if (shard() != nullptr) {
+    thread_state().begin = now();
+  }
+}
+
+void stats_xct_committed() {
+  auto* s = shard();
+  if (s == nullptr) {
+    return;
+  }
+  auto& state = thread_state();
+  const int64_t t = now();
+  bump(s->commits, 1);
+  if (state.begin != 0) {
+    s->begin_to_commit.record(static_cast<uint64_t>(t - state.begin));
+  }
+  state.begin = 0;
+  state.commit = t;
+}
+
+void stats_xct_durable() {
+  auto* s = shard();
+  auto& state = thread_state();
+  if (s == nullptr || state.commit == 0) {
+    return;
+  }
+  s->commit_to_durable.record(static_cast<uint64_t>(now() - state.commit));
+  state.commit = 0;
+}
+
+void stats_xct_aborted(const char* reason) {
+  auto* s = shard();
+  if (s == nullptr) {
+    return;
+  }
+  thread_state().begin = 0;
+  std::lock_guard<std::mutex> lock(s->aborts_mutex);
+  ++s->aborts[reason];
+}
+
+void stats_xct_retried() {
+  if (auto* s = shard()) {
+    bump(s->retries, 1);
+  }
+}
+
+void stats_rows_read(uint64_t n) {
+  if (auto* s = shard()) {
+    bump(s->rows_read, n);
+  }
+}
+
+void stats_rows_written(uint64_t n) {
+  if (auto* s = shard()) {
+    bump(s->rows_written, n);
+  }
+}
+
+void stats_set_procedure(const std::string& name) {
+  auto& state = thread_state();
+  if (state.current == nullptr) {
+    return;
+  }
+  // called once per transaction, so the registry is only locked for new names
+  auto it = state.names.find(name);
+  if (it == state.names.end()) {
+    it = state.names.emplace(name, procedure_of(name)).first;
+  }
+  state.named = it->second;
+}
+
+StatsProcedure* stats_current_procedure() {
+  return thread_state().current;
+}
+
+std::map<std::string, TxnStats> stats_snapshot() {
+  std::map<std::string, TxnStats> ret;
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (const auto& p : r.procedures) {
+    auto& stats = ret[p.first];
+    std::lock_guard<std::mutex> shards_lock(p.second->mutex);
+    for (const auto& s : p.second->shards) {
+      s->read(&stats);
+    }
+  }
+  return ret;
+}
+
+void stats_reset() {
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (const auto& p : r.procedures) {
+    std::lock_guard<std::mutex> shards_lock(p.second->mutex);
+    for (const auto& s : p.second->shards) {
+      s->reset();
+    }
+  }
+}
+
+void print_stats(std::ostream& o) {
+  for (const auto& p : stats_snapshot()) {
+    o << "procedure " << p.first << "\n";
+    p.second.print(o);
+  }
+}
+
+StatsScope::StatsScope(const std::string& name) : StatsScope(procedure_of(name)) {}
+
+StatsScope::StatsScope(StatsProcedure* procedure) {
+  auto& state = thread_state();
+  previous_ = state.current;
+  state.current = procedure;
+  state.named = nullptr;
+}
+
+StatsScope::~StatsScope() {
+  auto& state = thread_state();
+  state.current = previous_;
+  state.named = nullptr;
+}
+
+}  // namespace reir
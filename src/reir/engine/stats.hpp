@@ -0,0 +1,109 @@
+#ifndef REIR_STATS_HPP_
+#define REIR_STATS_HPP_
+
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace reir {
+
+// latencies in nanoseconds, bucketed like an HdrHistogram: values below 32 each have
+// a bucket, above that every power of two is cut into 32 linear buckets, so a
+// percentile is off by at most about 3%. values of 2^40ns (18 minutes) and more share
+// the last bucket
+class LatencyHistogram {
+ public:
+  static const int kSubBits = 5;
+  static const int kMaxBits = 40;
+  static const size_t kBuckets = size_t(kMaxBits - kSubBits + 1) << kSubBits;
+
+  LatencyHistogram();
+
+  void record(uint64_t nanos);
+  void merge(const LatencyHistogram& o);
+
+  uint64_t count() const { return count_; }
+  uint64_t max() const { return max_; }
+  double mean() const;
+  // the highest value of the bucket holding the q-th percentile, 0 when empty
+  uint64_t percentile(double q) const;
+
+  static size_t bucket_of(uint64_t nanos);
+  static uint64_t highest_of(size_t bucket);
+  // for the per-thread shards, which keep their own buckets
+  void add(size_t bucket, uint64_t n) { counts_[bucket] += n; }
+  void add_totals(uint64_t count, uint64_t sum, uint64_t max);
+
+ private:
+  std::vector<uint64_t> counts_;
+  uint64_t count_;
+  uint64_t sum_;
+  uint64_t max_;
+};
+
+// what the transactions of one procedure did, merged over every thread
+struct TxnStats {
+  uint64_t commits = 0;
+  uint64_t retries = 0;  // transactions run again after an abort
+  uint64_t rows_read = 0;
+  uint64_t rows_written = 0;
+  std::map<std::string, uint64_t> aborts;  // by reason
+  LatencyHistogram begin_to_commit;
+  LatencyHistogram commit_to_durable;
+
+  uint64_t total_aborts() const;
+  void merge(const TxnStats& o);
+  // counters first, then p50, p99, p99.9 and max of both histograms
+  void print(std::ostream& o) const;
+};
+
+// the engine interfaces record into the procedure of the innermost StatsScope of
+// the calling thread. a thread working for another one, like a parallel worker,
+// opens a scope on the procedure it was handed. every thread has its own counters
+// and histograms per procedure, nothing is shared until they are read. outside of
+// a scope nothing is recorded
+void stats_xct_begin();
+void stats_xct_committed();
+// the commit of the last committed transaction of this thread is durable
+void stats_xct_durable();
+void stats_xct_aborted(const char* reason);
+void stats_xct_retried();
+void stats_rows_read(uint64_t n = 1);
+void stats_rows_written(uint64_t n = 1);
+
+// the transactions this thread runs from now on are counted for name instead of
+// the procedure of the scope, until a scope of this thread opens or closes.
+// for code mixing several procedures in one scope, like the TPC-C mix. does
+// nothing outside of a scope
+void stats_set_procedure(const std::string& name);
+
+// stats of a procedure, handed to the threads that work for it
+struct StatsProcedure;
+// the procedure of the innermost scope of this thread, nullptr outside of one
+StatsProcedure* stats_current_procedure();
+
+// every procedure seen so far, by name
+std::map<std::string, TxnStats> stats_snapshot();
+void stats_reset();
+void print_stats(std::ostream& o);
+
+// transactions of this thread are counted for name while it lives. scopes nest,
+// the previous procedure is back once it is gone
+class StatsScope {
+ public:
+  explicit StatsScope(const std::string& name);
+  // the procedure of another thread's scope, nothing is recorded for nullptr
+  explicit StatsScope(StatsProcedure* procedure);
+  ~StatsScope();
+  StatsScope(const StatsScope&) = delete;
+  StatsScope& operator=(const StatsScope&) = delete;
+
+ private:
+  StatsProcedure* previous_;
+};
+
+}  // namespace reir
+
+#endif  // REIR_STATS_HPP_
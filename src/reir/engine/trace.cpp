@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "trace.hpp"
+
+namespace reir {
+
+namespace detail {
+std::atomic<int> trace_level(static_cast<int>(TraceLevel::kInfo));
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct TraceRecord {
+  int64_t nanos;
+  int32_t level;
+  char text[116];  // the record fills two cache lines, longer messages are cut
+};
+
+// written by its thread only, read by the drain only
+struct TraceRing {
+  static const uint64_t kCapacity = 1024;
+  explicit TraceRing(uint32_t t) : thread(t), head(0), tail(0) {}
+  const uint32_t thread;
+  std::atomic<uint64_t> head;  // next slot to write
+  std::atomic<uint64_t> tail;  // next slot to read
+  TraceRecord records[kCapacity];
+};
+
+class Tracer {
+ public:
+  Tracer() : start_(Clock::now()), sink_(&std::cout), dropped_(0), reported_(0), stop_(false) {}
+
+  TraceRing* ring() {
+    thread_local TraceRing* ring = nullptr;
+    if (ring == nullptr) {
+      std::lock_guard<std::mutex> lock(rings_mutex_);
+      rings_.emplace_back(new TraceRing(static_cast<uint32_t>(rings_.size())));
+      ring = rings_.back().get();
+      if (!drain_thread_.joinable()) {
+        drain_thread_ = std::thread([this] { drain_loop(); });
+        std::atexit([] { tracer().stop(); });
+      }
+    }
+    return ring;
+  }
+
+  void append(TraceLevel level, const char* format, va_list args) {
+    TraceRing* r = ring();
+    const uint64_t head = r->head.load(std::memory_order_relaxed);
+    if (TraceRing::kCapacity <= head - r->tail.load(std::memory_order_acquire)) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    TraceRecord& rec = r->records[head % TraceRing::kCapacity];
+    rec.nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_).count();
+    rec.level = static_cast<int32_t>(level);
+    vsnprintf(rec.text, sizeof(rec.text), format, args);
+    r->head.store(head + 1, std::memory_order_release);
+  }
+
+  // the single consumer of every ring
+  void drain() {
+    std::lock_guard<std::mutex> drain_lock(drain_mutex_);
+    std::vector<TraceRing*> rings;
+    {
+      std::lock_guard<std::mutex> lock(rings_mutex_);
+      for (const auto& r : rings_) {
+        rings.push_back(r.get());
+      }
+    }
+    struct Entry {
+      const TraceRecord* rec;
+      uint32_t thread;
+    };
+    std::vector<Entry> entries;
+    std::vector<uint64_t> heads;
+    for (auto* r : rings) {
+      const uint64_t head = r->head.load(std::memory_order_acquire);
+      for (uint64_t i = r->tail.load(std::memory_order_relaxed); i < head; ++i) {
+        entries.push_back(Entry{&r->records[i % TraceRing::kCapacity], r->thread});
+      }
+      heads.push_back(head);
+    }
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+      return a.rec->nanos < b.rec->nanos;
+    });
+    static const char kLevels[] = "DIWE";
+    char prefix[48];
+    for (const auto& e : entries) {
+      snprintf(prefix, sizeof(prefix), "[%c t%u %.6f] ",
+               kLevels[e.rec->level], e.thread, e.rec->nanos / 1e9);
+      *sink_ << prefix << e.rec->text << "\n";
+    }
+    const uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != reported_) {
+      *sink_ << "[trace] " << dropped - reported_ << " messages dropped\n";
+      reported_ = dropped;
+    }
+    if (!entries.empty()) {
+      sink_->flush();
+    }
+    // the slots go back to their writers only once they are written out
+    for (size_t i = 0; i < rings.size(); ++i) {
+      rings[i]->tail.store(heads[i], std::memory_order_release);
+    }
+  }
+
+  void set_sink(std::ostream* sink) {
+    drain();
+    std::lock_guard<std::mutex> drain_lock(drain_mutex_);
+    sink_ = sink;
+  }
+
+  uint64_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(stop_mutex_);
+      stop_ = true;
+    }
+    stop_cv_.notify_all();
+    if (drain_thread_.joinable()) {
+      drain_thread_.join();
+    }
+    drain();
+  }
+
+  static Tracer& tracer() {
+    // never destroyed, threads may still trace while statics go away
+    static Tracer* t = new Tracer;
+    return *t;
+  }
+
+ private:
+  void drain_loop() {
+    std::unique_lock<std::mutex> lock(stop_mutex_);
+    while (!stop_) {
+      stop_cv_.wait_for(lock, std::chrono::milliseconds(10));
+      lock.unlock();
+      drain();
+      lock.lock();
+    }
+  }
+
+  const Clock::time_point start_;
+  std::ostream* sink_;
+  std::atomic<uint64_t> dropped_;
+  uint64_t reported_;
+
+  std::mutex rings_mutex_;
+  std::vector<std::unique_ptr<TraceRing>> rings_;
+  std::mutex drain_mutex_;
+  std::thread drain_thread_;
+  std::mutex stop_mutex_;
+  std::condition_variable stop_cv_;
+  bool stop_;
+};
+
+}  // anonymous namespace
+
+void trace(TraceLevel level, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  Tracer::tracer().append(level, format, args);
+  va_end(args);
+}
+
+void set_trace_level(TraceLevel level) {
+  detail::trace_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+void set_trace_sink(std::ostream* sink) {
+  Tracer::tracer().set_sink(sink);
+}
+
+void trace_flush() {
+  Tracer::tracer().drain();
+}
+
+uint64_t trace_dropped() {
+  return Tracer::tracer().dropped();
+}
+
+}  // namespace reir
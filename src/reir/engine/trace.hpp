@@ -0,0 +1,81 @@
+#ifndef REIR_TRACE_HPP_
+#define REIR_TRACE_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+
+// traces below this level are compiled out, their arguments are not even evaluated.
+// 0 debug, 1 info, 2 warn, 3 error. set with -DREIR_TRACE_MIN_LEVEL=0 to get everything
+#ifndef REIR_TRACE_MIN_LEVEL
+#define REIR_TRACE_MIN_LEVEL 1
+#endif
+
+namespace reir {
+
+enum class TraceLevel : int {
+  kDebug = 0,
+  kInfo = 1,
+  kWarn = 2,
+  kError = 3,
+  kOff = 4,
+};
+
+// a trace call formats into a ring buffer of the calling thread and returns, it
+// never takes a lock or writes to a stream. a drain thread writes the rings out to
+// the sink in time order every few milliseconds. when a ring is full the message is
+// dropped and counted, the count is reported with the next drain
+void trace(TraceLevel level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+// traces below level are skipped at run time, the default is info
+void set_trace_level(TraceLevel level);
+// where the drain thread writes, std::cout by default. waits for pending traces
+// to go to the old sink first
+void set_trace_sink(std::ostream* sink);
+// writes out everything traced so far, also done at exit
+void trace_flush();
+// messages lost to full rings so far
+uint64_t trace_dropped();
+
+namespace detail {
+extern std::atomic<int> trace_level;
+}
+
+inline bool trace_enabled(TraceLevel level) {
+  return detail::trace_level.load(std::memory_order_relaxed) <= static_cast<int>(level);
+}
+
+}  // namespace reir
+
+#define REIR_TRACE(level, ...) \
+  do { \
+    if (::reir::trace_enabled(level)) { \
+      ::reir::trace(level, __VA_ARGS__); \
+    } \
+  } while (0)
+
+#if REIR_TRACE_MIN_LEVEL <= 0
+#define REIR_TRACE_DEBUG(...) REIR_TRACE(::reir::TraceLevel::kDebug, __VA_ARGS__)
+#else
+#define REIR_TRACE_DEBUG(...) do {} while (0)
+#endif
+
+#if REIR_TRACE_MIN_LEVEL <= 1
+#define REIR_TRACE_INFO(...) REIR_TRACE(::reir::TraceLevel::kInfo, __VA_ARGS__)
+#else
+#define REIR_TRACE_INFO(...) do {} while (0)
+#endif
+
+#if REIR_TRACE_MIN_LEVEL <= 2
+#define REIR_TRACE_WARN(...) REIR_TRACE(::reir::TraceLevel::kWarn, __VA_ARGS__)
+#else
+#define REIR_TRACE_WARN(...) do {} while (0)
+#endif
+
+#if REIR_TRACE_MIN_LEVEL <= 3
+#define REIR_TRACE_ERROR(...) REIR_TRACE(::reir::TraceLevel::kError, __VA_ARGS__)
+#else
+#define REIR_TRACE_ERROR(...) do {} while (0)
+#endif
+
+#endif  // REIR_TRACE_HPP_
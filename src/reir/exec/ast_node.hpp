@@ -49,6 +49,7 @@ struct Node {
     ND_STATEMENT_FIRST,
     ND_Block,
     ND_Define,
+    ND_DefineIndex,
     ND_Emit,
     ND_ExprStatement,
     ND_For,
@@ -57,6 +58,13 @@ struct Node {
     ND_Jump,
     ND_Insert,
     ND_Scan,
+    ND_Aggregate,
+    ND_AggregateStep,
+    ND_Join,
+    ND_JoinStep,
+    ND_Sort,
+    ND_SortStep,
+    ND_Parallel,
     ND_Let,
     ND_Transaction,
     ND_STATEMENT_LAST,
@@ -185,6 +193,11 @@ struct TupleType : public Type {
   std::vector<Attribute::AttrProperty> props_;
   std::vector<std::shared_ptr<int>> params_;
   std::vector<Type*> types_;  // only analyzed
+  // a table type, set by define: where its rows are stored
+  StorageKind storage_ = StorageKind::MASSTREE;
+  uint64_t storage_size_ = 0;
+  // added by define index, statements analyzed later see them
+  std::vector<IndexDef> indexes_;
   TupleType(std::vector<Type*>&& types,
             std::vector<std::string>&& names,
             std::vector<Attribute::AttrProperty>&& props = {})
@@ -219,6 +232,10 @@ struct TupleType : public Type {
     types_.push_back(type);
     names_.emplace_back(std::move(name));
   }
+  // key columns in the order they are laid out in the key
+  std::vector<size_t> key_columns() const {
+    return key_order(props_);
+  }
   ~TupleType() override = default;
 
   Type* analyze(CompilerContext& ctx);
@@ -21,6 +21,10 @@ namespace node {
 struct Statement : public Node {
   Statement(NodeKind k) : Node(k) {}
 
+  // where it starts in the source, 0 for statements the compiler makes up
+  int row_ = 0;
+  int col_ = 0;
+
   Statement(const Statement&) = delete;
 
   void dump(std::ostream& o, size_t indent) const override = 0;
@@ -166,8 +170,14 @@ struct Define : public Statement {
   void dump(std::ostream& o, size_t indent) const override {
     o << "Define(" << name_ << ")";
     schema_->dump(o);
+    if (schema_->storage_ != StorageKind::MASSTREE) {
+      o << " using " << storage_kind_name(schema_->storage_);
+    }
   }
 
+  // throws if the columns do not fit the storage chosen with using
+  void check_storage() const;
+
   void alloca_stack(CompilerContext& c) const override;
 
   void each_value(const std::function<void(const Expression*)>& func) const override {}
@@ -186,6 +196,45 @@ struct Define : public Statement {
   }
 };
 
+// define index <name> on <table>(<column>, ...)
+struct DefineIndex : public Statement {
+  std::string name_;
+  std::string table_;
+  std::vector<std::string> columns_;
+  IndexDef index_;  // resolved by analyze
+  mutable llvm::Constant* table_begin_;
+  mutable llvm::Constant* table_end_;
+  mutable llvm::Constant* prefix_;
+  mutable llvm::Value* entry_stack_;
+
+  ~DefineIndex() override = default;
+
+  explicit DefineIndex(TokenStream& s);
+
+  void dump(std::ostream& o, size_t indent) const override {
+    o << "DefineIndex(" << name_ << " on " << table_ << "(";
+    for (size_t i = 0; i < columns_.size(); ++i) {
+      o << (i == 0 ? "" : ", ") << columns_[i];
+    }
+    o << "))";
+  }
+
+  void alloca_stack(CompilerContext& c) const override;
+
+  void each_value(const std::function<void(const Expression*)>& func) const override {}
+
+  void each_statement(std::function<void(const Statement*)> func) const override {}
+
+  // fills the index with the rows already in the table
+  void codegen(CompilerContext& c) const override;
+
+  void analyze(CompilerContext& ctx) override;
+
+  static bool classof(const Node *n) {
+    return n->getKind() == ND_DefineIndex;
+  }
+};
+
 struct For : public Statement {
   Statement* init_;
   Expression* cond_;
@@ -330,10 +379,13 @@ struct Emit : public Statement {
 struct Insert : public Statement {
   std::string table_;
   Expression* value_;
+  std::vector<IndexDef> indexes_;  // of the table when this insert is analyzed, kept up to date here
   mutable llvm::Constant* prefix_;
   mutable llvm::Value* key_stack_;
   mutable llvm::Value* value_stack_;
   mutable llvm::Value* tuple_stack_;
+  mutable std::vector<llvm::Constant*> index_prefixes_;
+  mutable std::vector<llvm::Value*> index_stacks_;
 
   explicit Insert(TokenStream& tokens);
 
@@ -341,6 +393,13 @@ struct Insert : public Statement {
      key_stack_(nullptr), value_stack_(nullptr), tuple_stack_(nullptr), prefix_(nullptr) {}
 
   void codegen(CompilerContext& c) const override;
+  // writes the masstree key and value of one row
+  void encode_row(CompilerContext& c, llvm::Value* row, llvm::StructType* row_type,
+                  llvm::Value* key, llvm::Value* value) const;
+  // writes the entry of the i-th index for one row
+  void encode_index_entry(CompilerContext& c, size_t i, llvm::Value* row, llvm::Value* entry) const;
+  // inserts the entries of every index for a row, if inserted is true
+  void insert_index_entries(CompilerContext& c, llvm::Value* row, llvm::Value* inserted) const;
 
   ~Insert() override {
     delete value_;
@@ -360,6 +419,9 @@ struct Insert : public Statement {
   }
   void analyze(CompilerContext& ctx) override {
     value_->analyze(ctx);
+    if (auto* tuple = dynamic_cast<TupleType*>(ctx.analyze_type_table_[table_])) {
+      indexes_ = tuple->indexes_;
+    }
   }
   static bool classof(const Node *n) {
     return n->getKind() == ND_Insert;
@@ -367,50 +429,503 @@ struct Insert : public Statement {
 };
 
 struct Scan : public Statement {
+  static constexpr uint64_t kDefaultBatchSize = 1024;
+  // the batch buffers are allocas, wider rows get fewer rows per batch
+  static constexpr uint64_t kBatchBufferBytes = 64 * 1024;
+
   std::string table_;
   std::string row_name_;
+  Expression* where_;  // nullptr if no filter
   Block* blk_;
+  uint64_t batch_size_;  // 0 means row at a time
+  uint64_t limit_;       // stop after the body ran this many times, 0 means no limit
+  bool parallel_;        // morsels of the range are scanned by all workers
+
+  // where_ split by analyze(). equalities on the leading key columns and one
+  // range on the next key column become the cursor range, the rest is residual.
+  std::vector<const Expression*> key_eq_;
+  const Expression* key_lower_;
+  const Expression* key_upper_;
+  bool lower_inclusive_;
+  bool upper_inclusive_;
+  bool point_lookup_;  // every key column is bound by an equality
+  std::vector<const Expression*> residual_;
+  // with no key range, an index whose leading columns are bound by equalities.
+  // the scan walks its entries and looks every row up, the equalities stay residual
+  IndexDef index_;  // name is empty when no index is used
+  std::vector<const Expression*> index_eq_;
+
   mutable llvm::Constant* prefix_begin_;
   mutable llvm::Constant* prefix_end_;
-  mutable llvm::Value* key_stack_;
-  mutable llvm::Value* value_stack_;
+  mutable llvm::Value* range_begin_;
+  mutable llvm::Value* range_end_;
   mutable llvm::Value* tuple_stack_;
-
-  Scan(TokenStream& tokens);
-
-  Scan(std::string t, std::string n, Block* b) : Statement(NodeKind::ND_Scan),
-    table_(std::move(t)), row_name_(std::move(n)), blk_(b),
-    key_stack_(nullptr), value_stack_(nullptr), tuple_stack_(nullptr), prefix_begin_(nullptr), prefix_end_(nullptr) {}
+  mutable llvm::Value* batch_index_;
+  mutable llvm::Value* batch_keys_;
+  mutable llvm::Value* batch_values_;
+  mutable llvm::Value* batch_mask_;    // nullptr without a residual predicate
+  mutable llvm::Value* cursor_slot_;   // reused cursor when nested in another scan
+  mutable llvm::Value* lookup_value_;
+  mutable llvm::Value* limit_count_;
+  mutable llvm::Constant* index_prefix_;
+  mutable llvm::Value* index_begin_;
+  mutable llvm::Value* index_end_;
+
+  explicit Scan(TokenStream& tokens, bool with_body = true);
+
+  Scan(std::string t, std::string n, Block* b, Expression* where = nullptr, uint64_t batch_size = 0,
+       uint64_t limit = 0)
+    : Statement(NodeKind::ND_Scan),
+      table_(std::move(t)), row_name_(std::move(n)), where_(where), blk_(b), batch_size_(batch_size),
+      limit_(limit), parallel_(false),
+      key_lower_(nullptr), key_upper_(nullptr), lower_inclusive_(false), upper_inclusive_(false),
+      point_lookup_(false),
+      prefix_begin_(nullptr), prefix_end_(nullptr), range_begin_(nullptr), range_end_(nullptr),
+      tuple_stack_(nullptr), batch_index_(nullptr), batch_keys_(nullptr), batch_values_(nullptr),
+      batch_mask_(nullptr), cursor_slot_(nullptr), lookup_value_(nullptr),
+      limit_count_(nullptr), index_prefix_(nullptr), index_begin_(nullptr), index_end_(nullptr) {}
 
   void codegen(CompilerContext& c) const override;
 
   ~Scan() override {
+    delete where_;
     delete blk_;
   }
 
   void dump(std::ostream& o, size_t indent) const override {
-    o << "full_scan(" << table_ << "): as |" << row_name_ << "|\n" << util::blank(indent);
+    if (parallel_) {
+      o << "parallel ";
+    }
+    o << "full_scan(" << table_ << "): as |" << row_name_ << "|";
+    if (where_) {
+      o << " where ";
+      where_->dump(o, indent);
+    }
+    if (uses_index()) {
+      o << " by index " << index_.name;
+    }
+    if (batch_size_ != 0) {
+      o << " batch " << batch_size_;
+    }
+    if (limit_ != 0) {
+      o << " limit " << limit_;
+    }
+    o << "\n" << util::blank(indent);
     blk_->dump(o, indent);
   }
 
   void alloca_stack(CompilerContext& c) const override;
 
   void each_statement(std::function<void(const Statement*)> func) const override {
-    blk_->each_statement(func);
+    // a parallel scan allocates its body in the outlined function
+    if (!parallel_) {
+      blk_->each_statement(func);
+    }
   }
 
   void each_value(const std::function<void(const Expression*)>& func) const override {
+    if (where_) {
+      func(where_);
+    }
   }
 
   void analyze(CompilerContext& ctx) override {
-    auto* schema = ctx.local_schema_table_[table_];
-    ctx.variable_type_table_[row_name_] = ctx.analyze_type_table_[table_];
+    auto* tuple = dynamic_cast<TupleType*>(ctx.analyze_type_table_[table_]);
+    if (!tuple) {
+      throw std::runtime_error("undefined table: " + table_);
+    }
+    ctx.variable_type_table_[row_name_] = tuple;
+    if (where_) {
+      where_->analyze(ctx);
+      split_where(*tuple);
+    }
+    if (point_lookup_) {
+      parallel_ = false;  // a single row, nothing to split
+    }
+    if (uses_index()) {
+      // a few rows looked up one by one
+      parallel_ = false;
+      batch_size_ = 0;
+    }
+    if (tuple->storage_ == StorageKind::HASH && !point_lookup_) {
+      throw std::runtime_error("hash table " + table_ + " can only be read by its whole key");
+    }
+    if (parallel_ && tuple->storage_ == StorageKind::SEQUENTIAL) {
+      throw std::runtime_error("sequential table " + table_ + " can not be scanned in parallel");
+    }
     blk_->analyze(ctx);
   }
 
   static bool classof(const Node *n) {
     return n->getKind() == ND_Scan;
   }
+
+  void split_where(const TupleType& table);
+  bool has_key_range() const {
+    return !key_eq_.empty() || key_lower_ || key_upper_;
+  }
+  bool uses_index() const {
+    return !index_.name.empty();
+  }
+  uint64_t build_range_key(CompilerContext& c, llvm::Value* buffer,
+                           const Expression* bound, bool pad) const;
+  uint64_t build_index_key(CompilerContext& c, llvm::Value* buffer, bool pad) const;
+  // the key of the row an index entry points at, built in range_begin_
+  llvm::Value* index_to_key(CompilerContext& c, llvm::Value* entry) const;
+  llvm::Value* residual_value(CompilerContext& c) const;
+  llvm::Value* load_row(CompilerContext& c, llvm::Value* key, llvm::Value* value) const;
+  void alloca_range(CompilerContext& c) const;
+  void alloca_row(CompilerContext& c) const;
+  void cursor_range(CompilerContext& c, llvm::Value** from, llvm::Value** from_length,
+                    llvm::Value** to, llvm::Value** to_length) const;
+  void codegen_cursor(CompilerContext& c, llvm::Value* from, llvm::Value* from_length,
+                      llvm::Value* to, llvm::Value* to_length) const;
+  void codegen_parallel(CompilerContext& c) const;
+  void codegen_row(CompilerContext& c, CursorBase* cursor) const;
+  void codegen_batch(CompilerContext& c, CursorBase* cursor) const;
+  void codegen_lookup(CompilerContext& c) const;
+  // where continue and the end of the body go, next unless there is a limit
+  llvm::BasicBlock* counted_block(CompilerContext& c, llvm::BasicBlock* next) const;
+  void count_limit(CompilerContext& c, llvm::BasicBlock* counted, llvm::BasicBlock* next,
+                   llvm::BasicBlock* fin) const;
+};
+
+struct Aggregate;
+
+// the body of the scan under an aggregate, accumulates the current row
+struct AggregateStep : public Statement {
+  const Aggregate* owner_;
+
+  explicit AggregateStep(const Aggregate* owner) : Statement(ND_AggregateStep), owner_(owner) {}
+
+  void dump(std::ostream& o, size_t indent) const override;
+  void codegen(CompilerContext& c) const override;
+  void alloca_stack(CompilerContext& c) const override {}
+  void each_statement(std::function<void(const Statement*)> func) const override {}
+  void each_value(const std::function<void(const Expression*)>& func) const override {}
+  void analyze(CompilerContext& ctx) override;
+
+  static bool classof(const Node *n) {
+    return n->getKind() == ND_AggregateStep;
+  }
+};
+
+struct Aggregate : public Statement {
+  enum Function {
+    SUM,
+    COUNT,
+    MIN,
+    MAX,
+    AVG,
+  };
+  struct Term {
+    Function func;
+    Expression* arg;  // nullptr for count()
+    uint64_t offset;  // first accumulator word
+  };
+
+  Scan* scan_;
+  std::vector<Expression*> group_by_;
+  std::vector<Term> terms_;
+  uint64_t accumulator_words_;
+
+  mutable llvm::Value* table_;        // RowHashTable*, group by only
+  mutable llvm::Value* key_stack_;    // group key of the current row
+  mutable llvm::Value* iter_stack_;   // position for reir_hash_table_next
+  mutable std::vector<llvm::Value*> accumulators_;  // no group by, promoted to registers
+  mutable llvm::AllocaInst* output_stack_;
+
+  // aggregate scan <table> as <row> [where ..] [batch ..] [by <expr>, ...] { <func>(<expr>), ... }
+  explicit Aggregate(TokenStream& tokens);
+
+  ~Aggregate() override {
+    delete scan_;
+    for (auto* g : group_by_) {
+      delete g;
+    }
+    for (auto& t : terms_) {
+      delete t.arg;
+    }
+  }
+
+  void dump(std::ostream& o, size_t indent) const override {
+    o << "aggregate";
+    if (!group_by_.empty()) {
+      o << " by ";
+      for (size_t i = 0; i < group_by_.size(); ++i) {
+        if (0 < i) { o << ", "; }
+        group_by_[i]->dump(o, indent);
+      }
+    }
+    o << " over ";
+    scan_->dump(o, indent + 2);
+  }
+
+  void codegen(CompilerContext& c) const override;
+  void codegen_step(CompilerContext& c) const;
+  void alloca_stack(CompilerContext& c) const override;
+
+  void each_statement(std::function<void(const Statement*)> func) const override {
+    func(scan_);
+    scan_->each_statement(func);
+  }
+
+  void each_value(const std::function<void(const Expression*)>& func) const override {
+    scan_->each_value(func);
+    for (const auto* g : group_by_) {
+      func(g);
+    }
+    for (const auto& t : terms_) {
+      if (t.arg) {
+        func(t.arg);
+      }
+    }
+  }
+
+  void analyze(CompilerContext& ctx) override {
+    scan_->analyze(ctx);  // analyzes group_by_ and terms_ through AggregateStep
+  }
+
+  static bool classof(const Node *n) {
+    return n->getKind() == ND_Aggregate;
+  }
+
+private:
+  void accumulate(CompilerContext& c, const std::function<llvm::Value*(uint64_t)>& word) const;
+  void init_accumulators(CompilerContext& c, const std::function<llvm::Value*(uint64_t)>& word) const;
+  void emit_result(CompilerContext& c, const std::function<llvm::Value*(uint64_t)>& key,
+                   const std::function<llvm::Value*(uint64_t)>& word) const;
+};
+
+struct Join;
+
+// the body of either scan under a join, inserts a build row or probes with a probe row
+struct JoinStep : public Statement {
+  const Join* owner_;
+  bool build_;
+
+  JoinStep(const Join* owner, bool build) : Statement(ND_JoinStep), owner_(owner), build_(build) {}
+
+  void dump(std::ostream& o, size_t indent) const override;
+  void codegen(CompilerContext& c) const override;
+  void alloca_stack(CompilerContext& c) const override {}
+  void each_statement(std::function<void(const Statement*)> func) const override;
+  void each_value(const std::function<void(const Expression*)>& func) const override {}
+  void analyze(CompilerContext& ctx) override;
+
+  static bool classof(const Node *n) {
+    return n->getKind() == ND_JoinStep;
+  }
+};
+
+// equi join, the first scan builds a hash table and the second one probes it.
+// put the smaller input first.
+struct Join : public Statement {
+  Scan* build_;
+  Scan* probe_;
+  std::vector<Expression*> build_keys_;
+  std::vector<Expression*> probe_keys_;
+  Block* blk_;
+
+  mutable llvm::Value* table_;
+  mutable llvm::Value* key_stack_;
+
+  // join scan <t1> as <r1> [where ..] on <expr>, ... with scan <t2> as <r2> [where ..] on <expr>, ... { ... }
+  explicit Join(TokenStream& tokens);
+
+  ~Join() override {
+    delete build_;
+    delete probe_;
+    for (auto* k : build_keys_) {
+      delete k;
+    }
+    for (auto* k : probe_keys_) {
+      delete k;
+    }
+    delete blk_;
+  }
+
+  void dump(std::ostream& o, size_t indent) const override {
+    o << "hash_join build: ";
+    build_->dump(o, indent + 2);
+    o << util::blank(indent) << "probe: ";
+    probe_->dump(o, indent + 2);
+    o << "\n" << util::blank(indent);
+    blk_->dump(o, indent);
+  }
+
+  void codegen(CompilerContext& c) const override;
+  void codegen_build(CompilerContext& c) const;
+  void codegen_probe(CompilerContext& c) const;
+  void alloca_stack(CompilerContext& c) const override;
+
+  void each_statement(std::function<void(const Statement*)> func) const override {
+    func(build_);
+    build_->each_statement(func);
+    func(probe_);
+    probe_->each_statement(func);
+  }
+
+  void each_value(const std::function<void(const Expression*)>& func) const override {
+    build_->each_value(func);
+    probe_->each_value(func);
+  }
+
+  void analyze(CompilerContext& ctx) override {
+    build_->analyze(ctx);
+    probe_->analyze(ctx);  // analyzes the body too, both rows are visible there
+  }
+
+  static bool classof(const Node *n) {
+    return n->getKind() == ND_Join;
+  }
+};
+
+struct Sort;
+
+// the body of the scan under a sort, appends the current row to the sorter
+struct SortStep : public Statement {
+  const Sort* owner_;
+
+  explicit SortStep(const Sort* owner) : Statement(ND_SortStep), owner_(owner) {}
+
+  void dump(std::ostream& o, size_t indent) const override;
+  void codegen(CompilerContext& c) const override;
+  void alloca_stack(CompilerContext& c) const override {}
+  void each_statement(std::function<void(const Statement*)> func) const override;
+  void each_value(const std::function<void(const Expression*)>& func) const override {}
+  void analyze(CompilerContext& ctx) override;
+
+  static bool classof(const Node *n) {
+    return n->getKind() == ND_SortStep;
+  }
+};
+
+// collects the rows of a scan, then runs the block for each row in order.
+// the row variable of the scan is bound to the sorted row in the block.
+struct Sort : public Statement {
+  Scan* scan_;
+  std::vector<Expression*> keys_;
+  std::vector<bool> descending_;
+  uint64_t limit_;  // 0 means no limit
+  Block* blk_;
+
+  mutable llvm::Value* sorter_;
+  mutable llvm::Value* record_stack_;  // [sort keys][scan order][row]
+  mutable llvm::Value* order_stack_;  // rows added so far, the last sort key keeps ties in scan order
+
+  // sort scan <table> as <row> [where ..] [batch ..] by <expr> [asc|desc], ... [limit <n>] { ... }
+  explicit Sort(TokenStream& tokens);
+
+  ~Sort() override {
+    delete scan_;
+    for (auto* k : keys_) {
+      delete k;
+    }
+    delete blk_;
+  }
+
+  void dump(std::ostream& o, size_t indent) const override {
+    o << "sort by ";
+    for (size_t i = 0; i < keys_.size(); ++i) {
+      if (0 < i) { o << ", "; }
+      keys_[i]->dump(o, indent);
+      if (descending_[i]) {
+        o << " desc";
+      }
+    }
+    if (limit_ != 0) {
+      o << " limit " << limit_;
+    }
+    o << " over ";
+    scan_->dump(o, indent + 2);
+    o << "\n" << util::blank(indent);
+    blk_->dump(o, indent);
+  }
+
+  void codegen(CompilerContext& c) const override;
+  void codegen_step(CompilerContext& c) const;
+  void alloca_stack(CompilerContext& c) const override;
+
+  void each_statement(std::function<void(const Statement*)> func) const override {
+    func(scan_);
+    scan_->each_statement(func);
+  }
+
+  void each_value(const std::function<void(const Expression*)>& func) const override {
+    scan_->each_value(func);
+    for (const auto* k : keys_) {
+      func(k);
+    }
+  }
+
+  void analyze(CompilerContext& ctx) override {
+    scan_->analyze(ctx);  // analyzes keys_ and the body through SortStep
+  }
+
+  static bool classof(const Node *n) {
+    return n->getKind() == ND_Sort;
+  }
+};
+
+// runs the block for every integer in [from_, to_) on the worker threads of the
+// engine, each iteration in its own transaction. meant for bulk loading, the
+// block is compiled into a function of its own so it can not see variables
+// from outside.
+struct Parallel : public Statement {
+  static constexpr uint64_t kDefaultBatch = 1;
+
+  std::string var_;
+  Expression* from_;
+  Expression* to_;
+  uint64_t batch_;  // iterations a worker takes at a time
+  bool partitioned_;  // var is a partition key, iterations run on the node owning it
+  Block* blk_;
+
+  // parallel for <var> in <from> to <to> [batch <n>] [partitioned] { ... }
+  explicit Parallel(TokenStream& tokens);
+
+  ~Parallel() override {
+    delete from_;
+    delete to_;
+    delete blk_;
+  }
+
+  void dump(std::ostream& o, size_t indent) const override {
+    o << "parallel for " << var_ << " in ";
+    from_->dump(o, indent);
+    o << " to ";
+    to_->dump(o, indent);
+    o << " batch " << batch_;
+    if (partitioned_) {
+      o << " partitioned";
+    }
+    o << " {" << std::endl << util::blank(indent + 2);
+    blk_->dump(o, indent + 2);
+    o << std::endl << util::blank(indent) << "}";
+  }
+
+  // the block allocates its stack in the outlined function
+  void alloca_stack(CompilerContext& c) const override {}
+  void each_statement(std::function<void(const Statement*)> func) const override {}
+
+  void each_value(const std::function<void(const Expression*)>& func) const override {
+    func(from_);
+    func(to_);
+  }
+
+  void codegen(CompilerContext& c) const override;
+
+  void analyze(CompilerContext& ctx) override {
+    from_->analyze(ctx);
+    to_->analyze(ctx);
+    ctx.variable_type_table_[var_] = ctx.analyze_type_table_["integer"];
+    blk_->analyze(ctx);
+  }
+
+  static bool classof(const Node *n) {
+    return n->getKind() == ND_Parallel;
+  }
 };
 
 struct Let : public Statement {
@@ -3,6 +3,9 @@
 //
 
 
+#include <algorithm>
+#include <limits>
+#include <llvm/IR/Intrinsics.h>
 #include <llvm/Support/raw_ostream.h>
 #include "ast_node.hpp"
 #include "ast_expression.hpp"
@@ -12,21 +15,71 @@
 #include "debug.hpp"
 #include "llvm_util.hpp"
 #include "reir/db/metadata.hpp"
+#include "sorter.hpp"
 
 namespace reir {
 namespace node {
 
+#ifdef REIR_PROFILE_STATEMENTS
+// how a statement shows up in the profile
+static std::string profile_label(const Statement* s) {
+  switch (s->getKind()) {
+    case Node::ND_Block: return "block";
+    case Node::ND_Define: return "define";
+    case Node::ND_DefineIndex: return "define index";
+    case Node::ND_Emit: return "emit";
+    case Node::ND_ExprStatement: return "expression";
+    case Node::ND_For: return "for";
+    case Node::ND_DefineTuple: return "define tuple";
+    case Node::ND_If: return "if";
+    case Node::ND_Jump: return "jump";
+    case Node::ND_Insert: return "insert " + static_cast<const Insert*>(s)->table_;
+    case Node::ND_Scan: return "scan " + static_cast<const Scan*>(s)->table_;
+    case Node::ND_Aggregate: return "aggregate";
+    case Node::ND_Join: return "join";
+    case Node::ND_Sort: return "sort";
+    case Node::ND_Parallel: return "parallel";
+    case Node::ND_Let: return "let " + static_cast<const Let*>(s)->name_;
+    case Node::ND_Transaction: return "transaction";
+    default: return "statement";
+  }
+}
+#endif
+
+// generates s, wrapped in counters when the statements are profiled
+static void codegen_statement(CompilerContext& c, const Statement* s) {
+  c.set_location(s->row_, s->col_);
+#ifdef REIR_PROFILE_STATEMENTS
+  auto* start = c.profile_begin(profile_label(s), s->row_);
+  s->codegen(c);
+  c.profile_end(start);
+#else
+  s->codegen(c);
+#endif
+}
+
 void Block::codegen(CompilerContext& c) const {
+#ifdef REIR_PROFILE_STATEMENTS
+  c.profile_row();
+#endif
   for (auto& s : statements_) {
-    s->codegen(c);
+    codegen_statement(c, s);
   }
 }
 
 void Transaction::codegen(CompilerContext& c) const {
+  if (c.in_txn_) {
+    throw std::runtime_error("transactions do not nest, and every iteration of a parallel for is one already");
+  }
   c.emit_begin_txn();
+  c.in_txn_ = true;
+#ifdef REIR_PROFILE_STATEMENTS
+  c.profile_row();
+#endif
   for (auto& s : sequence_->statements_) {
-    s->codegen(c);
+    codegen_statement(c, s);
   }
+  c.in_txn_ = false;
   c.emit_precommit_txn();
 }
 
@@ -119,8 +172,10 @@ void Define::alloca_stack(reir::CompilerContext& c) const {
     }
   }
 
-  c.local_schema_table_[name_] = new Schema(name_, attrs);
-  c.md_->create_table(name_, std::move(attrs));
+  auto* schema = new Schema(name_, attrs, schema_->storage_, schema_->storage_size_);
+  c.local_schema_table_[name_] = schema;
+  c.md_->create_table(name_, std::move(attrs), schema_->storage_, schema_->storage_size_);
+  c.define_table(*schema);
 }
 
 void Define::codegen(CompilerContext& c) const {
@@ -165,6 +220,9 @@ void For::codegen(reir::CompilerContext& c) const {
 
 void Jump::codegen(reir::CompilerContext& c) const {
   auto* current_loop = c.loop_;
+  if (!current_loop) {
+    throw std::runtime_error("break/continue outside of a loop");
+  }
   switch (t_) {
     case type::continue_jump: {
       c.builder_.CreateBr(current_loop->every_);
@@ -178,6 +236,31 @@ void Jump::codegen(reir::CompilerContext& c) const {
       throw std::runtime_error("unknown jump type");
     }
   }
+  // statements after the jump are dead but still need a block to go into
+  c.builder_.SetInsertPoint(llvm::BasicBlock::Create(c.ctx_, "after_jump", c.func_));
+}
+
+// the field types and offsets of the emitted struct, for the columnar sink
+static std::unique_ptr<EmitLayout> emit_layout(CompilerContext& c, llvm::StructType* type) {
+  std::unique_ptr<EmitLayout> layout(new EmitLayout);
+  const auto* struct_layout = c.mod_->getDataLayout().getStructLayout(type);
+  for (unsigned i = 0; i < type->getNumElements(); ++i) {
+    auto* elm = type->getElementType(i);
+    ColumnType column;
+    if (elm->isIntegerTy(64)) {
+      column = ColumnType::INT64;
+    } else if (elm->isIntegerTy(1)) {
+      column = ColumnType::BOOL;
+    } else if (elm->isDoubleTy()) {
+      column = ColumnType::DOUBLE;
+    } else if (elm == c.type_table_["string"]) {
+      column = ColumnType::UTF8;
+    } else {
+      throw std::runtime_error("this type can not be emitted as a column");
+    }
+    layout->fields.push_back({column, struct_layout->getElementOffset(i)});
+  }
+  return layout;
 }
 
 void Emit::codegen(CompilerContext& c) const {
@@ -185,7 +268,6 @@ void Emit::codegen(CompilerContext& c) const {
   if (value_->get_type(c)->isStructTy()) {
     auto value = value_->get_value(c);
     c.builder_.CreateStore(value, stack);
-    auto* emit_func = c.functions_table_["__emit_func"];
     auto* type = llvm::dyn_cast<llvm::StructType>(value_->get_type(c));
     const uint64_t elms = type->getNumElements();
     size_t size = 0;
@@ -195,8 +277,15 @@ void Emit::codegen(CompilerContext& c) const {
     }
 
     auto* from = c.builder_.CreateBitCast(stack, llvm::Type::getInt8PtrTy(c.ctx_));
-    std::vector<llvm::Value*> args{ get_ptr(c, &c), from, c.builder_.getInt64(size)};
-    c.builder_.CreateCall(emit_func, args);
+    if (c.get_columnar_sink()) {
+      if (c.proc_) {
+        // batches are appended in place, an aborted attempt could not take them back
+        throw std::runtime_error("columnar output can not be emitted from a parallel body");
+      }
+      c.emit_columns(emit_layout(c, type), from);
+    } else {
+      c.emit_output(from, size);
+    }
   } else {
     throw std::runtime_error("non struct type cant be emitted");
   }
@@ -221,46 +310,256 @@ llvm::Constant* find_or_create_prefix(CompilerContext& c, const std::string& pre
   return ret;
 }
 
-void Insert::codegen(CompilerContext& c) const {
+// integer key columns are stored big-endian with the sign bit flipped,
+// so that the byte order in masstree matches the integer order
+llvm::Value* encode_key_column(CompilerContext& c, llvm::Value* v) {
+  auto* bswap = llvm::Intrinsic::getDeclaration(c.mod_.get(), llvm::Intrinsic::bswap,
+                                                {c.builder_.getInt64Ty()});
+  return c.builder_.CreateCall(bswap, {c.builder_.CreateXor(v, c.builder_.getInt64(1ULL << 63))});
+}
+
+// a stored key is fixed length and ends with a 0 byte after its columns. every
+// full key, of a row or an index entry, has to write it or it differs per call
+uint64_t terminate_key(CompilerContext& c, llvm::Value* key, const Schema& schema) {
+  const uint64_t length = schema.get_fixed_key_length();
+  c.builder_.CreateStore(c.builder_.getInt8(0), c.builder_.CreateInBoundsGEP(key, {c.builder_.getInt64(length - 1)}));
+  return length;
+}
+
+llvm::Value* decode_key_column(CompilerContext& c, llvm::Value* raw) {
+  auto* bswap = llvm::Intrinsic::getDeclaration(c.mod_.get(), llvm::Intrinsic::bswap,
+                                                {c.builder_.getInt64Ty()});
+  return c.builder_.CreateXor(c.builder_.CreateCall(bswap, {raw}), c.builder_.getInt64(1ULL << 63));
+}
+
+void DefineIndex::analyze(CompilerContext& ctx) {
+  auto it = ctx.analyze_type_table_.find(table_);
+  auto* tuple = it == ctx.analyze_type_table_.end() ? nullptr : dynamic_cast<TupleType*>(it->second);
+  if (!tuple) {
+    throw std::runtime_error("undefined table: " + table_);
+  }
+  // every row found through the index is looked up by its primary key. an array
+  // insert overwrites the row, the entry of the old row would be left behind
+  if (tuple->storage_ != StorageKind::MASSTREE) {
+    throw std::runtime_error(std::string("can not index ") + storage_kind_name(tuple->storage_) +
+                             " table " + table_);
+  }
+  for (const auto& t : ctx.analyze_type_table_) {
+    const auto* other = dynamic_cast<TupleType*>(t.second);
+    if (t.first == name_ || (other && std::any_of(other->indexes_.begin(), other->indexes_.end(),
+                                                  [&](const IndexDef& i) { return i.name == name_; }))) {
+      throw std::runtime_error("index name already used: " + name_);
+    }
+  }
+  index_ = IndexDef{name_, table_, {}};
+  for (const auto& column : columns_) {
+    auto found = std::find(tuple->names_.begin(), tuple->names_.end(), column);
+    if (found == tuple->names_.end()) {
+      throw std::runtime_error("undefined column in index " + name_ + ": " + column);
+    }
+    const size_t idx = found - tuple->names_.begin();
+    if (tuple->type_names_[idx] != "int" && tuple->type_names_[idx] != "date") {
+      throw std::runtime_error("only int columns can be indexed: " + column);
+    }
+    if (std::find(index_.columns.begin(), index_.columns.end(), idx) != index_.columns.end()) {
+      throw std::runtime_error("column indexed twice: " + column);
+    }
+    index_.columns.push_back(idx);
+  }
+  tuple->indexes_.push_back(index_);
+}
+
+void DefineIndex::alloca_stack(CompilerContext& c) const {
+  // like define, the index is created at compile time
+  const auto* table = c.local_schema_table_[table_];
+  if (table == nullptr) {
+    throw std::runtime_error("undefined table: " + table_);
+  }
+  auto* entry = new Schema(table->index_schema(index_));
+  c.local_schema_table_[name_] = entry;
+  c.md_->create_index(index_);
+  c.define_table(*entry);
+
+  prefix_ = find_or_create_prefix(c, entry->get_key_prefix(), name_ + "_index_prefix");
+  auto prefix = table->get_key_prefix();
+  table_begin_ = find_or_create_prefix(c, prefix, table_ + "_table_prefix_begin");
+  prefix.resize(table->get_fixed_key_length(), '\xff');
+  table_end_ = find_or_create_prefix(c, prefix, table_ + "_table_prefix_end");
+  auto* entry_type = llvm::ArrayType::get(c.builder_.getInt8Ty(), entry->get_fixed_key_length());
+  entry_stack_ = c.builder_.CreateAlloca(entry_type, nullptr, name_ + "_entry");
+}
+
+void DefineIndex::codegen(CompilerContext& c) const {
+  // inserts after this point maintain the index, the rows already in the table are added here
+  const auto* table = c.local_schema_table_[table_];
+  const auto* entry = c.local_schema_table_[name_];
+  const bool own_txn = !c.in_txn_;
+  if (own_txn) {
+    c.emit_begin_txn();
+  }
+  const auto table_prefix = table->get_key_prefix().size();
+  auto* cursor = c.get_cursor(*table, table_begin_, c.builder_.getInt64(table_prefix),
+                              table_end_, c.builder_.getInt64(table->get_fixed_key_length()));
+  llvm::BasicBlock* check = llvm::BasicBlock::Create(c.ctx_, "index_fill_check", c.func_);
+  llvm::BasicBlock* body = llvm::BasicBlock::Create(c.ctx_, "index_fill_body", c.func_);
+  llvm::BasicBlock* fin = llvm::BasicBlock::Create(c.ctx_, "index_fill_fin", c.func_);
+  c.builder_.CreateBr(check);
+  c.builder_.SetInsertPoint(check);
+  c.builder_.CreateCondBr(c.emit_is_valid_cursor(cursor), body, fin);
+
+  c.builder_.SetInsertPoint(body);
+  auto* key = c.emit_cursor_get_key(cursor);
+  auto* value = c.emit_cursor_get_value(cursor);
+  auto* buf = c.builder_.CreateBitCast(entry_stack_, c.builder_.getInt8PtrTy());
+  uint64_t offset = entry->get_key_prefix().size();
+  c.builder_.CreateMemCpy(buf, prefix_, offset, 1);
+  for (auto column : table->index_columns(index_)) {
+    auto* dst = c.builder_.CreateInBoundsGEP(buf, {c.builder_.getInt64(offset)});
+    if (table->is_key(static_cast<int>(column))) {
+      // already encoded in the row key
+      auto* src = c.builder_.CreateInBoundsGEP(key, {c.builder_.getInt64(table_prefix + table->key_offset(column))});
+      c.builder_.CreateMemCpy(dst, src, 8, 1);
+    } else {
+      uint64_t value_offset = 0;
+      for (size_t i = 0; i < column; ++i) {
+        if (!table->is_key(static_cast<int>(i))) {
+          value_offset += table->get_tuple_length(static_cast<int>(i));
+        }
+      }
+      auto* src = c.builder_.CreateInBoundsGEP(value, {c.builder_.getInt64(value_offset)});
+      auto* v = c.builder_.CreateAlignedLoad(c.builder_.CreateBitCast(src, c.builder_.getInt64Ty()->getPointerTo()), 1);
+      c.builder_.CreateAlignedStore(encode_key_column(c, v),
+                                    c.builder_.CreateBitCast(dst, c.builder_.getInt64Ty()->getPointerTo()), 1);
+    }
+    offset += 8;
+  }
+  c.builder_.CreateStore(c.builder_.getInt8(0), c.builder_.CreateInBoundsGEP(buf, {c.builder_.getInt64(offset)}));
+  c.emit_insert(*entry, buf, c.builder_.getInt64(entry->get_fixed_key_length()), buf, c.builder_.getInt64(0));
+  c.emit_cursor_next(cursor);
+  c.builder_.CreateBr(check);
+
+  c.builder_.SetInsertPoint(fin);
+  c.emit_cursor_destroy(cursor);
+  delete cursor;
+  if (own_txn) {
+    c.emit_precommit_txn();
+  }
+}
+
+void Insert::encode_row(CompilerContext& c, llvm::Value* row, llvm::StructType* row_type,
+                        llvm::Value* key, llvm::Value* value) const {
   const auto* schema = c.local_schema_table_[table_];
-  auto* row = value_->get_value(c);
   std::string key_prefix = schema->get_key_prefix();
-  if (value_->get_type(c)->isStructTy()) {
-    auto* row_type = llvm::dyn_cast<llvm::StructType>(value_->get_type(c));
-    int elements = row_type->getNumElements();
-    c.builder_.CreateStore(row, tuple_stack_);
-    auto* buff = c.builder_.CreateBitCast(tuple_stack_, c.builder_.getInt8PtrTy());
-
-    c.builder_.CreateMemCpy(key_stack_, prefix_, c.builder_.getInt64(key_prefix.size()), 8);
-    auto key_idx = static_cast<int>(key_prefix.size());
-    int value_idx = 0;
-    int offset = 0;
-    for (int i = 0; i < elements; ++i) {
-      auto* src = c.builder_.CreateInBoundsGEP(buff,
-                                               {
-                                                c.builder_.getInt32(
-                                                    static_cast<uint32_t>(offset))});
-      if (schema->is_key(i)) {
-        auto* dst = c.builder_.CreateInBoundsGEP(key_stack_,
-                                                 {c.builder_.getInt64(0),
-                                                  c.builder_.getInt32(
-                                                      static_cast<uint32_t>(key_idx))});
-        c.builder_.CreateMemCpy(dst, src, schema->get_tuple_length(i), 8);
-        key_idx += schema->get_tuple_length(i);
+  int elements = row_type->getNumElements();
+  c.builder_.CreateStore(row, tuple_stack_);
+  auto* buff = c.builder_.CreateBitCast(tuple_stack_, c.builder_.getInt8PtrTy());
+
+  c.builder_.CreateMemCpy(key, prefix_, c.builder_.getInt64(key_prefix.size()), 1);
+  int value_idx = 0;
+  int offset = 0;
+  for (int i = 0; i < elements; ++i) {
+    auto* src = c.builder_.CreateInBoundsGEP(buff,
+                                             {
+                                              c.builder_.getInt32(
+                                                  static_cast<uint32_t>(offset))});
+    if (schema->is_key(i)) {
+      const auto key_idx = key_prefix.size() + schema->key_offset(i);
+      auto* dst = c.builder_.CreateInBoundsGEP(key,
+                                               {c.builder_.getInt32(
+                                                    static_cast<uint32_t>(key_idx))});
+      if (row_type->getElementType(i)->isIntegerTy(64)) {
+        auto* k = encode_key_column(c, c.builder_.CreateExtractValue(row, i));
+        c.builder_.CreateAlignedStore(k, c.builder_.CreateBitCast(dst, c.builder_.getInt64Ty()->getPointerTo()), 1);
       } else {
-        auto* dst = c.builder_.CreateInBoundsGEP(value_stack_,
-                                                 {c.builder_.getInt32(0),
-                                                  c.builder_.getInt32(
-                                                      static_cast<uint32_t>(value_idx))});
-        c.builder_.CreateMemCpy(dst, src, schema->get_tuple_length(i), 8);
-        value_idx += schema->get_tuple_length(i);
+        c.builder_.CreateMemCpy(dst, src, schema->get_tuple_length(i), 1);
       }
-      offset += schema->get_tuple_length(i);
+    } else {
+      auto* dst = c.builder_.CreateInBoundsGEP(value,
+                                               {c.builder_.getInt32(
+                                                    static_cast<uint32_t>(value_idx))});
+      c.builder_.CreateMemCpy(dst, src, schema->get_tuple_length(i), 1);
+      value_idx += schema->get_tuple_length(i);
     }
-    c.emit_insert(c.builder_.CreateBitCast(key_stack_, c.builder_.getInt8PtrTy()),
-                  c.builder_.getInt64(static_cast<uint64_t>(key_idx)),
-                  c.builder_.CreateBitCast(value_stack_, c.builder_.getInt8PtrTy()),
-                  c.builder_.getInt64(static_cast<uint64_t>(value_idx)));
+    offset += schema->get_tuple_length(i);
+  }
+  terminate_key(c, key, *schema);
+}
+
+void Insert::encode_index_entry(CompilerContext& c, size_t i, llvm::Value* row, llvm::Value* entry) const {
+  // the columns of an entry are all int, encoded like key columns
+  const auto* schema = c.local_schema_table_[table_];
+  uint64_t offset = indexes_[i].name.size() + 1;
+  c.builder_.CreateMemCpy(entry, index_prefixes_[i], c.builder_.getInt64(offset), 1);
+  for (auto column : schema->index_columns(indexes_[i])) {
+    auto* dst = c.builder_.CreateInBoundsGEP(entry, {c.builder_.getInt64(offset)});
+    auto* k = encode_key_column(c, c.builder_.CreateExtractValue(row, {static_cast<unsigned>(column)}));
+    c.builder_.CreateAlignedStore(k, c.builder_.CreateBitCast(dst, c.builder_.getInt64Ty()->getPointerTo()), 1);
+    offset += 8;
+  }
+  c.builder_.CreateStore(c.builder_.getInt8(0), c.builder_.CreateInBoundsGEP(entry, {c.builder_.getInt64(offset)}));
+}
+
+void Insert::insert_index_entries(CompilerContext& c, llvm::Value* row, llvm::Value* inserted) const {
+  // a row that was already there keeps the entries it has, a duplicate gets none
+  if (indexes_.empty()) {
+    return;
+  }
+  auto* add = llvm::BasicBlock::Create(c.ctx_, "index_entries", c.func_);
+  auto* fin = llvm::BasicBlock::Create(c.ctx_, "index_entries_fin", c.func_);
+  c.builder_.CreateCondBr(inserted, add, fin);
+  c.builder_.SetInsertPoint(add);
+  for (size_t i = 0; i < indexes_.size(); ++i) {
+    const auto* entry = c.local_schema_table_[indexes_[i].name];
+    auto* buf = c.builder_.CreateBitCast(index_stacks_[i], c.builder_.getInt8PtrTy());
+    encode_index_entry(c, i, row, buf);
+    c.emit_insert(*entry, buf, c.builder_.getInt64(entry->get_fixed_key_length()), buf, c.builder_.getInt64(0));
+  }
+  c.builder_.CreateBr(fin);
+  c.builder_.SetInsertPoint(fin);
+}
+
+void Insert::codegen(CompilerContext& c) const {
+  // index entries are inserted right after the rows, in the same transaction
+  const auto* schema = c.local_schema_table_[table_];
+  const uint64_t key_length = schema->get_fixed_key_length();
+  const uint64_t value_length = schema->get_fixed_value_length();
+  auto* keys = c.builder_.CreateBitCast(key_stack_, c.builder_.getInt8PtrTy());
+  auto* values = c.builder_.CreateBitCast(value_stack_, c.builder_.getInt8PtrTy());
+  auto* type = value_->get_type(c);
+  if (auto* row_type = llvm::dyn_cast<llvm::StructType>(type)) {
+    auto* row = value_->get_value(c);
+    encode_row(c, row, row_type, keys, values);
+    auto* inserted = c.emit_insert(*schema, keys, c.builder_.getInt64(key_length),
+                                   values, c.builder_.getInt64(value_length));
+    insert_index_entries(c, row, inserted);
+  } else if (auto* rows_type = llvm::dyn_cast<llvm::ArrayType>(type)) {
+    auto* row_type = llvm::dyn_cast<llvm::StructType>(rows_type->getElementType());
+    if (!row_type) {
+      throw std::runtime_error("non row type cant be inserted");
+    }
+    auto* rows = value_->get_value(c);
+    const uint64_t n = rows_type->getNumElements();
+    if (!indexes_.empty()) {
+      // the entries of a row depend on whether it went in, so the rows go one by one
+      for (uint64_t i = 0; i < n; ++i) {
+        auto* row = c.builder_.CreateExtractValue(rows, {static_cast<unsigned>(i)});
+        encode_row(c, row, row_type, keys, values);
+        auto* inserted = c.emit_insert(*schema, keys, c.builder_.getInt64(key_length),
+                                       values, c.builder_.getInt64(value_length));
+        insert_index_entries(c, row, inserted);
+      }
+      return;
+    }
+    // every row is encoded into one contiguous buffer, then a single call inserts them all
+    for (uint64_t i = 0; i < n; ++i) {
+      auto* row = c.builder_.CreateExtractValue(rows, {static_cast<unsigned>(i)});
+      encode_row(c, row, row_type,
+                 c.builder_.CreateInBoundsGEP(keys, {c.builder_.getInt64(i * key_length)}),
+                 c.builder_.CreateInBoundsGEP(values, {c.builder_.getInt64(i * value_length)}));
+    }
+    c.emit_insert_batch(*schema, keys, c.builder_.getInt64(key_length),
+                        values, c.builder_.getInt64(value_length),
+                        c.builder_.getInt64(n));
   } else {
     throw std::runtime_error("non row type cant be inserted");
   }
@@ -280,8 +579,15 @@ void Insert::alloca_stack(CompilerContext& c) const {
   auto prefix = schema->get_key_prefix();
   prefix_ = find_or_create_prefix(c, prefix, table_ + "_table_prefix");
 
-  auto* key_stk = llvm::ArrayType::get(c.builder_.getInt8Ty(), schema->get_fixed_key_length());
-  auto* val_stk = llvm::ArrayType::get(c.builder_.getInt8Ty(), schema->get_fixed_value_length());
+  // an array of rows gets room for all of its keys and values
+  auto* buff_type = value_->get_type(c);
+  uint64_t rows = 1;
+  if (auto* rows_type = llvm::dyn_cast<llvm::ArrayType>(buff_type)) {
+    rows = rows_type->getNumElements();
+    buff_type = rows_type->getElementType();
+  }
+  auto* key_stk = llvm::ArrayType::get(c.builder_.getInt8Ty(), schema->get_fixed_key_length() * rows);
+  auto* val_stk = llvm::ArrayType::get(c.builder_.getInt8Ty(), schema->get_fixed_value_length() * rows);
 
   if (key_stack_) {
     throw std::runtime_error("key_stack is already initialized");
@@ -289,76 +595,713 @@ void Insert::alloca_stack(CompilerContext& c) const {
   key_stack_ = c.builder_.CreateAlloca(key_stk, nullptr, "insert_key_stack");
   value_stack_ = c.builder_.CreateAlloca(val_stk, nullptr, "insert_val_stack");
 
-  auto* buff_type = value_->get_type(c);
   tuple_stack_ = c.builder_.CreateAlloca(buff_type, nullptr, "tuple_stack");
+
+  index_prefixes_.clear();
+  index_stacks_.clear();
+  for (const auto& index : indexes_) {
+    const auto* entry = c.local_schema_table_[index.name];
+    index_prefixes_.push_back(find_or_create_prefix(c, entry->get_key_prefix(), index.name + "_index_prefix"));
+    auto* entry_type = llvm::ArrayType::get(c.builder_.getInt8Ty(), entry->get_fixed_key_length());
+    index_stacks_.push_back(c.builder_.CreateAlloca(entry_type, nullptr, index.name + "_entry_stack"));
+  }
 }
 
-void Scan::codegen(CompilerContext& c) const {
-  const auto* schema = c.local_schema_table_[table_];
-  std::string key_prefix = schema->get_key_prefix();
-  std::string key_prefix_end = key_prefix;
-  key_prefix_end[key_prefix_end.size() - 2]++;
+namespace {
 
-  auto* rowtype = c.type_table_[row_name_];
+// moves the code generated between construction and finish() into
+// void name(proc, env, args...), a function the worker threads can call.
+// the variables visible here are passed in env and copied at entry, so the
+// body reads them but its writes stay in the body
+class Outliner {
+ public:
+  Outliner(CompilerContext& c, const std::string& name, const std::vector<llvm::Type*>& args)
+      : c_(c), caller_(c.func_), caller_block_(c.builder_.GetInsertBlock()), caller_loop_(c.loop_),
+        caller_proc_(c.proc_), caller_cursors_(c.inner_cursors_) {
+    auto* i8_ptr = c.builder_.getInt8PtrTy();
+    std::vector<llvm::Type*> params{llvm::Type::getInt64PtrTy(c.ctx_), i8_ptr->getPointerTo()};
+    params.insert(params.end(), args.begin(), args.end());
+    func_ = llvm::Function::Create(
+        llvm::FunctionType::get(c.builder_.getVoidTy(), params, false),
+        llvm::Function::ExternalLinkage,
+        name + std::to_string(c.parallel_bodies_++),
+        c.mod_.get());
 
-  auto* cursor = c.get_cursor(prefix_begin_, c.builder_.getInt64(key_prefix.size()),
-                              prefix_end_, c.builder_.getInt64(key_prefix_end.size()));
-  llvm::BasicBlock* check =
-      llvm::BasicBlock::Create(c.ctx_, "fullscan_check", c.func_);
-  llvm::BasicBlock* begin =
-      llvm::BasicBlock::Create(c.ctx_, "fullscan_begin", c.func_);
-  llvm::BasicBlock* fin =
-      llvm::BasicBlock::Create(c.ctx_, "fullscan_fin", c.func_);
+    std::vector<std::pair<std::string, llvm::AllocaInst*>> captured(c.variable_table_.begin(),
+                                                                    c.variable_table_.end());
+    llvm::IRBuilder<> entry(&caller_->getEntryBlock(), caller_->getEntryBlock().begin());
+    env_ = entry.CreateAlloca(i8_ptr, entry.getInt64(std::max<size_t>(captured.size(), 1)), "parallel_env");
+    for (size_t i = 0; i < captured.size(); ++i) {
+      c.builder_.CreateStore(c.builder_.CreateBitCast(captured[i].second, i8_ptr),
+                             c.builder_.CreateInBoundsGEP(env_, {c.builder_.getInt64(i)}));
+    }
 
-  c.builder_.CreateBr(check);
-  c.builder_.SetInsertPoint(check);
-  auto* cond = c.builder_.CreateICmpEQ(c.emit_is_valid_cursor(cursor), c.builder_.getInt1(true));
-  c.builder_.CreateCondBr(cond, begin, fin);
+    caller_variables_ = std::move(c.variable_table_);
+    c.variable_table_.clear();
+    c.func_ = func_;
+    c.loop_ = nullptr;
+    c.inner_cursors_ = nullptr;
+    auto arg = func_->arg_begin();
+    c.proc_ = &*arg++;
+    llvm::Value* env = &*arg;
+    c.builder_.SetInsertPoint(llvm::BasicBlock::Create(c.ctx_, "parallel_entry", func_));
+    for (size_t i = 0; i < captured.size(); ++i) {
+      auto* type = captured[i].second->getAllocatedType();
+      auto* copy = c.builder_.CreateAlloca(type, nullptr, captured[i].first);
+      copy->setAlignment(8);
+      auto* src = c.builder_.CreateLoad(c.builder_.CreateInBoundsGEP(env, {c.builder_.getInt64(i)}));
+      c.builder_.CreateStore(c.builder_.CreateLoad(c.builder_.CreateBitCast(src, type->getPointerTo())), copy);
+      c.variable_table_[captured[i].first] = copy;
+    }
+    c.emit_begin_partial_output();
+  }
 
-  c.builder_.SetInsertPoint(begin);
-  auto* key = c.builder_.CreateBitCast(key_stack_, llvm::Type::getInt8PtrTy(c.ctx_));
-  c.emit_cursor_copy_key(cursor, key);
-  auto* value = c.builder_.CreateBitCast(value_stack_, llvm::Type::getInt8PtrTy(c.ctx_));
-  c.emit_cursor_copy_value(cursor, value);
+  // i-th of args
+  llvm::Value* arg(size_t i) const {
+    return &*std::next(func_->arg_begin(), i + 2);
+  }
+
+  // to be passed to the engine along with the function
+  llvm::Value* env() const {
+    return env_;
+  }
+
+  llvm::Function* finish() {
+    c_.emit_end_partial_output();
+    c_.builder_.CreateRetVoid();
+    c_.func_ = caller_;
+    c_.loop_ = caller_loop_;
+    c_.proc_ = caller_proc_;
+    c_.inner_cursors_ = caller_cursors_;
+    c_.variable_table_ = std::move(caller_variables_);
+    c_.builder_.SetInsertPoint(caller_block_);
+    return func_;
+  }
+
+ private:
+  CompilerContext& c_;
+  llvm::Function* func_;
+  llvm::Value* env_;
+  llvm::Function* caller_;
+  llvm::BasicBlock* caller_block_;
+  LoopContext* caller_loop_;
+  llvm::Value* caller_proc_;
+  std::vector<llvm::Value*>* caller_cursors_;
+  std::unordered_map<std::string, llvm::AllocaInst*> caller_variables_;
+};
+
+}  // namespace
 
- 	llvm::Value* prev = llvm::UndefValue::get(rowtype);
-  uint32_t key_offset = static_cast<uint32_t>(key_prefix.size()), value_offset = 0;
+llvm::Value* Scan::load_row(CompilerContext& c, llvm::Value* key, llvm::Value* value) const {
+  const auto* schema = c.local_schema_table_[table_];
+  auto* rowtype = c.type_table_[row_name_];
+
+  llvm::Value* prev = llvm::UndefValue::get(rowtype);
+  const auto key_prefix_length = schema->get_key_prefix().size();
+  uint32_t value_offset = 0;
   for (uint64_t i = 0; i < schema->columns(); ++i) {
     if (schema->is_key((int)i)) {
+      const auto key_offset = static_cast<uint32_t>(key_prefix_length + schema->key_offset(i));
       auto* offset_key = c.builder_.CreateInBoundsGEP(key,
                                                       {
                                                        c.builder_.getInt32(key_offset)});
       auto* key_r = c.builder_.CreateBitCast(offset_key, llvm::Type::getInt64PtrTy(c.ctx_));
-      auto* record = c.builder_.CreateLoad(key_r);
-
+      auto* record = decode_key_column(c, c.builder_.CreateAlignedLoad(key_r, 1));
 
       prev = c.builder_.CreateInsertValue(prev, record, i);
-      key_offset += 8;
     } else {
-      auto* offset_value = c.builder_.CreateInBoundsGEP(value_stack_,
-                                                        {c.builder_.getInt32(0),
-                                                         c.builder_.getInt32(value_offset)});
+      auto* offset_value = c.builder_.CreateInBoundsGEP(value,
+                                                        {c.builder_.getInt32(value_offset)});
       auto* value_r = c.builder_.CreateBitCast(offset_value, llvm::Type::getInt64PtrTy(c.ctx_));
-      auto* record = c.builder_.CreateLoad(value_r);
+      auto* record = c.builder_.CreateAlignedLoad(value_r, 1);
 
       prev = c.builder_.CreateInsertValue(prev, record, i);
       value_offset += 8;
     }
   }
+  return prev;
+}
+
+namespace {
+
+bool is_row_column(const Expression* e, const std::string& row) {
+  const auto* member = llvm::dyn_cast<MemberReference>(e);
+  if (!member) {
+    return false;
+  }
+  const auto* parent = llvm::dyn_cast<VariableReference>(member->parent_);
+  return parent && parent->name_ == row;
+}
+
+// true if e may depend on row, anything we don't understand counts as dependent
+bool depends_on(const Expression* e, const std::string& row) {
+  if (const auto* v = llvm::dyn_cast<VariableReference>(e)) {
+    return v->name_ == row;
+  }
+  if (const auto* m = llvm::dyn_cast<MemberReference>(e)) {
+    return depends_on(m->parent_, row);
+  }
+  if (const auto* b = llvm::dyn_cast<BinaryExpression>(e)) {
+    return depends_on(b->lhs_, row) || depends_on(b->rhs_, row);
+  }
+  if (const auto* p = llvm::dyn_cast<PrimaryExpression>(e)) {
+    return p->value_.which() != 0 && depends_on(boost::get<Expression*>(p->value_), row);
+  }
+  return true;
+}
+
+void flatten_and(const Expression* e, std::vector<const Expression*>& out) {
+  const auto* b = llvm::dyn_cast<BinaryExpression>(e);
+  if (b && b->op_ == CONDITIONAL_AND) {
+    flatten_and(b->lhs_, out);
+    flatten_and(b->rhs_, out);
+  } else {
+    out.push_back(e);
+  }
+}
+
+operators flip(operators op) {
+  switch (op) {
+    case LESSTHAN: return MORETHAN;
+    case LESSEQUAL: return MOREEQUAL;
+    case MORETHAN: return LESSTHAN;
+    case MOREEQUAL: return LESSEQUAL;
+    default: return op;
+  }
+}
+
+struct KeyPredicate {
+  const Expression* source;
+  uint64_t column;
+  operators op;  // column <op> value
+  const Expression* value;
+};
+
+}  // namespace
+
+void Scan::split_where(const TupleType& table) {
+  key_eq_.clear();
+  key_lower_ = key_upper_ = nullptr;
+  point_lookup_ = false;
+  residual_.clear();
+  index_ = IndexDef();
+  index_eq_.clear();
+
+  std::vector<const Expression*> conjuncts;
+  flatten_and(where_, conjuncts);
+
+  std::vector<KeyPredicate> candidates;
+  for (const auto* e : conjuncts) {
+    const auto* b = llvm::dyn_cast<BinaryExpression>(e);
+    if (!b) {
+      continue;
+    }
+    switch (b->op_) {
+      case EQUAL: case LESSTHAN: case LESSEQUAL: case MORETHAN: case MOREEQUAL: break;
+      default: continue;
+    }
+    const Expression* column = b->lhs_;
+    const Expression* value = b->rhs_;
+    operators op = b->op_;
+    if (!is_row_column(column, row_name_)) {
+      std::swap(column, value);
+      op = flip(op);
+    }
+    if (!is_row_column(column, row_name_) || depends_on(value, row_name_)) {
+      continue;
+    }
+    if (!value->type_ || value->type_->type_ != type_id::INTEGER) {
+      continue;
+    }
+    candidates.push_back({e, llvm::cast<MemberReference>(column)->offset_, op, value});
+  }
+
+  const auto key_columns = table.key_columns();
+
+  std::vector<const Expression*> used;
+  auto take = [&](uint64_t column, std::function<bool(operators)> match) -> const KeyPredicate* {
+    for (const auto& p : candidates) {
+      if (p.column == column && match(p.op) &&
+          std::find(used.begin(), used.end(), p.source) == used.end()) {
+        used.push_back(p.source);
+        return &p;
+      }
+    }
+    return nullptr;
+  };
+
+  size_t k = 0;
+  for (; k < key_columns.size(); ++k) {
+    const auto* eq = take(key_columns[k], [](operators op) { return op == EQUAL; });
+    if (!eq) {
+      break;
+    }
+    key_eq_.push_back(eq->value);
+  }
+  // a sequential table can not look a key up, it scans with the key as the range
+  point_lookup_ = !key_columns.empty() && k == key_columns.size() &&
+      table.storage_ != StorageKind::SEQUENTIAL;
+  if (k < key_columns.size()) {
+    if (const auto* lo = take(key_columns[k], [](operators op) { return op == MORETHAN || op == MOREEQUAL; })) {
+      key_lower_ = lo->value;
+      lower_inclusive_ = lo->op == MOREEQUAL;
+    }
+    if (const auto* hi = take(key_columns[k], [](operators op) { return op == LESSTHAN || op == LESSEQUAL; })) {
+      key_upper_ = hi->value;
+      upper_inclusive_ = hi->op == LESSEQUAL;
+    }
+  }
+
+  for (const auto* e : conjuncts) {
+    if (std::find(used.begin(), used.end(), e) == used.end()) {
+      residual_.push_back(e);
+    }
+  }
+
+  // the primary key did not narrow the scan, try the index with the most leading
+  // columns bound by equalities. those stay residual and are checked on the row
+  // again after the lookup
+  if (has_key_range()) {
+    return;
+  }
+  for (const auto& index : table.indexes_) {
+    std::vector<const Expression*> eq;
+    for (auto column : index.columns) {
+      auto p = std::find_if(candidates.begin(), candidates.end(), [&](const KeyPredicate& k) {
+        return k.column == column && k.op == EQUAL;
+      });
+      if (p == candidates.end()) {
+        break;
+      }
+      eq.push_back(p->value);
+    }
+    if (index_eq_.size() < eq.size()) {
+      index_ = index;
+      index_eq_ = std::move(eq);
+    }
+  }
+}
+
+uint64_t Scan::build_range_key(CompilerContext& c, llvm::Value* buffer,
+                               const Expression* bound, bool pad) const {
+  // keys are fixed length, so padding with 0xff past the last bound column sorts
+  // after every key sharing those columns. that gives exact inclusive/exclusive
+  // bounds without having to compute a successor key.
+  const auto* schema = c.local_schema_table_[table_];
+  const auto prefix = schema->get_key_prefix();
+  const uint64_t max_length = schema->get_fixed_key_length();
+
+  auto* buf = c.builder_.CreateBitCast(buffer, c.builder_.getInt8PtrTy());
+  c.builder_.CreateMemCpy(buf, prefix_begin_, prefix.size(), 1);
+  uint64_t offset = prefix.size();
+  auto store_column = [&](const Expression* e) {
+    auto* dst = c.builder_.CreateInBoundsGEP(buf, {c.builder_.getInt64(offset)});
+    c.builder_.CreateAlignedStore(encode_key_column(c, e->get_value(c)),
+                                  c.builder_.CreateBitCast(dst, c.builder_.getInt64Ty()->getPointerTo()), 1);
+    offset += 8;
+  };
+  for (const auto* e : key_eq_) {
+    store_column(e);
+  }
+  if (bound) {
+    store_column(bound);
+  }
+  if (pad) {
+    auto* dst = c.builder_.CreateInBoundsGEP(buf, {c.builder_.getInt64(offset)});
+    c.builder_.CreateMemSet(dst, c.builder_.getInt8(0xff), max_length - offset, 1);
+    offset = max_length;
+  }
+  return offset;
+}
+
+uint64_t Scan::build_index_key(CompilerContext& c, llvm::Value* buffer, bool pad) const {
+  // same as build_range_key, over the entries of the index
+  const auto* entry = c.local_schema_table_[index_.name];
+  auto* buf = c.builder_.CreateBitCast(buffer, c.builder_.getInt8PtrTy());
+  uint64_t offset = entry->get_key_prefix().size();
+  c.builder_.CreateMemCpy(buf, index_prefix_, offset, 1);
+  for (const auto* e : index_eq_) {
+    auto* dst = c.builder_.CreateInBoundsGEP(buf, {c.builder_.getInt64(offset)});
+    c.builder_.CreateAlignedStore(encode_key_column(c, e->get_value(c)),
+                                  c.builder_.CreateBitCast(dst, c.builder_.getInt64Ty()->getPointerTo()), 1);
+    offset += 8;
+  }
+  if (pad) {
+    auto* dst = c.builder_.CreateInBoundsGEP(buf, {c.builder_.getInt64(offset)});
+    c.builder_.CreateMemSet(dst, c.builder_.getInt8(0xff), entry->get_fixed_key_length() - offset, 1);
+    offset = entry->get_fixed_key_length();
+  }
+  return offset;
+}
+
+llvm::Value* Scan::index_to_key(CompilerContext& c, llvm::Value* entry) const {
+  // the primary key columns are in the entry already encoded, copy them over
+  const auto* schema = c.local_schema_table_[table_];
+  const auto entry_prefix = index_.name.size() + 1;
+  const auto entry_columns = schema->index_columns(index_);
+  auto* key = c.builder_.CreateBitCast(range_begin_, c.builder_.getInt8PtrTy());
+  const auto prefix = schema->get_key_prefix().size();
+  c.builder_.CreateMemCpy(key, prefix_begin_, prefix, 1);
+  for (auto k : schema->key_columns()) {
+    const uint64_t at = std::find(entry_columns.begin(), entry_columns.end(), k) - entry_columns.begin();
+    auto* src = c.builder_.CreateInBoundsGEP(entry, {c.builder_.getInt64(entry_prefix + 8 * at)});
+    auto* dst = c.builder_.CreateInBoundsGEP(key, {c.builder_.getInt64(prefix + schema->key_offset(k))});
+    c.builder_.CreateMemCpy(dst, src, 8, 1);
+  }
+  terminate_key(c, key, *schema);
+  return key;
+}
+
+llvm::Value* Scan::residual_value(CompilerContext& c) const {
+  // all residual conjuncts are evaluated and combined with a plain and,
+  // so the filter is a single branch (or a mask in batch mode)
+  llvm::Value* ret = c.builder_.getInt1(true);
+  for (const auto* e : residual_) {
+    auto* v = e->get_value(c);
+    if (v->getType() != c.builder_.getInt1Ty()) {
+      v = c.builder_.CreateICmpNE(v, c.builder_.getInt64(0));
+    }
+    ret = c.builder_.CreateAnd(ret, v, "where");
+  }
+  return ret;
+}
+
+void Scan::cursor_range(CompilerContext& c, llvm::Value** from, llvm::Value** from_length,
+                        llvm::Value** to, llvm::Value** to_length) const {
+  const auto* schema = c.local_schema_table_[table_];
+  if (uses_index()) {
+    *from = c.builder_.CreateBitCast(index_begin_, c.builder_.getInt8PtrTy());
+    *from_length = c.builder_.getInt64(build_index_key(c, index_begin_, false));
+    *to = c.builder_.CreateBitCast(index_end_, c.builder_.getInt8PtrTy());
+    *to_length = c.builder_.getInt64(build_index_key(c, index_end_, true));
+  } else if (has_key_range()) {
+    auto begin_length = build_range_key(c, range_begin_, key_lower_, key_lower_ && !lower_inclusive_);
+    auto end_length = build_range_key(c, range_end_, key_upper_, !key_upper_ || upper_inclusive_);
+    *from = c.builder_.CreateBitCast(range_begin_, c.builder_.getInt8PtrTy());
+    *from_length = c.builder_.getInt64(begin_length);
+    *to = c.builder_.CreateBitCast(range_end_, c.builder_.getInt8PtrTy());
+    *to_length = c.builder_.getInt64(end_length);
+  } else {
+    *from = prefix_begin_;
+    *from_length = c.builder_.getInt64(schema->get_key_prefix().size());
+    *to = prefix_end_;
+    *to_length = c.builder_.getInt64(schema->get_fixed_key_length());
+  }
+}
+
+void Scan::codegen(CompilerContext& c) const {
+  if (point_lookup_) {
+    codegen_lookup(c);
+    return;
+  }
+  if (parallel_) {
+    codegen_parallel(c);
+    return;
+  }
+  llvm::Value* from;
+  llvm::Value* from_length;
+  llvm::Value* to;
+  llvm::Value* to_length;
+  cursor_range(c, &from, &from_length, &to, &to_length);
+  codegen_cursor(c, from, from_length, to, to_length);
+}
+
+void Scan::codegen_cursor(CompilerContext& c, llvm::Value* from, llvm::Value* from_length,
+                          llvm::Value* to, llvm::Value* to_length) const {
+  // a scan nested in another scan reopens one cursor per outer row instead of
+  // allocating a new one, the outermost scan frees them all when it is done
+  const auto* schema = c.local_schema_table_[uses_index() ? index_.name : table_];
+  std::vector<llvm::Value*> inner_cursors;
+  const bool outermost = c.inner_cursors_ == nullptr;
+  CursorBase* cursor;
+  if (outermost) {
+    c.inner_cursors_ = &inner_cursors;
+    cursor = c.get_cursor(*schema, from, from_length, to, to_length);
+  } else {
+    cursor = c.emit_reopen_cursor(*schema, cursor_slot_, from, from_length, to, to_length);
+    c.inner_cursors_->push_back(cursor_slot_);
+  }
+  if (batch_size_ == 0) {
+    codegen_row(c, cursor);
+  } else {
+    codegen_batch(c, cursor);
+  }
+  if (outermost) {
+    c.inner_cursors_ = nullptr;
+    c.emit_cursor_destroy(cursor);
+    for (auto* slot : inner_cursors) {
+      auto* inner = c.emit_load_cursor(slot);
+      c.emit_cursor_destroy(inner);
+      delete inner;
+      c.builder_.CreateStore(llvm::ConstantPointerNull::get(c.builder_.getInt64Ty()->getPointerTo()), slot);
+    }
+  }
+  delete cursor;
+}
+
+void Scan::codegen_parallel(CompilerContext& c) const {
+  // the range is computed here, the engine cuts it into morsels and every worker
+  // runs the outlined scan over the morsels it takes
+  if (c.proc_ || c.inner_cursors_) {
+    throw std::runtime_error("parallel scan can not be nested in a scan or a parallel body");
+  }
+  if (limit_ != 0) {
+    throw std::runtime_error("parallel scan does not support limit");
+  }
+  llvm::Value* from;
+  llvm::Value* from_length;
+  llvm::Value* to;
+  llvm::Value* to_length;
+  cursor_range(c, &from, &from_length, &to, &to_length);
+
+  auto* i8_ptr = c.builder_.getInt8PtrTy();
+  auto* i64 = c.builder_.getInt64Ty();
+  Outliner body(c, "__parallel_scan", {i8_ptr, i64, i8_ptr, i64});
+  alloca_row(c);
+  blk_->each_statement([&](const Statement* s) {
+    s->alloca_stack(c);
+  });
+  codegen_cursor(c, body.arg(0), body.arg(1), body.arg(2), body.arg(3));
+  auto* func = body.finish();
+  c.emit_parallel_scan(*c.local_schema_table_[table_], func, body.env(), from, from_length, to, to_length);
+}
+
+void Scan::codegen_lookup(CompilerContext& c) const {
+  // the where clause names the whole key, so this is a single Masstree lookup
+  // and no cursor at all. an inner scan keyed on the outer row becomes an index join.
+  const auto* schema = c.local_schema_table_[table_];
+  build_range_key(c, range_begin_, nullptr, false);
+  auto* key = c.builder_.CreateBitCast(range_begin_, c.builder_.getInt8PtrTy());
+  const auto key_length = terminate_key(c, key, *schema);
+  auto* value = c.builder_.CreateBitCast(lookup_value_, c.builder_.getInt8PtrTy());
+  auto* found = c.emit_lookup(*schema, key, c.builder_.getInt64(key_length),
+                              value, c.builder_.getInt64(schema->get_fixed_value_length()));
+
+  llvm::BasicBlock* hit =
+      llvm::BasicBlock::Create(c.ctx_, "lookup_hit", c.func_);
+  llvm::BasicBlock* fin =
+      llvm::BasicBlock::Create(c.ctx_, "lookup_fin", c.func_);
+  c.builder_.CreateCondBr(found, hit, fin);
+
+  c.builder_.SetInsertPoint(hit);
+  c.enter_loop(hit, hit, fin, fin);  // at most one row, break and continue both leave
+  c.builder_.CreateStore(load_row(c, key, value), tuple_stack_);
+  if (!residual_.empty()) {
+    llvm::BasicBlock* match =
+        llvm::BasicBlock::Create(c.ctx_, "lookup_match", c.func_);
+    c.builder_.CreateCondBr(residual_value(c), match, fin);
+    c.builder_.SetInsertPoint(match);
+  }
+  blk_->codegen(c);
+  c.builder_.CreateBr(fin);
 
-  // auto* row = c.builder_.CreateBitCast(tuple_stack_, rowtype->getPointerTo());
-  c.builder_.CreateStore(prev, tuple_stack_);
+  c.builder_.SetInsertPoint(fin);
+  c.exit_loop_ctx();
+}
 
+void Scan::codegen_row(CompilerContext& c, CursorBase* cursor) const {
+  llvm::BasicBlock* check =
+      llvm::BasicBlock::Create(c.ctx_, "fullscan_check", c.func_);
+  llvm::BasicBlock* begin =
+      llvm::BasicBlock::Create(c.ctx_, "fullscan_begin", c.func_);
+  llvm::BasicBlock* fin =
+      llvm::BasicBlock::Create(c.ctx_, "fullscan_fin", c.func_);
+  llvm::BasicBlock* next =
+      llvm::BasicBlock::Create(c.ctx_, "fullscan_next", c.func_);
+  llvm::BasicBlock* counted = counted_block(c, next);
+  c.enter_loop(check, begin, counted, fin);
+  if (limit_ != 0) {
+    c.builder_.CreateStore(c.builder_.getInt64(0), limit_count_);
+  }
+  c.builder_.CreateBr(check);
+  c.builder_.SetInsertPoint(check);
+  auto* cond = c.builder_.CreateAnd(c.emit_is_valid_cursor(cursor),
+                                    c.builder_.CreateNot(c.emit_is_cancelled()));
+  c.builder_.CreateCondBr(cond, begin, fin);
+
+  c.builder_.SetInsertPoint(begin);
+  // read columns straight out of the record, no copy into the stack
+  auto* key = c.emit_cursor_get_key(cursor);
+  llvm::Value* value;
+  if (uses_index()) {
+    // the cursor is on an index entry, the row is looked up by the key in it
+    const auto* schema = c.local_schema_table_[table_];
+    key = index_to_key(c, key);
+    value = c.builder_.CreateBitCast(lookup_value_, c.builder_.getInt8PtrTy());
+    const uint64_t key_length = schema->get_fixed_key_length();
+    auto* found = c.emit_lookup(*schema, key, c.builder_.getInt64(key_length),
+                                value, c.builder_.getInt64(schema->get_fixed_value_length()));
+    llvm::BasicBlock* hit =
+        llvm::BasicBlock::Create(c.ctx_, "indexscan_hit", c.func_);
+    c.builder_.CreateCondBr(found, hit, next);
+    c.builder_.SetInsertPoint(hit);
+  } else {
+    value = c.emit_cursor_get_value(cursor);
+  }
+  c.builder_.CreateStore(load_row(c, key, value), tuple_stack_);
+
+  if (!residual_.empty()) {
+    llvm::BasicBlock* match =
+        llvm::BasicBlock::Create(c.ctx_, "fullscan_match", c.func_);
+    c.builder_.CreateCondBr(residual_value(c), match, next);
+    c.builder_.SetInsertPoint(match);
+  }
   blk_->codegen(c);
+  count_limit(c, counted, next, fin);
+
+  c.builder_.SetInsertPoint(next);
   c.emit_cursor_next(cursor);
   c.builder_.CreateBr(check);
 
   c.builder_.SetInsertPoint(fin);
-  c.emit_cursor_destroy(cursor);
-  delete cursor;
+  c.exit_loop_ctx();
+}
+
+llvm::BasicBlock* Scan::counted_block(CompilerContext& c, llvm::BasicBlock* next) const {
+  if (limit_ == 0) {
+    return next;
+  }
+  return llvm::BasicBlock::Create(c.ctx_, row_name_ + "_counted", c.func_);
+}
+
+void Scan::count_limit(CompilerContext& c, llvm::BasicBlock* counted, llvm::BasicBlock* next,
+                       llvm::BasicBlock* fin) const {
+  // the body ran for one more row, leave the scan once limit_ rows went through it.
+  // continue comes here too, rows left out by the where clause go to next
+  c.builder_.CreateBr(counted);
+  if (limit_ == 0) {
+    return;
+  }
+  c.builder_.SetInsertPoint(counted);
+  auto* count = c.builder_.CreateAdd(c.builder_.CreateLoad(limit_count_), c.builder_.getInt64(1));
+  c.builder_.CreateStore(count, limit_count_);
+  c.builder_.CreateCondBr(c.builder_.CreateICmpULT(count, c.builder_.getInt64(limit_)), next, fin);
+}
+
+static uint64_t batch_stride(size_t len) {
+  // keep every row 8 bytes aligned inside the batch
+  return std::max<uint64_t>((len + 7) & ~7ULL, 8);
+}
+
+// rows a batch holds, batch_size cut down so that the buffers fit kBatchBufferBytes
+static uint64_t batch_rows(const Schema& schema, uint64_t batch_size) {
+  const uint64_t row = batch_stride(schema.get_fixed_key_length()) +
+                       batch_stride(schema.get_fixed_value_length()) + 1;
+  return std::max<uint64_t>(1, std::min(batch_size, Scan::kBatchBufferBytes / row));
+}
+
+void Scan::codegen_batch(CompilerContext& c, CursorBase* cursor) const {
+  // the cursor copies up to batch_size_ rows into two flat buffers with one call,
+  // then the body runs as a counted loop over the buffers. that leaves a plain
+  // loop with no opaque calls between rows for the loop passes to work on.
+  // with a residual predicate, a first loop computes a byte mask for the whole
+  // batch without branching, and the body loop only tests the mask.
+  const auto* schema = c.local_schema_table_[table_];
+  const uint64_t key_stride = batch_stride(schema->get_fixed_key_length());
+  const uint64_t value_stride = batch_stride(schema->get_fixed_value_length());
+  const uint64_t rows = batch_rows(*schema, batch_size_);
+
+  // the buffers are in the frame of the procedure, a scan run once per outer row reuses them
+  auto* keys = c.builder_.CreateBitCast(batch_keys_, c.builder_.getInt8PtrTy());
+  auto* values = c.builder_.CreateBitCast(batch_values_, c.builder_.getInt8PtrTy());
+  llvm::Value* mask = batch_mask_ ? c.builder_.CreateBitCast(batch_mask_, c.builder_.getInt8PtrTy()) : nullptr;
+
+  llvm::BasicBlock* fill =
+      llvm::BasicBlock::Create(c.ctx_, "batchscan_fill", c.func_);
+  llvm::BasicBlock* check =
+      llvm::BasicBlock::Create(c.ctx_, "batchscan_check", c.func_);
+  llvm::BasicBlock* begin =
+      llvm::BasicBlock::Create(c.ctx_, "batchscan_begin", c.func_);
+  llvm::BasicBlock* next =
+      llvm::BasicBlock::Create(c.ctx_, "batchscan_next", c.func_);
+  llvm::BasicBlock* fin =
+      llvm::BasicBlock::Create(c.ctx_, "batchscan_fin", c.func_);
+
+  auto row_at = [&](llvm::Value* idx) {
+    auto* key = c.builder_.CreateInBoundsGEP(keys, {c.builder_.CreateMul(idx, c.builder_.getInt64(key_stride))});
+    auto* value = c.builder_.CreateInBoundsGEP(values, {c.builder_.CreateMul(idx, c.builder_.getInt64(value_stride))});
+    c.builder_.CreateStore(load_row(c, key, value), tuple_stack_);
+  };
+  auto increment = [&]() {
+    c.builder_.CreateStore(c.builder_.CreateAdd(c.builder_.CreateLoad(batch_index_), c.builder_.getInt64(1)),
+                           batch_index_);
+  };
+
+  llvm::BasicBlock* counted = counted_block(c, next);
+  c.enter_loop(check, begin, counted, fin);
+  if (limit_ != 0) {
+    c.builder_.CreateStore(c.builder_.getInt64(0), limit_count_);
+  }
+  c.builder_.CreateBr(fill);
+  c.builder_.SetInsertPoint(fill);
+  llvm::BasicBlock* fetch =
+      llvm::BasicBlock::Create(c.ctx_, "batchscan_fetch", c.func_);
+  c.builder_.CreateCondBr(c.emit_is_cancelled(), fin, fetch);
+  c.builder_.SetInsertPoint(fetch);
+  auto* filled = c.emit_cursor_next_batch(cursor,
+                                          keys, c.builder_.getInt64(key_stride),
+                                          values, c.builder_.getInt64(value_stride),
+                                          c.builder_.getInt64(rows));
+  c.builder_.CreateStore(c.builder_.getInt64(0), batch_index_);
+  if (mask) {
+    llvm::BasicBlock* filter_check =
+        llvm::BasicBlock::Create(c.ctx_, "batchscan_filter_check", c.func_);
+    llvm::BasicBlock* filter =
+        llvm::BasicBlock::Create(c.ctx_, "batchscan_filter", c.func_);
+    llvm::BasicBlock* filter_fin =
+        llvm::BasicBlock::Create(c.ctx_, "batchscan_filter_fin", c.func_);
+    c.builder_.CreateCondBr(c.builder_.CreateICmpEQ(filled, c.builder_.getInt64(0)), fin, filter_check);
+
+    c.builder_.SetInsertPoint(filter_check);
+    auto* idx = c.builder_.CreateLoad(batch_index_);
+    c.builder_.CreateCondBr(c.builder_.CreateICmpULT(idx, filled), filter, filter_fin);
+
+    c.builder_.SetInsertPoint(filter);
+    row_at(idx);
+    auto* bit = c.builder_.CreateZExt(residual_value(c), c.builder_.getInt8Ty());
+    c.builder_.CreateStore(bit, c.builder_.CreateInBoundsGEP(mask, {idx}));
+    increment();
+    c.builder_.CreateBr(filter_check);
+
+    c.builder_.SetInsertPoint(filter_fin);
+    c.builder_.CreateStore(c.builder_.getInt64(0), batch_index_);
+    c.builder_.CreateBr(check);
+  } else {
+    c.builder_.CreateCondBr(c.builder_.CreateICmpEQ(filled, c.builder_.getInt64(0)), fin, check);
+  }
+
+  c.builder_.SetInsertPoint(check);
+  auto* idx = c.builder_.CreateLoad(batch_index_);
+  c.builder_.CreateCondBr(c.builder_.CreateICmpULT(idx, filled), begin, fill);
+
+  c.builder_.SetInsertPoint(begin);
+  if (mask) {
+    llvm::BasicBlock* match =
+        llvm::BasicBlock::Create(c.ctx_, "batchscan_match", c.func_);
+    auto* bit = c.builder_.CreateLoad(c.builder_.CreateInBoundsGEP(mask, {idx}));
+    c.builder_.CreateCondBr(c.builder_.CreateICmpNE(bit, c.builder_.getInt8(0)), match, next);
+    c.builder_.SetInsertPoint(match);
+  }
+  row_at(idx);
+  blk_->codegen(c);
+  count_limit(c, counted, next, fin);
+
+  c.builder_.SetInsertPoint(next);
+  increment();
+  c.builder_.CreateBr(check);
+
+  c.builder_.SetInsertPoint(fin);
+  c.exit_loop_ctx();
 }
 
 void Scan::alloca_stack(CompilerContext& c) const {
+  alloca_range(c);
+  if (!parallel_) {
+    alloca_row(c);
+  }
+}
+
+void Scan::alloca_range(CompilerContext& c) const {
   const auto* schema = c.local_schema_table_[table_];
   if (!schema->fixed_key_length()) {
     throw std::runtime_error("fixed length row is available");
@@ -368,19 +1311,41 @@ void Scan::alloca_stack(CompilerContext& c) const {
   }
   auto prefix = schema->get_key_prefix();
   prefix_begin_ = find_or_create_prefix(c, prefix, table_ + "_table_prefix_begin");
+  // sorts after every key of this table (keys are fixed length) and before the next table
   auto prefix_end = prefix;
-  prefix_end[prefix_end.size() - 2]++;
+  prefix_end.resize(schema->get_fixed_key_length(), '\xff');
   prefix_end_ = find_or_create_prefix(c, prefix_end, table_ + "_table_prefix_end");
-
-  auto* key_stk = llvm::ArrayType::get(c.builder_.getInt8Ty(), schema->get_fixed_key_length());
-  auto* val_stk = llvm::ArrayType::get(c.builder_.getInt8Ty(), schema->get_fixed_value_length());
-
-  if (key_stack_) {
-    throw std::runtime_error("key_stack is already initialized");
+  if (has_key_range()) {
+    auto* key_type = llvm::ArrayType::get(c.builder_.getInt8Ty(), schema->get_fixed_key_length());
+    range_begin_ = c.builder_.CreateAlloca(key_type, nullptr, row_name_ + "_range_begin");
+    range_end_ = c.builder_.CreateAlloca(key_type, nullptr, row_name_ + "_range_end");
   }
-  key_stack_ = c.builder_.CreateAlloca(key_stk, nullptr, "scan_key_stack");
-  value_stack_ = c.builder_.CreateAlloca(val_stk, nullptr, "scan_val_stack");
+  if (uses_index()) {
+    // range_begin_ holds the key of the row to look up
+    const auto* entry = c.local_schema_table_[index_.name];
+    index_prefix_ = find_or_create_prefix(c, entry->get_key_prefix(), index_.name + "_index_prefix");
+    auto* key_type = llvm::ArrayType::get(c.builder_.getInt8Ty(), schema->get_fixed_key_length());
+    auto* entry_type = llvm::ArrayType::get(c.builder_.getInt8Ty(), entry->get_fixed_key_length());
+    range_begin_ = c.builder_.CreateAlloca(key_type, nullptr, row_name_ + "_lookup_key");
+    index_begin_ = c.builder_.CreateAlloca(entry_type, nullptr, row_name_ + "_index_begin");
+    index_end_ = c.builder_.CreateAlloca(entry_type, nullptr, row_name_ + "_index_end");
+  }
+}
 
+void Scan::alloca_row(CompilerContext& c) const {
+  const auto* schema = c.local_schema_table_[table_];
+  if (point_lookup_ || uses_index()) {
+    auto* value_type = llvm::ArrayType::get(c.builder_.getInt8Ty(), schema->get_fixed_value_length());
+    lookup_value_ = c.builder_.CreateAlloca(value_type, nullptr, row_name_ + "_lookup_value");
+  }
+  if (!point_lookup_) {
+    auto* cursor_type = c.builder_.getInt64Ty()->getPointerTo();
+    cursor_slot_ = c.builder_.CreateAlloca(cursor_type, nullptr, row_name_ + "_cursor");
+    c.builder_.CreateStore(llvm::ConstantPointerNull::get(cursor_type), cursor_slot_);
+  }
+  if (tuple_stack_) {
+    throw std::runtime_error("tuple_stack is already initialized");
+  }
 
   std::vector<llvm::Type*> row_attrs;
   schema->each_attr([&](size_t idx, const Attribute& attr) {
@@ -395,6 +1360,492 @@ void Scan::alloca_stack(CompilerContext& c) const {
   auto* store = c.builder_.CreateAlloca(row_type, nullptr, row_name_);
   store->setAlignment(8);
   tuple_stack_ = c.variable_table_[row_name_] = store;
+
+  if (batch_size_ != 0) {
+    batch_index_ = c.builder_.CreateAlloca(c.builder_.getInt64Ty(), nullptr, row_name_ + "_batch_index");
+    const uint64_t rows = batch_rows(*schema, batch_size_);
+    auto buffer = [&](uint64_t bytes, const std::string& name) {
+      auto* buf = c.builder_.CreateAlloca(llvm::ArrayType::get(c.builder_.getInt8Ty(), bytes), nullptr,
+                                          row_name_ + name);
+      buf->setAlignment(8);
+      return buf;
+    };
+    batch_keys_ = buffer(batch_stride(schema->get_fixed_key_length()) * rows, "_batch_keys");
+    batch_values_ = buffer(batch_stride(schema->get_fixed_value_length()) * rows, "_batch_values");
+    batch_mask_ = residual_.empty() ? nullptr : buffer(rows, "_batch_mask");
+  }
+  if (limit_ != 0) {
+    limit_count_ = c.builder_.CreateAlloca(c.builder_.getInt64Ty(), nullptr, row_name_ + "_limit_count");
+  }
+}
+
+void AggregateStep::dump(std::ostream& o, size_t indent) const {
+  o << "accumulate";
+}
+
+void AggregateStep::analyze(CompilerContext& ctx) {
+  // runs inside Scan::analyze, so the row variable is visible here
+  for (auto* g : owner_->group_by_) {
+    g->analyze(ctx);
+  }
+  for (const auto& t : owner_->terms_) {
+    if (t.arg) {
+      t.arg->analyze(ctx);
+    }
+  }
+}
+
+void AggregateStep::codegen(CompilerContext& c) const {
+  owner_->codegen_step(c);
+}
+
+namespace {
+
+llvm::Value* as_i64(CompilerContext& c, llvm::Value* v) {
+  if (v->getType()->isIntegerTy(1)) {
+    return c.builder_.CreateZExt(v, c.builder_.getInt64Ty());
+  }
+  return v;
+}
+
+// evaluates the key expressions into key_stack and hashes them the way
+// RowHashTable expects (never 0, that marks an empty slot)
+llvm::Value* hash_row_keys(CompilerContext& c, const std::vector<Expression*>& exprs,
+                           llvm::Value* key_stack, std::vector<llvm::Value*>& keys) {
+  llvm::Value* hash = c.builder_.getInt64(0);
+  for (uint64_t i = 0; i < exprs.size(); ++i) {
+    auto* k = as_i64(c, exprs[i]->get_value(c));
+    c.builder_.CreateStore(k, c.builder_.CreateInBoundsGEP(key_stack, {c.builder_.getInt64(0), c.builder_.getInt64(i)}));
+    keys.push_back(k);
+    hash = c.builder_.CreateMul(c.builder_.CreateXor(hash, k), c.builder_.getInt64(0x9e3779b97f4a7c15ULL));
+    hash = c.builder_.CreateXor(hash, c.builder_.CreateLShr(hash, 29));
+  }
+  return c.builder_.CreateOr(hash, c.builder_.getInt64(1));
+}
+
+}  // namespace
+
+void Aggregate::init_accumulators(CompilerContext& c,
+                                  const std::function<llvm::Value*(uint64_t)>& word) const {
+  for (const auto& t : terms_) {
+    switch (t.func) {
+      case MIN:
+        c.builder_.CreateStore(c.builder_.getInt64(std::numeric_limits<int64_t>::max()), word(t.offset));
+        break;
+      case MAX:
+        c.builder_.CreateStore(c.builder_.getInt64(std::numeric_limits<int64_t>::min()), word(t.offset));
+        break;
+      case AVG:
+        c.builder_.CreateStore(c.builder_.getInt64(0), word(t.offset + 1));
+        // fallthrough
+      case SUM:
+      case COUNT:
+        c.builder_.CreateStore(c.builder_.getInt64(0), word(t.offset));
+        break;
+    }
+  }
+}
+
+void Aggregate::accumulate(CompilerContext& c,
+                           const std::function<llvm::Value*(uint64_t)>& word) const {
+  for (const auto& t : terms_) {
+    llvm::Value* v = t.arg ? as_i64(c, t.arg->get_value(c)) : nullptr;
+    auto* acc = word(t.offset);
+    auto* cur = c.builder_.CreateLoad(acc);
+    switch (t.func) {
+      case SUM:
+        c.builder_.CreateStore(c.builder_.CreateAdd(cur, v), acc);
+        break;
+      case COUNT:
+        c.builder_.CreateStore(c.builder_.CreateAdd(cur, c.builder_.getInt64(1)), acc);
+        break;
+      case MIN:
+        c.builder_.CreateStore(c.builder_.CreateSelect(c.builder_.CreateICmpSLT(v, cur), v, cur), acc);
+        break;
+      case MAX:
+        c.builder_.CreateStore(c.builder_.CreateSelect(c.builder_.CreateICmpSGT(v, cur), v, cur), acc);
+        break;
+      case AVG: {
+        c.builder_.CreateStore(c.builder_.CreateAdd(cur, v), acc);
+        auto* count = word(t.offset + 1);
+        c.builder_.CreateStore(c.builder_.CreateAdd(c.builder_.CreateLoad(count), c.builder_.getInt64(1)), count);
+        break;
+      }
+    }
+  }
+}
+
+void Aggregate::emit_result(CompilerContext& c, const std::function<llvm::Value*(uint64_t)>& key,
+                            const std::function<llvm::Value*(uint64_t)>& word) const {
+  // emitted row is {group keys..., one value per function}
+  auto slot = [&](uint64_t i) {
+    return c.builder_.CreateInBoundsGEP(output_stack_,
+                                        {c.builder_.getInt32(0), c.builder_.getInt32(static_cast<uint32_t>(i))});
+  };
+  const uint64_t keys = group_by_.size();
+  for (uint64_t i = 0; i < keys; ++i) {
+    c.builder_.CreateStore(c.builder_.CreateLoad(key(i)), slot(i));
+  }
+  for (uint64_t i = 0; i < terms_.size(); ++i) {
+    const auto& t = terms_[i];
+    llvm::Value* v = c.builder_.CreateLoad(word(t.offset));
+    if (t.func == AVG) {
+      // integer average, 0 for an empty input
+      auto* count = c.builder_.CreateLoad(word(t.offset + 1));
+      auto* empty = c.builder_.CreateICmpEQ(count, c.builder_.getInt64(0));
+      auto* divisor = c.builder_.CreateSelect(empty, c.builder_.getInt64(1), count);
+      v = c.builder_.CreateSelect(empty, c.builder_.getInt64(0), c.builder_.CreateSDiv(v, divisor));
+    }
+    c.builder_.CreateStore(v, slot(keys + i));
+  }
+  auto* row = c.builder_.CreateBitCast(output_stack_, c.builder_.getInt8PtrTy());
+  if (c.get_columnar_sink()) {
+    c.emit_columns(emit_layout(c, llvm::cast<llvm::StructType>(output_stack_->getAllocatedType())), row);
+  } else {
+    c.emit_output(row, (keys + terms_.size()) * 8);
+  }
+}
+
+void Aggregate::codegen_step(CompilerContext& c) const {
+  if (group_by_.empty()) {
+    accumulate(c, [&](uint64_t i) { return accumulators_[i]; });
+    return;
+  }
+
+  auto* i64 = c.builder_.getInt64Ty();
+  std::vector<llvm::Value*> keys;
+  auto* hash = hash_row_keys(c, group_by_, key_stack_, keys);
+
+  // RowHashTable: word 0 is slots_, word 1 is mask_. reloaded per row since insert may grow
+  auto* slots = c.builder_.CreateIntToPtr(c.builder_.CreateLoad(table_), i64->getPointerTo());
+  auto* mask = c.builder_.CreateLoad(c.builder_.CreateInBoundsGEP(table_, {c.builder_.getInt64(1)}));
+  const uint64_t entry_words = 1 + group_by_.size() + accumulator_words_;
+
+  auto* pre = c.builder_.GetInsertBlock();
+  auto* probe = llvm::BasicBlock::Create(c.ctx_, "agg_probe", c.func_);
+  auto* compare = llvm::BasicBlock::Create(c.ctx_, "agg_compare", c.func_);
+  auto* next = llvm::BasicBlock::Create(c.ctx_, "agg_next", c.func_);
+  auto* miss = llvm::BasicBlock::Create(c.ctx_, "agg_miss", c.func_);
+  auto* update = llvm::BasicBlock::Create(c.ctx_, "agg_update", c.func_);
+  c.builder_.CreateBr(probe);
+
+  c.builder_.SetInsertPoint(probe);
+  auto* pos = c.builder_.CreatePHI(i64, 2, "agg_pos");
+  pos->addIncoming(c.builder_.CreateAnd(hash, mask), pre);
+  auto* entry = c.builder_.CreateInBoundsGEP(slots, {c.builder_.CreateMul(pos, c.builder_.getInt64(entry_words))});
+  auto* tag = c.builder_.CreateLoad(entry);
+  c.builder_.CreateCondBr(c.builder_.CreateICmpEQ(tag, c.builder_.getInt64(0)), miss, compare);
+
+  c.builder_.SetInsertPoint(compare);
+  llvm::Value* same = c.builder_.CreateICmpEQ(tag, hash);
+  for (uint64_t i = 0; i < keys.size(); ++i) {
+    auto* stored = c.builder_.CreateLoad(c.builder_.CreateInBoundsGEP(entry, {c.builder_.getInt64(1 + i)}));
+    same = c.builder_.CreateAnd(same, c.builder_.CreateICmpEQ(stored, keys[i]));
+  }
+  c.builder_.CreateCondBr(same, update, next);
+
+  c.builder_.SetInsertPoint(next);
+  pos->addIncoming(c.builder_.CreateAnd(c.builder_.CreateAdd(pos, c.builder_.getInt64(1)), mask), next);
+  c.builder_.CreateBr(probe);
+
+  c.builder_.SetInsertPoint(miss);
+  auto* inserted = c.builder_.CreateCall(c.functions_table_["__hash_table_insert"],
+                                         {table_, hash,
+                                          c.builder_.CreateBitCast(key_stack_, i64->getPointerTo())});
+  const uint64_t payload = 1 + group_by_.size();
+  init_accumulators(c, [&](uint64_t i) {
+    return c.builder_.CreateInBoundsGEP(inserted, {c.builder_.getInt64(payload + i)});
+  });
+  c.builder_.CreateBr(update);
+
+  c.builder_.SetInsertPoint(update);
+  auto* found = c.builder_.CreatePHI(i64->getPointerTo(), 2, "agg_entry");
+  found->addIncoming(entry, compare);
+  found->addIncoming(inserted, miss);
+  accumulate(c, [&](uint64_t i) {
+    return c.builder_.CreateInBoundsGEP(found, {c.builder_.getInt64(payload + i)});
+  });
+}
+
+// every worker would build a table of its own and emit it, nothing merges them
+static void reject_in_parallel_body(const CompilerContext& c, const std::string& what) {
+  if (c.proc_) {
+    throw std::runtime_error(what + " can not run in a parallel body, the results of the workers are not merged");
+  }
+}
+
+void Aggregate::codegen(CompilerContext& c) const {
+  reject_in_parallel_body(c, "aggregate");
+  if (group_by_.empty()) {
+    // no hash table, the accumulators are allocas and end up in registers
+    init_accumulators(c, [&](uint64_t i) { return accumulators_[i]; });
+    scan_->codegen(c);
+    emit_result(c, nullptr, [&](uint64_t i) { return accumulators_[i]; });
+    return;
+  }
+
+  table_ = c.builder_.CreateCall(c.functions_table_["__hash_table_create"],
+                                 {c.builder_.getInt64(group_by_.size()),
+                                  c.builder_.getInt64(accumulator_words_)});
+  scan_->codegen(c);
+
+  auto* check = llvm::BasicBlock::Create(c.ctx_, "agg_emit_check", c.func_);
+  auto* body = llvm::BasicBlock::Create(c.ctx_, "agg_emit", c.func_);
+  auto* fin = llvm::BasicBlock::Create(c.ctx_, "agg_emit_fin", c.func_);
+  c.builder_.CreateStore(c.builder_.getInt64(0), iter_stack_);
+  c.builder_.CreateBr(check);
+
+  c.builder_.SetInsertPoint(check);
+  auto* entry = c.builder_.CreateCall(c.functions_table_["__hash_table_next"], {table_, iter_stack_});
+  c.builder_.CreateCondBr(c.builder_.CreateIsNull(entry), fin, body);
+
+  c.builder_.SetInsertPoint(body);
+  const uint64_t payload = 1 + group_by_.size();
+  emit_result(c,
+              [&](uint64_t i) { return c.builder_.CreateInBoundsGEP(entry, {c.builder_.getInt64(1 + i)}); },
+              [&](uint64_t i) { return c.builder_.CreateInBoundsGEP(entry, {c.builder_.getInt64(payload + i)}); });
+  c.builder_.CreateBr(check);
+
+  c.builder_.SetInsertPoint(fin);
+  c.builder_.CreateCall(c.functions_table_["__hash_table_destroy"], {table_});
+}
+
+void Aggregate::alloca_stack(CompilerContext& c) const {
+  auto* i64 = c.builder_.getInt64Ty();
+  if (group_by_.empty()) {
+    for (uint64_t i = 0; i < accumulator_words_; ++i) {
+      accumulators_.push_back(c.builder_.CreateAlloca(i64, nullptr, "accumulator"));
+    }
+  } else {
+    key_stack_ = c.builder_.CreateAlloca(llvm::ArrayType::get(i64, group_by_.size()), nullptr, "group_key");
+    iter_stack_ = c.builder_.CreateAlloca(i64, nullptr, "group_iter");
+  }
+  // a struct of i64, its layout is what a columnar sink reads
+  std::vector<llvm::Type*> columns(group_by_.size() + terms_.size(), i64);
+  output_stack_ = c.builder_.CreateAlloca(llvm::StructType::get(c.ctx_, columns), nullptr, "aggregate_output");
+}
+
+void JoinStep::dump(std::ostream& o, size_t indent) const {
+  // the block of the join is dumped by the join
+  o << (build_ ? "build" : "probe");
+}
+
+void JoinStep::analyze(CompilerContext& ctx) {
+  for (auto* k : build_ ? owner_->build_keys_ : owner_->probe_keys_) {
+    k->analyze(ctx);
+  }
+  if (!build_) {
+    owner_->blk_->analyze(ctx);
+  }
+}
+
+void JoinStep::each_statement(std::function<void(const Statement*)> func) const {
+  if (!build_) {
+    owner_->blk_->each_statement(func);
+  }
+}
+
+void JoinStep::codegen(CompilerContext& c) const {
+  if (build_) {
+    owner_->codegen_build(c);
+  } else {
+    owner_->codegen_probe(c);
+  }
+}
+
+void Join::codegen_build(CompilerContext& c) const {
+  // entry is [hash][keys][build row], duplicate keys are inserted as separate entries
+  std::vector<llvm::Value*> keys;
+  auto* hash = hash_row_keys(c, build_keys_, key_stack_, keys);
+  auto* entry = c.builder_.CreateCall(c.functions_table_["__hash_table_insert"],
+                                      {table_, hash,
+                                       c.builder_.CreateBitCast(key_stack_, c.builder_.getInt64Ty()->getPointerTo())});
+  auto* row_type = c.type_table_[build_->row_name_];
+  auto* row = c.builder_.CreateBitCast(
+      c.builder_.CreateInBoundsGEP(entry, {c.builder_.getInt64(1 + build_keys_.size())}),
+      row_type->getPointerTo());
+  c.builder_.CreateStore(c.builder_.CreateLoad(build_->tuple_stack_), row);
+}
+
+void Join::codegen_probe(CompilerContext& c) const {
+  auto* i64 = c.builder_.getInt64Ty();
+  std::vector<llvm::Value*> keys;
+  auto* hash = hash_row_keys(c, probe_keys_, key_stack_, keys);
+
+  // the table does not grow while probing, slots_/mask_ could be hoisted out of the loop
+  auto* slots = c.builder_.CreateIntToPtr(c.builder_.CreateLoad(table_), i64->getPointerTo());
+  auto* mask = c.builder_.CreateLoad(c.builder_.CreateInBoundsGEP(table_, {c.builder_.getInt64(1)}));
+  const auto* schema = c.local_schema_table_[build_->table_];
+  const uint64_t entry_words = 1 + build_keys_.size() + schema->columns();
+
+  auto* pre = c.builder_.GetInsertBlock();
+  auto* probe = llvm::BasicBlock::Create(c.ctx_, "join_probe", c.func_);
+  auto* compare = llvm::BasicBlock::Create(c.ctx_, "join_compare", c.func_);
+  auto* match = llvm::BasicBlock::Create(c.ctx_, "join_match", c.func_);
+  auto* next = llvm::BasicBlock::Create(c.ctx_, "join_next", c.func_);
+  auto* fin = llvm::BasicBlock::Create(c.ctx_, "join_fin", c.func_);
+  c.builder_.CreateBr(probe);
+
+  // walk the whole cluster, every entry with the same keys is a match
+  c.builder_.SetInsertPoint(probe);
+  auto* pos = c.builder_.CreatePHI(i64, 2, "join_pos");
+  pos->addIncoming(c.builder_.CreateAnd(hash, mask), pre);
+  auto* entry = c.builder_.CreateInBoundsGEP(slots, {c.builder_.CreateMul(pos, c.builder_.getInt64(entry_words))});
+  auto* tag = c.builder_.CreateLoad(entry);
+  c.builder_.CreateCondBr(c.builder_.CreateICmpEQ(tag, c.builder_.getInt64(0)), fin, compare);
+
+  c.builder_.SetInsertPoint(compare);
+  llvm::Value* same = c.builder_.CreateICmpEQ(tag, hash);
+  for (uint64_t i = 0; i < keys.size(); ++i) {
+    auto* stored = c.builder_.CreateLoad(c.builder_.CreateInBoundsGEP(entry, {c.builder_.getInt64(1 + i)}));
+    same = c.builder_.CreateAnd(same, c.builder_.CreateICmpEQ(stored, keys[i]));
+  }
+  c.builder_.CreateCondBr(same, match, next);
+
+  c.builder_.SetInsertPoint(match);
+  auto* row_type = c.type_table_[build_->row_name_];
+  auto* row = c.builder_.CreateBitCast(
+      c.builder_.CreateInBoundsGEP(entry, {c.builder_.getInt64(1 + build_keys_.size())}),
+      row_type->getPointerTo());
+  c.builder_.CreateStore(c.builder_.CreateLoad(row), build_->tuple_stack_);
+  blk_->codegen(c);
+  c.builder_.CreateBr(next);
+
+  c.builder_.SetInsertPoint(next);
+  pos->addIncoming(c.builder_.CreateAnd(c.builder_.CreateAdd(pos, c.builder_.getInt64(1)), mask), next);
+  c.builder_.CreateBr(probe);
+
+  c.builder_.SetInsertPoint(fin);
+}
+
+void Join::codegen(CompilerContext& c) const {
+  reject_in_parallel_body(c, "join");
+  const auto* schema = c.local_schema_table_[build_->table_];
+  table_ = c.builder_.CreateCall(c.functions_table_["__hash_table_create"],
+                                 {c.builder_.getInt64(build_keys_.size()),
+                                  c.builder_.getInt64(schema->columns())});
+  build_->codegen(c);
+  probe_->codegen(c);
+  c.builder_.CreateCall(c.functions_table_["__hash_table_destroy"], {table_});
+}
+
+void Join::alloca_stack(CompilerContext& c) const {
+  key_stack_ = c.builder_.CreateAlloca(llvm::ArrayType::get(c.builder_.getInt64Ty(), build_keys_.size()),
+                                       nullptr, "join_key");
+}
+
+void SortStep::dump(std::ostream& o, size_t indent) const {
+  o << "collect";
+}
+
+void SortStep::analyze(CompilerContext& ctx) {
+  // the body runs after the scan, but the row variable is still the scanned row
+  for (auto* k : owner_->keys_) {
+    k->analyze(ctx);
+  }
+  owner_->blk_->analyze(ctx);
+}
+
+void SortStep::each_statement(std::function<void(const Statement*)> func) const {
+  owner_->blk_->each_statement(func);
+}
+
+void SortStep::codegen(CompilerContext& c) const {
+  owner_->codegen_step(c);
+}
+
+void Sort::codegen_step(CompilerContext& c) const {
+  // keys are flipped so that the sorter only compares unsigned words,
+  // the sign bit for signed order and every bit for descending order
+  for (uint64_t i = 0; i < keys_.size(); ++i) {
+    auto* k = c.builder_.CreateXor(as_i64(c, keys_[i]->get_value(c)), c.builder_.getInt64(1ULL << 63));
+    if (descending_[i]) {
+      k = c.builder_.CreateNot(k);
+    }
+    c.builder_.CreateStore(k, c.builder_.CreateInBoundsGEP(record_stack_, {c.builder_.getInt64(0), c.builder_.getInt64(i)}));
+  }
+  auto* order = c.builder_.CreateLoad(order_stack_);
+  c.builder_.CreateStore(order, c.builder_.CreateInBoundsGEP(record_stack_, {c.builder_.getInt64(0), c.builder_.getInt64(keys_.size())}));
+  c.builder_.CreateStore(c.builder_.CreateAdd(order, c.builder_.getInt64(1)), order_stack_);
+  auto* row_type = c.type_table_[scan_->row_name_];
+  auto* row = c.builder_.CreateBitCast(
+      c.builder_.CreateInBoundsGEP(record_stack_, {c.builder_.getInt64(0), c.builder_.getInt64(keys_.size() + 1)}),
+      row_type->getPointerTo());
+  c.builder_.CreateStore(c.builder_.CreateLoad(scan_->tuple_stack_), row);
+  c.builder_.CreateCall(c.functions_table_["__sorter_add"],
+                        {sorter_, c.builder_.CreateBitCast(record_stack_, c.builder_.getInt64Ty()->getPointerTo())});
+}
+
+void Sort::codegen(CompilerContext& c) const {
+  reject_in_parallel_body(c, "sort");
+  const auto* schema = c.local_schema_table_[scan_->table_];
+  // the scan order is a key too, so that rows with equal keys keep it, in a
+  // top-N and across spilled runs alike
+  sorter_ = c.builder_.CreateCall(c.functions_table_["__sorter_create"],
+                                  {c.builder_.getInt64(keys_.size() + 1),
+                                   c.builder_.getInt64(schema->columns()),
+                                   c.builder_.getInt64(limit_),
+                                   c.builder_.getInt64(RowSorter::kDefaultMemoryBudget)});
+  c.builder_.CreateStore(c.builder_.getInt64(0), order_stack_);
+  scan_->codegen(c);
+  c.builder_.CreateCall(c.functions_table_["__sorter_finish"], {sorter_});
+
+  auto* check = llvm::BasicBlock::Create(c.ctx_, "sort_check", c.func_);
+  auto* body = llvm::BasicBlock::Create(c.ctx_, "sort_body", c.func_);
+  auto* fin = llvm::BasicBlock::Create(c.ctx_, "sort_fin", c.func_);
+  c.builder_.CreateBr(check);
+
+  c.builder_.SetInsertPoint(check);
+  auto* found = c.builder_.CreateCall(c.functions_table_["__sorter_next"],
+                                      {sorter_, c.builder_.CreateBitCast(record_stack_, c.builder_.getInt64Ty()->getPointerTo())});
+  c.builder_.CreateCondBr(found, body, fin);
+
+  c.builder_.SetInsertPoint(body);
+  // continue takes the next row, break leaves through the destroy
+  c.enter_loop(check, body, check, fin);
+  auto* row_type = c.type_table_[scan_->row_name_];
+  auto* row = c.builder_.CreateBitCast(
+      c.builder_.CreateInBoundsGEP(record_stack_, {c.builder_.getInt64(0), c.builder_.getInt64(keys_.size() + 1)}),
+      row_type->getPointerTo());
+  c.builder_.CreateStore(c.builder_.CreateLoad(row), scan_->tuple_stack_);
+  blk_->codegen(c);
+  c.builder_.CreateBr(check);
+  c.exit_loop_ctx();
+
+  c.builder_.SetInsertPoint(fin);
+  c.builder_.CreateCall(c.functions_table_["__sorter_destroy"], {sorter_});
+}
+
+void Sort::alloca_stack(CompilerContext& c) const {
+  const auto* schema = c.local_schema_table_[scan_->table_];
+  record_stack_ = c.builder_.CreateAlloca(
+      llvm::ArrayType::get(c.builder_.getInt64Ty(), keys_.size() + 1 + schema->columns()),
+      nullptr, "sort_record");
+  order_stack_ = c.builder_.CreateAlloca(c.builder_.getInt64Ty(), nullptr, "sort_order");
+}
+
+void Parallel::codegen(CompilerContext& c) const {
+  if (c.in_txn_ || c.inner_cursors_ || c.proc_) {
+    throw std::runtime_error("parallel for runs its own transactions, put it outside of transactions, scans and parallel bodies");
+  }
+  auto* from = from_->get_value(c);
+  auto* to = to_->get_value(c);
+
+  // body(proc, env, var), called by the workers for every iteration
+  Outliner body(c, "__parallel_body", {c.builder_.getInt64Ty()});
+  auto* var = c.builder_.CreateAlloca(c.builder_.getInt64Ty(), nullptr, var_);
+  var->setAlignment(8);
+  c.variable_table_[var_] = var;
+  c.builder_.CreateStore(body.arg(0), var);
+  blk_->each_statement([&](const Statement* s) {
+    s->alloca_stack(c);
+  });
+  // the engine runs every iteration in a transaction of its own
+  c.in_txn_ = true;
+  blk_->codegen(c);
+  c.in_txn_ = false;
+  auto* func = body.finish();
+  c.emit_parallel_for(func, body.env(), from, to, c.builder_.getInt64(batch_), partitioned_);
 }
 
 }  // namespace node
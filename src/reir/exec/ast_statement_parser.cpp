@@ -2,6 +2,7 @@
 // Created by kumagi on 18/04/12.
 //
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include "parser.hpp"
@@ -102,8 +103,118 @@ Define::Define(TokenStream& tokens) : Statement(ND_Define) {
   expect_token(tokens.get(), token_type::IDENTIFIER);
   name_ = tokens.get().text;
   tokens.next();  // '>'
+  // define <{...}> <name> [partition by <key column>]
+  if (tokens.get().type == token_type::IDENTIFIER && tokens.get().text == "partition") {
+    tokens.next();
+    if (tokens.get().type != token_type::IDENTIFIER || tokens.get().text != "by") {
+      throw std::runtime_error("partition needs 'by <column>'");
+    }
+    tokens.next();
+    expect_token(tokens.get(), token_type::IDENTIFIER);
+    const std::string column(tokens.get().text);
+    auto it = std::find(schema_->names_.begin(), schema_->names_.end(), column);
+    if (it == schema_->names_.end()) {
+      throw std::runtime_error("undefined partition column: " + column);
+    }
+    auto& prop = schema_->props_[it - schema_->names_.begin()];
+    if (!(prop & Attribute::AttrProperty::KEY)) {
+      throw std::runtime_error("partition column must be a key: " + column);
+    }
+    prop = Attribute::AttrProperty(prop | Attribute::AttrProperty::PARTITION);
+    tokens.next();
+  }
+  // [using masstree | array <records> | hash [<expected records>] | sequential]
+  if (tokens.has_next() && tokens.get().type == token_type::IDENTIFIER && tokens.get().text == "using") {
+    tokens.next();
+    expect_token(tokens.get(), token_type::IDENTIFIER);
+    const std::string kind(tokens.get().text);
+    tokens.next();
+    if (kind == "masstree") {
+      schema_->storage_ = StorageKind::MASSTREE;
+    } else if (kind == "array") {
+      schema_->storage_ = StorageKind::ARRAY;
+    } else if (kind == "hash") {
+      schema_->storage_ = StorageKind::HASH;
+    } else if (kind == "sequential") {
+      schema_->storage_ = StorageKind::SEQUENTIAL;
+    } else {
+      throw std::runtime_error("unknown storage: " + kind);
+    }
+    if (tokens.has_next() && tokens.get().type == token_type::NUMBER) {
+      auto size = std::stoll(tokens.get().text);
+      if (size <= 0) {
+        throw std::runtime_error("storage size must be positive");
+      }
+      schema_->storage_size_ = static_cast<uint64_t>(size);
+      tokens.next();
+    }
+    check_storage();
+  }
 }
 
+void Define::check_storage() const {
+  std::vector<size_t> keys;
+  for (size_t i = 0; i < schema_->props_.size(); ++i) {
+    if (schema_->props_[i] & Attribute::AttrProperty::KEY) {
+      keys.push_back(i);
+    }
+  }
+  switch (schema_->storage_) {
+    case StorageKind::ARRAY: {
+      // the key is the offset in the array
+      if (schema_->storage_size_ == 0) {
+        throw std::runtime_error("array needs its number of records: using array <records>");
+      }
+      if (keys.size() != 1 ||
+          (schema_->type_names_[keys[0]] != "int" && schema_->type_names_[keys[0]] != "date")) {
+        throw std::runtime_error("array table " + name_ + " needs a single int key");
+      }
+      if (keys.size() == schema_->props_.size()) {
+        throw std::runtime_error("array table " + name_ + " needs a non key column");
+      }
+      break;
+    }
+    case StorageKind::SEQUENTIAL:
+      if (schema_->storage_size_ != 0) {
+        throw std::runtime_error("sequential table " + name_ + " does not take a size");
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+DefineIndex::DefineIndex(TokenStream& tokens)
+    : Statement(ND_DefineIndex), table_begin_(nullptr), table_end_(nullptr), prefix_(nullptr),
+      entry_stack_(nullptr) {
+  // define index <name> on <table>(<column>, ...)
+  expect_token(tokens.get(), token_type::DEFINE);
+  tokens.next();
+  tokens.next();  // 'index'
+  expect_token(tokens.get(), token_type::IDENTIFIER);
+  name_ = tokens.get().text;
+  tokens.next();
+  if (tokens.get().type != token_type::IDENTIFIER || tokens.get().text != "on") {
+    throw std::runtime_error("define index needs 'on <table>(<columns>)'");
+  }
+  tokens.next();
+  expect_token(tokens.get(), token_type::IDENTIFIER);
+  table_ = tokens.get().text;
+  tokens.next();
+  expect_token(tokens.get(), token_type::OPEN_PAREN);
+  tokens.next();
+  for (;;) {
+    expect_token(tokens.get(), token_type::IDENTIFIER);
+    columns_.emplace_back(tokens.get().text);
+    tokens.next();
+    if (tokens.get().type != token_type::COMMA) {
+      break;
+    }
+    tokens.next();
+  }
+  expect_token(tokens.get(), token_type::CLOSE_PAREN);
+  tokens.next();
+}
 
 For::For(TokenStream& tokens) : Statement(ND_For) {
   expect_token(tokens.get(), token_type::FOR);
@@ -125,10 +236,34 @@ For::For(TokenStream& tokens) : Statement(ND_For) {
   blk_ = new Block(tokens);
 };
 
-Statement* parse_statement(TokenStream& tokens) {
-  assert(tokens.has_next());
-  if (tokens.get().type == token_type::CLOSE_BRACE) {
-    return nullptr;
+namespace {
+
+// aggregate, join, sort and parallel are not reserved. like where or by, they are
+// keywords only where they start a statement, in front of the token given
+bool contextual(TokenStream& tokens, const char* word, token_type next) {
+  return tokens.get().type == token_type::IDENTIFIER && tokens.get().text == word &&
+         tokens.pos() + 1 < tokens.size() && tokens.peek(1).type == next;
+}
+
+Statement* parse_statement_kind(TokenStream& tokens) {
+  if (contextual(tokens, "aggregate", token_type::SCAN)) {
+    return new Aggregate(tokens);
+  }
+  if (contextual(tokens, "join", token_type::SCAN)) {
+    return new Join(tokens);
+  }
+  if (contextual(tokens, "sort", token_type::SCAN)) {
+    return new Sort(tokens);
+  }
+  if (contextual(tokens, "parallel", token_type::SCAN)) {
+    tokens.next();
+    auto* scan = new Scan(tokens);
+    scan->parallel_ = true;
+    return scan;
+  }
+  if (contextual(tokens, "parallel", token_type::FOR)) {
+    tokens.next();
+    return new Parallel(tokens);
   }
   switch (tokens.get().type) {
     case token_type::OPEN_BRACE: {
@@ -150,6 +285,10 @@ Statement* parse_statement(TokenStream& tokens) {
       return new For(tokens);
     }
     case token_type::DEFINE: {
+      const auto& next = tokens.peek(1);
+      if (next.type == token_type::IDENTIFIER && next.text == "index") {
+        return new DefineIndex(tokens);
+      }
       return new Define(tokens);
     }
     case token_type::EMIT: {
@@ -191,6 +330,23 @@ Statement* parse_statement(TokenStream& tokens) {
   }
 }
 
+}  // anonymous namespace
+
+Statement* parse_statement(TokenStream& tokens) {
+  assert(tokens.has_next());
+  if (tokens.get().type == token_type::CLOSE_BRACE) {
+    return nullptr;
+  }
+  const int row = tokens.get().row;
+  const int col = tokens.get().col;
+  auto* stmt = parse_statement_kind(tokens);
+  if (stmt != nullptr) {
+    stmt->row_ = row;
+    stmt->col_ = col;
+  }
+  return stmt;
+}
+
 Emit::Emit(TokenStream& tokens) : Statement(ND_Emit) {
   expect_token(tokens.get(), token_type::EMIT);
   tokens.next();
@@ -204,21 +360,239 @@ Insert::Insert(TokenStream& tokens)
   expect_token(tokens.get(), token_type::IDENTIFIER);
   table_ = tokens.get().text;
   tokens.next();
-  expect_token(tokens.get(), token_type::OPEN_BRACE);
+  // insert <table> {row} or insert <table> [{row}, {row}, ...]
+  if (tokens.get().type != token_type::OPEN_BRACKET) {
+    expect_token(tokens.get(), token_type::OPEN_BRACE);
+  }
   value_ = parse_expr(tokens);
 }
 
-Scan::Scan(TokenStream& tokens)
-     : Statement(ND_Scan), key_stack_(nullptr), value_stack_(nullptr), tuple_stack_(nullptr), prefix_begin_(nullptr), prefix_end_(nullptr) {
+Scan::Scan(TokenStream& tokens, bool with_body)
+     : Statement(ND_Scan), where_(nullptr), blk_(nullptr), batch_size_(0), limit_(0), parallel_(false),
+       key_lower_(nullptr), key_upper_(nullptr), lower_inclusive_(false), upper_inclusive_(false),
+       point_lookup_(false),
+       prefix_begin_(nullptr), prefix_end_(nullptr), range_begin_(nullptr), range_end_(nullptr),
+       tuple_stack_(nullptr), batch_index_(nullptr), batch_keys_(nullptr), batch_values_(nullptr),
+       batch_mask_(nullptr), cursor_slot_(nullptr), lookup_value_(nullptr),
+       limit_count_(nullptr), index_prefix_(nullptr), index_begin_(nullptr), index_end_(nullptr) {
+  // scan <table> (, | as) <row> [where <expr>] [batch [<size>]] [limit <n>] { ... }
   expect_token(tokens.get(), token_type::SCAN);
   tokens.next();
   expect_token(tokens.get(), token_type::IDENTIFIER);
   table_ = tokens.get().text;
   tokens.next();
-  expect_token(tokens.get(), token_type::COMMA);
-  tokens.next();
+  if (tokens.get().type == token_type::IDENTIFIER && tokens.get().text == "as") {
+    tokens.next();
+  } else {
+    expect_token(tokens.get(), token_type::COMMA);
+    tokens.next();
+  }
+  expect_token(tokens.get(), token_type::IDENTIFIER);
   row_name_ = tokens.get().text;
   tokens.next();
+  if (tokens.get().type == token_type::IDENTIFIER && tokens.get().text == "where") {
+    tokens.next();
+    where_ = parse_expr(tokens);
+  }
+  if (tokens.get().type == token_type::IDENTIFIER && tokens.get().text == "batch") {
+    tokens.next();
+    batch_size_ = kDefaultBatchSize;
+    if (tokens.get().type == token_type::NUMBER) {
+      auto size = std::stoll(tokens.get().text);
+      if (size <= 0) {
+        throw std::runtime_error("batch size must be positive");
+      }
+      batch_size_ = static_cast<uint64_t>(size);
+      tokens.next();
+    }
+  }
+  if (tokens.get().type == token_type::IDENTIFIER && tokens.get().text == "limit") {
+    tokens.next();
+    expect_token(tokens.get(), token_type::NUMBER);
+    auto limit = std::stoll(tokens.get().text);
+    if (limit <= 0) {
+      throw std::runtime_error("scan limit must be positive");
+    }
+    limit_ = static_cast<uint64_t>(limit);
+    tokens.next();
+  }
+  if (with_body) {
+    expect_token(tokens.get(), token_type::OPEN_BRACE);
+    blk_ = new Block(tokens);
+  }
+}
+
+Aggregate::Aggregate(TokenStream& tokens)
+    : Statement(ND_Aggregate), scan_(nullptr), accumulator_words_(0),
+      table_(nullptr), key_stack_(nullptr), iter_stack_(nullptr), output_stack_(nullptr) {
+  // "aggregate" is checked by parse_statement
+  tokens.next();
+  scan_ = new Scan(tokens, false);
+  if (tokens.get().type == token_type::IDENTIFIER && tokens.get().text == "by") {
+    tokens.next();
+    group_by_.push_back(parse_expr(tokens));
+    while (tokens.get().type == token_type::COMMA) {
+      tokens.next();
+      group_by_.push_back(parse_expr(tokens));
+    }
+  }
+  expect_token(tokens.get(), token_type::OPEN_BRACE);
+  tokens.next();
+  while (tokens.get().type != token_type::CLOSE_BRACE) {
+    auto* expr = parse_expr(tokens);
+    auto* call = llvm::dyn_cast<FunctionCall>(expr);
+    auto* name = call ? llvm::dyn_cast<VariableReference>(call->parent_) : nullptr;
+    if (!name) {
+      delete expr;
+      throw std::runtime_error("aggregate function expected");
+    }
+    Term term{SUM, nullptr, accumulator_words_};
+    if (name->name_ == "sum") {
+      term.func = SUM;
+    } else if (name->name_ == "count") {
+      term.func = COUNT;
+    } else if (name->name_ == "min") {
+      term.func = MIN;
+    } else if (name->name_ == "max") {
+      term.func = MAX;
+    } else if (name->name_ == "avg") {
+      term.func = AVG;
+    } else {
+      std::string fname = name->name_;
+      delete expr;
+      throw std::runtime_error("unknown aggregate function: " + fname);
+    }
+    if (1 < call->args_.size() || (call->args_.empty() && term.func != COUNT)) {
+      delete expr;
+      throw std::runtime_error("aggregate function takes one argument");
+    }
+    if (!call->args_.empty()) {
+      term.arg = call->args_[0];
+      call->args_.clear();
+    }
+    delete expr;
+    accumulator_words_ += term.func == AVG ? 2 : 1;  // avg keeps sum and count
+    terms_.push_back(term);
+
+    if (tokens.get().type == token_type::CLOSE_BRACE) {
+      break;
+    }
+    expect_token(tokens.get(), token_type::COMMA);
+    tokens.next();
+  }
+  tokens.next();  // '}'
+  if (terms_.empty()) {
+    throw std::runtime_error("aggregate needs at least one function");
+  }
+  scan_->blk_ = new Block({new AggregateStep(this)});
+}
+
+namespace {
+
+void parse_join_keys(TokenStream& tokens, std::vector<Expression*>& keys) {
+  if (tokens.get().type != token_type::IDENTIFIER || tokens.get().text != "on") {
+    throw std::runtime_error("join needs 'on <expr>' for both inputs");
+  }
+  tokens.next();
+  keys.push_back(parse_expr(tokens));
+  while (tokens.get().type == token_type::COMMA) {
+    tokens.next();
+    keys.push_back(parse_expr(tokens));
+  }
+}
+
+}  // namespace
+
+Join::Join(TokenStream& tokens)
+    : Statement(ND_Join), build_(nullptr), probe_(nullptr), blk_(nullptr),
+      table_(nullptr), key_stack_(nullptr) {
+  // "join" is checked by parse_statement
+  tokens.next();
+  build_ = new Scan(tokens, false);
+  parse_join_keys(tokens, build_keys_);
+  if (tokens.get().type != token_type::IDENTIFIER || tokens.get().text != "with") {
+    throw std::runtime_error("join expects 'with scan ...' for the probe side");
+  }
+  tokens.next();
+  probe_ = new Scan(tokens, false);
+  parse_join_keys(tokens, probe_keys_);
+  if (build_keys_.size() != probe_keys_.size()) {
+    throw std::runtime_error("join key counts differ between inputs");
+  }
+  expect_token(tokens.get(), token_type::OPEN_BRACE);
+  blk_ = new Block(tokens);
+  build_->blk_ = new Block({new JoinStep(this, true)});
+  probe_->blk_ = new Block({new JoinStep(this, false)});
+}
+
+Sort::Sort(TokenStream& tokens)
+    : Statement(ND_Sort), scan_(nullptr), limit_(0), blk_(nullptr),
+      sorter_(nullptr), record_stack_(nullptr), order_stack_(nullptr) {
+  // "sort" is checked by parse_statement
+  tokens.next();
+  scan_ = new Scan(tokens, false);
+  if (tokens.get().type != token_type::IDENTIFIER || tokens.get().text != "by") {
+    throw std::runtime_error("sort needs 'by <expr>'");
+  }
+  do {
+    tokens.next();
+    keys_.push_back(parse_expr(tokens));
+    bool desc = false;
+    if (tokens.get().type == token_type::IDENTIFIER &&
+        (tokens.get().text == "asc" || tokens.get().text == "desc")) {
+      desc = tokens.get().text == "desc";
+      tokens.next();
+    }
+    descending_.push_back(desc);
+  } while (tokens.get().type == token_type::COMMA);
+  if (tokens.get().type == token_type::IDENTIFIER && tokens.get().text == "limit") {
+    tokens.next();
+    expect_token(tokens.get(), token_type::NUMBER);
+    auto limit = std::stoll(tokens.get().text);
+    if (limit <= 0) {
+      throw std::runtime_error("sort limit must be positive");
+    }
+    limit_ = static_cast<uint64_t>(limit);
+    tokens.next();
+  }
+  expect_token(tokens.get(), token_type::OPEN_BRACE);
+  blk_ = new Block(tokens);
+  scan_->blk_ = new Block({new SortStep(this)});
+}
+
+Parallel::Parallel(TokenStream& tokens)
+    : Statement(ND_Parallel), from_(nullptr), to_(nullptr), batch_(kDefaultBatch), partitioned_(false),
+      blk_(nullptr) {
+  // "parallel" is already taken by parse_statement
+  expect_token(tokens.get(), token_type::FOR);
+  tokens.next();
+  expect_token(tokens.get(), token_type::IDENTIFIER);
+  var_ = tokens.get().text;
+  tokens.next();
+  if (tokens.get().type != token_type::IDENTIFIER || tokens.get().text != "in") {
+    throw std::runtime_error("parallel for needs 'in <from> to <to>'");
+  }
+  tokens.next();
+  from_ = parse_expr(tokens);
+  if (tokens.get().type != token_type::IDENTIFIER || tokens.get().text != "to") {
+    throw std::runtime_error("parallel for needs 'in <from> to <to>'");
+  }
+  tokens.next();
+  to_ = parse_expr(tokens);
+  if (tokens.get().type == token_type::IDENTIFIER && tokens.get().text == "batch") {
+    tokens.next();
+    expect_token(tokens.get(), token_type::NUMBER);
+    auto batch = std::stoll(tokens.get().text);
+    if (batch <= 0) {
+      throw std::runtime_error("parallel batch must be positive");
+    }
+    batch_ = static_cast<uint64_t>(batch);
+    tokens.next();
+  }
+  if (tokens.get().type == token_type::IDENTIFIER && tokens.get().text == "partitioned") {
+    partitioned_ = true;
+    tokens.next();
+  }
   expect_token(tokens.get(), token_type::OPEN_BRACE);
   blk_ = new Block(tokens);
 }
@@ -0,0 +1,152 @@
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include "columnar.hpp"
+
+namespace reir {
+
+ColumnBuffer::~ColumnBuffer() {
+  std::free(data_);
+}
+
+ColumnBuffer::ColumnBuffer(ColumnBuffer&& o) noexcept
+    : data_(o.data_), size_(o.size_), capacity_(o.capacity_) {
+  o.data_ = nullptr;
+  o.size_ = o.capacity_ = 0;
+}
+
+ColumnBuffer& ColumnBuffer::operator=(ColumnBuffer&& o) noexcept {
+  if (this != &o) {
+    std::free(data_);
+    data_ = o.data_;
+    size_ = o.size_;
+    capacity_ = o.capacity_;
+    o.data_ = nullptr;
+    o.size_ = o.capacity_ = 0;
+  }
+  return *this;
+}
+
+void ColumnBuffer::reserve(size_t n) {
+  if (n <= capacity_) {
+    return;
+  }
+  size_t capacity = capacity_ ? capacity_ : kAlignment;
+  while (capacity < n) {
+    capacity *= 2;
+  }
+  void* p = nullptr;
+  if (posix_memalign(&p, kAlignment, capacity) != 0) {
+    throw std::bad_alloc();
+  }
+  // padding bytes are zero, as Arrow expects
+  std::memset(p, 0, capacity);
+  if (data_) {
+    std::memcpy(p, data_, size_);
+    std::free(data_);
+  }
+  data_ = static_cast<uint8_t*>(p);
+  capacity_ = capacity;
+}
+
+void ColumnBuffer::append(const void* src, size_t len) {
+  reserve(size_ + len);
+  std::memcpy(data_ + size_, src, len);
+  size_ += len;
+}
+
+void ColumnBuffer::set_bit(size_t i, bool value) {
+  const size_t bytes = i / 8 + 1;
+  if (size_ < bytes) {
+    reserve(bytes);
+    std::memset(data_ + size_, 0, bytes - size_);
+    size_ = bytes;
+  }
+  if (value) {
+    data_[i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+  } else {
+    data_[i / 8] &= static_cast<uint8_t>(~(1u << (i % 8)));
+  }
+}
+
+ColumnarSink::ColumnarSink(Callback cb, uint64_t batch_rows)
+    : cb_(std::move(cb)), batch_rows_(batch_rows), layout_(nullptr) {
+  if (batch_rows_ == 0) {
+    throw std::runtime_error("batch must hold at least one row");
+  }
+  batch_.length = 0;
+}
+
+void ColumnarSink::reset(const EmitLayout& layout) {
+  layout_ = &layout;
+  batch_.length = 0;
+  batch_.columns.resize(layout.fields.size());
+  for (size_t i = 0; i < layout.fields.size(); ++i) {
+    auto& col = batch_.columns[i];
+    col.type = layout.fields[i].type;
+    col.null_count = 0;
+    col.validity.clear();
+    col.values.clear();
+    col.data.clear();
+    if (col.type == ColumnType::UTF8) {
+      int32_t zero = 0;
+      col.values.append(&zero, sizeof(zero));
+    }
+  }
+}
+
+bool ColumnarSink::append(const EmitLayout& layout, const char* row) {
+  if (layout_ != &layout) {
+    // another emit statement, a batch has a single schema
+    if (!flush()) {
+      return false;
+    }
+    reset(layout);
+  }
+  const uint64_t r = batch_.length;
+  for (size_t i = 0; i < layout.fields.size(); ++i) {
+    const auto& field = layout.fields[i];
+    auto& col = batch_.columns[i];
+    const char* src = row + field.offset;
+    col.validity.set_bit(r, true);  // emitted values are never null yet
+    switch (field.type) {
+      case ColumnType::INT64:
+      case ColumnType::DOUBLE:
+        col.values.append(src, 8);
+        break;
+      case ColumnType::BOOL:
+        col.values.set_bit(r, (*reinterpret_cast<const uint8_t*>(src) & 1) != 0);
+        break;
+      case ColumnType::UTF8: {
+        const char* str;
+        int64_t len;
+        std::memcpy(&str, src, sizeof(str));
+        std::memcpy(&len, src + sizeof(str), sizeof(len));
+        col.data.append(str, static_cast<size_t>(len));
+        if (INT32_MAX < col.data.size()) {
+          throw std::runtime_error("string column exceeds int32 offsets");
+        }
+        int32_t end = static_cast<int32_t>(col.data.size());
+        col.values.append(&end, sizeof(end));
+        break;
+      }
+    }
+  }
+  if (++batch_.length == batch_rows_) {
+    return flush();
+  }
+  return true;
+}
+
+bool ColumnarSink::flush() {
+  if (layout_ == nullptr || batch_.length == 0) {
+    return true;
+  }
+  const bool ret = cb_(batch_);
+  reset(*layout_);
+  return ret;
+}
+
+}  // namespace reir
@@ -0,0 +1,97 @@
+#ifndef REIR_COLUMNAR_HPP_
+#define REIR_COLUMNAR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace reir {
+
+// column buffers follow the Arrow memory layout, so a consumer can hand them
+// to Arrow without copying: 64 byte aligned and padded buffers, validity
+// bitmaps with LSB first bit order, int32 offsets for strings.
+enum class ColumnType {
+  INT64,
+  DOUBLE,
+  BOOL,
+  UTF8,
+};
+
+class ColumnBuffer {
+ public:
+  static constexpr size_t kAlignment = 64;
+
+  ColumnBuffer() : data_(nullptr), size_(0), capacity_(0) {}
+  ~ColumnBuffer();
+  ColumnBuffer(ColumnBuffer&& o) noexcept;
+  ColumnBuffer& operator=(ColumnBuffer&& o) noexcept;
+  ColumnBuffer(const ColumnBuffer&) = delete;
+  ColumnBuffer& operator=(const ColumnBuffer&) = delete;
+
+  const uint8_t* data() const { return data_; }
+  uint8_t* data() { return data_; }
+  size_t size() const { return size_; }
+
+  void append(const void* src, size_t len);
+  // bit i of the buffer, the buffer grows in whole bytes
+  void set_bit(size_t i, bool value);
+  void clear() { size_ = 0; }
+
+ private:
+  void reserve(size_t n);
+
+  uint8_t* data_;
+  size_t size_;
+  size_t capacity_;
+};
+
+struct Column {
+  ColumnType type;
+  uint64_t null_count;
+  ColumnBuffer validity;
+  ColumnBuffer values;   // int64 / double values, bits for bool, length + 1 int32 offsets for utf8
+  ColumnBuffer data;     // utf8 bytes
+};
+
+struct ColumnBatch {
+  uint64_t length;
+  std::vector<Column> columns;
+};
+
+// where each field of an emitted row is, built once per emit statement at codegen time
+struct EmitLayout {
+  struct Field {
+    ColumnType type;
+    uint64_t offset;  // a string field is {const char*, int64 length}
+  };
+  std::vector<Field> fields;
+};
+
+// collects emitted rows into column batches and hands every full batch to the callback
+class ColumnarSink {
+ public:
+  static constexpr uint64_t kDefaultBatchRows = 4096;
+
+  // returning false from the callback cancels the query.
+  // the batch is reused after the callback returns.
+  using Callback = std::function<bool(const ColumnBatch&)>;
+
+  explicit ColumnarSink(Callback cb, uint64_t batch_rows = kDefaultBatchRows);
+
+  bool append(const EmitLayout& layout, const char* row);
+  // hands over the rows that did not fill a batch
+  bool flush();
+
+ private:
+  void reset(const EmitLayout& layout);
+
+  Callback cb_;
+  uint64_t batch_rows_;
+  const EmitLayout* layout_;
+  ColumnBatch batch_;
+};
+
+}  // namespace reir
+
+#endif  // REIR_COLUMNAR_HPP_
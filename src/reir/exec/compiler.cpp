@@ -1,6 +1,7 @@
 
 #include <chrono>
 #include <random>
+#include <sstream>
 #include <llvm/Support/DynamicLibrary.h>
 
 #include <llvm/ADT/STLExtras.h>
@@ -9,15 +10,23 @@
 #include <llvm/ExecutionEngine/RTDyldMemoryManager.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/IR/Constants.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Transforms/Vectorize.h>
 
 #include "compiler.hpp"
 #include "tuple.hpp"
 #include "reir/db/metadata.hpp"
 #include "reir/engine/db_handle.hpp"
+#include "reir/engine/stats.hpp"
+#include "reir/engine/trace.hpp"
 
 #include "compiler_context.hpp"
+#include "explain.hpp"
+#include "hash_table.hpp"
+#include "jit_debug.hpp"
+#include "sorter.hpp"
 
-#include "leveldb_compiler.hpp"
 #include "db_interface.hpp"
 #include "llvm_util.hpp"
 #include "ast_statement.hpp"
@@ -26,13 +35,22 @@
 #define OFFSET_OF(struct_t, member) (reinterpret_cast<std::uint64_t>(&reinterpret_cast<struct_t*>(0)->member) / sizeof(void*))
 
 namespace {
+
+// only evaluated when debug traces are compiled in
+template <typename T>
+std::string stringify(const T& v) {
+  std::stringstream ss;
+  ss << v;
+  return ss.str();
+}
+
 extern "C" {
 
 size_t get_length(const std::string& s) {
   return s.length();
 }
 const char* get_data(const std::string& s) {
-  std::cout << "getting data(" << s << ")" << std::endl;
+  REIR_TRACE_DEBUG("get_data(%s)", s.c_str());
   return s.data();
 }
 
@@ -48,8 +66,15 @@ void print_string(const string_struct& s) {
 
 std::random_device rd;
 int64_t rand_int(const int64_t from, const int64_t to) {
+  // a generator per thread, reading the device on every call is a syscall and
+  // parallel workers would share it
+  thread_local std::mt19937_64 engine(rd());
   std::uniform_int_distribution<int64_t> dist(from, to);
-  return dist(rd);
+  return dist(engine);
+}
+
+void stats_procedure(const string_struct& name) {
+  reir::stats_set_procedure(std::string(name.data, name.length));
 }
 
 void print_int(int64_t s) {
@@ -67,6 +92,18 @@ void emit(reir::CompilerContext* ctx, char* buff, size_t len) {
   ctx->get_output(buff, len);
 }
 
+void emit_columns(reir::CompilerContext* ctx, const reir::EmitLayout* layout, char* buff) {
+  ctx->get_columns(*layout, buff);
+}
+
+void partial_output_begin(reir::CompilerContext* ctx) {
+  ctx->begin_partial_output();
+}
+
+void partial_output_end(reir::CompilerContext* ctx) {
+  ctx->end_partial_output();
+}
+
 void tmp(reir::node::Node* a) {
   std::cout << "a " << &a << ")" << std::endl;
 }
@@ -76,7 +113,7 @@ void debug_out() {
 }
 
 const reir::MaybeValue* value_at(const std::vector<reir::MaybeValue>& v, size_t idx) {
-  std::cout << "key may be: " << v[idx] << std::endl;
+  REIR_TRACE_DEBUG("value_at(%zu): %s", idx, stringify(v[idx]).c_str());
   return &v[idx];
 }
 
@@ -237,6 +274,72 @@ void Compiler::init_functions(CompilerContext& ctx) {
     }
     ctx.functions_table_["malloc"] = malloc_func;
   }
+  {  // hash table for aggregation and joins, see hash_table.hpp
+    auto* i64 = llvm::Type::getInt64Ty(ctx.ctx_);
+    auto* i64p = llvm::Type::getInt64PtrTy(ctx.ctx_);
+    ctx.functions_table_["__hash_table_create"] =
+        llvm::Function::Create(llvm::FunctionType::get(i64p, {i64, i64}, false),
+                               llvm::Function::ExternalLinkage,
+                               "reir_hash_table_create",
+                               ctx.mod_.get());
+    ctx.functions_table_["__hash_table_insert"] =
+        llvm::Function::Create(llvm::FunctionType::get(i64p, {i64p, i64, i64p}, false),
+                               llvm::Function::ExternalLinkage,
+                               "reir_hash_table_insert",
+                               ctx.mod_.get());
+    ctx.functions_table_["__hash_table_next"] =
+        llvm::Function::Create(llvm::FunctionType::get(i64p, {i64p, i64p}, false),
+                               llvm::Function::ExternalLinkage,
+                               "reir_hash_table_next",
+                               ctx.mod_.get());
+    ctx.functions_table_["__hash_table_destroy"] =
+        llvm::Function::Create(llvm::FunctionType::get(llvm::Type::getVoidTy(ctx.ctx_), {i64p}, false),
+                               llvm::Function::ExternalLinkage,
+                               "reir_hash_table_destroy",
+                               ctx.mod_.get());
+  }
+  {  // sorter for sort, see sorter.hpp
+    auto* i64 = llvm::Type::getInt64Ty(ctx.ctx_);
+    auto* i64p = llvm::Type::getInt64PtrTy(ctx.ctx_);
+    auto* void_ty = llvm::Type::getVoidTy(ctx.ctx_);
+    ctx.functions_table_["__sorter_create"] =
+        llvm::Function::Create(llvm::FunctionType::get(i64p, {i64, i64, i64, i64}, false),
+                               llvm::Function::ExternalLinkage,
+                               "reir_sorter_create",
+                               ctx.mod_.get());
+    ctx.functions_table_["__sorter_add"] =
+        llvm::Function::Create(llvm::FunctionType::get(void_ty, {i64p, i64p}, false),
+                               llvm::Function::ExternalLinkage,
+                               "reir_sorter_add",
+                               ctx.mod_.get());
+    ctx.functions_table_["__sorter_finish"] =
+        llvm::Function::Create(llvm::FunctionType::get(void_ty, {i64p}, false),
+                               llvm::Function::ExternalLinkage,
+                               "reir_sorter_finish",
+                               ctx.mod_.get());
+    ctx.functions_table_["__sorter_next"] =
+        llvm::Function::Create(llvm::FunctionType::get(llvm::Type::getInt1Ty(ctx.ctx_), {i64p, i64p}, false),
+                               llvm::Function::ExternalLinkage,
+                               "reir_sorter_next",
+                               ctx.mod_.get());
+    ctx.functions_table_["__sorter_destroy"] =
+        llvm::Function::Create(llvm::FunctionType::get(void_ty, {i64p}, false),
+                               llvm::Function::ExternalLinkage,
+                               "reir_sorter_destroy",
+                               ctx.mod_.get());
+  }
+  {  // init free
+    llvm::Function* free_func =
+        llvm::Function::Create(
+            llvm::FunctionType::get(llvm::Type::getVoidTy(ctx.ctx_),
+                                    {llvm::Type::getInt8PtrTy(ctx.ctx_)},
+                                    false),
+            llvm::Function::ExternalLinkage,
+            "free",
+            ctx.mod_.get());
+    free_func->arg_begin()->setName("ptr");
+    ctx.functions_table_["free"] = free_func;
+  }
 
   {
     std::vector<llvm::Type*> args{
@@ -315,6 +418,16 @@ void Compiler::init_functions(CompilerContext& ctx) {
     }
     ctx.functions_table_["rand"] = rand_int;
   }
+  {  // stats_procedure
+    ctx.functions_table_["stats_procedure"] =
+        llvm::Function::Create(
+            llvm::FunctionType::get(llvm::Type::getVoidTy(ctx.ctx_),
+                                    {ctx.type_table_["string"]->getPointerTo()},
+                                    false),
+            llvm::Function::ExternalLinkage,
+            "stats_procedure",
+            ctx.mod_.get());
+  }
   {  // emit
     llvm::Function* emit_func =
         llvm::Function::Create(
@@ -334,13 +447,49 @@ void Compiler::init_functions(CompilerContext& ctx) {
     }
     ctx.functions_table_["__emit_func"] = emit_func;
   }
+  {  // emit into column batches
+    ctx.functions_table_["__emit_columns_func"] =
+        llvm::Function::Create(
+            llvm::FunctionType::get(llvm::Type::getVoidTy(ctx.ctx_),
+                                    {llvm::Type::getInt64PtrTy(ctx.ctx_),  // ctx
+                                     llvm::Type::getInt64PtrTy(ctx.ctx_),  // layout
+                                     llvm::Type::getInt8PtrTy(ctx.ctx_)},  // row
+                                    false),
+            llvm::Function::ExternalLinkage,
+            "__emit_columns_func",
+            ctx.mod_.get());
+  }
+  // rows of a parallel body are buffered per thread and merged when it returns
+  for (const auto* name : {"__partial_output_begin", "__partial_output_end"}) {
+    ctx.functions_table_[name] =
+        llvm::Function::Create(
+            llvm::FunctionType::get(llvm::Type::getVoidTy(ctx.ctx_),
+                                    {llvm::Type::getInt64PtrTy(ctx.ctx_)},  // ctx
+                                    false),
+            llvm::Function::ExternalLinkage,
+            name,
+            ctx.mod_.get());
+  }
 }
 
+namespace {
+
+// hands every object the JIT loads to the profiler and debugger listeners
+void notify_loaded(llvm::orc::RTDyldObjectLinkingLayer::ObjHandleT,
+                   const llvm::orc::RTDyldObjectLinkingLayer::ObjectPtr& obj,
+                   const llvm::RuntimeDyld::LoadedObjectInfo& info) {
+  for (auto* listener : jit_event_listeners()) {
+    listener->NotifyObjectEmitted(*obj->getBinary(), info);
+  }
+}
+
+}  // anonymous namespace
+
 Compiler::Compiler()
-  : target_machine_(llvm::EngineBuilder().selectTarget()),
+  : target_machine_(llvm::EngineBuilder().setMCPU(llvm::sys::getHostCPUName()).selectTarget()),
     data_layout_(target_machine_->createDataLayout()),
-    obj_layer_([]() { return std::make_shared<llvm::SectionMemoryManager>(); }),
-    compile_layer_(obj_layer_, llvm::orc::SimpleCompiler(*target_machine_)),
+    obj_layer_([]() { return std::make_shared<llvm::SectionMemoryManager>(); }, notify_loaded),
+    compile_layer_(obj_layer_, EmitCompiler(*target_machine_, &explain_)),
     optimize_layer_(compile_layer_,
                     [this](std::shared_ptr<llvm::Module> M) {
                       return optimize_module(std::move(M));
@@ -351,32 +500,117 @@ Compiler::Compiler()
              [](llvm::Function &F) { return std::set<llvm::Function*>({&F}); },
              *CompileCallbackManager,
              llvm::orc::createLocalIndirectStubsManagerBuilder(
-                 target_machine_->getTargetTriple())) {
+                 target_machine_->getTargetTriple())),
+    source_("input.rir"),
+    explain_(nullptr) {
 
   llvm::sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
 }
 
+namespace {
+
+struct NamedPass {
+  const char* name;  // as explain reports it
+  llvm::Pass* (*create)();
+};
+
+const NamedPass kPipeline[] = {
+    {"instcombine", []() -> llvm::Pass* { return llvm::createInstructionCombiningPass(); }},
+    {"reassociate", []() -> llvm::Pass* { return llvm::createReassociatePass(); }},
+    {"gvn", []() -> llvm::Pass* { return llvm::createGVNPass(); }},
+    {"simplifycfg", []() -> llvm::Pass* { return llvm::createCFGSimplificationPass(); }},
+    {"memcpyopt", []() -> llvm::Pass* { return llvm::createMemCpyOptPass(); }},
+    // split scan row structs so predicates work on registers
+    {"sroa", []() -> llvm::Pass* { return llvm::createSROAPass(); }},
+    {"mem2reg", []() -> llvm::Pass* { return llvm::createPromoteMemoryToRegisterPass(); }},
+    // batch scans lower to counted loops, let the vectorizers use the host ISA on them
+    {"instcombine", []() -> llvm::Pass* { return llvm::createInstructionCombiningPass(); }},
+    {"loop-rotate", []() -> llvm::Pass* { return llvm::createLoopRotatePass(); }},
+    {"loop-vectorize", []() -> llvm::Pass* { return llvm::createLoopVectorizePass(); }},
+    {"slp-vectorizer", []() -> llvm::Pass* { return llvm::createSLPVectorizerPass(); }},
+    {"instcombine", []() -> llvm::Pass* { return llvm::createInstructionCombiningPass(); }},
+    {"simplifycfg", []() -> llvm::Pass* { return llvm::createCFGSimplificationPass(); }},
+};
+
+std::string print_module(const llvm::Module& m) {
+  std::string s;
+  llvm::raw_string_ostream os(s);
+  os << m;
+  return os.str();
+}
+
+}  // anonymous namespace
+
 std::shared_ptr<llvm::Module> Compiler::optimize_module(std::shared_ptr<llvm::Module> M) {
-  // Create a function pass manager.
-  auto FPM = llvm::make_unique<llvm::legacy::FunctionPassManager>(M.get());
-
-  // Add some optimizations.
-  FPM->add(llvm::createInstructionCombiningPass());
-  FPM->add(llvm::createReassociatePass());
-  FPM->add(llvm::createGVNPass());
-  FPM->add(llvm::createCFGSimplificationPass());
-  FPM->add(llvm::createMemCpyOptPass());
-  FPM->add(llvm::createPromoteMemoryToRegisterPass());
-  FPM->doInitialization();
-
-  // Run the optimizations over all functions in the module being added to
-  // the JIT.
-  for (auto &F : *M)
-    FPM->run(F);
-  // llvm::outs() << *M << "\n";  // see optimized IR
+  Explain* explain = explain_;
+  if (explain != nullptr && explain->ir()) {
+    explain->add_ir_before(print_module(*M));
+  }
+  if (explain == nullptr) {
+    // Create a function pass manager.
+    auto FPM = llvm::make_unique<llvm::legacy::FunctionPassManager>(M.get());
+    FPM->add(llvm::createTargetTransformInfoWrapperPass(target_machine_->getTargetIRAnalysis()));
+    for (const auto& pass : kPipeline) {
+      FPM->add(pass.create());
+    }
+    FPM->doInitialization();
+
+    // Run the optimizations over all functions in the module being added to
+    // the JIT.
+    for (auto &F : *M)
+      FPM->run(F);
+    return M;
+  }
+  // one pass at a time to time each of them, they are all function passes, so
+  // the result is the same
+  for (const auto& pass : kPipeline) {
+    ExplainTimer timer(explain, std::string("optimize ") + pass.name);
+    llvm::legacy::FunctionPassManager FPM(M.get());
+    FPM.add(llvm::createTargetTransformInfoWrapperPass(target_machine_->getTargetIRAnalysis()));
+    FPM.add(pass.create());
+    FPM.doInitialization();
+    for (auto &F : *M)
+      FPM.run(F);
+    FPM.doFinalization();
+  }
+  if (explain->ir()) {
+    explain->add_ir_after(print_module(*M));
+  }
   return M;
 }
 
+llvm::object::OwningBinary<llvm::object::ObjectFile> EmitCompiler::operator()(llvm::Module& m) {
+  Explain* explain = *explain_;
+  if (explain == nullptr) {
+    return compiler_(m);
+  }
+  llvm::object::OwningBinary<llvm::object::ObjectFile> obj;
+  {
+    ExplainTimer timer(explain, "emit machine code");
+    obj = compiler_(m);
+  }
+  if (const auto* o = obj.getBinary()) {
+    uint64_t size = 0;
+    for (const auto& section : o->sections()) {
+      if (section.isText()) {
+        size += section.getSize();
+      }
+    }
+    explain->add_code(size);
+  }
+  if (explain->assembly()) {
+    // once more as text, simpler than setting up a disassembler for the object
+    llvm::SmallVector<char, 0> buffer;
+    llvm::raw_svector_ostream os(buffer);
+    llvm::legacy::PassManager pm;
+    if (!target_machine_.addPassesToEmitFile(pm, os, llvm::TargetMachine::CGFT_AssemblyFile)) {
+      pm.run(m);
+      explain->add_assembly(std::string(buffer.begin(), buffer.end()));
+    }
+  }
+  return obj;
+}
+
 Compiler::ModuleHandle Compiler::add_module(std::unique_ptr<llvm::Module> M) {
   // Build our symbol resolver:
   // Lambda 1: Look back into the JIT itself to find symbols that are part of
@@ -507,7 +741,6 @@ void insert_codegen(CompilerContext& ctx, DBInterface& dbi, MetaData& md, node::
     }
 
     // serialize key
-    size_t offset = prefix.size();
     sc.each_attr([&](size_t i, const Attribute& attr) {
         if (!attr.is_key()) { return; }
         if (attr.type().is_integer()) {
@@ -515,8 +748,7 @@ void insert_codegen(CompilerContext& ctx, DBInterface& dbi, MetaData& md, node::
           std::vector<llvm::Expression*> args{values, ctx.builder_.getInt64(i)};
           std::vector<llvm::Expression*> maybe_value{ctx.builder_.CreateCall(value_at_func, args)};
           auto* v = ctx.builder_.CreateCall(value_int_func, maybe_value);
-          emit_value_cell_serializer(ctx, keytype, key, v, offset);
-          offset += sizeof(int64_t);
+          emit_value_cell_serializer(ctx, keytype, key, v, prefix.size() + sc.key_offset(i));
         } else {
           // other type key
           throw std::runtime_error("not implemented yet");
@@ -719,23 +951,53 @@ void init_types(CompilerContext& ctx) {
 void Compiler::compile(CompilerContext& ctx, DBInterface& dbi, MetaData& md, node::Node* ast) {
   init_types(ctx);
   init_functions(ctx);
-  ast->analyze(ctx);
+  {
+    ExplainTimer timer(explain_, "analyze");
+    ast->analyze(ctx);
+  }
 
   llvm::BasicBlock *bb = llvm::BasicBlock::Create(ctx.ctx_, "entry_jit", ctx.func_);
   ctx.builder_.SetInsertPoint(bb);
+  ctx.builder_.SetCurrentDebugLocation(llvm::DebugLoc());
+  if (jit_profiling_enabled()) {
+    ctx.lines_.reset(new SourceLines(*ctx.mod_, source_));
+  }
 
   llvm::sys::DynamicLibrary::AddSymbol("print_int", (void*)&print_int);
   llvm::sys::DynamicLibrary::AddSymbol("print_string", (void*)&print_string);
   llvm::sys::DynamicLibrary::AddSymbol("rand_int", (int64_t*)&rand_int);
+  llvm::sys::DynamicLibrary::AddSymbol("stats_procedure", (void*)&stats_procedure);
   llvm::sys::DynamicLibrary::AddSymbol("__emit_func", (void*)&emit);
+  llvm::sys::DynamicLibrary::AddSymbol("__emit_columns_func", (void*)&emit_columns);
+  llvm::sys::DynamicLibrary::AddSymbol("__partial_output_begin", (void*)&partial_output_begin);
+  llvm::sys::DynamicLibrary::AddSymbol("__partial_output_end", (void*)&partial_output_end);
+  llvm::sys::DynamicLibrary::AddSymbol("reir_hash_table_create", (void*)&reir_hash_table_create);
+  llvm::sys::DynamicLibrary::AddSymbol("reir_hash_table_insert", (void*)&reir_hash_table_insert);
+  llvm::sys::DynamicLibrary::AddSymbol("reir_hash_table_next", (void*)&reir_hash_table_next);
+  llvm::sys::DynamicLibrary::AddSymbol("reir_hash_table_destroy", (void*)&reir_hash_table_destroy);
+  llvm::sys::DynamicLibrary::AddSymbol("reir_sorter_create", (void*)&reir_sorter_create);
+  llvm::sys::DynamicLibrary::AddSymbol("reir_sorter_add", (void*)&reir_sorter_add);
+  llvm::sys::DynamicLibrary::AddSymbol("reir_sorter_finish", (void*)&reir_sorter_finish);
+  llvm::sys::DynamicLibrary::AddSymbol("reir_sorter_next", (void*)&reir_sorter_next);
+  llvm::sys::DynamicLibrary::AddSymbol("reir_sorter_destroy", (void*)&reir_sorter_destroy);
 
   auto* whole_block = reinterpret_cast<node::Block*>(ast);
-  whole_block->each_statement([&](const node::Statement* n) -> void {
-    n->alloca_stack(ctx);
-  });
+  {
+    ExplainTimer timer(explain_, "alloca");
+    whole_block->each_statement([&](const node::Statement* n) -> void {
+      n->alloca_stack(ctx);
+    });
+  }
 
-  whole_block->codegen(ctx);
-  ctx.builder_.CreateRet(ctx.builder_.getInt1(true));
+  {
+    ExplainTimer timer(explain_, "codegen");
+    whole_block->codegen(ctx);
+    ctx.builder_.CreateRet(ctx.builder_.getInt1(true));
+    if (ctx.lines_) {
+      ctx.lines_->finish();
+      ctx.lines_.reset();
+    }
+  }
 #ifndef NDEBUG
   ctx.dump();
 #endif
@@ -746,7 +1008,23 @@ void Compiler::compile_and_exec(DBInterface& dbi, MetaData& md, node::Node* ast)
   compile_and_exec(ctx, dbi, md, ast);
 }
 
+namespace {
+
+// finishes the sink however compile_and_exec is left, a consumer waiting for
+// the end of the rows would hang on a compile error or a failed procedure
+struct SinkFinisher {
+  ResultSink* sink;
+  ~SinkFinisher() {
+    if (sink) {
+      sink->finish();
+    }
+  }
+};
+
+}  // anonymous namespace
+
 void Compiler::compile_and_exec(CompilerContext& ctx, DBInterface& dbi, MetaData& md, node::Node* ast) {
+  SinkFinisher finisher{ctx.get_sink()};
   if (ast == nullptr) {
     return;
   }
@@ -758,11 +1036,17 @@ void Compiler::compile_and_exec(CompilerContext& ctx, DBInterface& dbi, MetaData
   auto start_time = std::chrono::steady_clock::now();
   compile(ctx, dbi, md, ast);
 
-  auto handle = add_module(std::move(ctx.mod_));
-  ctx.init();
+  ModuleHandle handle;
+  exec_func ret;
+  {
+    ExplainTimer timer(explain_, "add to jit");
+    handle = add_module(std::move(ctx.mod_));
+    ctx.init();
 
-  auto ExprSymbol = this->find_symbol(ctx.get_name());
-  assert(ExprSymbol && "Function not found");
+    auto ExprSymbol = this->find_symbol(ctx.get_name());
+    assert(ExprSymbol && "Function not found");
+    ret = (exec_func)llvm::cantFail(ExprSymbol.getAddress());
+  }
 
 #ifndef NDEBUG
   auto compiled_time = std::chrono::steady_clock::now();
@@ -771,13 +1055,17 @@ void Compiler::compile_and_exec(CompilerContext& ctx, DBInterface& dbi, MetaData
             << " sec.\n";
 #endif
 
-  auto ret = (exec_func)llvm::cantFail(ExprSymbol.getAddress());
   if (ret == nullptr) {
     std::cout << "failed to compile " << std::endl;
     cantFail(CODLayer.removeModule(handle));
     return;
   }
-  bool a = ret(ast);
+  bool a;
+  {
+    // optimize and emit of every function happen in here, on its first call
+    ExplainTimer timer(explain_, "execute");
+    a = ret(ast);
+  }
 
 #ifndef NDEBUG
   auto executed_time = std::chrono::steady_clock::now();
@@ -785,6 +1073,17 @@ void Compiler::compile_and_exec(CompilerContext& ctx, DBInterface& dbi, MetaData
   std::cout << "executed in " << executed_duration << " sec." << std::endl;
   std::cout << "returns: " << a << std::endl;
 #endif
+#ifdef REIR_PROFILE_STATEMENTS
+  ctx.profile().print(std::cout);
+#endif
+  if (ctx.get_columnar_sink()) {
+    ctx.get_columnar_sink()->flush();
+  }
+  if (ctx.get_sink() || ctx.get_columnar_sink()) {
+    // rows went to the sink as they were emitted
+    cantFail(CODLayer.removeModule(handle));
+    return;
+  }
   std::cout << "emitted values: ";
   std::vector<RawRow>& outputs = ctx.outputs_;
   for (int i = 0; i < outputs.size(); ++i) {
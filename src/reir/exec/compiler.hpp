@@ -44,6 +44,20 @@ class Node;
 class MetaData;
 class DBInterface;
 class CompilerContext;
+class Explain;
+
+// SimpleCompiler, timed and sized when explaining
+class EmitCompiler {
+ public:
+  EmitCompiler(llvm::TargetMachine& tm, Explain* const* explain)
+      : compiler_(tm), target_machine_(tm), explain_(explain) {}
+  llvm::object::OwningBinary<llvm::object::ObjectFile> operator()(llvm::Module& m);
+
+ private:
+  llvm::orc::SimpleCompiler compiler_;
+  llvm::TargetMachine& target_machine_;
+  Explain* const* explain_;  // the one the compiler has now, usually nullptr
+};
 
 class Compiler {
   void init_functions(CompilerContext& ctx);
@@ -54,9 +68,11 @@ class Compiler {
   llvm::DataLayout data_layout_;
   llvm::orc::RTDyldObjectLinkingLayer obj_layer_;
   std::unique_ptr<llvm::orc::JITCompileCallbackManager> CompileCallbackManager;
-  llvm::orc::IRCompileLayer<decltype(obj_layer_), llvm::orc::SimpleCompiler> compile_layer_;
+  llvm::orc::IRCompileLayer<decltype(obj_layer_), EmitCompiler> compile_layer_;
   llvm::orc::IRTransformLayer<decltype(compile_layer_), OptimizeFunction> optimize_layer_;
   llvm::orc::CompileOnDemandLayer<decltype(optimize_layer_)> CODLayer;
+  std::string source_;
+  Explain* explain_;
 
  public:
   using ModuleHandle = decltype(CODLayer)::ModuleHandleT;
@@ -72,6 +88,16 @@ class Compiler {
     return target_machine_.get();
   }
 
+  // the file line tables of the generated code point into, when profiling it
+  void set_source(const std::string& name) {
+    source_ = name;
+  }
+
+  // the compile phases of what runs until it is reset to nullptr are added to explain
+  void set_explain(Explain* explain) {
+    explain_ = explain;
+  }
+
   ModuleHandle add_module(std::unique_ptr<llvm::Module> m);
   llvm::JITSymbol find_symbol(const std::string& name);
 
@@ -2,16 +2,36 @@
 // Created by kumagi on 18/06/15.
 //
 #include <llvm/ADT/STLExtras.h>
+#include <llvm/IR/Intrinsics.h>
 #include <llvm/IR/Module.h>
+#include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetMachine.h>
 #include "compiler_context.hpp"
 #include "db_interface.hpp"
-#include "debug.hpp"
+#include "jit_debug.hpp"
+#include "llvm_util.hpp"
 #include "reir/exec/llvm_environment.hpp"
+#include "reir/engine/attempt.hpp"
+#include "reir/engine/trace.hpp"
 #include "compiler.hpp"
 
 namespace reir {
 
+namespace {
+
+// only evaluated when debug traces are compiled in
+template <typename T>
+std::string print_ir(const T* v) {
+  std::string s;
+  llvm::raw_string_ostream os(s);
+  v->print(os);
+  return os.str();
+}
+
+// rows of the parallel body this thread is running, nullptr outside of one
+thread_local std::vector<RawRow>* partial_outputs = nullptr;
+}  // anonymous namespace
+
 CompilerContext::CompilerContext(Compiler& c, DBInterface* dbi, MetaData* md)
     : ctx_(),
       mod_(new llvm::Module("global_module", ctx_)),
@@ -19,7 +39,12 @@ CompilerContext::CompilerContext(Compiler& c, DBInterface* dbi, MetaData* md)
       dbi_(dbi),
       md_(md),
       target_machine_(c.get_target_machine()),
-      in_txn_(false) {
+      in_txn_(false),
+      cancelled_(false),
+      output_limit_(0),
+      emitted_(0),
+      sink_(nullptr),
+      columnar_sink_(nullptr) {
   func_ = llvm::Function::Create(
               llvm::FunctionType::get(llvm::Type::getInt1Ty(ctx_),
                                       {llvm::Type::getInt64PtrTy(ctx_)},
@@ -31,6 +56,9 @@ CompilerContext::CompilerContext(Compiler& c, DBInterface* dbi, MetaData* md)
   iter->setName("ast");
   mod_->setDataLayout(target_machine_->createDataLayout());
   loop_ = nullptr;
+  inner_cursors_ = nullptr;
+  proc_ = nullptr;
+  parallel_bodies_ = 0;
 
   // default types
   analyze_type_table_.emplace("integer", new node::PrimaryType(node::type_id::INTEGER));
@@ -61,10 +89,55 @@ CompilerContext::~CompilerContext() {
   }
 }
 
-CursorBase* CompilerContext::get_cursor(llvm::Value* from_prefix, llvm::Value* from_len,
+CursorBase* CompilerContext::get_cursor(const Schema& table, llvm::Value* from_prefix, llvm::Value* from_len,
                          llvm::Value* to_prefix, llvm::Value* to_len) {
-  return dbi_->emit_get_cursor(*this, from_prefix, from_len, to_prefix, to_len);
+  return dbi_->emit_get_cursor(*this, table, from_prefix, from_len, to_prefix, to_len);
+}
+
+void CompilerContext::set_location(int row, int col) {
+  if (lines_) {
+    lines_->set_location(builder_, row, col);
+  }
+}
+
+#ifdef REIR_PROFILE_STATEMENTS
+namespace {
+
+// rdtsc on x86
+llvm::Value* read_cycles(CompilerContext& c) {
+  auto* f = llvm::Intrinsic::getDeclaration(c.mod_.get(), llvm::Intrinsic::readcyclecounter);
+  return c.builder_.CreateCall(f);
+}
+
+void count(CompilerContext& c, uint64_t* counter, llvm::Value* n) {
+  c.builder_.CreateAtomicRMW(llvm::AtomicRMWInst::Add, get_ptr(c, counter), n,
+                             llvm::AtomicOrdering::Monotonic);
+}
+
+}  // anonymous namespace
+
+llvm::Value* CompilerContext::profile_begin(const std::string& label, int row) {
+  auto* counters = profile_.enter(label, row);
+  count(*this, &counters->calls, builder_.getInt64(1));
+  return read_cycles(*this);
+}
+
+void CompilerContext::profile_end(llvm::Value* start) {
+  bool leaf;
+  auto* counters = profile_.leave(&leaf);
+  count(*this, &counters->cycles, builder_.CreateSub(read_cycles(*this), start));
+  if (leaf) {
+    count(*this, &counters->rows, builder_.getInt64(1));
+  }
+}
+
+void CompilerContext::profile_row() {
+  auto* counters = profile_.enter_body();
+  if (counters != nullptr) {
+    count(*this, &counters->rows, builder_.getInt64(1));
+  }
 }
+#endif
 
 void CompilerContext::init() {
   mod_ = llvm::make_unique<llvm::Module>("global_module", ctx_);
@@ -72,8 +145,90 @@ void CompilerContext::init() {
 }
 
 void CompilerContext::get_output(char* buff, uint64_t length) {
-  RawRow r(buff, length);
-  outputs_.emplace_back(std::move(r));
+  if (cancelled_) {
+    return;
+  }
+  if (partial_outputs) {
+    partial_outputs->emplace_back(buff, length);
+    return;
+  }
+  if (sink_) {
+    if (!sink_->consume(buff, length)) {
+      cancelled_ = true;
+      return;
+    }
+  } else {
+    RawRow r(buff, length);
+    outputs_.emplace_back(std::move(r));
+  }
+  if (output_limit_ != 0 && output_limit_ <= ++emitted_) {
+    cancelled_ = true;
+  }
+}
+
+void CompilerContext::begin_partial_output() {
+  partial_outputs = new std::vector<RawRow>;
+}
+
+void CompilerContext::end_partial_output() {
+  // the transaction of the body may still abort and run the body again, its
+  // rows are merged only once it commits
+  std::shared_ptr<std::vector<RawRow>> rows(partial_outputs);
+  partial_outputs = nullptr;
+  attempt_defer([this, rows](bool committed) {
+    if (!committed) {
+      return;
+    }
+    std::lock_guard<std::mutex> lk(output_mutex_);
+    for (auto& r : *rows) {
+      get_output(r.buff_, r.len_);
+    }
+  });
+}
+
+void CompilerContext::emit_begin_partial_output() {
+  builder_.CreateCall(functions_table_["__partial_output_begin"], {get_ptr(*this, this)});
+}
+
+void CompilerContext::emit_end_partial_output() {
+  builder_.CreateCall(functions_table_["__partial_output_end"], {get_ptr(*this, this)});
+}
+
+void CompilerContext::emit_output(llvm::Value* buffer, uint64_t length) {
+  auto* emit_func = functions_table_["__emit_func"];
+  std::vector<llvm::Value*> args{get_ptr(*this, this), buffer, builder_.getInt64(length)};
+  builder_.CreateCall(emit_func, args);
+}
+
+void CompilerContext::get_columns(const EmitLayout& layout, const char* row) {
+  // batches are appended in place, so parallel bodies may not emit columns
+  if (cancelled_) {
+    return;
+  }
+  if (!columnar_sink_->append(layout, row)) {
+    cancelled_ = true;
+    return;
+  }
+  if (output_limit_ != 0 && output_limit_ <= ++emitted_) {
+    cancelled_ = true;
+  }
+}
+
+void CompilerContext::emit_columns(std::unique_ptr<EmitLayout> layout, llvm::Value* row) {
+  auto* emit_func = functions_table_["__emit_columns_func"];
+  std::vector<llvm::Value*> args{get_ptr(*this, this), get_ptr(*this, layout.get()), row};
+  builder_.CreateCall(emit_func, args);
+  emit_layouts_.emplace_back(std::move(layout));
+}
+
+llvm::Value* CompilerContext::emit_is_cancelled() {
+  // workers of a parallel body read it while another thread may set it
+  static_assert(sizeof(cancelled_) == 1, "cancelled_ is read as a byte");
+  auto* flag = builder_.CreateBitCast(get_ptr(*this, &cancelled_), builder_.getInt8PtrTy());
+  auto* load = builder_.CreateLoad(flag);
+  load->setAtomic(llvm::AtomicOrdering::Monotonic);
+  load->setAlignment(1);
+  return builder_.CreateICmpNE(load, builder_.getInt8(0), "cancelled");
 }
 
 void CompilerContext::dump() const {
@@ -88,10 +243,20 @@ void CompilerContext::emit_precommit_txn() {
   dbi_->emit_precommit_txn(*this);
 }
 
-void CompilerContext::emit_insert(llvm::Value* key, llvm::Value* key_len,
-                                  llvm::Value* value, llvm::Value* value_len) {
-  dbi_->emit_insert(*this, key, key_len, value, value_len);
-  LLVM_DUMP(key);
+void CompilerContext::define_table(const Schema& table) {
+  dbi_->define_table(*this, table);
+}
+
+llvm::Value* CompilerContext::emit_insert(const Schema& table, llvm::Value* key, llvm::Value* key_len,
+                                          llvm::Value* value, llvm::Value* value_len) {
+  auto* inserted = dbi_->emit_insert(*this, table, key, key_len, value, value_len);
+  REIR_TRACE_DEBUG("emit_insert key: %s", print_ir(key).c_str());
+  return inserted;
+}
+
+void CompilerContext::emit_insert_batch(const Schema& table, llvm::Value* keys, llvm::Value* key_len,
+                                        llvm::Value* values, llvm::Value* value_len, llvm::Value* n) {
+  dbi_->emit_insert_batch(*this, table, keys, key_len, values, value_len, n);
 }
 
 llvm::Value* CompilerContext::emit_cursor_next(CursorBase* cursor) {
@@ -109,10 +274,52 @@ void CompilerContext::emit_cursor_copy_value(CursorBase* c, llvm::Value* buffer)
   dbi_->emit_cursor_copy_value(*this, c, buffer);
 }
 
+llvm::Value* CompilerContext::emit_cursor_get_key(CursorBase* c) {
+  return dbi_->emit_cursor_get_key(*this, c);
+}
+
+llvm::Value* CompilerContext::emit_cursor_get_value(CursorBase* c) {
+  return dbi_->emit_cursor_get_value(*this, c);
+}
+
+llvm::Value* CompilerContext::emit_cursor_next_batch(CursorBase* c,
+                                                    llvm::Value* keys, llvm::Value* key_stride,
+                                                    llvm::Value* values, llvm::Value* value_stride,
+                                                    llvm::Value* n) {
+  return dbi_->emit_cursor_next_batch(*this, c, keys, key_stride, values, value_stride, n);
+}
+
+void CompilerContext::emit_parallel_for(llvm::Function* body, llvm::Value* env,
+                                        llvm::Value* from, llvm::Value* to, llvm::Value* batch,
+                                        bool partitioned) {
+  dbi_->emit_parallel_for(*this, body, env, from, to, batch, partitioned);
+}
+
+void CompilerContext::emit_parallel_scan(const Schema& table, llvm::Function* body, llvm::Value* env,
+                                         llvm::Value* from, llvm::Value* from_len,
+                                         llvm::Value* to, llvm::Value* to_len) {
+  dbi_->emit_parallel_scan(*this, table, body, env, from, from_len, to, to_len);
+}
+
 void CompilerContext::emit_cursor_destroy(reir::CursorBase* c) {
   dbi_->emit_cursor_destroy(*this, c);
 }
 
+CursorBase* CompilerContext::emit_reopen_cursor(const Schema& table, llvm::Value* slot,
+                                                llvm::Value* from_prefix, llvm::Value* from_len,
+                                                llvm::Value* to_prefix, llvm::Value* to_len) {
+  return dbi_->emit_reopen_cursor(*this, table, slot, from_prefix, from_len, to_prefix, to_len);
+}
+
+CursorBase* CompilerContext::emit_load_cursor(llvm::Value* slot) {
+  return dbi_->emit_load_cursor(*this, slot);
+}
+
+llvm::Value* CompilerContext::emit_lookup(const Schema& table, llvm::Value* key, llvm::Value* key_len,
+                                          llvm::Value* value, llvm::Value* value_len) {
+  return dbi_->emit_lookup(*this, table, key, key_len, value, value_len);
+}
+
 std::string CompilerContext::get_name() const {
   return "__top_function";
 }
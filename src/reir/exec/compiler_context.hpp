@@ -5,6 +5,9 @@
 #ifndef PROJECT_COMPILER_CONTEXT_HPP
 #define PROJECT_COMPILER_CONTEXT_HPP
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <utility>
 #include "reir/db/schema.hpp"
@@ -12,6 +15,9 @@
 #include "db_interface.hpp"
 #include "ast_node.hpp"
 #include "llvm_environment.hpp"
+#include "result_sink.hpp"
+#include "columnar.hpp"
+#include "statement_profile.hpp"
 
 namespace llvm {
 class LLVMContext;
@@ -82,6 +88,8 @@ struct LoopContext {
 
 };
 
+class SourceLines;
+
 struct CursorBase {
   virtual ~CursorBase() = default;
 };
@@ -93,16 +101,73 @@ struct CompilerContext {
   void dump() const;
   void emit_begin_txn();
   void emit_precommit_txn();
-  void emit_insert(llvm::Value*key, llvm::Value*key_len, llvm::Value*value, llvm::Value* value_len);
-  CursorBase* get_cursor(llvm::Value* from_prefix, llvm::Value* from_len,
+  // creates the storage of a table, if the engine keeps it apart
+  void define_table(const Schema& table);
+  llvm::Value* emit_insert(const Schema& table, llvm::Value*key, llvm::Value*key_len, llvm::Value*value,
+                           llvm::Value* value_len);
+  void emit_insert_batch(const Schema& table, llvm::Value* keys, llvm::Value* key_len,
+                         llvm::Value* values, llvm::Value* value_len, llvm::Value* n);
+  CursorBase* get_cursor(const Schema& table, llvm::Value* from_prefix, llvm::Value* from_len,
                          llvm::Value* to_prefix, llvm::Value* to_len);
   void emit_cursor_destroy(CursorBase* c);
+  CursorBase* emit_reopen_cursor(const Schema& table, llvm::Value* slot,
+                                 llvm::Value* from_prefix, llvm::Value* from_len,
+                                 llvm::Value* to_prefix, llvm::Value* to_len);
+  CursorBase* emit_load_cursor(llvm::Value* slot);
+  llvm::Value* emit_lookup(const Schema& table, llvm::Value* key, llvm::Value* key_len,
+                           llvm::Value* value, llvm::Value* value_len);
   llvm::Value* emit_cursor_next(CursorBase* cursor);
   llvm::Value* emit_is_valid_cursor(CursorBase* cursor);
   void emit_cursor_copy_key(CursorBase* c, llvm::Value* buffer);
   void emit_cursor_copy_value(CursorBase* c, llvm::Value* buffer);
+  llvm::Value* emit_cursor_get_key(CursorBase* c);
+  llvm::Value* emit_cursor_get_value(CursorBase* c);
+  llvm::Value* emit_cursor_next_batch(CursorBase* c,
+                                      llvm::Value* keys, llvm::Value* key_stride,
+                                      llvm::Value* values, llvm::Value* value_stride,
+                                      llvm::Value* n);
+  void emit_parallel_for(llvm::Function* body, llvm::Value* env,
+                         llvm::Value* from, llvm::Value* to, llvm::Value* batch, bool partitioned);
+  void emit_parallel_scan(const Schema& table, llvm::Function* body, llvm::Value* env,
+                          llvm::Value* from, llvm::Value* from_len,
+                          llvm::Value* to, llvm::Value* to_len);
   void init();
   void get_output(char* buff, uint64_t length);
+  // rows emitted by this thread are kept aside until end_partial_output, so
+  // workers of a parallel body do not race on outputs_ or the sink. they are
+  // merged once the engine commits the attempt that emitted them
+  void begin_partial_output();
+  void end_partial_output();
+  void emit_begin_partial_output();
+  void emit_end_partial_output();
+  void emit_output(llvm::Value* buffer, uint64_t length);
+  // i1, true once the consumer cancelled. scans test it on every row and stop early
+  llvm::Value* emit_is_cancelled();
+  // the consumer can stop the query mid-stream, rows emitted after this are dropped
+  void cancel() { cancelled_ = true; }
+  bool is_cancelled() const { return cancelled_; }
+  // cancels by itself after n rows are emitted, 0 means no limit
+  void set_output_limit(uint64_t n) { output_limit_ = n; }
+  // streams emitted rows to sink instead of collecting them in outputs_, not owned
+  void set_sink(ResultSink* sink) { sink_ = sink; }
+  ResultSink* get_sink() const { return sink_; }
+  // emit writes typed column batches instead of raw rows, must be set before compiling
+  void set_columnar_sink(ColumnarSink* sink) { columnar_sink_ = sink; }
+  ColumnarSink* get_columnar_sink() const { return columnar_sink_; }
+  void get_columns(const EmitLayout& layout, const char* row);
+  // layout is owned by the context, row points at the emitted struct
+  void emit_columns(std::unique_ptr<EmitLayout> layout, llvm::Value* row);
+  // the code generated from now on comes from row:col, when keeping line tables
+  void set_location(int row, int col);
+#ifdef REIR_PROFILE_STATEMENTS
+  // instrumentation around the code of one statement. begin counts a call and
+  // reads the cycle counter, end adds the cycles since the matching begin
+  llvm::Value* profile_begin(const std::string& label, int row);
+  void profile_end(llvm::Value* start);
+  // counts a row of the statement being generated, at the top of its body
+  void profile_row();
+  const StatementProfile& profile() const { return profile_; }
+#endif
   MetaData* get_metadata() { return md_; }
   std::string get_name() const;
 
@@ -132,15 +197,34 @@ struct CompilerContext {
   std::unordered_map<std::string, llvm::Constant*> global_variable_table_;
   std::vector<RawRow> outputs_;
   LoopContext* loop_;
+  // cursor slots of scans nested in the current outermost scan, released when it finishes
+  std::vector<llvm::Value*>* inner_cursors_;
+  // the engine handle of the worker running the code being generated,
+  // nullptr means the handle the query was compiled with
+  llvm::Value* proc_;
+  uint64_t parallel_bodies_;
 
   llvm::LLVMContext ctx_;
   std::unique_ptr<llvm::Module> mod_;
+  // line tables of mod_, only when profiling the generated code. declared after
+  // mod_ to go away before it
+  std::unique_ptr<SourceLines> lines_;
   llvm::Function* func_;
   llvm::IRBuilder<> builder_;
   DBInterface* dbi_;
   MetaData* md_;
   llvm::TargetMachine* target_machine_;
   bool in_txn_;
+  std::atomic<bool> cancelled_;
+  uint64_t output_limit_;
+  uint64_t emitted_;
+  ResultSink* sink_;
+  ColumnarSink* columnar_sink_;
+  std::vector<std::unique_ptr<EmitLayout>> emit_layouts_;
+  std::mutex output_mutex_;
+#ifdef REIR_PROFILE_STATEMENTS
+  StatementProfile profile_;
+#endif
 };
 }
 
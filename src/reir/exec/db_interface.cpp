@@ -1,12 +1,21 @@
 //
 // Created by kumagi on 18/02/20.
 //
-#include <iostream>
+#include <sstream>
 
 #include "db_interface.hpp"
 #include "compiler_context.hpp"
 #include "llvm_util.hpp"
+#include "reir/db/schema.hpp"
+#include "reir/engine/trace.hpp"
+#include <foedus/engine.hpp>
 #include <foedus/proc/proc_id.hpp>
+#include <foedus/storage/storage.hpp>
+#include <foedus/storage/storage_manager.hpp>
+#include <foedus/storage/storage_manager_pimpl.hpp>
+#include <foedus/storage/array/array_metadata.hpp>
+#include <foedus/storage/hash/hash_metadata.hpp>
+#include <foedus/storage/sequential/sequential_metadata.hpp>
 
 namespace foedus {
 namespace storage{
@@ -20,8 +29,102 @@ namespace reir {
 
 struct FoedusCursor : public CursorBase {
   llvm::Value* cursor;
+  StorageKind kind = StorageKind::MASSTREE;
 };
 
+namespace {
+
+// the runtime function doing op on a table of the given storage. masstree has
+// the plain names (__insert, __cursor_next), the others are __array_insert, ...
+llvm::Function* storage_function(CompilerContext& ctx, StorageKind kind, const std::string& op) {
+  const std::string name = kind == StorageKind::MASSTREE ?
+      "__" + op : std::string("__") + storage_kind_name(kind) + "_" + op;
+  auto it = ctx.functions_table_.find(name);
+  if (it == ctx.functions_table_.end()) {
+    throw std::runtime_error(std::string(storage_kind_name(kind)) + " storage does not support " + op);
+  }
+  return it->second;
+}
+
+llvm::Function* cursor_function(CompilerContext& ctx, CursorBase* c, const std::string& op) {
+  return storage_function(ctx, reinterpret_cast<FoedusCursor*>(c)->kind, "cursor_" + op);
+}
+
+}  // anonymous namespace
+
+// code outlined for a worker thread gets the handle of that worker as an argument
+llvm::Value* FoedusInterface::get_proc(CompilerContext& ctx) const {
+  return ctx.proc_ ? ctx.proc_ : get_ptr(ctx, arg);
+}
+
+std::vector<llvm::Value*> FoedusInterface::table_args(CompilerContext& ctx, const Schema& table) const {
+  std::vector<llvm::Value*> args{get_proc(ctx)};
+  if (table.storage() == StorageKind::MASSTREE) {
+    return args;
+  }
+  const auto* storage = arg->engine_->get_storage_manager()->get_storage(table.name());
+  args.push_back(ctx.builder_.getInt32(storage->meta_.id_));
+  if (table.storage() == StorageKind::ARRAY) {
+    args.push_back(ctx.builder_.getInt64(table.get_key_prefix().size()));
+  }
+  return args;
+}
+
+void FoedusInterface::define_table(CompilerContext& ctx, const Schema& table) {
+  namespace storage = ::foedus::storage;
+  if (table.storage() == StorageKind::MASSTREE) {
+    return;  // every masstree table shares "db"
+  }
+  const std::string& name = table.name();
+  if (name == "db") {
+    throw std::runtime_error("table db can only use masstree");
+  }
+  auto* storages = arg->engine_->get_storage_manager();
+  auto create = [&](storage::Metadata* meta) {
+    if (storages->get_pimpl()->exists(name)) {
+      // made by an earlier run
+      if (storages->get_storage(name)->meta_.type_ != meta->type_) {
+        throw std::runtime_error("table " + name + " already exists in another storage");
+      }
+      return;
+    }
+    ::foedus::Epoch create_epoch;
+    auto ret = storages->create_storage(meta, &create_epoch);
+    if (ret.is_error()) {
+      std::stringstream message;
+      message << ret;
+      REIR_TRACE_ERROR("foedus error:[create_storage]: %s", message.str().c_str());
+      throw std::runtime_error("could not create the storage of " + name);
+    }
+  };
+  switch (table.storage()) {
+    case StorageKind::ARRAY: {
+      const auto payload = table.get_fixed_value_length();
+      if (UINT16_MAX < payload) {
+        throw std::runtime_error("rows of array table " + name + " are too long");
+      }
+      storage::array::ArrayMetadata meta(name, static_cast<uint16_t>(payload), table.storage_size());
+      create(&meta);
+      break;
+    }
+    case StorageKind::HASH: {
+      storage::hash::HashMetadata meta(name);
+      if (table.storage_size() != 0) {
+        meta.set_capacity(table.storage_size());
+      }
+      create(&meta);
+      break;
+    }
+    case StorageKind::SEQUENTIAL: {
+      storage::sequential::SequentialMetadata meta(name);
+      create(&meta);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
 void FoedusInterface::define_functions(CompilerContext& ctx) {
   std::vector<llvm::Type*> begin_xct_arg_types({
                                                    llvm::Type::getInt64PtrTy(ctx.ctx_)
@@ -64,6 +167,21 @@ void FoedusInterface::define_functions(CompilerContext& ctx) {
                              ctx.mod_.get());
   ctx.functions_table_["__insert"] = insert_func;
 
+  // insert batch
+  ctx.functions_table_["__insert_batch"] =
+      llvm::Function::Create(
+          llvm::FunctionType::get(llvm::Type::getInt64Ty(ctx.ctx_), {
+              llvm::Type::getInt64PtrTy(ctx.ctx_),  // proc
+              llvm::Type::getInt8PtrTy(ctx.ctx_),   // keys
+              llvm::Type::getInt64Ty(ctx.ctx_),     // key len
+              llvm::Type::getInt8PtrTy(ctx.ctx_),   // values
+              llvm::Type::getInt64Ty(ctx.ctx_),     // value len
+              llvm::Type::getInt64Ty(ctx.ctx_)      // n
+          }, false),
+          llvm::Function::ExternalLinkage,
+          "foedus_insert_batch",
+          ctx.mod_.get());
+
   // generate cursor
   std::vector<llvm::Type*> generate_cursor_args;
   generate_cursor_args.emplace_back(llvm::Type::getInt64PtrTy(ctx.ctx_));
@@ -130,6 +248,130 @@ void FoedusInterface::define_functions(CompilerContext& ctx) {
                              ctx.mod_.get());
   ctx.functions_table_["__cursor_copy_value"] = cursor_copy_value_func;
 
+  // get key / value pointer
+  ctx.functions_table_["__cursor_get_key"] =
+      llvm::Function::Create(
+          llvm::FunctionType::get(llvm::Type::getInt8PtrTy(ctx.ctx_), {
+              llvm::Type::getInt64PtrTy(ctx.ctx_)  // cursor
+          }, false),
+          llvm::Function::ExternalLinkage,
+          "foedus_cursor_get_key",
+          ctx.mod_.get());
+  ctx.functions_table_["__cursor_get_key_length"] =
+      llvm::Function::Create(
+          llvm::FunctionType::get(llvm::Type::getInt64Ty(ctx.ctx_), {
+              llvm::Type::getInt64PtrTy(ctx.ctx_)  // cursor
+          }, false),
+          llvm::Function::ExternalLinkage,
+          "foedus_cursor_get_key_length",
+          ctx.mod_.get());
+  ctx.functions_table_["__cursor_get_value"] =
+      llvm::Function::Create(
+          llvm::FunctionType::get(llvm::Type::getInt8PtrTy(ctx.ctx_), {
+              llvm::Type::getInt64PtrTy(ctx.ctx_)  // cursor
+          }, false),
+          llvm::Function::ExternalLinkage,
+          "foedus_cursor_get_value",
+          ctx.mod_.get());
+  ctx.functions_table_["__cursor_get_value_length"] =
+      llvm::Function::Create(
+          llvm::FunctionType::get(llvm::Type::getInt64Ty(ctx.ctx_), {
+              llvm::Type::getInt64PtrTy(ctx.ctx_)  // cursor
+          }, false),
+          llvm::Function::ExternalLinkage,
+          "foedus_cursor_get_value_length",
+          ctx.mod_.get());
+
+  // fetch up to n rows into fixed stride buffers
+  ctx.functions_table_["__cursor_next_batch"] =
+      llvm::Function::Create(
+          llvm::FunctionType::get(llvm::Type::getInt64Ty(ctx.ctx_), {
+              llvm::Type::getInt64PtrTy(ctx.ctx_),  // cursor
+              llvm::Type::getInt8PtrTy(ctx.ctx_),   // keys
+              llvm::Type::getInt64Ty(ctx.ctx_),     // key stride
+              llvm::Type::getInt8PtrTy(ctx.ctx_),   // values
+              llvm::Type::getInt64Ty(ctx.ctx_),     // value stride
+              llvm::Type::getInt64Ty(ctx.ctx_)      // n
+          }, false),
+          llvm::Function::ExternalLinkage,
+          "foedus_cursor_next_batch",
+          ctx.mod_.get());
+
+  // reopen cursor
+  ctx.functions_table_["__reopen_cursor"] =
+      llvm::Function::Create(
+          llvm::FunctionType::get(llvm::Type::getInt64PtrTy(ctx.ctx_), {
+              llvm::Type::getInt64PtrTy(ctx.ctx_),  // proc
+              llvm::Type::getInt64PtrTy(ctx.ctx_),  // cursor
+              llvm::Type::getInt8PtrTy(ctx.ctx_),   // from
+              llvm::Type::getInt64Ty(ctx.ctx_),     // from len
+              llvm::Type::getInt8PtrTy(ctx.ctx_),   // to
+              llvm::Type::getInt64Ty(ctx.ctx_)      // to len
+          }, false),
+          llvm::Function::ExternalLinkage,
+          "foedus_reopen_cursor",
+          ctx.mod_.get());
+
+  // point lookup
+  ctx.functions_table_["__lookup"] =
+      llvm::Function::Create(
+          llvm::FunctionType::get(llvm::Type::getInt1Ty(ctx.ctx_), {
+              llvm::Type::getInt64PtrTy(ctx.ctx_),  // proc
+              llvm::Type::getInt8PtrTy(ctx.ctx_),   // key
+              llvm::Type::getInt64Ty(ctx.ctx_),     // key len
+              llvm::Type::getInt8PtrTy(ctx.ctx_),   // value
+              llvm::Type::getInt64Ty(ctx.ctx_)      // value len
+          }, false),
+          llvm::Function::ExternalLinkage,
+          "foedus_lookup",
+          ctx.mod_.get());
+
+  // parallel for
+  ctx.functions_table_["__parallel_for"] =
+      llvm::Function::Create(
+          llvm::FunctionType::get(llvm::Type::getVoidTy(ctx.ctx_), {
+              llvm::Type::getInt64PtrTy(ctx.ctx_),  // proc
+              llvm::Type::getInt8PtrTy(ctx.ctx_),   // body
+              llvm::Type::getInt8PtrTy(ctx.ctx_),   // env
+              llvm::Type::getInt64Ty(ctx.ctx_),     // from
+              llvm::Type::getInt64Ty(ctx.ctx_),     // to
+              llvm::Type::getInt64Ty(ctx.ctx_)      // batch
+          }, false),
+          llvm::Function::ExternalLinkage,
+          "foedus_parallel_for",
+          ctx.mod_.get());
+
+  // parallel for, iterations routed to the node owning the partition
+  ctx.functions_table_["__parallel_for_partitioned"] =
+      llvm::Function::Create(
+          llvm::FunctionType::get(llvm::Type::getVoidTy(ctx.ctx_), {
+              llvm::Type::getInt64PtrTy(ctx.ctx_),  // proc
+              llvm::Type::getInt8PtrTy(ctx.ctx_),   // body
+              llvm::Type::getInt8PtrTy(ctx.ctx_),   // env
+              llvm::Type::getInt64Ty(ctx.ctx_),     // from
+              llvm::Type::getInt64Ty(ctx.ctx_),     // to
+              llvm::Type::getInt64Ty(ctx.ctx_)      // batch
+          }, false),
+          llvm::Function::ExternalLinkage,
+          "foedus_parallel_for_partitioned",
+          ctx.mod_.get());
+
+  // parallel scan
+  ctx.functions_table_["__parallel_scan"] =
+      llvm::Function::Create(
+          llvm::FunctionType::get(llvm::Type::getVoidTy(ctx.ctx_), {
+              llvm::Type::getInt64PtrTy(ctx.ctx_),  // proc
+              llvm::Type::getInt8PtrTy(ctx.ctx_),   // body
+              llvm::Type::getInt8PtrTy(ctx.ctx_),   // env
+              llvm::Type::getInt8PtrTy(ctx.ctx_),   // from
+              llvm::Type::getInt64Ty(ctx.ctx_),     // from len
+              llvm::Type::getInt8PtrTy(ctx.ctx_),   // to
+              llvm::Type::getInt64Ty(ctx.ctx_)      // to len
+          }, false),
+          llvm::Function::ExternalLinkage,
+          "foedus_parallel_scan",
+          ctx.mod_.get());
+
   // destroy cursor
   std::vector<llvm::Type*> cursor_destroy_args = {
       llvm::Type::getInt64PtrTy(ctx.ctx_)  // cursor
@@ -141,46 +383,119 @@ void FoedusInterface::define_functions(CompilerContext& ctx) {
                              llvm::Function::ExternalLinkage,
                              "foedus_cursor_destroy",
                              ctx.mod_.get());
+
+  define_storage_functions(ctx);
+}
+
+// tables in array, hash and sequential storages. the functions take the storage
+// id after proc, array ones also where the integer key starts in the key
+void FoedusInterface::define_storage_functions(CompilerContext& ctx) {
+  auto* i1 = llvm::Type::getInt1Ty(ctx.ctx_);
+  auto* i32 = llvm::Type::getInt32Ty(ctx.ctx_);
+  auto* i64 = llvm::Type::getInt64Ty(ctx.ctx_);
+  auto* i64_ptr = llvm::Type::getInt64PtrTy(ctx.ctx_);
+  auto* i8_ptr = llvm::Type::getInt8PtrTy(ctx.ctx_);
+  auto* void_type = llvm::Type::getVoidTy(ctx.ctx_);
+  auto declare = [&](const std::string& name, llvm::Type* ret,
+                     const std::vector<llvm::Type*>& args, const std::string& symbol) {
+    ctx.functions_table_[name] =
+        llvm::Function::Create(llvm::FunctionType::get(ret, args, false),
+                               llvm::Function::ExternalLinkage,
+                               symbol,
+                               ctx.mod_.get());
+  };
+
+  // proc, storage, key prefix length
+  declare("__array_insert", i1, {i64_ptr, i32, i64, i8_ptr, i64, i8_ptr, i64}, "foedus_array_insert");
+  declare("__array_insert_batch", i64, {i64_ptr, i32, i64, i8_ptr, i64, i8_ptr, i64, i64},
+          "foedus_array_insert_batch");
+  declare("__array_lookup", i1, {i64_ptr, i32, i64, i8_ptr, i64, i8_ptr, i64}, "foedus_array_lookup");
+  declare("__array_get_cursor", i64_ptr, {i64_ptr, i32, i64, i8_ptr, i64, i8_ptr, i64},
+          "foedus_array_generate_cursor");
+  declare("__array_reopen_cursor", i64_ptr, {i64_ptr, i32, i64, i64_ptr, i8_ptr, i64, i8_ptr, i64},
+          "foedus_array_reopen_cursor");
+  declare("__array_parallel_scan", void_type, {i64_ptr, i32, i64, i8_ptr, i8_ptr, i8_ptr, i64, i8_ptr, i64},
+          "foedus_array_parallel_scan");
+
+  // proc, storage
+  declare("__hash_insert", i1, {i64_ptr, i32, i8_ptr, i64, i8_ptr, i64}, "foedus_hash_insert");
+  declare("__hash_insert_batch", i64, {i64_ptr, i32, i8_ptr, i64, i8_ptr, i64, i64}, "foedus_hash_insert_batch");
+  declare("__hash_lookup", i1, {i64_ptr, i32, i8_ptr, i64, i8_ptr, i64}, "foedus_hash_lookup");
+
+  // proc, storage, and for cursors the key length
+  declare("__sequential_insert", i1, {i64_ptr, i32, i8_ptr, i64, i8_ptr, i64}, "foedus_sequential_append");
+  declare("__sequential_insert_batch", i64, {i64_ptr, i32, i8_ptr, i64, i8_ptr, i64, i64},
+          "foedus_sequential_append_batch");
+  declare("__sequential_get_cursor", i64_ptr, {i64_ptr, i32, i64, i8_ptr, i64, i8_ptr, i64},
+          "foedus_sequential_generate_cursor");
+  declare("__sequential_reopen_cursor", i64_ptr, {i64_ptr, i32, i64, i64_ptr, i8_ptr, i64, i8_ptr, i64},
+          "foedus_sequential_reopen_cursor");
+
+  // cursors, same signatures as the masstree ones
+  for (const std::string kind : {"array", "sequential"}) {
+    const auto name = "__" + kind + "_cursor_";
+    const auto symbol = "foedus_" + kind + "_cursor_";
+    declare(name + "is_valid", i1, {i64_ptr}, symbol + "is_valid");
+    declare(name + "next", i1, {i64_ptr}, symbol + "next");
+    declare(name + "copy_key", void_type, {i64_ptr, i8_ptr}, symbol + "copy_key");
+    declare(name + "copy_value", void_type, {i64_ptr, i8_ptr}, symbol + "copy_value");
+    declare(name + "get_key", i8_ptr, {i64_ptr}, symbol + "get_key");
+    declare(name + "get_key_length", i64, {i64_ptr}, symbol + "get_key_length");
+    declare(name + "get_value", i8_ptr, {i64_ptr}, symbol + "get_value");
+    declare(name + "get_value_length", i64, {i64_ptr}, symbol + "get_value_length");
+    declare(name + "next_batch", i64, {i64_ptr, i8_ptr, i64, i8_ptr, i64, i64}, symbol + "next_batch");
+  }
 }
 
 void FoedusInterface::emit_begin_txn(CompilerContext& ctx) {
   auto* begin_xct_func = ctx.functions_table_["__begin_xct"];
-  std::vector<llvm::Value*> begin_xct_arg({get_ptr(ctx, arg)});
+  std::vector<llvm::Value*> begin_xct_arg({get_proc(ctx)});
   ctx.builder_.CreateCall(begin_xct_func, begin_xct_arg);
 }
 
 void FoedusInterface::emit_precommit_txn(CompilerContext& ctx) {
   auto* precommit_xct_func = ctx.functions_table_["__precommit_xct"];
-  std::vector<llvm::Value*> precommit_xct_arg({get_ptr(ctx, arg)});
+  std::vector<llvm::Value*> precommit_xct_arg({get_proc(ctx)});
   ctx.builder_.CreateCall(precommit_xct_func, precommit_xct_arg);
 }
 
-void FoedusInterface::emit_insert(CompilerContext& ctx,
-                                  llvm::Value* key, llvm::Value* key_len,
-                                  llvm::Value*value, llvm::Value* value_len)  {
-  auto* insert_func = ctx.functions_table_["__insert"];
-  std::vector<llvm::Value*> insert_arg{
-      get_ptr(ctx, arg),
-      key, key_len,
-      value, value_len};
-  ctx.builder_.CreateCall(insert_func, insert_arg);
+llvm::Value* FoedusInterface::emit_insert(CompilerContext& ctx, const Schema& table,
+                                          llvm::Value* key, llvm::Value* key_len,
+                                          llvm::Value*value, llvm::Value* value_len)  {
+  auto* insert_func = storage_function(ctx, table.storage(), "insert");
+  auto insert_arg = table_args(ctx, table);
+  insert_arg.insert(insert_arg.end(), {key, key_len, value, value_len});
+  return ctx.builder_.CreateCall(insert_func, insert_arg);
+}
+
+void FoedusInterface::emit_insert_batch(CompilerContext& ctx, const Schema& table,
+                                        llvm::Value* keys, llvm::Value* key_len,
+                                        llvm::Value* values, llvm::Value* value_len,
+                                        llvm::Value* n) {
+  auto* insert_batch_func = storage_function(ctx, table.storage(), "insert_batch");
+  auto args = table_args(ctx, table);
+  args.insert(args.end(), {keys, key_len, values, value_len, n});
+  ctx.builder_.CreateCall(insert_batch_func, args);
 }
 
-CursorBase* FoedusInterface::emit_get_cursor(reir::CompilerContext& ctx, llvm::Value* from_prefix,
+CursorBase* FoedusInterface::emit_get_cursor(reir::CompilerContext& ctx, const Schema& table, llvm::Value* from_prefix,
                                              llvm::Value* from_len, llvm::Value* to_prefix, llvm::Value* to_len) {
-  auto* get_cursor_func = ctx.functions_table_["__get_cursor"];
-  std::vector<llvm::Value*> get_cursor_arg{
-      get_ptr(ctx, arg),
-      from_prefix, from_len,
-      to_prefix, to_len};
+  auto* get_cursor_func = storage_function(ctx, table.storage(), "get_cursor");
+  auto get_cursor_arg = table_args(ctx, table);
+  if (table.storage() == StorageKind::SEQUENTIAL) {
+    // a record holds the key and the value back to back
+    get_cursor_arg.push_back(ctx.builder_.getInt64(table.get_fixed_key_length()));
+  }
+  get_cursor_arg.insert(get_cursor_arg.end(), {from_prefix, from_len, to_prefix, to_len});
   auto* ret = new FoedusCursor;
   ret->cursor = ctx.builder_.CreateCall(get_cursor_func, get_cursor_arg);
+  ret->kind = table.storage();
   return ret;
 }
 
 llvm::Value* FoedusInterface::emit_is_valid_cursor(reir::CompilerContext& ctx,
                                                CursorBase* c) {
-  auto* func = ctx.functions_table_["__cursor_is_valid"];
+  auto* func = cursor_function(ctx, c, "is_valid");
   auto* fc = reinterpret_cast<FoedusCursor*>(c);
   return ctx.builder_.CreateCall(func, {fc->cursor});
 }
@@ -188,7 +503,7 @@ llvm::Value* FoedusInterface::emit_is_valid_cursor(reir::CompilerContext& ctx,
 void FoedusInterface::emit_cursor_copy_key(reir::CompilerContext& ctx,
                                            CursorBase* c,
                                            llvm::Value* buffer) {
-  auto* func = ctx.functions_table_["__cursor_copy_key"];
+  auto* func = cursor_function(ctx, c, "copy_key");
   auto* fc = reinterpret_cast<FoedusCursor*>(c);
   std::vector<llvm::Value*> args = {fc->cursor, buffer};
   ctx.builder_.CreateCall(func, args);
@@ -196,25 +511,119 @@ void FoedusInterface::emit_cursor_copy_key(reir::CompilerContext& ctx,
 
 llvm::Value* FoedusInterface::emit_cursor_next(reir::CompilerContext& ctx,
                                                CursorBase* c) {
-  auto* func = ctx.functions_table_["__cursor_next"];
+  auto* func = cursor_function(ctx, c, "next");
   auto* fc = reinterpret_cast<FoedusCursor*>(c);
   return ctx.builder_.CreateCall(func, {fc->cursor});
 }
 
 void FoedusInterface::emit_cursor_copy_value(CompilerContext& ctx, CursorBase* c, llvm::Value* buffer) {
-  auto* func = ctx.functions_table_["__cursor_copy_value"];
+  auto* func = cursor_function(ctx, c, "copy_value");
   auto* fc = reinterpret_cast<FoedusCursor*>(c);
   std::vector<llvm::Value*> args = {fc->cursor, buffer};
   ctx.builder_.CreateCall(func, args);
 }
 
+llvm::Value* FoedusInterface::emit_cursor_get_key(CompilerContext& ctx, CursorBase* c) {
+  auto* func = cursor_function(ctx, c, "get_key");
+  auto* fc = reinterpret_cast<FoedusCursor*>(c);
+  return ctx.builder_.CreateCall(func, {fc->cursor});
+}
+
+llvm::Value* FoedusInterface::emit_cursor_get_key_length(CompilerContext& ctx, CursorBase* c) {
+  auto* func = cursor_function(ctx, c, "get_key_length");
+  auto* fc = reinterpret_cast<FoedusCursor*>(c);
+  return ctx.builder_.CreateCall(func, {fc->cursor});
+}
+
+llvm::Value* FoedusInterface::emit_cursor_get_value(CompilerContext& ctx, CursorBase* c) {
+  auto* func = cursor_function(ctx, c, "get_value");
+  auto* fc = reinterpret_cast<FoedusCursor*>(c);
+  return ctx.builder_.CreateCall(func, {fc->cursor});
+}
+
+llvm::Value* FoedusInterface::emit_cursor_get_value_length(CompilerContext& ctx, CursorBase* c) {
+  auto* func = cursor_function(ctx, c, "get_value_length");
+  auto* fc = reinterpret_cast<FoedusCursor*>(c);
+  return ctx.builder_.CreateCall(func, {fc->cursor});
+}
+
+llvm::Value* FoedusInterface::emit_cursor_next_batch(CompilerContext& ctx, CursorBase* c,
+                                                    llvm::Value* keys, llvm::Value* key_stride,
+                                                    llvm::Value* values, llvm::Value* value_stride,
+                                                    llvm::Value* n) {
+  auto* func = cursor_function(ctx, c, "next_batch");
+  auto* fc = reinterpret_cast<FoedusCursor*>(c);
+  std::vector<llvm::Value*> args = {fc->cursor, keys, key_stride, values, value_stride, n};
+  return ctx.builder_.CreateCall(func, args);
+}
+
 void FoedusInterface::emit_cursor_destroy(CompilerContext& ctx, CursorBase* c) {
+  // cursors of every storage are freed by the same function
   auto* func = ctx.functions_table_["__cursor_destroy"];
   auto* fc = reinterpret_cast<FoedusCursor*>(c);
   std::vector<llvm::Value*> args = {fc->cursor};
   ctx.builder_.CreateCall(func, args);
 }
 
+CursorBase* FoedusInterface::emit_reopen_cursor(CompilerContext& ctx, const Schema& table, llvm::Value* slot,
+                                                llvm::Value* from_prefix, llvm::Value* from_len,
+                                                llvm::Value* to_prefix, llvm::Value* to_len) {
+  auto* func = storage_function(ctx, table.storage(), "reopen_cursor");
+  auto args = table_args(ctx, table);
+  if (table.storage() == StorageKind::SEQUENTIAL) {
+    args.push_back(ctx.builder_.getInt64(table.get_fixed_key_length()));
+  }
+  args.insert(args.end(), {ctx.builder_.CreateLoad(slot),
+                           from_prefix, from_len,
+                           to_prefix, to_len});
+  auto* ret = new FoedusCursor;
+  ret->cursor = ctx.builder_.CreateCall(func, args);
+  ret->kind = table.storage();
+  ctx.builder_.CreateStore(ret->cursor, slot);
+  return ret;
+}
+
+CursorBase* FoedusInterface::emit_load_cursor(CompilerContext& ctx, llvm::Value* slot) {
+  // the storage is not known here, the cursor can only be destroyed
+  auto* ret = new FoedusCursor;
+  ret->cursor = ctx.builder_.CreateLoad(slot);
+  return ret;
+}
+
+llvm::Value* FoedusInterface::emit_lookup(CompilerContext& ctx, const Schema& table,
+                                          llvm::Value* key, llvm::Value* key_len,
+                                          llvm::Value* value, llvm::Value* value_len) {
+  auto* func = storage_function(ctx, table.storage(), "lookup");
+  auto args = table_args(ctx, table);
+  args.insert(args.end(), {key, key_len, value, value_len});
+  return ctx.builder_.CreateCall(func, args);
+}
+
+void FoedusInterface::emit_parallel_for(CompilerContext& ctx, llvm::Function* body, llvm::Value* env,
+                                        llvm::Value* from, llvm::Value* to, llvm::Value* batch,
+                                        bool partitioned) {
+  auto* func = ctx.functions_table_[partitioned ? "__parallel_for_partitioned" : "__parallel_for"];
+  std::vector<llvm::Value*> args{
+      get_proc(ctx),
+      ctx.builder_.CreateBitCast(body, ctx.builder_.getInt8PtrTy()),
+      ctx.builder_.CreateBitCast(env, ctx.builder_.getInt8PtrTy()),
+      from, to, batch};
+  ctx.builder_.CreateCall(func, args);
+}
+
+void FoedusInterface::emit_parallel_scan(CompilerContext& ctx, const Schema& table,
+                                         llvm::Function* body, llvm::Value* env,
+                                         llvm::Value* from, llvm::Value* from_len,
+                                         llvm::Value* to, llvm::Value* to_len) {
+  auto* func = storage_function(ctx, table.storage(), "parallel_scan");
+  auto args = table_args(ctx, table);
+  args.insert(args.end(), {
+      ctx.builder_.CreateBitCast(body, ctx.builder_.getInt8PtrTy()),
+      ctx.builder_.CreateBitCast(env, ctx.builder_.getInt8PtrTy()),
+      from, from_len, to, to_len});
+  ctx.builder_.CreateCall(func, args);
+}
+
 void FoedusInterface::emit_update(CompilerContext& ctx,
                                   llvm::Value* key, llvm::Value* key_len,
                                   llvm::Value* value, llvm::Value* value_len)  {
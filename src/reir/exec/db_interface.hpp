@@ -1,10 +1,12 @@
 #ifndef REIR_DB_INTERFACE_HPP_
 #define REIR_DB_INTERFACE_HPP_
 #include <string>
+#include <vector>
 #include "util/slice.hpp"
 
 namespace llvm {
 class Value;
+class Function;
 }
 
 namespace foedus {
@@ -20,6 +22,7 @@ namespace reir {
 /* it may hold FOEDUS or any other Transaction Engine */
 class CompilerContext;
 class CursorBase;
+class Schema;
 
 class DBInterface {
  public:
@@ -28,26 +31,68 @@ class DBInterface {
   }
 
   virtual void define_functions(CompilerContext& ctx) = 0;
+  // called at compile time for every define. an engine keeping tables in
+  // storages of their own creates the storage here
+  virtual void define_table(CompilerContext& ctx, const Schema& table) {}
   virtual void emit_begin_txn(CompilerContext& ctx) = 0;
   virtual void emit_precommit_txn(CompilerContext& ctx) = 0;
-  virtual void emit_insert(CompilerContext& ctx,
-                           llvm::Value* key, llvm::Value* key_len,
-                           llvm::Value* value, llvm::Value* value_len) = 0;
+  // calls taking the table dispatch on the storage it lives in
+  // an insert returns i1, false when the key is already there
+  virtual llvm::Value* emit_insert(CompilerContext& ctx, const Schema& table,
+                                   llvm::Value* key, llvm::Value* key_len,
+                                   llvm::Value* value, llvm::Value* value_len) = 0;
+  // n rows, keys and values are contiguous with key_len / value_len strides
+  virtual void emit_insert_batch(CompilerContext& ctx, const Schema& table,
+                                 llvm::Value* keys, llvm::Value* key_len,
+                                 llvm::Value* values, llvm::Value* value_len,
+                                 llvm::Value* n) = 0;
   virtual void emit_update(CompilerContext& ctx,
                            llvm::Value* key, llvm::Value* key_len,
                            llvm::Value* value, llvm::Value* value_len) = 0;
 
   virtual void emit_delete(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len) = 0;
   virtual void emit_scan(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* offset) = 0;
-  virtual CursorBase* emit_get_cursor(CompilerContext& ctx,
+  virtual CursorBase* emit_get_cursor(CompilerContext& ctx, const Schema& table,
                                       llvm::Value* from_prefix, llvm::Value* from_len,
                                       llvm::Value* to_prefix, llvm::Value* to_len) = 0;
   virtual llvm::Value* emit_cursor_next(CompilerContext& ctx, CursorBase* cursor) = 0;
 
   virtual void emit_cursor_copy_key(CompilerContext& ctx, CursorBase* c, llvm::Value* buffer) = 0;
   virtual void emit_cursor_copy_value(CompilerContext& ctx, CursorBase* c, llvm::Value* buffer) = 0;
+
+  // zero-copy access to the current record, returned pointers are valid until the cursor moves
+  virtual llvm::Value* emit_cursor_get_key(CompilerContext& ctx, CursorBase* c) = 0;
+  virtual llvm::Value* emit_cursor_get_key_length(CompilerContext& ctx, CursorBase* c) = 0;
+  virtual llvm::Value* emit_cursor_get_value(CompilerContext& ctx, CursorBase* c) = 0;
+  virtual llvm::Value* emit_cursor_get_value_length(CompilerContext& ctx, CursorBase* c) = 0;
+  // copies up to n rows into keys/values at the given strides, returns the number of rows copied
+  virtual llvm::Value* emit_cursor_next_batch(CompilerContext& ctx, CursorBase* c,
+                                              llvm::Value* keys, llvm::Value* key_stride,
+                                              llvm::Value* values, llvm::Value* value_stride,
+                                              llvm::Value* n) = 0;
   virtual void emit_cursor_destroy(CompilerContext& ctx, CursorBase* c) = 0;
   virtual llvm::Value* emit_is_valid_cursor(CompilerContext& ctx, CursorBase* c) = 0;
+  // slot is an i64** holding a cursor or null. reopen repositions the cursor in the slot
+  // (creating it on first use) so a nested scan allocates once, not once per outer row
+  virtual CursorBase* emit_reopen_cursor(CompilerContext& ctx, const Schema& table, llvm::Value* slot,
+                                         llvm::Value* from_prefix, llvm::Value* from_len,
+                                         llvm::Value* to_prefix, llvm::Value* to_len) = 0;
+  virtual CursorBase* emit_load_cursor(CompilerContext& ctx, llvm::Value* slot) = 0;
+  // point lookup, copies the payload into value and returns i1 found
+  virtual llvm::Value* emit_lookup(CompilerContext& ctx, const Schema& table,
+                                   llvm::Value* key, llvm::Value* key_len,
+                                   llvm::Value* value, llvm::Value* value_len) = 0;
+  // calls body(proc, env, i) for every i in [from, to) on the worker threads, each i in a
+  // transaction of its own. a worker takes batch iterations at a time. when partitioned,
+  // i is a partition key and only workers of the NUMA node owning it run it
+  virtual void emit_parallel_for(CompilerContext& ctx, llvm::Function* body, llvm::Value* env,
+                                 llvm::Value* from, llvm::Value* to, llvm::Value* batch,
+                                 bool partitioned) = 0;
+  // cuts [from, to) into morsels and calls body(proc, env, from, from_len, to, to_len)
+  // for each of them on the worker threads
+  virtual void emit_parallel_scan(CompilerContext& ctx, const Schema& table, llvm::Function* body, llvm::Value* env,
+                                  llvm::Value* from, llvm::Value* from_len,
+                                  llvm::Value* to, llvm::Value* to_len) = 0;
  private:
   std::string name_;
 };
@@ -60,21 +105,53 @@ public:
     return "FOEDUS";
   }
   void define_functions(CompilerContext& ctx) override;
+  void define_table(CompilerContext& ctx, const Schema& table) override;
   void emit_begin_txn(CompilerContext& ctx) override;
   void emit_precommit_txn(CompilerContext& ctx) override;
-  void emit_insert(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* value, llvm::Value* value_len) override;
+  llvm::Value* emit_insert(CompilerContext& ctx, const Schema& table,
+                           llvm::Value* key, llvm::Value* key_len, llvm::Value* value, llvm::Value* value_len) override;
+  void emit_insert_batch(CompilerContext& ctx, const Schema& table,
+                         llvm::Value* keys, llvm::Value* key_len,
+                         llvm::Value* values, llvm::Value* value_len,
+                         llvm::Value* n) override;
   void emit_update(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* value, llvm::Value* value_len) override;
   void emit_delete(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len) override;
   void emit_scan(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* offset) override;
-  CursorBase* emit_get_cursor(CompilerContext& ctx,
+  CursorBase* emit_get_cursor(CompilerContext& ctx, const Schema& table,
                               llvm::Value* from_prefix, llvm::Value* from_len,
                               llvm::Value* to_prefix, llvm::Value* to_len) override;
 
   llvm::Value* emit_cursor_next(CompilerContext& ctx, CursorBase* c) override;
   void emit_cursor_copy_key(CompilerContext& ctx, CursorBase* c, llvm::Value* buffer) override;
   void emit_cursor_copy_value(CompilerContext& ctx, CursorBase* cursor, llvm::Value* buffer) override;
+  llvm::Value* emit_cursor_get_key(CompilerContext& ctx, CursorBase* c) override;
+  llvm::Value* emit_cursor_get_key_length(CompilerContext& ctx, CursorBase* c) override;
+  llvm::Value* emit_cursor_get_value(CompilerContext& ctx, CursorBase* c) override;
+  llvm::Value* emit_cursor_get_value_length(CompilerContext& ctx, CursorBase* c) override;
+  llvm::Value* emit_cursor_next_batch(CompilerContext& ctx, CursorBase* c,
+                                      llvm::Value* keys, llvm::Value* key_stride,
+                                      llvm::Value* values, llvm::Value* value_stride,
+                                      llvm::Value* n) override;
   void emit_cursor_destroy(CompilerContext& ctx, CursorBase* cursor) override;
   llvm::Value* emit_is_valid_cursor(CompilerContext& ctx, CursorBase* c) override;
+  CursorBase* emit_reopen_cursor(CompilerContext& ctx, const Schema& table, llvm::Value* slot,
+                                 llvm::Value* from_prefix, llvm::Value* from_len,
+                                 llvm::Value* to_prefix, llvm::Value* to_len) override;
+  CursorBase* emit_load_cursor(CompilerContext& ctx, llvm::Value* slot) override;
+  llvm::Value* emit_lookup(CompilerContext& ctx, const Schema& table,
+                           llvm::Value* key, llvm::Value* key_len,
+                           llvm::Value* value, llvm::Value* value_len) override;
+  void emit_parallel_for(CompilerContext& ctx, llvm::Function* body, llvm::Value* env,
+                         llvm::Value* from, llvm::Value* to, llvm::Value* batch,
+                         bool partitioned) override;
+  void emit_parallel_scan(CompilerContext& ctx, const Schema& table, llvm::Function* body, llvm::Value* env,
+                          llvm::Value* from, llvm::Value* from_len,
+                          llvm::Value* to, llvm::Value* to_len) override;
+ private:
+  void define_storage_functions(CompilerContext& ctx);
+  llvm::Value* get_proc(CompilerContext& ctx) const;
+  // proc, the storage id and for an array where its integer key starts
+  std::vector<llvm::Value*> table_args(CompilerContext& ctx, const Schema& table) const;
 };
 
 }  // namespace reir
@@ -0,0 +1,86 @@
+#include <cstdio>
+#include <ostream>
+
+#include "explain.hpp"
+
+namespace reir {
+
+Explain::Explain(std::string source, const ExplainOptions& options)
+    : source_(std::move(source)), options_(options), code_bytes_(0), objects_(0) {}
+
+void Explain::add_time(const std::string& phase, double seconds) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& t : times_) {
+    if (t.first == phase) {
+      t.second += seconds;
+      return;
+    }
+  }
+  times_.emplace_back(phase, seconds);
+}
+
+void Explain::add_code(uint64_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  code_bytes_ += bytes;
+  ++objects_;
+}
+
+void Explain::add_ir_before(const std::string& ir) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ir_before_ += ir;
+}
+
+void Explain::add_ir_after(const std::string& ir) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ir_after_ += ir;
+}
+
+void Explain::add_assembly(const std::string& text) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  assembly_ += text;
+}
+
+double Explain::time_of(const std::string& phase) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& t : times_) {
+    if (t.first == phase) {
+      return t.second;
+    }
+  }
+  return 0.0;
+}
+
+uint64_t Explain::code_size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return code_bytes_;
+}
+
+void Explain::print(std::ostream& o) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  o << "explain " << source_ << "\n";
+  char line[96];
+  for (const auto& t : times_) {
+    std::snprintf(line, sizeof(line), "  %-32s %10.3f ms\n", t.first.c_str(), t.second * 1e3);
+    o << line;
+  }
+  o << "  code size " << code_bytes_ << " bytes in " << objects_ << " objects\n";
+  if (options_.ir) {
+    o << "--- IR before optimization ---\n" << ir_before_
+      << "--- IR after optimization ---\n" << ir_after_;
+  }
+  if (options_.assembly) {
+    o << "--- assembly ---\n" << assembly_;
+  }
+}
+
+ExplainTimer::ExplainTimer(Explain* explain, std::string phase)
+    : explain_(explain), phase_(std::move(phase)), start_(std::chrono::steady_clock::now()) {}
+
+ExplainTimer::~ExplainTimer() {
+  if (explain_ != nullptr) {
+    const auto elapsed = std::chrono::steady_clock::now() - start_;
+    explain_->add_time(phase_, std::chrono::duration<double>(elapsed).count());
+  }
+}
+
+}  // namespace reir
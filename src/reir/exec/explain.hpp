@@ -0,0 +1,71 @@
+#ifndef REIR_EXPLAIN_HPP_
+#define REIR_EXPLAIN_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace reir {
+
+struct ExplainOptions {
+  bool enabled = false;
+  bool ir = false;        // the module before and after optimization
+  bool assembly = false;  // the machine code the JIT emitted
+};
+
+// where the compile time of one execute() goes. functions are optimized and
+// emitted on their first call, so those phases are recorded while the code runs,
+// possibly from the workers of a parallel for
+class Explain {
+ public:
+  Explain(std::string source, const ExplainOptions& options);
+
+  bool ir() const { return options_.ir; }
+  bool assembly() const { return options_.assembly; }
+
+  // phases are reported in the order they first showed up, times of the same
+  // phase add up
+  void add_time(const std::string& phase, double seconds);
+  void add_code(uint64_t bytes);
+  void add_ir_before(const std::string& ir);
+  void add_ir_after(const std::string& ir);
+  void add_assembly(const std::string& text);
+
+  double time_of(const std::string& phase) const;
+  uint64_t code_size() const;
+
+  void print(std::ostream& o) const;
+
+ private:
+  const std::string source_;
+  const ExplainOptions options_;
+  mutable std::mutex mutex_;
+  std::vector<std::pair<std::string, double>> times_;
+  uint64_t code_bytes_;
+  uint64_t objects_;
+  std::string ir_before_;
+  std::string ir_after_;
+  std::string assembly_;
+};
+
+// adds the time it lived to a phase of explain, does nothing without one
+class ExplainTimer {
+ public:
+  ExplainTimer(Explain* explain, std::string phase);
+  ~ExplainTimer();
+  ExplainTimer(const ExplainTimer&) = delete;
+  ExplainTimer& operator=(const ExplainTimer&) = delete;
+
+ private:
+  Explain* explain_;
+  std::string phase_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace reir
+
+#endif  // REIR_EXPLAIN_HPP_
@@ -0,0 +1,204 @@
+#include "handle_interface.hpp"
+#include "compiler_context.hpp"
+#include "llvm_util.hpp"
+
+namespace reir {
+
+struct HandleCursor : public CursorBase {
+  llvm::Value* cursor;
+};
+
+namespace {
+
+llvm::Value* cursor_of(CursorBase* c) {
+  return reinterpret_cast<HandleCursor*>(c)->cursor;
+}
+
+}  // anonymous namespace
+
+// bodies outlined for parallel for get the handle as their first argument, like a proc
+llvm::Value* HandleInterface::get_proc(CompilerContext& ctx) const {
+  return ctx.proc_ ? ctx.proc_ : get_ptr(ctx, handle_);
+}
+
+llvm::Value* HandleInterface::call(CompilerContext& ctx, const std::string& name,
+                                    const std::vector<llvm::Value*>& args) {
+  return ctx.builder_.CreateCall(ctx.functions_table_[name], args);
+}
+
+void HandleInterface::define_functions(CompilerContext& ctx) {
+  auto* i1 = llvm::Type::getInt1Ty(ctx.ctx_);
+  auto* i64 = llvm::Type::getInt64Ty(ctx.ctx_);
+  auto* i64_ptr = llvm::Type::getInt64PtrTy(ctx.ctx_);
+  auto* i8_ptr = llvm::Type::getInt8PtrTy(ctx.ctx_);
+  auto* void_type = llvm::Type::getVoidTy(ctx.ctx_);
+  auto declare = [&](const std::string& name, llvm::Type* ret,
+                     const std::vector<llvm::Type*>& args, const std::string& symbol) {
+    ctx.functions_table_[name] =
+        llvm::Function::Create(llvm::FunctionType::get(ret, args, false),
+                               llvm::Function::ExternalLinkage,
+                               symbol,
+                               ctx.mod_.get());
+  };
+
+  // same signatures as the foedus ones, the handle takes the place of proc
+  declare("__begin_xct", i1, {i64_ptr}, prefix_ + "_begin_xct");
+  declare("__precommit_xct", i1, {i64_ptr}, prefix_ + "_precommit_xct");
+  declare("__insert", i1, {i64_ptr, i8_ptr, i64, i8_ptr, i64}, prefix_ + "_insert");
+  declare("__insert_batch", i64, {i64_ptr, i8_ptr, i64, i8_ptr, i64, i64}, prefix_ + "_insert_batch");
+  declare("__overwrite", i1, {i64_ptr, i8_ptr, i64, i8_ptr, i64}, prefix_ + "_overwrite");
+  declare("__overwrite_batch", i64, {i64_ptr, i8_ptr, i64, i8_ptr, i64, i64}, prefix_ + "_overwrite_batch");
+  declare("__lookup", i1, {i64_ptr, i8_ptr, i64, i8_ptr, i64}, prefix_ + "_lookup");
+  declare("__get_cursor", i64_ptr, {i64_ptr, i8_ptr, i64, i8_ptr, i64}, prefix_ + "_generate_cursor");
+  declare("__reopen_cursor", i64_ptr, {i64_ptr, i64_ptr, i8_ptr, i64, i8_ptr, i64}, prefix_ + "_reopen_cursor");
+  declare("__cursor_is_valid", i1, {i64_ptr}, prefix_ + "_cursor_is_valid");
+  declare("__cursor_next", i1, {i64_ptr}, prefix_ + "_cursor_next");
+  declare("__cursor_copy_key", void_type, {i64_ptr, i8_ptr}, prefix_ + "_cursor_copy_key");
+  declare("__cursor_copy_value", void_type, {i64_ptr, i8_ptr}, prefix_ + "_cursor_copy_value");
+  declare("__cursor_get_key", i8_ptr, {i64_ptr}, prefix_ + "_cursor_get_key");
+  declare("__cursor_get_key_length", i64, {i64_ptr}, prefix_ + "_cursor_get_key_length");
+  declare("__cursor_get_value", i8_ptr, {i64_ptr}, prefix_ + "_cursor_get_value");
+  declare("__cursor_get_value_length", i64, {i64_ptr}, prefix_ + "_cursor_get_value_length");
+  declare("__cursor_next_batch", i64, {i64_ptr, i8_ptr, i64, i8_ptr, i64, i64}, prefix_ + "_cursor_next_batch");
+  declare("__cursor_destroy", void_type, {i64_ptr}, prefix_ + "_cursor_destroy");
+
+  // the runtimes have a single thread, a partition has no NUMA node to go to
+  declare("__parallel_for", void_type, {i64_ptr, i8_ptr, i8_ptr, i64, i64, i64}, prefix_ + "_parallel_for");
+  declare("__parallel_for_partitioned", void_type, {i64_ptr, i8_ptr, i8_ptr, i64, i64, i64},
+          prefix_ + "_parallel_for");
+  declare("__parallel_scan", void_type, {i64_ptr, i8_ptr, i8_ptr, i8_ptr, i64, i8_ptr, i64},
+          prefix_ + "_parallel_scan");
+}
+
+void HandleInterface::emit_begin_txn(CompilerContext& ctx) {
+  call(ctx, "__begin_xct", {get_proc(ctx)});
+}
+
+void HandleInterface::emit_precommit_txn(CompilerContext& ctx) {
+  call(ctx, "__precommit_xct", {get_proc(ctx)});
+}
+
+llvm::Value* HandleInterface::emit_insert(CompilerContext& ctx, const Schema& table,
+                                          llvm::Value* key, llvm::Value* key_len,
+                                          llvm::Value* value, llvm::Value* value_len) {
+  // a row of an array always exists, as in foedus an insert overwrites it
+  const char* f = table.storage() == StorageKind::ARRAY ? "__overwrite" : "__insert";
+  return call(ctx, f, {get_proc(ctx), key, key_len, value, value_len});
+}
+
+void HandleInterface::emit_insert_batch(CompilerContext& ctx, const Schema& table,
+                                         llvm::Value* keys, llvm::Value* key_len,
+                                         llvm::Value* values, llvm::Value* value_len,
+                                         llvm::Value* n) {
+  const char* f = table.storage() == StorageKind::ARRAY ? "__overwrite_batch" : "__insert_batch";
+  call(ctx, f, {get_proc(ctx), keys, key_len, values, value_len, n});
+}
+
+CursorBase* HandleInterface::emit_get_cursor(CompilerContext& ctx, const Schema& table,
+                                              llvm::Value* from_prefix, llvm::Value* from_len,
+                                              llvm::Value* to_prefix, llvm::Value* to_len) {
+  auto* ret = new HandleCursor;
+  ret->cursor = call(ctx, "__get_cursor", {get_proc(ctx), from_prefix, from_len, to_prefix, to_len});
+  return ret;
+}
+
+llvm::Value* HandleInterface::emit_is_valid_cursor(CompilerContext& ctx, CursorBase* c) {
+  return call(ctx, "__cursor_is_valid", {cursor_of(c)});
+}
+
+llvm::Value* HandleInterface::emit_cursor_next(CompilerContext& ctx, CursorBase* c) {
+  return call(ctx, "__cursor_next", {cursor_of(c)});
+}
+
+void HandleInterface::emit_cursor_copy_key(CompilerContext& ctx, CursorBase* c, llvm::Value* buffer) {
+  call(ctx, "__cursor_copy_key", {cursor_of(c), buffer});
+}
+
+void HandleInterface::emit_cursor_copy_value(CompilerContext& ctx, CursorBase* c, llvm::Value* buffer) {
+  call(ctx, "__cursor_copy_value", {cursor_of(c), buffer});
+}
+
+llvm::Value* HandleInterface::emit_cursor_get_key(CompilerContext& ctx, CursorBase* c) {
+  return call(ctx, "__cursor_get_key", {cursor_of(c)});
+}
+
+llvm::Value* HandleInterface::emit_cursor_get_key_length(CompilerContext& ctx, CursorBase* c) {
+  return call(ctx, "__cursor_get_key_length", {cursor_of(c)});
+}
+
+llvm::Value* HandleInterface::emit_cursor_get_value(CompilerContext& ctx, CursorBase* c) {
+  return call(ctx, "__cursor_get_value", {cursor_of(c)});
+}
+
+llvm::Value* HandleInterface::emit_cursor_get_value_length(CompilerContext& ctx, CursorBase* c) {
+  return call(ctx, "__cursor_get_value_length", {cursor_of(c)});
+}
+
+llvm::Value* HandleInterface::emit_cursor_next_batch(CompilerContext& ctx, CursorBase* c,
+                                                      llvm::Value* keys, llvm::Value* key_stride,
+                                                      llvm::Value* values, llvm::Value* value_stride,
+                                                      llvm::Value* n) {
+  return call(ctx, "__cursor_next_batch", {cursor_of(c), keys, key_stride, values, value_stride, n});
+}
+
+void HandleInterface::emit_cursor_destroy(CompilerContext& ctx, CursorBase* c) {
+  call(ctx, "__cursor_destroy", {cursor_of(c)});
+}
+
+CursorBase* HandleInterface::emit_reopen_cursor(CompilerContext& ctx, const Schema& table, llvm::Value* slot,
+                                                 llvm::Value* from_prefix, llvm::Value* from_len,
+                                                 llvm::Value* to_prefix, llvm::Value* to_len) {
+  auto* ret = new HandleCursor;
+  ret->cursor = call(ctx, "__reopen_cursor", {get_proc(ctx), ctx.builder_.CreateLoad(slot),
+                                              from_prefix, from_len, to_prefix, to_len});
+  ctx.builder_.CreateStore(ret->cursor, slot);
+  return ret;
+}
+
+CursorBase* HandleInterface::emit_load_cursor(CompilerContext& ctx, llvm::Value* slot) {
+  auto* ret = new HandleCursor;
+  ret->cursor = ctx.builder_.CreateLoad(slot);
+  return ret;
+}
+
+llvm::Value* HandleInterface::emit_lookup(CompilerContext& ctx, const Schema& table,
+                                           llvm::Value* key, llvm::Value* key_len,
+                                           llvm::Value* value, llvm::Value* value_len) {
+  return call(ctx, "__lookup", {get_proc(ctx), key, key_len, value, value_len});
+}
+
+void HandleInterface::emit_parallel_for(CompilerContext& ctx, llvm::Function* body, llvm::Value* env,
+                                         llvm::Value* from, llvm::Value* to, llvm::Value* batch,
+                                         bool partitioned) {
+  call(ctx, partitioned ? "__parallel_for_partitioned" : "__parallel_for", {
+      get_proc(ctx),
+      ctx.builder_.CreateBitCast(body, ctx.builder_.getInt8PtrTy()),
+      ctx.builder_.CreateBitCast(env, ctx.builder_.getInt8PtrTy()),
+      from, to, batch});
+}
+
+void HandleInterface::emit_parallel_scan(CompilerContext& ctx, const Schema& table,
+                                          llvm::Function* body, llvm::Value* env,
+                                          llvm::Value* from, llvm::Value* from_len,
+                                          llvm::Value* to, llvm::Value* to_len) {
+  call(ctx, "__parallel_scan", {
+      get_proc(ctx),
+      ctx.builder_.CreateBitCast(body, ctx.builder_.getInt8PtrTy()),
+      ctx.builder_.CreateBitCast(env, ctx.builder_.getInt8PtrTy()),
+      from, from_len, to, to_len});
+}
+
+void HandleInterface::emit_update(CompilerContext& ctx,
+                                   llvm::Value* key, llvm::Value* key_len,
+                                   llvm::Value* value, llvm::Value* value_len) {
+}
+
+void HandleInterface::emit_delete(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len) {
+}
+
+void HandleInterface::emit_scan(CompilerContext& ctx,
+                                 llvm::Value* key, llvm::Value* key_len,
+                                 llvm::Value* offset) {
+}
+
+}  // namespace reir
@@ -0,0 +1,70 @@
+#ifndef REIR_HANDLE_INTERFACE_HPP_
+#define REIR_HANDLE_INTERFACE_HPP_
+
+#include "db_interface.hpp"
+
+namespace reir {
+
+// an engine whose runtime is a set of C functions named <prefix>_insert,
+// <prefix>_cursor_next, ... taking one handle where foedus takes a proc.
+// every table is a key range of one ordered keyspace, whatever storage it asked for.
+// only inserts into an array keep its semantics and overwrite the row
+class HandleInterface : public DBInterface {
+ public:
+  HandleInterface(const std::string& name, void* handle, const std::string& prefix)
+      : name_(name), handle_(handle), prefix_(prefix) {}
+  std::string get_name() override {
+    return name_;
+  }
+  void define_functions(CompilerContext& ctx) override;
+  void emit_begin_txn(CompilerContext& ctx) override;
+  void emit_precommit_txn(CompilerContext& ctx) override;
+  llvm::Value* emit_insert(CompilerContext& ctx, const Schema& table,
+                           llvm::Value* key, llvm::Value* key_len, llvm::Value* value, llvm::Value* value_len) override;
+  void emit_insert_batch(CompilerContext& ctx, const Schema& table,
+                         llvm::Value* keys, llvm::Value* key_len,
+                         llvm::Value* values, llvm::Value* value_len,
+                         llvm::Value* n) override;
+  void emit_update(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* value, llvm::Value* value_len) override;
+  void emit_delete(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len) override;
+  void emit_scan(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* offset) override;
+  CursorBase* emit_get_cursor(CompilerContext& ctx, const Schema& table,
+                              llvm::Value* from_prefix, llvm::Value* from_len,
+                              llvm::Value* to_prefix, llvm::Value* to_len) override;
+  llvm::Value* emit_cursor_next(CompilerContext& ctx, CursorBase* c) override;
+  void emit_cursor_copy_key(CompilerContext& ctx, CursorBase* c, llvm::Value* buffer) override;
+  void emit_cursor_copy_value(CompilerContext& ctx, CursorBase* c, llvm::Value* buffer) override;
+  llvm::Value* emit_cursor_get_key(CompilerContext& ctx, CursorBase* c) override;
+  llvm::Value* emit_cursor_get_key_length(CompilerContext& ctx, CursorBase* c) override;
+  llvm::Value* emit_cursor_get_value(CompilerContext& ctx, CursorBase* c) override;
+  llvm::Value* emit_cursor_get_value_length(CompilerContext& ctx, CursorBase* c) override;
+  llvm::Value* emit_cursor_next_batch(CompilerContext& ctx, CursorBase* c,
+                                      llvm::Value* keys, llvm::Value* key_stride,
+                                      llvm::Value* values, llvm::Value* value_stride,
+                                      llvm::Value* n) override;
+  void emit_cursor_destroy(CompilerContext& ctx, CursorBase* c) override;
+  llvm::Value* emit_is_valid_cursor(CompilerContext& ctx, CursorBase* c) override;
+  CursorBase* emit_reopen_cursor(CompilerContext& ctx, const Schema& table, llvm::Value* slot,
+                                 llvm::Value* from_prefix, llvm::Value* from_len,
+                                 llvm::Value* to_prefix, llvm::Value* to_len) override;
+  CursorBase* emit_load_cursor(CompilerContext& ctx, llvm::Value* slot) override;
+  llvm::Value* emit_lookup(CompilerContext& ctx, const Schema& table,
+                           llvm::Value* key, llvm::Value* key_len,
+                           llvm::Value* value, llvm::Value* value_len) override;
+  void emit_parallel_for(CompilerContext& ctx, llvm::Function* body, llvm::Value* env,
+                         llvm::Value* from, llvm::Value* to, llvm::Value* batch,
+                         bool partitioned) override;
+  void emit_parallel_scan(CompilerContext& ctx, const Schema& table, llvm::Function* body, llvm::Value* env,
+                          llvm::Value* from, llvm::Value* from_len,
+                          llvm::Value* to, llvm::Value* to_len) override;
+ private:
+  llvm::Value* get_proc(CompilerContext& ctx) const;
+  llvm::Value* call(CompilerContext& ctx, const std::string& name, const std::vector<llvm::Value*>& args);
+  std::string name_;
+  void* handle_;
+  std::string prefix_;
+};
+
+}  // namespace reir
+
+#endif  // REIR_HANDLE_INTERFACE_HPP_
@@ -0,0 +1,90 @@
+#include <cstring>
+#include <stdexcept>
+
+#include "hash_table.hpp"
+
+namespace reir {
+
+RowHashTable::RowHashTable(uint64_t key_words, uint64_t payload_words, uint64_t capacity)
+    : slots_(nullptr), mask_(0), size_(0),
+      entry_words_(1 + key_words + payload_words), key_words_(key_words) {
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+    throw std::runtime_error("hash table capacity must be power of 2");
+  }
+  slots_ = new uint64_t[capacity * entry_words_]();
+  mask_ = capacity - 1;
+}
+
+RowHashTable::~RowHashTable() {
+  delete[] slots_;
+}
+
+uint64_t* RowHashTable::place(uint64_t hash) {
+  for (uint64_t pos = hash & mask_;; pos = (pos + 1) & mask_) {
+    uint64_t* entry = slots_ + pos * entry_words_;
+    if (entry[0] == 0) {
+      entry[0] = hash;
+      return entry;
+    }
+  }
+}
+
+void RowHashTable::grow() {
+  uint64_t* old = slots_;
+  const uint64_t old_capacity = capacity();
+  slots_ = new uint64_t[old_capacity * 2 * entry_words_]();
+  mask_ = old_capacity * 2 - 1;
+  for (uint64_t i = 0; i < old_capacity; ++i) {
+    const uint64_t* entry = old + i * entry_words_;
+    if (entry[0] != 0) {
+      // the stored hash is reused, no need to hash the keys again
+      uint64_t* dst = place(entry[0]);
+      std::memcpy(dst + 1, entry + 1, (entry_words_ - 1) * sizeof(uint64_t));
+    }
+  }
+  delete[] old;
+}
+
+uint64_t* RowHashTable::insert(uint64_t hash, const uint64_t* keys) {
+  // keep load factor under 1/2, linear probing degrades quickly above that
+  if ((size_ + 1) * 2 > capacity()) {
+    grow();
+  }
+  uint64_t* entry = place(hash | 1);
+  std::memcpy(entry + 1, keys, key_words_ * sizeof(uint64_t));
+  ++size_;
+  return entry;
+}
+
+uint64_t* RowHashTable::next(uint64_t* pos) const {
+  for (; *pos < capacity(); ++*pos) {
+    uint64_t* entry = slots_ + *pos * entry_words_;
+    if (entry[0] != 0) {
+      ++*pos;
+      return entry;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace reir
+
+extern "C" {
+
+reir::RowHashTable* reir_hash_table_create(uint64_t key_words, uint64_t payload_words) {
+  return new reir::RowHashTable(key_words, payload_words);
+}
+
+uint64_t* reir_hash_table_insert(reir::RowHashTable* table, uint64_t hash, const uint64_t* keys) {
+  return table->insert(hash, keys);
+}
+
+uint64_t* reir_hash_table_next(reir::RowHashTable* table, uint64_t* pos) {
+  return table->next(pos);
+}
+
+void reir_hash_table_destroy(reir::RowHashTable* table) {
+  delete table;
+}
+
+}
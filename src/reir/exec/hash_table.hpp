@@ -0,0 +1,52 @@
+#ifndef REIR_HASH_TABLE_HPP_
+#define REIR_HASH_TABLE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace reir {
+
+// open addressing table of fixed width entries, shared with generated code.
+// an entry is [hash | 1][key words...][payload words...], a zero first word
+// means the slot is empty. the JIT probes slots_ / mask_ inline and only calls
+// into the runtime to insert, so those two must stay the first two words.
+struct RowHashTable {
+  uint64_t* slots_;
+  uint64_t mask_;
+  uint64_t size_;
+  uint64_t entry_words_;
+  uint64_t key_words_;
+
+  RowHashTable(uint64_t key_words, uint64_t payload_words, uint64_t capacity = 1024);
+  ~RowHashTable();
+  RowHashTable(const RowHashTable&) = delete;
+  RowHashTable& operator=(const RowHashTable&) = delete;
+
+  // does not look for an existing entry, the caller has already probed.
+  // returns the new entry, its payload is zero filled.
+  uint64_t* insert(uint64_t hash, const uint64_t* keys);
+
+  // returns the next used entry at or after *pos and advances *pos past it,
+  // nullptr when there are no more entries
+  uint64_t* next(uint64_t* pos) const;
+
+  uint64_t capacity() const { return mask_ + 1; }
+
+ private:
+  void grow();
+  uint64_t* place(uint64_t hash);
+};
+
+static_assert(offsetof(RowHashTable, slots_) == 0, "generated code loads slots_ from word 0");
+static_assert(offsetof(RowHashTable, mask_) == 8, "generated code loads mask_ from word 1");
+
+}  // namespace reir
+
+extern "C" {
+reir::RowHashTable* reir_hash_table_create(uint64_t key_words, uint64_t payload_words);
+uint64_t* reir_hash_table_insert(reir::RowHashTable* table, uint64_t hash, const uint64_t* keys);
+uint64_t* reir_hash_table_next(reir::RowHashTable* table, uint64_t* pos);
+void reir_hash_table_destroy(reir::RowHashTable* table);
+}
+
+#endif  // REIR_HASH_TABLE_HPP_
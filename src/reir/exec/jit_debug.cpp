@@ -0,0 +1,148 @@
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#include <llvm/BinaryFormat/Dwarf.h>
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Object/SymbolSize.h>
+#include <llvm/Support/Path.h>
+
+#include "jit_debug.hpp"
+
+namespace reir {
+
+bool jit_profiling_enabled() {
+  static const bool enabled = [] {
+    const char* v = std::getenv("REIR_JIT_PROFILE");
+    return v != nullptr && *v != '\0' && std::strcmp(v, "0") != 0;
+  }();
+  return enabled;
+}
+
+std::vector<llvm::JITEventListener*> jit_event_listeners() {
+  std::vector<llvm::JITEventListener*> listeners;
+  if (!jit_profiling_enabled()) {
+    return listeners;
+  }
+  // the gdb listener is a process wide singleton
+  listeners.push_back(llvm::JITEventListener::createGDBRegistrationListener());
+  static llvm::JITEventListener* perf_jitdump = llvm::JITEventListener::createPerfJITEventListener();
+  if (perf_jitdump != nullptr) {
+    listeners.push_back(perf_jitdump);
+  }
+  static PerfMapListener perf_map;
+  listeners.push_back(&perf_map);
+  return listeners;
+}
+
+void PerfMapListener::NotifyObjectEmitted(const llvm::object::ObjectFile& obj,
+                                          const llvm::RuntimeDyld::LoadedObjectInfo& info) {
+  static std::mutex mutex;
+  static FILE* map = nullptr;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (map == nullptr) {
+    const std::string path = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+    map = fopen(path.c_str(), "a");
+    if (map == nullptr) {
+      return;
+    }
+  }
+  // the copy for debuggers has its sections at the addresses they were loaded at
+  auto debug_obj = info.getObjectForDebug(obj);
+  const auto& loaded = *debug_obj.getBinary();
+  for (const auto& sym_size : llvm::object::computeSymbolSizes(loaded)) {
+    const auto& sym = sym_size.first;
+    auto type = sym.getType();
+    if (!type) {
+      llvm::consumeError(type.takeError());
+      continue;
+    }
+    if (*type != llvm::object::SymbolRef::ST_Function) {
+      continue;
+    }
+    auto name = sym.getName();
+    auto address = sym.getAddress();
+    if (!name || !address) {
+      if (!name) {
+        llvm::consumeError(name.takeError());
+      }
+      if (!address) {
+        llvm::consumeError(address.takeError());
+      }
+      continue;
+    }
+    fprintf(map, "%lx %lx %s\n",
+            static_cast<unsigned long>(*address), static_cast<unsigned long>(sym_size.second),
+            name->str().c_str());
+  }
+  fflush(map);
+}
+
+SourceLines::SourceLines(llvm::Module& m, const std::string& source) : mod_(m), builder_(m) {
+  const auto dir = llvm::sys::path::parent_path(source);
+  file_ = builder_.createFile(llvm::sys::path::filename(source), dir.empty() ? "." : dir);
+  builder_.createCompileUnit(llvm::dwarf::DW_LANG_C, file_, "reir", true, "", 0);
+  type_ = builder_.createSubroutineType(builder_.getOrCreateTypeArray({}));
+  m.addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+  m.addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+}
+
+llvm::DISubprogram* SourceLines::subprogram(llvm::Function* f, unsigned line) {
+  if (auto* sp = f->getSubprogram()) {
+    return sp;
+  }
+  auto* sp = builder_.createFunction(file_, f->getName(), f->getName(), file_, line, type_,
+                                     false, true, line, llvm::DINode::FlagPrototyped, true);
+  f->setSubprogram(sp);
+  return sp;
+}
+
+void SourceLines::set_location(llvm::IRBuilder<>& b, int row, int col) {
+  if (row <= 0 || b.GetInsertBlock() == nullptr) {
+    return;  // made up by the compiler, it keeps the location of its parent
+  }
+  auto* sp = subprogram(b.GetInsertBlock()->getParent(), row);
+  b.SetCurrentDebugLocation(llvm::DebugLoc::get(row, col, sp));
+}
+
+void SourceLines::finish() {
+  for (auto& f : mod_) {
+    if (f.isDeclaration()) {
+      continue;
+    }
+    // the builder keeps its location across functions, so an outlined body and
+    // the code around it may point into each other's subprogram
+    unsigned first_line = 0;
+    for (auto& bb : f) {
+      for (auto& i : bb) {
+        if (first_line == 0 && i.getDebugLoc()) {
+          first_line = i.getDebugLoc().getLine();
+        }
+      }
+    }
+    if (first_line == 0 && f.getSubprogram() == nullptr) {
+      continue;
+    }
+    auto* sp = subprogram(&f, first_line == 0 ? 1 : first_line);
+    llvm::DebugLoc last = llvm::DebugLoc::get(sp->getLine(), 0, sp);
+    for (auto& bb : f) {
+      for (auto& i : bb) {
+        const llvm::DebugLoc& loc = i.getDebugLoc();
+        if (!loc) {
+          i.setDebugLoc(last);
+          continue;
+        }
+        if (loc->getScope()->getSubprogram() != sp) {
+          i.setDebugLoc(llvm::DebugLoc::get(loc.getLine(), loc.getCol(), sp));
+        }
+        last = i.getDebugLoc();
+      }
+    }
+  }
+  builder_.finalize();
+}
+
+}  // namespace reir
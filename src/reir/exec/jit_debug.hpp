@@ -0,0 +1,55 @@
+#ifndef REIR_JIT_DEBUG_HPP_
+#define REIR_JIT_DEBUG_HPP_
+
+#include <string>
+#include <vector>
+#include <llvm/ExecutionEngine/JITEventListener.h>
+#include <llvm/IR/DIBuilder.h>
+#include <llvm/IR/IRBuilder.h>
+
+namespace llvm {
+class Function;
+class Module;
+}
+
+namespace reir {
+
+// REIR_JIT_PROFILE=1 in the environment makes the generated code visible to perf
+// and gdb: compiled objects are announced to the listeners below and carry line
+// tables pointing back into the .rir source. off by default, it slows compiling
+bool jit_profiling_enabled();
+
+// the listeners compiled objects go to when profiling: gdb's JIT interface,
+// perf's jitdump when llvm was built with LLVM_USE_PERF, and /tmp/perf-<pid>.map
+std::vector<llvm::JITEventListener*> jit_event_listeners();
+
+// appends the address, size and name of every function of an object to
+// /tmp/perf-<pid>.map, which perf reads to name samples in anonymous memory
+class PerfMapListener : public llvm::JITEventListener {
+ public:
+  void NotifyObjectEmitted(const llvm::object::ObjectFile& obj,
+                           const llvm::RuntimeDyld::LoadedObjectInfo& info) override;
+};
+
+// line table of a module, statements set the location of what is generated for them
+class SourceLines {
+ public:
+  SourceLines(llvm::Module& m, const std::string& source);
+  // the code generated by b from now on comes from row:col of the source
+  void set_location(llvm::IRBuilder<>& b, int row, int col);
+  // gives every function with located code a subprogram of its own and every
+  // instruction in it a location in that subprogram, as the verifier wants
+  void finish();
+
+ private:
+  llvm::DISubprogram* subprogram(llvm::Function* f, unsigned line);
+
+  llvm::Module& mod_;
+  llvm::DIBuilder builder_;
+  llvm::DIFile* file_;
+  llvm::DISubroutineType* type_;
+};
+
+}  // namespace reir
+
+#endif  // REIR_JIT_DEBUG_HPP_
@@ -7,6 +7,7 @@
 #include <string>
 #include <reir/db/attribute.hpp>
 #include "ast_expression.hpp"
+#include "explain.hpp"
 #include "parser.hpp"
 #include "tokenize.hpp"
 #include "reir/db/maybe_value.hpp"
@@ -21,15 +22,23 @@ class Node;
 
 // implementation of parse_statement exists in ast_node_parser.cpp
 
-void parse(const std::string& code, const std::function<void(node::Node*)>& fun) {
-  auto token_list = tokenize(code);
+void parse(const std::string& code, const std::function<void(node::Node*)>& fun,
+           Explain* explain) {
+  std::vector<Token> token_list;
+  {
+    ExplainTimer timer(explain, "tokenize");
+    token_list = tokenize(code);
+  }
   // std::cout << token_list << std::endl;
   TokenStream tokens(std::move(token_list));
   std::unique_ptr<node::Block> global_block(new node::Block());
-  while (tokens.has_next()) {
-    auto* entry = node::parse_statement(tokens);
-    if (entry) {
-      global_block->add(entry);
+  {
+    ExplainTimer timer(explain, "parse");
+    while (tokens.has_next()) {
+      auto* entry = node::parse_statement(tokens);
+      if (entry) {
+        global_block->add(entry);
+      }
     }
   }
   fun(global_block.get());
@@ -10,7 +10,10 @@ namespace node {
 struct Statement;
 }
 class TokenStream;
-void parse(const std::string& code, const std::function<void(node::Node*)>& fun);
+class Explain;
+// explain, if any, gets the time of tokenize and parse
+void parse(const std::string& code, const std::function<void(node::Node*)>& fun,
+           Explain* explain = nullptr);
 
 }  // namespace reir
 
@@ -10,19 +10,53 @@
 #include "reir/exec/parser.hpp"
 #include "reir/exec/compiler.hpp"
 #include "reir/engine/foedus_runner.hpp"
+#include "reir/engine/runner.hpp"
 #include "reir/exec/db_interface.hpp"
 
 namespace reir {
 
-reir_context::reir_context()
-    : c(new Compiler), runner(new FoedusRunner), md(new MetaData) {}
+reir_context::reir_context(int threads)
+    : c(new Compiler), runner(new FoedusRunner(threads)), md(new MetaData) {}
 
-void reir_context::execute(const std::string& code) {
-  runner->run([&](DBInterface& dbi) {
-    parse(code, [&](node::Node* ast) {
-      c->compile_and_exec(dbi, *md, ast);
+reir_context::reir_context(const EngineConfig& config)
+    : c(new Compiler), runner(make_runner(config)), md(new MetaData) {}
+
+void reir_context::execute(const std::string& code, const std::string& source) {
+  c->set_source(source);
+  std::unique_ptr<Explain> explain;
+  if (explain_.enabled) {
+    explain.reset(new Explain(source, explain_));
+  }
+  {
+    // the compiler outlives explain, it must not keep it after a failed run
+    struct ExplainReset {
+      Compiler* c;
+      ~ExplainReset() { c->set_explain(nullptr); }
+    } reset{c.get()};
+    c->set_explain(explain.get());
+    runner->run([&](DBInterface& dbi) {
+      // on the thread the runner executes the code on
+      StatsScope scope(source);
+      parse(code, [&](node::Node* ast) {
+        c->compile_and_exec(dbi, *md, ast);
+      }, explain.get());
     });
-  });
+  }
+  if (explain) {
+    explain->print(std::cout);
+  }
+}
+
+std::map<std::string, TxnStats> reir_context::stats() const {
+  return stats_snapshot();
+}
+
+void reir_context::print_stats(std::ostream& o) const {
+  reir::print_stats(o);
+}
+
+void reir_context::reset_stats() {
+  stats_reset();
 }
 }
 
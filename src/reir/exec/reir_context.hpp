@@ -5,24 +5,45 @@
 #ifndef PROJECT_EXEC_HPP
 #define PROJECT_EXEC_HPP
 
+#include <iosfwd>
+#include <map>
 #include <string>
 #include <memory>
 #include <reir/db/metadata.hpp>
+#include <reir/engine/engine_config.hpp>
+#include <reir/engine/stats.hpp>
+#include <reir/exec/explain.hpp>
 
 namespace reir {
 class Compiler;
-class FoedusRunner;
+class Runner;
 class Metadata;
 
 class reir_context {
 public:
-  reir_context();
-  void execute(const std::string& code);
+  explicit reir_context(int threads = 1);
+  explicit reir_context(const EngineConfig& config);
+  // source names the code in line tables when the generated code is profiled,
+  // and is the procedure its transactions are counted for in stats()
+  void execute(const std::string& code, const std::string& source = "input.rir");
+
+  // transaction counters and latencies of every procedure run so far, by source.
+  // they are process wide, shared with the other contexts
+  std::map<std::string, TxnStats> stats() const;
+  void print_stats(std::ostream& o) const;
+  void reset_stats();
+
+  // with options.enabled, every execute() prints where its compile time went
+  // to std::cout once the code has run
+  void set_explain(const ExplainOptions& options) {
+    explain_ = options;
+  }
 
 private:
   std::shared_ptr<Compiler> c;
-  std::shared_ptr<FoedusRunner> runner;
+  std::shared_ptr<Runner> runner;
   std::shared_ptr<MetaData> md;
+  ExplainOptions explain_;
 };
 }  // namespace reir
 #endif //PROJECT_EXEC_HPP
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include "result_sink.hpp"
+
+namespace reir {
+
+BufferSink::BufferSink(uint64_t capacity) : capacity_(capacity) {
+  data_.reserve(capacity);
+}
+
+bool BufferSink::consume(const char* row, uint64_t length) {
+  if (capacity_ != 0 && capacity_ < data_.size() + length) {
+    return false;
+  }
+  offsets_.push_back(data_.size());
+  data_.insert(data_.end(), row, row + length);
+  return true;
+}
+
+RowView BufferSink::row(size_t i) const {
+  const uint64_t begin = offsets_[i];
+  const uint64_t end = i + 1 < offsets_.size() ? offsets_[i + 1] : data_.size();
+  return RowView{data_.data() + begin, end - begin};
+}
+
+void BufferSink::clear() {
+  data_.clear();
+  offsets_.clear();
+}
+
+RingSink::RingSink(uint64_t capacity)
+    : mask_(0), head_(0), tail_(0), closed_(false), cancelled_(false) {
+  uint64_t size = 64;
+  while (size < capacity) {
+    size *= 2;
+  }
+  buffer_.resize(size);
+  mask_ = size - 1;
+}
+
+void RingSink::copy_in(uint64_t pos, const void* src, uint64_t len) {
+  const uint64_t offset = pos & mask_;
+  const uint64_t first = std::min(len, buffer_.size() - offset);
+  std::memcpy(&buffer_[offset], src, first);
+  std::memcpy(&buffer_[0], static_cast<const char*>(src) + first, len - first);
+}
+
+void RingSink::copy_out(uint64_t pos, void* dst, uint64_t len) const {
+  const uint64_t offset = pos & mask_;
+  const uint64_t first = std::min(len, buffer_.size() - offset);
+  std::memcpy(dst, &buffer_[offset], first);
+  std::memcpy(static_cast<char*>(dst) + first, &buffer_[0], len - first);
+}
+
+bool RingSink::consume(const char* row, uint64_t length) {
+  // each record is [length][bytes]
+  const uint64_t need = sizeof(uint64_t) + length;
+  if (buffer_.size() < need) {
+    throw std::runtime_error("row does not fit in the result ring");
+  }
+  const uint64_t tail = tail_.load(std::memory_order_relaxed);
+  while (buffer_.size() - (tail - head_.load(std::memory_order_acquire)) < need) {
+    if (cancelled_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    std::this_thread::yield();
+  }
+  if (cancelled_.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  copy_in(tail, &length, sizeof(length));
+  copy_in(tail + sizeof(length), row, length);
+  tail_.store(tail + need, std::memory_order_release);
+  return true;
+}
+
+void RingSink::finish() {
+  closed_.store(true, std::memory_order_release);
+}
+
+bool RingSink::pop(std::vector<char>& row) {
+  const uint64_t head = head_.load(std::memory_order_relaxed);
+  while (tail_.load(std::memory_order_acquire) == head) {
+    if (closed_.load(std::memory_order_acquire)) {
+      // the last rows may have been published right before closing
+      if (tail_.load(std::memory_order_acquire) == head) {
+        return false;
+      }
+      break;
+    }
+    std::this_thread::yield();
+  }
+  uint64_t length;
+  copy_out(head, &length, sizeof(length));
+  row.resize(length);
+  copy_out(head + sizeof(length), row.data(), length);
+  head_.store(head + sizeof(length) + length, std::memory_order_release);
+  return true;
+}
+
+void RingSink::cancel() {
+  cancelled_.store(true, std::memory_order_relaxed);
+}
+
+}  // namespace reir
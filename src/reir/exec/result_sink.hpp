@@ -0,0 +1,93 @@
+#ifndef REIR_RESULT_SINK_HPP_
+#define REIR_RESULT_SINK_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace reir {
+
+// receives emitted rows while the query runs. set one with
+// CompilerContext::set_sink(), otherwise rows are collected in outputs_.
+class ResultSink {
+ public:
+  virtual ~ResultSink() = default;
+  // row is only valid during the call. returning false cancels the query,
+  // no more rows are delivered after that.
+  virtual bool consume(const char* row, uint64_t length) = 0;
+  // called once after the procedure returns
+  virtual void finish() {}
+};
+
+struct RowView {
+  const char* data;
+  uint64_t length;
+};
+
+// keeps rows back to back in one buffer, no allocation per row.
+// with a capacity the buffer never grows, and the query is cancelled
+// when the next row would not fit.
+class BufferSink : public ResultSink {
+ public:
+  explicit BufferSink(uint64_t capacity = 0);
+
+  bool consume(const char* row, uint64_t length) override;
+
+  size_t size() const { return offsets_.size(); }
+  RowView row(size_t i) const;
+  void clear();
+
+ private:
+  std::vector<char> data_;
+  std::vector<uint64_t> offsets_;
+  uint64_t capacity_;
+};
+
+class CallbackSink : public ResultSink {
+ public:
+  using Callback = std::function<bool(const char* row, uint64_t length)>;
+
+  explicit CallbackSink(Callback cb) : cb_(std::move(cb)) {}
+
+  bool consume(const char* row, uint64_t length) override {
+    return cb_(row, length);
+  }
+
+ private:
+  Callback cb_;
+};
+
+// bounded single producer / single consumer ring. the query thread produces,
+// another thread pops. the producer waits while the ring is full, so a slow
+// consumer holds the scan back instead of the results piling up in memory.
+class RingSink : public ResultSink {
+ public:
+  // capacity is rounded up to a power of 2
+  explicit RingSink(uint64_t capacity);
+
+  // producer side
+  bool consume(const char* row, uint64_t length) override;
+  void finish() override;
+
+  // consumer side. waits for the next row, false once the producer
+  // finished and everything was popped
+  bool pop(std::vector<char>& row);
+  // makes the next consume() return false, the query stops at its next row
+  void cancel();
+
+ private:
+  void copy_in(uint64_t pos, const void* src, uint64_t len);
+  void copy_out(uint64_t pos, void* dst, uint64_t len) const;
+
+  std::vector<char> buffer_;
+  uint64_t mask_;
+  alignas(64) std::atomic<uint64_t> head_;  // next byte to read
+  alignas(64) std::atomic<uint64_t> tail_;  // next byte to write
+  std::atomic<bool> closed_;
+  std::atomic<bool> cancelled_;
+};
+
+}  // namespace reir
+
+#endif  // REIR_RESULT_SINK_HPP_
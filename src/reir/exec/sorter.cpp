@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "sorter.hpp"
+
+namespace reir {
+
+RowSorter::RowSorter(uint64_t key_words, uint64_t payload_words,
+                     uint64_t limit, uint64_t memory_budget)
+    : key_words_(key_words), record_words_(key_words + payload_words), limit_(limit),
+      budget_records_(1), count_(0), read_pos_(0), finished_(false) {
+  if (record_words_ == 0) {
+    throw std::runtime_error("sort record must not be empty");
+  }
+  budget_records_ = std::max<uint64_t>(memory_budget / (record_words_ * sizeof(uint64_t)), 1);
+}
+
+RowSorter::~RowSorter() {
+  for (auto& run : runs_) {
+    std::fclose(run.file);
+  }
+}
+
+bool RowSorter::less(const uint64_t* a, const uint64_t* b) const {
+  for (uint64_t i = 0; i < key_words_; ++i) {
+    if (a[i] != b[i]) {
+      return a[i] < b[i];
+    }
+  }
+  return false;
+}
+
+void RowSorter::add(const uint64_t* record) {
+  if (finished_) {
+    throw std::runtime_error("sorter is already finished");
+  }
+  if (limit_ != 0) {
+    // top-N, a max heap of the kept records. a record equal to the current
+    // maximum does not get in, so earlier rows win ties.
+    auto cmp = [this](uint64_t a, uint64_t b) { return less(at(buffer_, a), at(buffer_, b)); };
+    if (count_ < limit_) {
+      buffer_.insert(buffer_.end(), record, record + record_words_);
+      heap_.push_back(count_++);
+      std::push_heap(heap_.begin(), heap_.end(), cmp);
+      return;
+    }
+    if (!less(record, at(buffer_, heap_.front()))) {
+      return;
+    }
+    std::pop_heap(heap_.begin(), heap_.end(), cmp);
+    std::memcpy(buffer_.data() + heap_.back() * record_words_, record, record_words_ * sizeof(uint64_t));
+    std::push_heap(heap_.begin(), heap_.end(), cmp);
+    return;
+  }
+  buffer_.insert(buffer_.end(), record, record + record_words_);
+  if (++count_ >= budget_records_) {
+    spill();
+  }
+}
+
+void RowSorter::radix_sort(std::vector<uint64_t>& buf, uint64_t n) {
+  // LSD radix sort on bytes, least significant byte of the last key word first.
+  // it is stable, and passes where every record has the same byte are skipped,
+  // which is most of them for small integer keys.
+  scratch_.resize(n * record_words_);
+  for (uint64_t w = key_words_; w-- > 0;) {
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+      uint64_t offsets[256] = {};
+      for (uint64_t i = 0; i < n; ++i) {
+        ++offsets[(at(buf, i)[w] >> shift) & 0xff];
+      }
+      if (std::find(std::begin(offsets), std::end(offsets), n) != std::end(offsets)) {
+        continue;
+      }
+      uint64_t sum = 0;
+      for (auto& o : offsets) {
+        auto c = o;
+        o = sum;
+        sum += c;
+      }
+      for (uint64_t i = 0; i < n; ++i) {
+        const uint64_t* src = at(buf, i);
+        uint64_t* dst = scratch_.data() + offsets[(src[w] >> shift) & 0xff]++ * record_words_;
+        std::memcpy(dst, src, record_words_ * sizeof(uint64_t));
+      }
+      buf.swap(scratch_);
+    }
+  }
+}
+
+void RowSorter::spill() {
+  if (count_ == 0) {
+    return;
+  }
+  radix_sort(buffer_, count_);
+  std::FILE* file = std::tmpfile();
+  if (file == nullptr) {
+    throw std::runtime_error("failed to create sort spill file");
+  }
+  if (std::fwrite(buffer_.data(), record_words_ * sizeof(uint64_t), count_, file) != count_) {
+    std::fclose(file);
+    throw std::runtime_error("failed to write sort spill file");
+  }
+  runs_.push_back(Run{file, {}, 0, 0});
+  buffer_.clear();
+  count_ = 0;
+}
+
+bool RowSorter::fill(Run& run) {
+  run.pos = 0;
+  run.count = std::fread(run.buffer.data(), record_words_ * sizeof(uint64_t),
+                         run.buffer.size() / record_words_, run.file);
+  return run.count != 0;
+}
+
+bool RowSorter::run_after(size_t a, size_t b) const {
+  // ties go to the earlier run, which keeps the sort stable
+  const uint64_t* ha = head(runs_[a]);
+  const uint64_t* hb = head(runs_[b]);
+  return less(hb, ha) || (!less(ha, hb) && b < a);
+}
+
+void RowSorter::finish() {
+  if (finished_) {
+    return;
+  }
+  finished_ = true;
+  if (runs_.empty()) {
+    radix_sort(buffer_, count_);
+    scratch_ = std::vector<uint64_t>();
+    return;
+  }
+  spill();
+  buffer_ = std::vector<uint64_t>();
+  scratch_ = std::vector<uint64_t>();
+
+  // split the budget between the read buffers of the runs
+  const uint64_t per_run = std::max<uint64_t>(budget_records_ / runs_.size(), 1);
+  auto cmp = [this](size_t a, size_t b) { return run_after(a, b); };
+  for (size_t i = 0; i < runs_.size(); ++i) {
+    auto& run = runs_[i];
+    std::rewind(run.file);
+    run.buffer.resize(per_run * record_words_);
+    if (fill(run)) {
+      merge_.push_back(i);
+      std::push_heap(merge_.begin(), merge_.end(), cmp);
+    }
+  }
+}
+
+bool RowSorter::next(uint64_t* out) {
+  finish();
+  if (runs_.empty()) {
+    if (read_pos_ >= count_) {
+      return false;
+    }
+    std::memcpy(out, at(buffer_, read_pos_++), record_words_ * sizeof(uint64_t));
+    return true;
+  }
+  if (merge_.empty()) {
+    return false;
+  }
+  auto cmp = [this](size_t a, size_t b) { return run_after(a, b); };
+  std::pop_heap(merge_.begin(), merge_.end(), cmp);
+  auto& run = runs_[merge_.back()];
+  std::memcpy(out, head(run), record_words_ * sizeof(uint64_t));
+  if (++run.pos == run.count && !fill(run)) {
+    merge_.pop_back();
+  } else {
+    std::push_heap(merge_.begin(), merge_.end(), cmp);
+  }
+  return true;
+}
+
+}  // namespace reir
+
+extern "C" {
+
+reir::RowSorter* reir_sorter_create(uint64_t key_words, uint64_t payload_words,
+                                    uint64_t limit, uint64_t memory_budget) {
+  return new reir::RowSorter(key_words, payload_words, limit, memory_budget);
+}
+
+void reir_sorter_add(reir::RowSorter* sorter, const uint64_t* record) {
+  sorter->add(record);
+}
+
+void reir_sorter_finish(reir::RowSorter* sorter) {
+  sorter->finish();
+}
+
+bool reir_sorter_next(reir::RowSorter* sorter, uint64_t* out) {
+  return sorter->next(out);
+}
+
+void reir_sorter_destroy(reir::RowSorter* sorter) {
+  delete sorter;
+}
+
+}
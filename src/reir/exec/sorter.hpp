@@ -0,0 +1,80 @@
+#ifndef REIR_SORTER_HPP_
+#define REIR_SORTER_HPP_
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace reir {
+
+// sorts fixed width records of [sort key words][payload words] by the key words,
+// compared as unsigned integers, first word first. generated code encodes signed
+// and descending keys so that the plain unsigned order is the wanted one.
+// without a limit, equal keys keep their insertion order.
+//
+// with a limit only the smallest `limit` records are kept (top-N). otherwise
+// records are buffered up to the memory budget, and every full buffer is sorted
+// and spilled to a temporary file as a run, runs are merged in next().
+class RowSorter {
+ public:
+  static constexpr uint64_t kDefaultMemoryBudget = 64ULL << 20;
+
+  RowSorter(uint64_t key_words, uint64_t payload_words,
+            uint64_t limit = 0, uint64_t memory_budget = kDefaultMemoryBudget);
+  ~RowSorter();
+  RowSorter(const RowSorter&) = delete;
+  RowSorter& operator=(const RowSorter&) = delete;
+
+  void add(const uint64_t* record);
+  // no add() after this
+  void finish();
+  // copies the next record in order into out, false when there are no more
+  bool next(uint64_t* out);
+
+  uint64_t record_words() const { return record_words_; }
+  size_t spilled_runs() const { return runs_.size(); }
+
+ private:
+  struct Run {
+    std::FILE* file;
+    std::vector<uint64_t> buffer;
+    uint64_t pos;
+    uint64_t count;
+  };
+
+  const uint64_t* at(const std::vector<uint64_t>& buf, uint64_t i) const {
+    return buf.data() + i * record_words_;
+  }
+  bool less(const uint64_t* a, const uint64_t* b) const;
+  void radix_sort(std::vector<uint64_t>& buf, uint64_t n);
+  void spill();
+  bool fill(Run& run);
+  bool run_after(size_t a, size_t b) const;
+  const uint64_t* head(const Run& run) const { return run.buffer.data() + run.pos * record_words_; }
+
+  uint64_t key_words_;
+  uint64_t record_words_;
+  uint64_t limit_;
+  uint64_t budget_records_;
+  std::vector<uint64_t> buffer_;
+  std::vector<uint64_t> scratch_;
+  uint64_t count_;
+  std::vector<uint64_t> heap_;  // top-N, indices into buffer_ ordered as a max heap
+  std::vector<Run> runs_;
+  std::vector<size_t> merge_;   // min heap of runs_ indices
+  uint64_t read_pos_;
+  bool finished_;
+};
+
+}  // namespace reir
+
+extern "C" {
+reir::RowSorter* reir_sorter_create(uint64_t key_words, uint64_t payload_words,
+                                    uint64_t limit, uint64_t memory_budget);
+void reir_sorter_add(reir::RowSorter* sorter, const uint64_t* record);
+void reir_sorter_finish(reir::RowSorter* sorter);
+bool reir_sorter_next(reir::RowSorter* sorter, uint64_t* out);
+void reir_sorter_destroy(reir::RowSorter* sorter);
+}
+
+#endif  // REIR_SORTER_HPP_
@@ -0,0 +1,64 @@
+#include <cstdio>
+#include <ostream>
+#include <stdexcept>
+
+#include "statement_profile.hpp"
+
+namespace reir {
+
+StatementCounters* StatementProfile::enter(const std::string& label, int row) {
+  Entry e;
+  e.label = label;
+  e.row = row;
+  e.depth = open_.size();
+  e.has_body = false;
+  e.counters.reset(new StatementCounters);
+  open_.push_back(entries_.size());
+  entries_.push_back(std::move(e));
+  return entries_.back().counters.get();
+}
+
+StatementCounters* StatementProfile::enter_body() {
+  if (open_.empty()) {
+    return nullptr;  // the procedure itself
+  }
+  auto& e = entries_[open_.back()];
+  e.has_body = true;
+  return e.counters.get();
+}
+
+StatementCounters* StatementProfile::leave(bool* leaf) {
+  if (open_.empty()) {
+    throw std::runtime_error("statement profile: leave without enter");
+  }
+  auto& e = entries_[open_.back()];
+  open_.pop_back();
+  *leaf = !e.has_body;
+  return e.counters.get();
+}
+
+void StatementProfile::print(std::ostream& o) const {
+  uint64_t total = 0;
+  for (const auto& e : entries_) {
+    if (e.depth == 0) {
+      total += e.counters->cycles;
+    }
+  }
+  char line[96];
+  std::snprintf(line, sizeof(line), "%5s %10s %10s %14s %6s  %s\n",
+                "line", "calls", "rows", "cycles", "%", "statement");
+  o << line;
+  for (const auto& e : entries_) {
+    const auto& c = *e.counters;
+    const double share = total == 0 ? 0.0 : 100.0 * c.cycles / total;
+    std::snprintf(line, sizeof(line), "%5d %10llu %10llu %14llu %6.1f  ",
+                  e.row,
+                  static_cast<unsigned long long>(c.calls),
+                  static_cast<unsigned long long>(c.rows),
+                  static_cast<unsigned long long>(c.cycles),
+                  share);
+    o << line << std::string(2 * e.depth, ' ') << e.label << "\n";
+  }
+}
+
+}  // namespace reir
@@ -0,0 +1,54 @@
+#ifndef REIR_STATEMENT_PROFILE_HPP_
+#define REIR_STATEMENT_PROFILE_HPP_
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace reir {
+
+// what the instrumented code of one statement adds to. parallel bodies run on
+// several workers, so the generated code updates them with atomic adds
+struct StatementCounters {
+  uint64_t calls = 0;
+  uint64_t rows = 0;    // times its body ran, or its calls if it has no body
+  uint64_t cycles = 0;  // including the statements nested in it
+};
+
+// the statements of one procedure in the order they were generated, each under
+// the statement it is nested in. only built with -DREIR_PROFILE_STATEMENTS=ON,
+// see CompilerContext::profile_begin
+class StatementProfile {
+ public:
+  // a new statement nested in the one being generated
+  StatementCounters* enter(const std::string& label, int row);
+  // the statement being generated has a body, that runs once per row
+  StatementCounters* enter_body();
+  // done with the statement being generated. returns its counters and whether
+  // no body was generated inside it
+  StatementCounters* leave(bool* leaf);
+
+  size_t size() const { return entries_.size(); }
+  const StatementCounters& counters(size_t i) const { return *entries_[i].counters; }
+
+  // one line per statement like explain analyze, the share of cycles is of all
+  // the top level statements
+  void print(std::ostream& o) const;
+
+ private:
+  struct Entry {
+    std::string label;
+    int row;
+    size_t depth;
+    bool has_body;
+    std::unique_ptr<StatementCounters> counters;  // the generated code keeps its address
+  };
+  std::vector<Entry> entries_;
+  std::vector<size_t> open_;
+};
+
+}  // namespace reir
+
+#endif  // REIR_STATEMENT_PROFILE_HPP_
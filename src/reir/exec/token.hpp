@@ -276,6 +276,14 @@ public:
     ++idx_;
   }
 
+  // the token n places ahead of the current one, nothing is consumed
+  const reir::Token& peek(size_t n) const {
+    if (tokens_.size() <= idx_ + n) {
+      throw std::runtime_error("reached EOF of tokens");
+    }
+    return tokens_[idx_ + n];
+  }
+
   size_t pos() const {
     return idx_;
   }
@@ -26,9 +26,9 @@ inline bool in_reserverd_word(const util::slice& word) {
 
 inline void add_token(std::vector<Token>& ret, const util::slice& word, int row, int col) {
   if (in_reserverd_word(word)) {
-    ret.emplace_back(Token{as_reserved(word), word, row});
+    ret.emplace_back(Token{as_reserved(word), word, row, col});
   } else {
-    ret.emplace_back(Token{IDENTIFIER, word, col});
+    ret.emplace_back(Token{IDENTIFIER, word, row, col});
   }
 }
 
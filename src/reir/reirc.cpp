@@ -3,6 +3,7 @@
 //
 
 #include <fstream>
+#include <sstream>
 #include <cmdline.h>
 
 #include "reir/exec/reir_context.hpp"
@@ -13,7 +14,17 @@ int main(int argc, char** argv) {
 
   a.add<std::string>("file", 'f', "target reir file", false, "");
   a.add<std::string>("exec", 'e', "execute reir code directly", false, "");
+  a.add<int>("threads", 't', "worker threads, parallel for uses all of them", false, 1);
+  a.add<std::string>("config", 'c', "engine config file, one key = value per line", false, "");
+  a.add<std::string>("option", 'o', "engine options, key=value[,key=value...], override the config file", false, "");
+  a.add<int>("page-pool-mb", '\0', "page pool size per NUMA node in MB", false, 1024);
+  a.add<std::string>("log-dir", '\0', "folder of the transaction logs", false, "./log");
+  a.add<std::string>("snapshot-dir", '\0', "folder of the snapshots", false, "./snapshot");
 
+  a.add("stats", '\0', "print transaction counters and latencies at exit");
+  a.add("explain", '\0', "print the time of every compile phase and the code size");
+  a.add("explain-ir", '\0', "with --explain, also dump the IR before and after optimization");
+  a.add("explain-asm", '\0', "with --explain, also dump the emitted machine code");
   a.add("version", 'v', "show version");
 
   // Run parser.
@@ -26,13 +37,57 @@ int main(int argc, char** argv) {
     std::cout << "reir-0.1dev" << std::endl;
     return 0;
   }
+  // the file first, then -o, then the dedicated flags
+  reir::EngineConfig config;
+  try {
+    if (a.exist("config")) {
+      config.load_file(a.get<std::string>("config"));
+    }
+    if (a.exist("option")) {
+      std::stringstream options(a.get<std::string>("option"));
+      std::string option;
+      while (std::getline(options, option, ',')) {
+        const auto eq = option.find('=');
+        if (eq == std::string::npos) {
+          throw std::runtime_error("engine option needs key=value: " + option);
+        }
+        config.set(option.substr(0, eq), option.substr(eq + 1));
+      }
+    }
+    if (a.exist("threads")) {
+      config.set("threads", std::to_string(a.get<int>("threads")));
+    }
+    if (a.exist("page-pool-mb")) {
+      config.set("page_pool_size_mb_per_node", std::to_string(a.get<int>("page-pool-mb")));
+    }
+    if (a.exist("log-dir")) {
+      config.log_dir = a.get<std::string>("log-dir");
+    }
+    if (a.exist("snapshot-dir")) {
+      config.snapshot_dir = a.get<std::string>("snapshot-dir");
+    }
+    config.validate();
+  } catch (const std::runtime_error& e) {
+    std::cout << e.what() << "\n";
+    return 1;
+  }
+
+  reir::ExplainOptions explain;
+  explain.enabled = a.exist("explain") || a.exist("explain-ir") || a.exist("explain-asm");
+  explain.ir = a.exist("explain-ir");
+  explain.assembly = a.exist("explain-asm");
+
   if (a.exist("file")) {
-    reir::reir_context ctx;
+    reir::reir_context ctx(config);
+    ctx.set_explain(explain);
     std::ifstream t(a.get<std::string>("file"));
     if (t.is_open()) {
       std::string code((std::istreambuf_iterator<char>(t)),
                        std::istreambuf_iterator<char>());
-      ctx.execute(code);
+      ctx.execute(code, a.get<std::string>("file"));
+      if (a.exist("stats")) {
+        ctx.print_stats(std::cout);
+      }
       return 0;
     } else {
       std::cout << "file " << a.get<std::string>("file") << " does not exist\n";
@@ -40,9 +95,13 @@ int main(int argc, char** argv) {
     }
   }
   if (a.exist("exec")) {
-    reir::reir_context ctx;
+    reir::reir_context ctx(config);
+    ctx.set_explain(explain);
     auto code = a.get<std::string>("exec");
     ctx.execute(code);
+    if (a.exist("stats")) {
+      ctx.print_stats(std::cout);
+    }
     return 0;
   }
 
@@ -0,0 +1,187 @@
+//
+// TPC-C driver: loads the tables with examples/tpcc/load.rir and runs the
+// standard mix of the five procedures on the worker threads of the engine
+//
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <cmdline.h>
+
+#include "reir/exec/reir_context.hpp"
+
+namespace {
+
+const char* const kProcedures[] = {
+    "new_order", "payment", "order_status", "delivery", "stock_level"};
+
+std::string read_file(const std::string& dir, const std::string& name) {
+  const std::string path = dir + "/" + name + ".rir";
+  std::ifstream t(path);
+  if (!t.is_open()) {
+    throw std::runtime_error("file " + path + " does not exist");
+  }
+  return std::string((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+}
+
+// replaces every $name by its value. the language has no parameters, so the
+// scale and the procedures bodies are pasted into the code before it compiles
+std::string expand(const std::string& code, const std::map<std::string, std::string>& values) {
+  std::string ret;
+  size_t i = 0;
+  while (i < code.size()) {
+    if (code[i] != '$') {
+      ret += code[i++];
+      continue;
+    }
+    size_t end = i + 1;
+    while (end < code.size() && (std::isalnum(code[end]) || code[end] == '_')) {
+      ++end;
+    }
+    const std::string name = code.substr(i + 1, end - i - 1);
+    const auto it = values.find(name);
+    if (it == values.end()) {
+      throw std::runtime_error("no value for $" + name);
+    }
+    ret += it->second;
+    i = end;
+  }
+  return ret;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double millis(uint64_t nanos) {
+  return nanos / 1e6;
+}
+
+void report(const std::map<std::string, reir::TxnStats>& stats, double elapsed, std::ostream& o) {
+  uint64_t new_orders = 0;
+  uint64_t commits = 0;
+  uint64_t aborts = 0;
+  char line[160];
+  std::snprintf(line, sizeof(line), "%-14s %10s %8s %8s %10s %10s %10s %10s\n",
+                "procedure", "commits", "aborts", "abort%", "p50 ms", "p90 ms", "p99 ms", "max ms");
+  o << line;
+  for (const char* name : kProcedures) {
+    const auto it = stats.find(name);
+    if (it == stats.end()) {
+      continue;
+    }
+    const auto& s = it->second;
+    const auto& latency = s.begin_to_commit;
+    const uint64_t attempts = s.commits + s.total_aborts();
+    std::snprintf(line, sizeof(line), "%-14s %10llu %8llu %8.3f %10.3f %10.3f %10.3f %10.3f\n",
+                  name,
+                  static_cast<unsigned long long>(s.commits),
+                  static_cast<unsigned long long>(s.total_aborts()),
+                  attempts == 0 ? 0.0 : 100.0 * s.total_aborts() / attempts,
+                  millis(latency.percentile(50)), millis(latency.percentile(90)),
+                  millis(latency.percentile(99)), millis(latency.max()));
+    o << line;
+    for (const auto& a : s.aborts) {
+      o << "  aborted by " << a.first << ": " << a.second << "\n";
+    }
+    if (std::string(name) == "new_order") {
+      new_orders = s.commits;
+    }
+    commits += s.commits;
+    aborts += s.total_aborts();
+  }
+  std::snprintf(line, sizeof(line), "%llu transactions in %.3f s, %.1f per second, %.3f%% aborted\n",
+                static_cast<unsigned long long>(commits), elapsed, commits / elapsed,
+                commits + aborts == 0 ? 0.0 : 100.0 * aborts / (commits + aborts));
+  o << line;
+  std::snprintf(line, sizeof(line), "tpmC %.1f\n", new_orders * 60.0 / elapsed);
+  o << line;
+}
+
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+  cmdline::parser a;
+
+  a.add<std::string>("dir", 'd', "folder of the TPC-C reir files", false, "examples/tpcc");
+  a.add<int>("warehouses", 'w', "number of warehouses", false, 1);
+  a.add<int>("transactions", 'n', "transactions of the mix to run", false, 100000);
+  a.add<int>("items", '\0', "items, 100000 in the spec", false, 100000);
+  a.add<int>("customers", '\0', "customers per district, 3000 in the spec", false, 3000);
+  a.add<int>("threads", 't', "worker threads", false, 1);
+  a.add<std::string>("config", 'c', "engine config file, one key = value per line", false, "");
+  a.add<std::string>("option", 'o', "engine options, key=value[,key=value...], override the config file", false, "");
+  a.add("stats", '\0', "also print the full transaction stats of the load and the mix");
+  a.parse_check(argc, argv);
+
+  try {
+    reir::EngineConfig config;
+    if (a.exist("config")) {
+      config.load_file(a.get<std::string>("config"));
+    }
+    if (a.exist("option")) {
+      std::stringstream options(a.get<std::string>("option"));
+      std::string option;
+      while (std::getline(options, option, ',')) {
+        const auto eq = option.find('=');
+        if (eq == std::string::npos) {
+          throw std::runtime_error("engine option needs key=value: " + option);
+        }
+        config.set(option.substr(0, eq), option.substr(eq + 1));
+      }
+    }
+    if (a.exist("threads")) {
+      config.set("threads", std::to_string(a.get<int>("threads")));
+    }
+    config.validate();
+
+    const int warehouses = a.get<int>("warehouses");
+    const int items = a.get<int>("items");
+    const int customers = a.get<int>("customers");
+    if (warehouses <= 0 || items <= 0 || customers < 10) {
+      throw std::runtime_error("warehouses and items must be positive, customers at least 10");
+    }
+    const std::string dir = a.get<std::string>("dir");
+    std::map<std::string, std::string> values = {
+        {"warehouses", std::to_string(warehouses)},
+        {"items", std::to_string(items)},
+        {"customers", std::to_string(customers)},
+        {"undelivered", std::to_string(customers * 3 / 10)},  // 900 of 3000 in the spec
+        {"district_rows", std::to_string(warehouses * 10)},
+        {"customer_rows", std::to_string(warehouses * 10 * customers)},
+        {"stock_rows", std::to_string(warehouses * items)},
+        {"transactions", std::to_string(a.get<int>("transactions"))},
+    };
+    for (const char* name : kProcedures) {
+      values[name] = expand(read_file(dir, name), values);
+    }
+
+    reir::reir_context ctx(config);
+    auto start = std::chrono::steady_clock::now();
+    ctx.execute(expand(read_file(dir, "schema"), values), "tpcc schema");
+    ctx.execute(expand(read_file(dir, "load"), values), "tpcc load");
+    std::cout << "loaded " << warehouses << " warehouses in " << seconds_since(start) << " s\n";
+    if (a.exist("stats")) {
+      ctx.print_stats(std::cout);
+    }
+    ctx.reset_stats();
+
+    // the time includes compiling the mix, it is dwarfed by any run worth measuring
+    start = std::chrono::steady_clock::now();
+    ctx.execute(expand(read_file(dir, "mix"), values), "tpcc mix");
+    const double elapsed = seconds_since(start);
+    if (a.exist("stats")) {
+      ctx.print_stats(std::cout);
+    }
+    report(ctx.stats(), elapsed, std::cout);
+  } catch (const std::runtime_error& e) {
+    std::cout << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -21,47 +21,10 @@
 
 #include "reir/exec/parser.hpp"
 #include "reir/db/maybe_value.hpp"
+#include "dummy_db.hpp"
 
 namespace reir {
 
-struct DummyDB : public DBInterface {
-
-  std::string get_name() override {
-    return DBInterface::get_name();
-  }
-
-  void define_functions(CompilerContext& ctx) override {}
-
-  void emit_precommit_txn(CompilerContext& ctx) override {}
-
-  void emit_begin_txn(CompilerContext& ctx) override {};
-
-  void emit_insert(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* value,
-                   llvm::Value* value_len) override {}
-
-  void emit_update(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* value,
-                   llvm::Value* value_len) override {}
-
-  void emit_delete(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len) override {}
-
-  void emit_scan( CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* offset)  override {}
-
-  CursorBase* emit_get_cursor(CompilerContext& ctx,
-                              llvm::Value* from_prefix, llvm::Value* from_len,
-                              llvm::Value* to_prefix, llvm::Value* to_len) override {
-    return nullptr;
-  }
-  llvm::Value* emit_cursor_next(CompilerContext& ctx, CursorBase* cursor) override {
-    return ctx.builder_.getInt1(false);
-  }
-  llvm::Value* emit_is_valid_cursor(CompilerContext& ctx, CursorBase* cursor) override {
-    return ctx.builder_.getInt1(false);
-  }
-  void emit_cursor_copy_key(CompilerContext& ctx, CursorBase* c, llvm::Value* buffer) override {}
-  void emit_cursor_copy_value(CompilerContext& ctx, CursorBase* c, llvm::Value* buffer) override {}
-  void emit_cursor_destroy(CompilerContext& ctx, CursorBase* c) override {}
-};
-
 using namespace node;
 
 class AstExecTest : public testing::Test {
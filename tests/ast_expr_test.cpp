@@ -9,47 +9,10 @@
 #include "reir/exec/executor.hpp"
 #include "reir/exec/storage.hpp"
 #include "reir/engine/foedus_runner.hpp"
+#include "dummy_db.hpp"
 
 namespace reir {
 
-struct DummyDB : public DBInterface {
-
-  std::string get_name() override {
-    return DBInterface::get_name();
-  }
-
-  void define_functions(CompilerContext& ctx) override {}
-
-  void emit_precommit_txn(CompilerContext& ctx) override {}
-
-  void emit_begin_txn(CompilerContext& ctx) override {};
-
-  void emit_insert(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* value,
-                   llvm::Value* value_len) override {}
-
-  void emit_update(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* value,
-                   llvm::Value* value_len) override {}
-
-  void emit_delete(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len) override {}
-
-  void emit_scan( CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* offset)  override {}
-
-  CursorBase* emit_get_cursor(CompilerContext& ctx,
-                              llvm::Value* from_prefix, llvm::Value* from_len,
-                              llvm::Value* to_prefix, llvm::Value* to_len) override {
-    return nullptr;
-  }
-  llvm::Value* emit_cursor_next(CompilerContext& ctx, CursorBase* cursor) override {
-    return ctx.builder_.getInt1(false);
-  }
-  llvm::Value* emit_is_valid_cursor(CompilerContext& ctx, CursorBase* cursor) override {
-    return ctx.builder_.getInt1(false);
-  }
-  void emit_cursor_copy_key(CompilerContext& ctx, CursorBase* c, llvm::Value* buffer) override {}
-  void emit_cursor_copy_value(CompilerContext& ctx, CursorBase* c, llvm::Value* buffer) override {}
-  void emit_cursor_destroy(CompilerContext& ctx, CursorBase* c) override {}
-};
-
 using namespace node;
 
 class AstExprTest : public testing::Test {
@@ -308,4 +271,75 @@ TEST_F(AstExprTest, test_short_circuit) {
   EXPECT_EQ(3, results.size());
 }
 
+TEST_F(AstExprTest, break_for_loop) {
+  // for x = 0; x < 10; x = x + 1 { if x == 3 { break } emit {x} }
+  node::Block blk({
+      new For(
+          new Let("x", new PrimaryExpression(MaybeValue(0))),
+          new BinaryExpression(new VariableReference("x"),
+                               operators::LESSTHAN,
+                               new PrimaryExpression(MaybeValue(10))),
+          new Assign(new VariableReference("x"),
+                     new BinaryExpression(new VariableReference("x"),
+                                          operators::PLUS,
+                                          new PrimaryExpression(MaybeValue(1)))),
+          new Block({
+              new If(new BinaryExpression(new VariableReference("x"),
+                                          operators::EQUAL,
+                                          new PrimaryExpression(MaybeValue(3))),
+                     new Block({new Jump(Jump::break_jump)}), {}),
+              new Emit(new RowLiteral({new VariableReference("x")}))
+          })
+      )
+  });
+  compile_and_exec(&blk);
+  EXPECT_EQ(3, results.size());
+}
+
+TEST_F(AstExprTest, output_limit_cancels) {
+  node::Block blk({
+      new Emit(new RowLiteral({new PrimaryExpression(MaybeValue(1))})),
+      new Emit(new RowLiteral({new PrimaryExpression(MaybeValue(2))})),
+      new Emit(new RowLiteral({new PrimaryExpression(MaybeValue(3))}))
+  });
+  CompilerContext limited(c, &d, &md);
+  limited.set_output_limit(2);
+  c.compile_and_exec(limited, d, md, &blk);
+  EXPECT_EQ(2, limited.outputs_.size());
+  EXPECT_TRUE(limited.is_cancelled());
+}
+
+TEST_F(AstExprTest, emit_to_sink) {
+  node::Block blk({
+      new Emit(new RowLiteral({new PrimaryExpression(MaybeValue(7))})),
+      new Emit(new RowLiteral({new PrimaryExpression(MaybeValue(8))}))
+  });
+  BufferSink sink;
+  CompilerContext streamed(c, &d, &md);
+  streamed.set_sink(&sink);
+  c.compile_and_exec(streamed, d, md, &blk);
+  EXPECT_TRUE(streamed.outputs_.empty());
+  ASSERT_EQ(2, sink.size());
+  EXPECT_EQ(8, *reinterpret_cast<const uint64_t*>(sink.row(1).data));
+}
+
+TEST_F(AstExprTest, emit_columns) {
+  node::Block blk({
+      new Emit(new RowLiteral({new PrimaryExpression(MaybeValue(1)), new PrimaryExpression(MaybeValue(10))})),
+      new Emit(new RowLiteral({new PrimaryExpression(MaybeValue(2)), new PrimaryExpression(MaybeValue(20))}))
+  });
+  std::vector<int64_t> second;
+  ColumnarSink sink([&](const ColumnBatch& b) {
+    EXPECT_EQ(2, b.columns.size());
+    const auto* values = reinterpret_cast<const int64_t*>(b.columns[1].values.data());
+    second.insert(second.end(), values, values + b.length);
+    return true;
+  });
+  CompilerContext columnar(c, &d, &md);
+  columnar.set_columnar_sink(&sink);
+  c.compile_and_exec(columnar, d, md, &blk);
+  EXPECT_TRUE(columnar.outputs_.empty());
+  EXPECT_EQ((std::vector<int64_t>{10, 20}), second);
+}
+
 }  // namespace reir
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include <vector>
+#include <gtest/gtest.h>
+#include "reir/engine/attempt.hpp"
+
+namespace reir {
+
+TEST(attempt, deferred_until_the_attempt_commits) {
+  std::vector<int> merged;
+  attempt_begin();
+  attempt_defer([&](bool committed) { if (committed) merged.push_back(1); });
+  attempt_defer([&](bool committed) { if (committed) merged.push_back(2); });
+  EXPECT_TRUE(merged.empty());
+  attempt_end(true);
+  EXPECT_EQ((std::vector<int>{1, 2}), merged);
+}
+
+TEST(attempt, aborted_attempts_are_dropped) {
+  std::vector<int> merged;
+  int aborted = 0;
+  // the first attempt loses a race, the retry commits
+  for (int retry = 0; retry < 2; ++retry) {
+    attempt_begin();
+    attempt_defer([&, retry](bool committed) {
+      if (committed) {
+        merged.push_back(retry);
+      } else {
+        ++aborted;
+      }
+    });
+    attempt_end(retry == 1);
+  }
+  EXPECT_EQ((std::vector<int>{1}), merged);
+  EXPECT_EQ(1, aborted);
+}
+
+TEST(attempt, right_away_outside_of_an_attempt) {
+  bool merged = false;
+  attempt_defer([&](bool committed) { merged = committed; });
+  EXPECT_TRUE(merged);
+
+  attempt_begin();
+  attempt_end(true);
+  merged = false;
+  attempt_defer([&](bool committed) { merged = committed; });
+  EXPECT_TRUE(merged);
+}
+
+}  // namespace reir
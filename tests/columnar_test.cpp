@@ -0,0 +1,75 @@
+#include <cstring>
+#include <string>
+#include <gtest/gtest.h>
+#include "reir/exec/columnar.hpp"
+
+namespace reir {
+
+namespace {
+struct Row {
+  int64_t id;
+  double score;
+  bool flag;
+  const char* name;
+  int64_t name_len;
+};
+
+EmitLayout row_layout() {
+  EmitLayout layout;
+  layout.fields.push_back({ColumnType::INT64, offsetof(Row, id)});
+  layout.fields.push_back({ColumnType::DOUBLE, offsetof(Row, score)});
+  layout.fields.push_back({ColumnType::BOOL, offsetof(Row, flag)});
+  layout.fields.push_back({ColumnType::UTF8, offsetof(Row, name)});
+  return layout;
+}
+}  // namespace
+
+TEST(columnar, arrow_layout) {
+  auto layout = row_layout();
+  uint64_t batches = 0;
+  ColumnarSink sink([&](const ColumnBatch& b) {
+    ++batches;
+    EXPECT_EQ(3, b.length);
+    const auto& ids = b.columns[0];
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(ids.values.data()) % ColumnBuffer::kAlignment);
+    EXPECT_EQ(2, reinterpret_cast<const int64_t*>(ids.values.data())[2]);
+    EXPECT_EQ(0x7, ids.validity.data()[0]);
+    EXPECT_EQ(1.5, reinterpret_cast<const double*>(b.columns[1].values.data())[1]);
+    EXPECT_EQ(0x5, b.columns[2].values.data()[0]);  // rows 0 and 2
+    const auto& names = b.columns[3];
+    const auto* offsets = reinterpret_cast<const int32_t*>(names.values.data());
+    EXPECT_EQ(0, offsets[0]);
+    EXPECT_EQ(3, offsets[1]);
+    EXPECT_EQ(3, offsets[2]);
+    EXPECT_EQ(8, offsets[3]);
+    EXPECT_EQ("abcfghij", std::string(reinterpret_cast<const char*>(names.data.data()), names.data.size()));
+    return true;
+  }, 3);
+  Row rows[] = {{0, 0.5, true, "abc", 3}, {1, 1.5, false, "", 0}, {2, 2.5, true, "fghij", 5}};
+  for (const auto& r : rows) {
+    ASSERT_TRUE(sink.append(layout, reinterpret_cast<const char*>(&r)));
+  }
+  ASSERT_TRUE(sink.flush());
+  ASSERT_EQ(1, batches);
+}
+
+TEST(columnar, flush_partial_and_cancel) {
+  auto layout = row_layout();
+  std::vector<uint64_t> lengths;
+  ColumnarSink sink([&](const ColumnBatch& b) {
+    lengths.push_back(b.length);
+    return lengths.size() < 2;
+  }, 4);
+  Row r{1, 1.0, false, "x", 1};
+  bool ok = true;
+  int appended = 0;
+  while (ok && appended < 100) {
+    ok = sink.append(layout, reinterpret_cast<const char*>(&r));
+    ++appended;
+  }
+  ASSERT_FALSE(ok);
+  ASSERT_EQ(8, appended);
+  ASSERT_EQ((std::vector<uint64_t>{4, 4}), lengths);
+}
+
+}  // namespace reir
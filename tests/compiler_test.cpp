@@ -2,6 +2,8 @@
 // Created by kumagi on 18/04/04.
 //
 
+#include <algorithm>
+
 #include <gtest/gtest.h>
 #include <reir/exec/debug.hpp>
 #include <reir/exec/compiler_context.hpp>
@@ -15,47 +17,13 @@
 #include "reir/engine/db_handle.hpp"
 #include "reir/exec/db_interface.hpp"
 #include "reir/exec/parser.hpp"
+#include "reir/exec/result_sink.hpp"
+#include "reir/exec/columnar.hpp"
+#include "reir/engine/runner.hpp"
+#include "dummy_db.hpp"
 
 namespace reir {
 
-struct DummyDB : public DBInterface {
-  std::string get_name()  override {
-    return DBInterface::get_name();
-  }
-
-  void define_functions(CompilerContext& ctx) override {}
-
-  void emit_precommit_txn(CompilerContext& ctx)  override {}
-
-  void emit_begin_txn(CompilerContext& ctx)  override {};
-
-  void emit_insert( CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* value,
-                   llvm::Value* value_len)  override {
-  }
-
-  void emit_update( CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* value,
-                   llvm::Value* value_len)  override {}
-
-  void emit_delete( CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len)  override {}
-
-  void emit_scan( CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* offset)  override {}
-
-  CursorBase* emit_get_cursor(CompilerContext& ctx,
-                              llvm::Value* from_prefix, llvm::Value* from_len,
-                              llvm::Value* to_prefix, llvm::Value* to_len) override {
-    return nullptr;
-  }
-  llvm::Value* emit_cursor_next(CompilerContext& ctx, CursorBase* cursor) override {
-    return ctx.builder_.getInt1(false);
-  }
-  llvm::Value* emit_is_valid_cursor(CompilerContext& ctx, CursorBase* cursor) override {
-    return ctx.builder_.getInt1(false);
-  }
-  void emit_cursor_copy_key(CompilerContext& ctx, CursorBase* c, llvm::Value* buffer) override {}
-  void emit_cursor_copy_value(CompilerContext& ctx, CursorBase* c, llvm::Value* buffer) override {}
-  void emit_cursor_destroy(CompilerContext& ctx, CursorBase* c) override {}
-};
-
 class CompilerTest : public testing::Test {
  protected:
   virtual void SetUp() override {
@@ -221,4 +189,648 @@ TEST_F(CompilerTest, evaluate_assign) {
                    "print_int(p.x)");
 }
 
+TEST_F(CompilerTest, parallel_for) {
+  compile_and_exec("parallel for i in 0 to 4 {\n"
+                   "  let x = i * 10\n"
+                   "  print_int(x)\n"
+                   "}\n"
+                   "parallel for w in 1 to 10 batch 3 {\n"
+                   "  for let d = 0; d < 3; d = d + 1 {\n"
+                   "    print_int(w * 100 + d)\n"
+                   "  }\n"
+                   "}");
+}
+
+TEST_F(CompilerTest, parallel_for_outer_variables) {
+  // copied into the body, writes stay in the iteration
+  compile_and_exec("let y = 1\n"
+                   "parallel for i in 0 to 4 {\n"
+                   "  y = y + i\n"
+                   "  emit {y}\n"
+                   "}\n"
+                   "print_int(y)");
+}
+
+TEST_F(CompilerTest, contextual_keywords_as_names) {
+  compile_and_exec("let sort = 2\n"
+                   "let parallel = sort + 1\n"
+                   "parallel for join in 0 to parallel {\n"
+                   "  let aggregate = join * sort\n"
+                   "  print_int(aggregate)\n"
+                   "}");
+}
+
+TEST_F(CompilerTest, parallel_for_restrictions) {
+  // it commits on its own
+  ASSERT_THROW(compile_and_exec("transaction { parallel for i in 0 to 4 { print_int(i) } }"),
+               std::runtime_error);
+  // and its iterations are transactions already
+  ASSERT_THROW(compile_and_exec("parallel for i in 0 to 4 { transaction { print_int(i) } }"),
+               std::runtime_error);
+  ASSERT_THROW(compile_and_exec("transaction { transaction { print_int(1) } }"),
+               std::runtime_error);
+}
+
+TEST_F(CompilerTest, partition_by) {
+  compile_and_exec("define<{int:did key, int:wid key, int:ytd}> district partition by wid\n"
+                   "parallel for wid in 0 to 4 partitioned {\n"
+                   "  for let did = 0; did < 10; did = did + 1 {\n"
+                   "    insert district {did, wid, 0}\n"
+                   "  }\n"
+                   "}\n"
+                   "transaction {\n"
+                   "  scan district as d where d.wid == 2 {\n"
+                   "    emit {d.did, d.wid}\n"
+                   "  }\n"
+                   "  scan district as d where (d.wid == 1) && (d.did == 3) {\n"
+                   "    emit d\n"
+                   "  }\n"
+                   "}");
+  ASSERT_THROW(compile_and_exec("define<{int:id key, int:v}> p partition by v"),
+               std::runtime_error);
+  ASSERT_THROW(compile_and_exec("define<{int:id key, int:v}> p partition by w"),
+               std::runtime_error);
+}
+
+TEST_F(CompilerTest, storage_choice) {
+  compile_and_exec("define<{int:wid key, int:ytd}> warehouse using array 16\n"
+                   "define<{int:iid key, int:price}> item using hash 1000\n"
+                   "define<{int:hid key, int:amount}> history using sequential\n"
+                   "define<{int:oid key, int:wid}> orders using masstree\n"
+                   "transaction {\n"
+                   "  insert warehouse {1, 100}\n"
+                   "  insert item [{1, 10}, {2, 20}]\n"
+                   "  insert history {1, 5}\n"
+                   "  scan warehouse as w where w.wid < 4 { emit w }\n"
+                   "  scan item as i where i.iid == 2 { emit i }\n"
+                   "  scan history as h where h.hid == 1 { emit h }\n"
+                   "}");
+  // only whole key lookups on a hash table
+  ASSERT_THROW(compile_and_exec("define<{int:iid key, int:price}> item2 using hash\n"
+                                "transaction { scan item2 as i { emit i } }"),
+               std::runtime_error);
+  // an array needs a size and a single int key
+  ASSERT_THROW(compile_and_exec("define<{int:wid key, int:ytd}> w2 using array"), std::runtime_error);
+  ASSERT_THROW(compile_and_exec("define<{int:a key, int:b key, int:v}> w3 using array 10"),
+               std::runtime_error);
+  ASSERT_THROW(compile_and_exec("define<{int:a key, int:v}> w4 using btree"), std::runtime_error);
+}
+
+TEST_F(CompilerTest, secondary_index) {
+  compile_and_exec("define<{int:oid key, int:wid key, int:cid, int:amount}> iorders partition by wid\n"
+                   "transaction { insert iorders {1, 1, 7, 100} }\n"
+                   "define index iorders_customer on iorders(cid, amount)\n"
+                   "transaction {\n"
+                   "  insert iorders {2, 1, 7, 200}\n"
+                   "  insert iorders [{3, 1, 8, 300}, {4, 2, 7, 400}]\n"
+                   "  scan iorders as o where (o.cid == 7) && (o.oid != 2) { emit o }\n"
+                   "  scan iorders as p where (p.amount > 100) && (p.wid == 2) limit 1 { emit p }\n"
+                   "}");
+  // unknown tables and columns, non int columns and hash tables can not be indexed
+  ASSERT_THROW(compile_and_exec("define index nothing on nowhere(a)"), std::runtime_error);
+  ASSERT_THROW(compile_and_exec("define<{int:a key, int:b}> idx1\n"
+                                "define index idx1_c on idx1(c)"),
+               std::runtime_error);
+  ASSERT_THROW(compile_and_exec("define<{int:a key, string(8):b}> idx2\n"
+                                "define index idx2_b on idx2(b)"),
+               std::runtime_error);
+  ASSERT_THROW(compile_and_exec("define<{int:a key, int:b}> idx3 using hash\n"
+                                "define index idx3_b on idx3(b)"),
+               std::runtime_error);
+  ASSERT_THROW(compile_and_exec("define<{int:a key, int:b}> idx4 using array 16\n"
+                                "define index idx4_b on idx4(b)"),
+               std::runtime_error);
+}
+
+TEST_F(CompilerTest, parallel_scan) {
+  compile_and_exec("define<{int:x key, int:y}> pscan\n"
+                   "let threshold = 2\n"
+                   "transaction {\n"
+                   "  insert pscan [{1, 10}, {2, 20}, {3, 30}]\n"
+                   "  parallel scan pscan as row where row.y > threshold {\n"
+                   "    emit {row.x, row.y}\n"
+                   "  }\n"
+                   "  parallel scan pscan as row where row.x >= 2 batch 16 {\n"
+                   "    emit row\n"
+                   "  }\n"
+                   "}");
+  // nested parallel bodies and limits are refused
+  ASSERT_THROW(compile_and_exec("define<{int:x key, int:y}> pscan2\n"
+                                "transaction {\n"
+                                "  scan pscan2 as a {\n"
+                                "    parallel scan pscan2 as b { emit b }\n"
+                                "  }\n"
+                                "}"),
+               std::runtime_error);
+  ASSERT_THROW(compile_and_exec("define<{int:x key, int:y}> pscan3\n"
+                                "transaction {\n"
+                                "  parallel scan pscan3 as r limit 2 { emit r }\n"
+                                "}"),
+               std::runtime_error);
+  // nothing would merge what the workers aggregate, sort or join
+  compile_and_exec("define<{int:x key, int:y}> pscan4");
+  ASSERT_THROW(compile_and_exec("transaction {\n"
+                                "  parallel scan pscan4 as r {\n"
+                                "    aggregate scan pscan4 as a by a.y { count() }\n"
+                                "  }\n"
+                                "}"),
+               std::runtime_error);
+  ASSERT_THROW(compile_and_exec("parallel for i in 0 to 4 {\n"
+                                "  sort scan pscan4 as s by s.y { emit s }\n"
+                                "}"),
+               std::runtime_error);
+  ASSERT_THROW(compile_and_exec("transaction {\n"
+                                "  parallel scan pscan4 as r {\n"
+                                "    join scan pscan4 as b on b.y\n"
+                                "    with scan pscan4 as p on p.y { emit {b.x, p.x} }\n"
+                                "  }\n"
+                                "}"),
+               std::runtime_error);
+}
+
+// runs code on the memory engine, the rows it emits go to sink or columnar
+void run_on_memory(const std::string& ir, ResultSink* sink, ColumnarSink* columnar) {
+  EngineConfig config;
+  config.backend = "memory";
+  auto runner = make_runner(config);
+  Compiler c;
+  MetaData md;
+  runner->run([&](DBInterface& dbi) {
+    parse(ir, [&](node::Node* ast) {
+      CompilerContext ctx(c, &dbi, &md);
+      ctx.set_sink(sink);
+      ctx.set_columnar_sink(columnar);
+      c.compile_and_exec(ctx, dbi, md, ast);
+    });
+  });
+}
+
+void run_on_memory(const std::string& ir, ResultSink& sink) {
+  run_on_memory(ir, &sink, nullptr);
+}
+
+int64_t column_of(const BufferSink& sink, size_t row, size_t column) {
+  return reinterpret_cast<const int64_t*>(sink.row(row).data)[column];
+}
+
+TEST(compiler, insert_then_lookup_by_key) {
+  // the partition column is laid out first, so the key is not in column order
+  BufferSink sink;
+  run_on_memory("define<{int:a key, int:b key, int:v}> lookup partition by b\n"
+                "transaction {\n"
+                "  insert lookup {1, 2, 30}\n"
+                "  insert lookup [{2, 1, 40}, {1, 3, 50}]\n"
+                "}\n"
+                "transaction {\n"
+                "  scan lookup as hit where (hit.a == 1) && (hit.b == 2) {\n"
+                "    emit {hit.v}\n"
+                "  }\n"
+                "  scan lookup as miss where (miss.a == 2) && (miss.b == 2) {\n"
+                "    emit {miss.v}\n"
+                "  }\n"
+                "  scan lookup as part where part.b == 1 {\n"
+                "    emit {part.v}\n"
+                "  }\n"
+                "  scan lookup as upper where (upper.b == 3) && (upper.a <= 1) {\n"
+                "    emit {upper.v}\n"
+                "  }\n"
+                "}", sink);
+  ASSERT_EQ(3U, sink.size());
+  EXPECT_EQ(30, column_of(sink, 0, 0));
+  EXPECT_EQ(40, column_of(sink, 1, 0));
+  EXPECT_EQ(50, column_of(sink, 2, 0));
+}
+
+TEST(compiler, key_ranges) {
+  BufferSink sink;
+  run_on_memory("define<{int:a key, int:b key, int:v}> ranged\n"
+                "transaction {\n"
+                "  for let x = 0 - 3; x < 4; x = x + 1 {\n"
+                "    insert ranged {1, x, x}\n"
+                "    insert ranged {2, x, x}\n"
+                "  }\n"
+                "  insert ranged [{0, 0, 8}, {0 - 1, 0, 7}]\n"
+                "}\n"
+                "transaction {\n"
+                "  scan ranged as s where (s.a == 1) && (s.b > 0 - 2) && (s.b < 2) {\n"
+                "    emit {s.a, s.v}\n"
+                "  }\n"
+                "  scan ranged as t where (t.a == 2) && (t.b > 0 - 3) && (t.b <= 0 - 1) {\n"
+                "    emit {t.a, t.v}\n"
+                "  }\n"
+                "  scan ranged as u where (u.a > 0) && (u.a < 2) {\n"
+                "    emit {u.a, u.v}\n"
+                "  }\n"
+                "  scan ranged as n where n.a < 1 {\n"
+                "    emit {n.a, n.v}\n"
+                "  }\n"
+                "}", sink);
+  // strict bounds leave their value out, negative keys sort before positive ones
+  const std::vector<std::vector<int64_t>> expected{
+      {1, -1}, {1, 0}, {1, 1},
+      {2, -2}, {2, -1},
+      {1, -3}, {1, -2}, {1, -1}, {1, 0}, {1, 1}, {1, 2}, {1, 3},
+      {-1, 7}, {0, 8}};
+  ASSERT_EQ(expected.size(), sink.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i][0], column_of(sink, i, 0)) << i;
+    EXPECT_EQ(expected[i][1], column_of(sink, i, 1)) << i;
+  }
+}
+
+TEST(compiler, lookup_through_index) {
+  BufferSink sink;
+  run_on_memory("define<{int:a key, int:b}> indexed\n"
+                "define index indexed_b on indexed(b)\n"
+                "transaction {\n"
+                "  insert indexed [{1, 7}, {2, 8}, {3, 7}]\n"
+                "}\n"
+                "transaction {\n"
+                "  scan indexed as r where r.b == 7 {\n"
+                "    emit {r.a}\n"
+                "  }\n"
+                "}", sink);
+  ASSERT_EQ(2U, sink.size());
+  EXPECT_EQ(1, column_of(sink, 0, 0));
+  EXPECT_EQ(3, column_of(sink, 1, 0));
+}
+
+TEST(compiler, duplicate_insert_adds_no_entries) {
+  BufferSink sink;
+  run_on_memory("define<{int:a key, int:b}> dup\n"
+                "define index dup_b on dup(b)\n"
+                "transaction {\n"
+                "  insert dup {1, 7}\n"
+                "  insert dup {1, 9}\n"
+                "  insert dup [{2, 7}, {2, 8}, {3, 8}]\n"
+                "}\n"
+                "transaction {\n"
+                "  scan dup as r where r.b == 7 {\n"
+                "    emit {r.a, r.b}\n"
+                "  }\n"
+                "  scan dup as r where r.b == 8 {\n"
+                "    emit {r.a, r.b}\n"
+                "  }\n"
+                "  scan dup as r where r.b == 9 {\n"
+                "    emit {r.a, r.b}\n"
+                "  }\n"
+                "}", sink);
+  // the rows whose key was taken are not found through the index
+  const std::vector<std::vector<int64_t>> expected{{1, 7}, {2, 7}, {3, 8}};
+  ASSERT_EQ(expected.size(), sink.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i][0], column_of(sink, i, 0)) << i;
+    EXPECT_EQ(expected[i][1], column_of(sink, i, 1)) << i;
+  }
+}
+
+TEST(compiler, aggregate_results) {
+  BufferSink sink;
+  run_on_memory("define<{int:x key, int:y, int:z}> agg\n"
+                "transaction {\n"
+                "  insert agg [{1, 1, 5}, {2, 2, 0 - 3}, {3, 1, 7}, {4, 2, 8}, {5, 1, 0 - 4}]\n"
+                "}\n"
+                "transaction {\n"
+                "  aggregate scan agg as r by r.y {\n"
+                "    count(), sum(r.z), min(r.z), max(r.z), avg(r.z)\n"
+                "  }\n"
+                "}", sink);
+  std::vector<std::vector<int64_t>> rows;
+  for (size_t i = 0; i < sink.size(); ++i) {
+    std::vector<int64_t> row;
+    for (size_t j = 0; j < 6; ++j) {
+      row.push_back(column_of(sink, i, j));
+    }
+    rows.push_back(row);
+  }
+  // the groups come in hash table order, avg truncates toward zero
+  std::sort(rows.begin(), rows.end());
+  EXPECT_EQ((std::vector<std::vector<int64_t>>{{1, 3, 8, -4, 7, 2}, {2, 2, 5, -3, 8, 2}}), rows);
+}
+
+TEST(compiler, aggregate_without_groups) {
+  BufferSink sink;
+  run_on_memory("define<{int:x key, int:z}> ungrouped\n"
+                "transaction {\n"
+                "  insert ungrouped [{1, 5}, {2, 0 - 3}, {3, 7}, {4, 8}, {5, 0 - 4}]\n"
+                "}\n"
+                "transaction {\n"
+                "  aggregate scan ungrouped as r {\n"
+                "    count(), sum(r.z), min(r.z), max(r.z), avg(r.z)\n"
+                "  }\n"
+                "  aggregate scan ungrouped as e where 10 < e.x {\n"
+                "    count(), sum(e.z), avg(e.z)\n"
+                "  }\n"
+                "  aggregate scan ungrouped as g where 10 < g.x by g.z {\n"
+                "    count()\n"
+                "  }\n"
+                "}", sink);
+  // an empty input still gives one row without groups, its average is 0.
+  // with groups it gives none
+  ASSERT_EQ(2U, sink.size());
+  const std::vector<int64_t> all{5, 13, -4, 8, 2};
+  for (size_t j = 0; j < all.size(); ++j) {
+    EXPECT_EQ(all[j], column_of(sink, 0, j)) << j;
+  }
+  ASSERT_EQ(3 * sizeof(int64_t), sink.row(1).length);
+  for (size_t j = 0; j < 3; ++j) {
+    EXPECT_EQ(0, column_of(sink, 1, j)) << j;
+  }
+}
+
+TEST(compiler, aggregate_to_columns) {
+  std::vector<std::vector<int64_t>> rows;
+  auto collect = [&](const ColumnBatch& b) {
+    for (uint64_t r = 0; r < b.length; ++r) {
+      std::vector<int64_t> row;
+      for (const auto& column : b.columns) {
+        EXPECT_EQ(ColumnType::INT64, column.type);
+        row.push_back(reinterpret_cast<const int64_t*>(column.values.data())[r]);
+      }
+      rows.push_back(row);
+    }
+    return true;
+  };
+  ColumnarSink sink(collect);
+  run_on_memory("define<{int:x key, int:y}> grouped\n"
+                "transaction {\n"
+                "  insert grouped [{1, 1}, {2, 2}, {3, 1}, {4, 2}, {5, 1}]\n"
+                "}\n"
+                "transaction {\n"
+                "  aggregate scan grouped as r by r.y {\n"
+                "    count(), sum(r.x)\n"
+                "  }\n"
+                "}", nullptr, &sink);
+  // the groups come in hash table order
+  std::sort(rows.begin(), rows.end());
+  EXPECT_EQ((std::vector<std::vector<int64_t>>{{1, 3, 9}, {2, 2, 6}}), rows);
+
+  rows.clear();
+  ColumnarSink single(collect);
+  run_on_memory("define<{int:x key}> single\n"
+                "transaction {\n"
+                "  insert single [{4}, {9}, {2}]\n"
+                "}\n"
+                "transaction {\n"
+                "  aggregate scan single as r {\n"
+                "    max(r.x), count()\n"
+                "  }\n"
+                "}", nullptr, &single);
+  EXPECT_EQ((std::vector<std::vector<int64_t>>{{9, 3}}), rows);
+}
+
+TEST(compiler, hash_join_pairs) {
+  BufferSink sink;
+  run_on_memory("define<{int:id key, int:k}> lhs\n"
+                "define<{int:id key, int:k}> nothing\n"
+                "define<{int:id key, int:k, int:v}> rhs\n"
+                "transaction {\n"
+                "  insert lhs [{1, 10}, {2, 20}, {3, 10}, {4, 40}]\n"
+                "  insert rhs [{1, 10, 100}, {2, 30, 300}, {3, 20, 200}]\n"
+                "}\n"
+                "transaction {\n"
+                "  join scan lhs as l on l.k\n"
+                "  with scan rhs as r on r.k {\n"
+                "    emit {r.id, l.id, r.v}\n"
+                "  }\n"
+                "  join scan nothing as n on n.k\n"
+                "  with scan rhs as r on r.k {\n"
+                "    emit {r.id, n.id, r.v}\n"
+                "  }\n"
+                "}", sink);
+  // key 10 is built twice and pairs with both, 30 and 40 have no partner,
+  // an empty build side pairs with nothing
+  std::vector<std::vector<int64_t>> rows;
+  for (size_t i = 0; i < sink.size(); ++i) {
+    rows.push_back({column_of(sink, i, 0), column_of(sink, i, 1), column_of(sink, i, 2)});
+  }
+  // rows of equal keys come in hash table order
+  std::sort(rows.begin(), rows.end());
+  EXPECT_EQ((std::vector<std::vector<int64_t>>{{1, 1, 100}, {1, 3, 100}, {3, 2, 200}}), rows);
+}
+
+// forwards to the engine and counts how the scans got their cursors
+struct CursorCounter : public DBInterface {
+  DBInterface& db;
+  int opened = 0;
+  int reopened = 0;
+  int lookups = 0;
+  explicit CursorCounter(DBInterface& d) : db(d) {}
+
+  std::string get_name() override { return db.get_name(); }
+  void define_functions(CompilerContext& ctx) override { db.define_functions(ctx); }
+  void define_table(CompilerContext& ctx, const Schema& table) override { db.define_table(ctx, table); }
+  void emit_begin_txn(CompilerContext& ctx) override { db.emit_begin_txn(ctx); }
+  void emit_precommit_txn(CompilerContext& ctx) override { db.emit_precommit_txn(ctx); }
+  llvm::Value* emit_insert(CompilerContext& ctx, const Schema& table, llvm::Value* key, llvm::Value* key_len,
+                           llvm::Value* value, llvm::Value* value_len) override {
+    return db.emit_insert(ctx, table, key, key_len, value, value_len);
+  }
+  void emit_insert_batch(CompilerContext& ctx, const Schema& table,
+                         llvm::Value* keys, llvm::Value* key_len,
+                         llvm::Value* values, llvm::Value* value_len,
+                         llvm::Value* n) override {
+    db.emit_insert_batch(ctx, table, keys, key_len, values, value_len, n);
+  }
+  void emit_update(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* value,
+                   llvm::Value* value_len) override {
+    db.emit_update(ctx, key, key_len, value, value_len);
+  }
+  void emit_delete(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len) override {
+    db.emit_delete(ctx, key, key_len);
+  }
+  void emit_scan(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* offset) override {
+    db.emit_scan(ctx, key, key_len, offset);
+  }
+  CursorBase* emit_get_cursor(CompilerContext& ctx, const Schema& table,
+                              llvm::Value* from_prefix, llvm::Value* from_len,
+                              llvm::Value* to_prefix, llvm::Value* to_len) override {
+    ++opened;
+    return db.emit_get_cursor(ctx, table, from_prefix, from_len, to_prefix, to_len);
+  }
+  llvm::Value* emit_cursor_next(CompilerContext& ctx, CursorBase* c) override {
+    return db.emit_cursor_next(ctx, c);
+  }
+  void emit_cursor_copy_key(CompilerContext& ctx, CursorBase* c, llvm::Value* buffer) override {
+    db.emit_cursor_copy_key(ctx, c, buffer);
+  }
+  void emit_cursor_copy_value(CompilerContext& ctx, CursorBase* c, llvm::Value* buffer) override {
+    db.emit_cursor_copy_value(ctx, c, buffer);
+  }
+  llvm::Value* emit_cursor_get_key(CompilerContext& ctx, CursorBase* c) override {
+    return db.emit_cursor_get_key(ctx, c);
+  }
+  llvm::Value* emit_cursor_get_key_length(CompilerContext& ctx, CursorBase* c) override {
+    return db.emit_cursor_get_key_length(ctx, c);
+  }
+  llvm::Value* emit_cursor_get_value(CompilerContext& ctx, CursorBase* c) override {
+    return db.emit_cursor_get_value(ctx, c);
+  }
+  llvm::Value* emit_cursor_get_value_length(CompilerContext& ctx, CursorBase* c) override {
+    return db.emit_cursor_get_value_length(ctx, c);
+  }
+  llvm::Value* emit_cursor_next_batch(CompilerContext& ctx, CursorBase* c,
+                                      llvm::Value* keys, llvm::Value* key_stride,
+                                      llvm::Value* values, llvm::Value* value_stride,
+                                      llvm::Value* n) override {
+    return db.emit_cursor_next_batch(ctx, c, keys, key_stride, values, value_stride, n);
+  }
+  void emit_cursor_destroy(CompilerContext& ctx, CursorBase* c) override { db.emit_cursor_destroy(ctx, c); }
+  llvm::Value* emit_is_valid_cursor(CompilerContext& ctx, CursorBase* c) override {
+    return db.emit_is_valid_cursor(ctx, c);
+  }
+  CursorBase* emit_reopen_cursor(CompilerContext& ctx, const Schema& table, llvm::Value* slot,
+                                 llvm::Value* from_prefix, llvm::Value* from_len,
+                                 llvm::Value* to_prefix, llvm::Value* to_len) override {
+    ++reopened;
+    return db.emit_reopen_cursor(ctx, table, slot, from_prefix, from_len, to_prefix, to_len);
+  }
+  CursorBase* emit_load_cursor(CompilerContext& ctx, llvm::Value* slot) override {
+    return db.emit_load_cursor(ctx, slot);
+  }
+  llvm::Value* emit_lookup(CompilerContext& ctx, const Schema& table,
+                           llvm::Value* key, llvm::Value* key_len,
+                           llvm::Value* value, llvm::Value* value_len) override {
+    ++lookups;
+    return db.emit_lookup(ctx, table, key, key_len, value, value_len);
+  }
+  void emit_parallel_for(CompilerContext& ctx, llvm::Function* body, llvm::Value* env,
+                         llvm::Value* from, llvm::Value* to, llvm::Value* batch,
+                         bool partitioned) override {
+    db.emit_parallel_for(ctx, body, env, from, to, batch, partitioned);
+  }
+  void emit_parallel_scan(CompilerContext& ctx, const Schema& table, llvm::Function* body, llvm::Value* env,
+                          llvm::Value* from, llvm::Value* from_len,
+                          llvm::Value* to, llvm::Value* to_len) override {
+    db.emit_parallel_scan(ctx, table, body, env, from, from_len, to, to_len);
+  }
+};
+
+TEST(compiler, index_nested_loop_join) {
+  EngineConfig config;
+  config.backend = "memory";
+  auto runner = make_runner(config);
+  Compiler c;
+  MetaData md;
+  BufferSink sink;
+  int opened = 0;
+  int reopened = 0;
+  int lookups = 0;
+  runner->run([&](DBInterface& dbi) {
+    CursorCounter counter(dbi);
+    parse("define<{int:id key, int:price}> item\n"
+          "define<{int:oid key, int:num key, int:iid, int:amount}> order_line\n"
+          "define<{int:id key}> orders\n"
+          "transaction {\n"
+          "  insert item [{1, 100}, {2, 250}]\n"
+          "  insert order_line [{1, 1, 2, 3}, {1, 2, 1, 5}, {2, 1, 3, 1}]\n"
+          "  insert orders [{1}, {2}, {3}]\n"
+          "}\n"
+          "transaction {\n"
+          "  scan order_line as ol {\n"
+          "    scan item as i where i.id == ol.iid {\n"
+          "      emit {ol.oid, ol.amount, i.price}\n"
+          "    }\n"
+          "  }\n"
+          "  scan orders as o {\n"
+          "    scan order_line as l where l.oid == o.id {\n"
+          "      emit {o.id, l.num, l.amount}\n"
+          "    }\n"
+          "  }\n"
+          "}", [&](node::Node* ast) {
+      CompilerContext ctx(c, &counter, &md);
+      ctx.set_sink(&sink);
+      c.compile_and_exec(ctx, counter, md, ast);
+    });
+    opened = counter.opened;
+    reopened = counter.reopened;
+    lookups = counter.lookups;
+  });
+  // the item join is a lookup per order line, the inner range scan reopens
+  // one cursor for every order instead of opening a new one
+  EXPECT_EQ(2, opened);
+  EXPECT_EQ(1, reopened);
+  EXPECT_EQ(1, lookups);
+  const std::vector<std::vector<int64_t>> expected{
+      {1, 3, 250}, {1, 5, 100},  // order line 2-1 names a missing item
+      {1, 1, 3}, {1, 2, 5}, {2, 1, 1}};
+  ASSERT_EQ(expected.size(), sink.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    for (size_t j = 0; j < expected[i].size(); ++j) {
+      EXPECT_EQ(expected[i][j], column_of(sink, i, j)) << i << ", " << j;
+    }
+  }
+}
+
+TEST(compiler, limit_counts_continued_rows) {
+  BufferSink sink;
+  run_on_memory("define<{int:x key}> limited\n"
+                "transaction {\n"
+                "  for let x = 1; x < 11; x = x + 1 {\n"
+                "    insert limited {x}\n"
+                "  }\n"
+                "}\n"
+                "transaction {\n"
+                "  scan limited as r where 1 < r.x limit 3 {\n"
+                "    if r.x == 3 {\n"
+                "      continue\n"
+                "    }\n"
+                "    emit {r.x}\n"
+                "  }\n"
+                "  scan limited as b batch 4 limit 3 {\n"
+                "    if b.x == 1 {\n"
+                "      continue\n"
+                "    }\n"
+                "    emit {b.x}\n"
+                "  }\n"
+                "}", sink);
+  const std::vector<int64_t> expected{2, 4, 2, 3};
+  ASSERT_EQ(expected.size(), sink.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i], column_of(sink, i, 0)) << i;
+  }
+}
+
+TEST(compiler, sink_finished_on_errors) {
+  struct FinishCounter : public ResultSink {
+    int finished = 0;
+    bool consume(const char* row, uint64_t length) override { return true; }
+    void finish() override { ++finished; }
+  } sink;
+  run_on_memory("emit {1}", sink);
+  EXPECT_EQ(1, sink.finished);
+  ASSERT_THROW(run_on_memory("transaction { transaction { emit {1} } }", sink), std::runtime_error);
+  EXPECT_EQ(2, sink.finished);
+}
+
+TEST(compiler, sort_ties_and_jumps) {
+  BufferSink sink;
+  run_on_memory("define<{int:x key, int:y}> sorted\n"
+                "transaction {\n"
+                "  for let x = 1; x < 13; x = x + 1 {\n"
+                "    insert sorted {x, x % 3}\n"
+                "  }\n"
+                "}\n"
+                "transaction {\n"
+                "  sort scan sorted as r by r.y limit 5 {\n"
+                "    emit {r.x}\n"
+                "  }\n"
+                "  sort scan sorted as r by r.y desc {\n"
+                "    if r.x == 5 {\n"
+                "      continue\n"
+                "    }\n"
+                "    if r.x == 4 {\n"
+                "      break\n"
+                "    }\n"
+                "    emit {r.x}\n"
+                "  }\n"
+                "}", sink);
+  // equal keys keep scan order, in a top-N too
+  const std::vector<int64_t> expected{3, 6, 9, 12, 1, 2, 8, 11, 1};
+  ASSERT_EQ(expected.size(), sink.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i], column_of(sink, i, 0)) << i;
+  }
+}
+
 }  // namespace reir
@@ -0,0 +1,116 @@
+#ifndef REIR_TESTS_DUMMY_DB_HPP_
+#define REIR_TESTS_DUMMY_DB_HPP_
+
+#include <string>
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Function.h>
+
+#include "reir/exec/compiler_context.hpp"
+#include "reir/exec/db_interface.hpp"
+
+namespace reir {
+
+// compiles the code without any engine behind it, scans see no rows
+struct DummyDB : public DBInterface {
+  std::string get_name() override {
+    return DBInterface::get_name();
+  }
+
+  void define_functions(CompilerContext& ctx) override {}
+
+  void emit_precommit_txn(CompilerContext& ctx) override {}
+
+  void emit_begin_txn(CompilerContext& ctx) override {};
+
+  llvm::Value* emit_insert(CompilerContext& ctx, const Schema& table, llvm::Value* key, llvm::Value* key_len,
+                           llvm::Value* value, llvm::Value* value_len) override {
+    return ctx.builder_.getInt1(true);
+  }
+
+  void emit_insert_batch(CompilerContext& ctx, const Schema& table,
+                         llvm::Value* keys, llvm::Value* key_len,
+                         llvm::Value* values, llvm::Value* value_len,
+                         llvm::Value* n) override {}
+
+  void emit_update(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* value,
+                   llvm::Value* value_len) override {}
+
+  void emit_delete(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len) override {}
+
+  void emit_scan(CompilerContext& ctx, llvm::Value* key, llvm::Value* key_len, llvm::Value* offset) override {}
+
+  CursorBase* emit_get_cursor(CompilerContext& ctx, const Schema& table,
+                              llvm::Value* from_prefix, llvm::Value* from_len,
+                              llvm::Value* to_prefix, llvm::Value* to_len) override {
+    return nullptr;
+  }
+  llvm::Value* emit_cursor_next(CompilerContext& ctx, CursorBase* cursor) override {
+    return ctx.builder_.getInt1(false);
+  }
+  llvm::Value* emit_is_valid_cursor(CompilerContext& ctx, CursorBase* cursor) override {
+    return ctx.builder_.getInt1(false);
+  }
+  void emit_cursor_copy_key(CompilerContext& ctx, CursorBase* c, llvm::Value* buffer) override {}
+  void emit_cursor_copy_value(CompilerContext& ctx, CursorBase* c, llvm::Value* buffer) override {}
+  llvm::Value* emit_cursor_get_key(CompilerContext& ctx, CursorBase* c) override {
+    return llvm::ConstantPointerNull::get(ctx.builder_.getInt8PtrTy());
+  }
+  llvm::Value* emit_cursor_get_key_length(CompilerContext& ctx, CursorBase* c) override {
+    return ctx.builder_.getInt64(0);
+  }
+  llvm::Value* emit_cursor_get_value(CompilerContext& ctx, CursorBase* c) override {
+    return llvm::ConstantPointerNull::get(ctx.builder_.getInt8PtrTy());
+  }
+  llvm::Value* emit_cursor_get_value_length(CompilerContext& ctx, CursorBase* c) override {
+    return ctx.builder_.getInt64(0);
+  }
+  llvm::Value* emit_cursor_next_batch(CompilerContext& ctx, CursorBase* c,
+                                      llvm::Value* keys, llvm::Value* key_stride,
+                                      llvm::Value* values, llvm::Value* value_stride,
+                                      llvm::Value* n) override {
+    return ctx.builder_.getInt64(0);
+  }
+  void emit_cursor_destroy(CompilerContext& ctx, CursorBase* c) override {}
+  CursorBase* emit_reopen_cursor(CompilerContext& ctx, const Schema& table, llvm::Value* slot,
+                                 llvm::Value* from_prefix, llvm::Value* from_len,
+                                 llvm::Value* to_prefix, llvm::Value* to_len) override {
+    return nullptr;
+  }
+  CursorBase* emit_load_cursor(CompilerContext& ctx, llvm::Value* slot) override {
+    return nullptr;
+  }
+  llvm::Value* emit_lookup(CompilerContext& ctx, const Schema& table,
+                           llvm::Value* key, llvm::Value* key_len,
+                           llvm::Value* value, llvm::Value* value_len) override {
+    return ctx.builder_.getInt1(false);
+  }
+  // no worker threads here, runs the iterations in order
+  void emit_parallel_for(CompilerContext& ctx, llvm::Function* body, llvm::Value* env,
+                         llvm::Value* from, llvm::Value* to, llvm::Value* batch,
+                         bool partitioned) override {
+    auto* entry = ctx.builder_.GetInsertBlock();
+    auto* loop = llvm::BasicBlock::Create(ctx.ctx_, "parallel_loop", ctx.func_);
+    auto* fin = llvm::BasicBlock::Create(ctx.ctx_, "parallel_fin", ctx.func_);
+    ctx.builder_.CreateCondBr(ctx.builder_.CreateICmpSLT(from, to), loop, fin);
+    ctx.builder_.SetInsertPoint(loop);
+    auto* i = ctx.builder_.CreatePHI(ctx.builder_.getInt64Ty(), 2);
+    i->addIncoming(from, entry);
+    ctx.builder_.CreateCall(body, {llvm::ConstantPointerNull::get(llvm::Type::getInt64PtrTy(ctx.ctx_)), env, i});
+    auto* next = ctx.builder_.CreateAdd(i, ctx.builder_.getInt64(1));
+    i->addIncoming(next, loop);
+    ctx.builder_.CreateCondBr(ctx.builder_.CreateICmpSLT(next, to), loop, fin);
+    ctx.builder_.SetInsertPoint(fin);
+  }
+  // the whole range as a single morsel
+  void emit_parallel_scan(CompilerContext& ctx, const Schema& table, llvm::Function* body, llvm::Value* env,
+                          llvm::Value* from, llvm::Value* from_len,
+                          llvm::Value* to, llvm::Value* to_len) override {
+    ctx.builder_.CreateCall(body, {llvm::ConstantPointerNull::get(llvm::Type::getInt64PtrTy(ctx.ctx_)),
+                                   env, from, from_len, to, to_len});
+  }
+};
+
+}  // namespace reir
+
+#endif  // REIR_TESTS_DUMMY_DB_HPP_
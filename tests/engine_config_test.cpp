@@ -0,0 +1,90 @@
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include "reir/engine/engine_config.hpp"
+
+namespace reir {
+
+TEST(engine_config, defaults_are_valid) {
+  EngineConfig config;
+  config.validate();
+}
+
+TEST(engine_config, set_by_name) {
+  EngineConfig config;
+  config.set("page_pool_size_mb_per_node", "4096");
+  config.set("use_numa_alloc", "false");
+  config.set("log_dir", "/mnt/log");
+  ASSERT_EQ(4096, config.page_pool_size_mb_per_node);
+  ASSERT_FALSE(config.use_numa_alloc);
+  ASSERT_EQ("/mnt/log", config.log_dir);
+
+  ASSERT_THROW(config.set("no_such_option", "1"), std::runtime_error);
+  ASSERT_THROW(config.set("threads", "-1"), std::runtime_error);
+  ASSERT_THROW(config.set("threads", "4x"), std::runtime_error);
+  ASSERT_THROW(config.set("flush_at_shutdown", "maybe"), std::runtime_error);
+}
+
+TEST(engine_config, load_file) {
+  const char* path = "engine_config_test.conf";
+  {
+    std::ofstream out(path);
+    out << "# sized for the TPC-C runs\n"
+        << "page_pool_size_mb_per_node = 8192\n"
+        << "\n"
+        << "  threads=16   # all of them\n"
+        << "snapshot_dir = /data/snapshot\n";
+  }
+  EngineConfig config;
+  config.load_file(path);
+  ASSERT_EQ(8192, config.page_pool_size_mb_per_node);
+  ASSERT_EQ(16, config.threads);
+  ASSERT_EQ("/data/snapshot", config.snapshot_dir);
+  {
+    std::ofstream out(path);
+    out << "threads 16\n";
+  }
+  ASSERT_THROW(config.load_file(path), std::runtime_error);
+  std::remove(path);
+  ASSERT_THROW(config.load_file(path), std::runtime_error);
+}
+
+TEST(engine_config, validate) {
+  EngineConfig config;
+  config.threads = 0;
+  ASSERT_THROW(config.validate(), std::runtime_error);
+
+  config = EngineConfig();
+  config.page_pool_size_mb_per_node = 32;
+  config.threads = 64;  // every worker grabs 64 pages up front
+  config.private_page_pool_initial_grab = 1024;
+  ASSERT_THROW(config.validate(), std::runtime_error);
+
+  config = EngineConfig();
+  config.threads = 2;
+  config.thread_groups = 4;
+  ASSERT_THROW(config.validate(), std::runtime_error);
+}
+
+TEST(engine_config, leveldb_backend) {
+  EngineConfig config;
+  config.set("backend", "leveldb");
+  config.set("leveldb_bloom_bits", "16");
+  config.set("leveldb_sync", "on");
+  config.threads = 0;  // foedus options are not checked
+  config.validate();
+  ASSERT_EQ(16, config.leveldb_bloom_bits);
+  ASSERT_TRUE(config.leveldb_sync);
+
+  config.leveldb_dir = "";
+  ASSERT_THROW(config.validate(), std::runtime_error);
+  config = EngineConfig();
+  config.backend = "rocksdb";
+  ASSERT_THROW(config.validate(), std::runtime_error);
+  config.backend = "memory";
+  config.threads = 0;
+  config.validate();
+}
+
+}  // namespace reir
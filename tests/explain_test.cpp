@@ -0,0 +1,62 @@
+#include <sstream>
+#include <string>
+#include <gtest/gtest.h>
+#include "reir/exec/explain.hpp"
+
+namespace reir {
+
+TEST(explain, phases_add_up_in_order) {
+  ExplainOptions options;
+  options.enabled = true;
+  Explain e("q.rir", options);
+  e.add_time("parse", 0.001);
+  e.add_time("codegen", 0.002);
+  e.add_time("parse", 0.003);
+  e.add_code(100);
+  e.add_code(28);
+  EXPECT_DOUBLE_EQ(0.004, e.time_of("parse"));
+  EXPECT_DOUBLE_EQ(0.0, e.time_of("execute"));
+  EXPECT_EQ(128U, e.code_size());
+
+  std::stringstream out;
+  e.print(out);
+  const auto s = out.str();
+  EXPECT_NE(std::string::npos, s.find("explain q.rir")) << s;
+  EXPECT_LT(s.find("parse"), s.find("codegen")) << s;
+  EXPECT_NE(std::string::npos, s.find("4.000 ms")) << s;
+  EXPECT_NE(std::string::npos, s.find("128 bytes in 2 objects")) << s;
+  EXPECT_EQ(std::string::npos, s.find("IR before")) << s;
+}
+
+TEST(explain, dumps_only_when_asked) {
+  ExplainOptions options;
+  options.enabled = true;
+  options.ir = true;
+  Explain e("q.rir", options);
+  e.add_ir_before("define i1 @f()\n");
+  e.add_ir_after("define i1 @f() #0\n");
+  e.add_assembly("f:\n  ret\n");
+  std::stringstream out;
+  e.print(out);
+  const auto s = out.str();
+  EXPECT_LT(s.find("IR before"), s.find("define i1 @f()\n")) << s;
+  EXPECT_LT(s.find("IR after"), s.find("#0")) << s;
+  EXPECT_EQ(std::string::npos, s.find("assembly")) << s;
+}
+
+TEST(explain, timer) {
+  ExplainOptions options;
+  Explain e("q.rir", options);
+  {
+    ExplainTimer timer(&e, "tokenize");
+  }
+  {
+    ExplainTimer nothing(nullptr, "tokenize");
+  }
+  EXPECT_LE(0.0, e.time_of("tokenize"));
+  std::stringstream out;
+  e.print(out);
+  EXPECT_NE(std::string::npos, out.str().find("tokenize"));
+}
+
+}  // namespace reir
@@ -0,0 +1,63 @@
+#include <map>
+#include <gtest/gtest.h>
+#include "reir/exec/hash_table.hpp"
+
+namespace reir {
+
+namespace {
+uint64_t* find(const RowHashTable& t, uint64_t hash, uint64_t key) {
+  for (uint64_t pos = hash & t.mask_;; pos = (pos + 1) & t.mask_) {
+    uint64_t* entry = t.slots_ + pos * t.entry_words_;
+    if (entry[0] == 0) {
+      return nullptr;
+    }
+    if (entry[0] == hash && entry[1] == key) {
+      return entry;
+    }
+  }
+}
+}  // namespace
+
+TEST(hash_table, insert_and_find) {
+  RowHashTable t(1, 1, 4);
+  uint64_t key = 42;
+  uint64_t* e = t.insert(key * 3, &key);
+  e[2] = 100;
+  ASSERT_EQ(1, t.size_);
+  uint64_t* found = find(t, (key * 3) | 1, key);
+  ASSERT_EQ(e, found);
+  ASSERT_EQ(100, found[2]);
+}
+
+TEST(hash_table, grow_keeps_entries) {
+  RowHashTable t(1, 1, 4);
+  for (uint64_t k = 0; k < 1000; ++k) {
+    uint64_t* e = t.insert(k * 7, &k);
+    e[2] = k * 2;
+  }
+  ASSERT_EQ(1000, t.size_);
+  ASSERT_LE(2000, t.capacity());
+  for (uint64_t k = 0; k < 1000; ++k) {
+    uint64_t* e = find(t, (k * 7) | 1, k);
+    ASSERT_NE(nullptr, e);
+    ASSERT_EQ(k * 2, e[2]);
+  }
+}
+
+TEST(hash_table, iterate) {
+  RowHashTable t(1, 0, 16);
+  std::map<uint64_t, int> seen;
+  for (uint64_t k = 0; k < 100; ++k) {
+    t.insert(k, &k);
+  }
+  uint64_t pos = 0;
+  while (uint64_t* e = t.next(&pos)) {
+    seen[e[1]]++;
+  }
+  ASSERT_EQ(100, seen.size());
+  for (const auto& s : seen) {
+    ASSERT_EQ(1, s.second);
+  }
+}
+
+}  // namespace reir
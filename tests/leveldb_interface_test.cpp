@@ -0,0 +1,99 @@
+#include <cstdlib>
+#include <string>
+#include <gtest/gtest.h>
+#include <leveldb/db.h>
+#include "reir/engine/leveldb_interface.hpp"
+
+namespace reir {
+
+namespace {
+
+class LevelDBInterfaceTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char dir[] = "/tmp/reir_leveldb_XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+    dir_ = dir;
+    leveldb::Options options;
+    options.create_if_missing = true;
+    ASSERT_TRUE(leveldb::DB::Open(options, dir_, &h_.db).ok());
+  }
+  void TearDown() override {
+    delete h_.db;
+    leveldb::DestroyDB(dir_, leveldb::Options());
+  }
+
+  bool insert(const std::string& key, const std::string& value) {
+    return reir_leveldb_insert(&h_, key.data(), key.size(), value.data(), value.size());
+  }
+  std::string lookup(const std::string& key) {
+    std::string value(8, '\0');
+    if (!reir_leveldb_lookup(&h_, key.data(), key.size(), &value[0], value.size())) {
+      return "";
+    }
+    return value.substr(0, value.find('\0'));
+  }
+  // keys in [from, to)
+  std::string scan(const std::string& from, const std::string& to) {
+    std::string keys;
+    auto* c = reir_leveldb_generate_cursor(&h_, from.data(), from.size(), to.data(), to.size());
+    for (bool valid = reir_leveldb_cursor_is_valid(c); valid; valid = reir_leveldb_cursor_next(c)) {
+      keys.append(reir_leveldb_cursor_get_key(c), reir_leveldb_cursor_get_key_length(c));
+      keys += ",";
+    }
+    reir_leveldb_cursor_destroy(c);
+    return keys;
+  }
+
+  std::string dir_;
+  LevelDBHandle h_;
+};
+
+}  // anonymous namespace
+
+TEST_F(LevelDBInterfaceTest, read_own_writes) {
+  ASSERT_TRUE(insert("t:b", "2"));
+  reir_leveldb_begin_xct(&h_);
+  ASSERT_TRUE(insert("t:a", "1"));
+  ASSERT_TRUE(insert("t:c", "3"));
+  ASSERT_EQ("1", lookup("t:a"));
+  ASSERT_EQ("2", lookup("t:b"));
+  ASSERT_EQ("t:a,t:b,t:c,", scan("t:", "t;"));
+  ASSERT_EQ("t:b,", scan("t:b", "t:c"));
+  ASSERT_TRUE(reir_leveldb_precommit_xct(&h_));
+  ASSERT_EQ("t:a,t:b,t:c,", scan("t:", "t;"));
+}
+
+TEST_F(LevelDBInterfaceTest, duplicate_insert_fails) {
+  ASSERT_TRUE(insert("t:a", "1"));
+  ASSERT_FALSE(insert("t:a", "2"));
+  reir_leveldb_begin_xct(&h_);
+  ASSERT_TRUE(insert("t:b", "1"));
+  ASSERT_FALSE(insert("t:b", "2"));
+  ASSERT_TRUE(reir_leveldb_precommit_xct(&h_));
+  ASSERT_EQ("1", lookup("t:a"));
+  ASSERT_EQ("1", lookup("t:b"));
+}
+
+TEST_F(LevelDBInterfaceTest, nested_commit_with_outermost) {
+  reir_leveldb_begin_xct(&h_);
+  reir_leveldb_begin_xct(&h_);
+  ASSERT_TRUE(insert("t:a", "1"));
+  ASSERT_TRUE(reir_leveldb_precommit_xct(&h_));
+  std::string value;
+  ASSERT_TRUE(h_.db->Get(leveldb::ReadOptions(), "t:a", &value).IsNotFound());
+  ASSERT_TRUE(reir_leveldb_precommit_xct(&h_));
+  ASSERT_TRUE(h_.db->Get(leveldb::ReadOptions(), "t:a", &value).ok());
+}
+
+TEST_F(LevelDBInterfaceTest, snapshot_isolates) {
+  reir_leveldb_begin_xct(&h_);
+  // written by someone else after the transaction began
+  ASSERT_TRUE(h_.db->Put(leveldb::WriteOptions(), "t:x", "9").ok());
+  ASSERT_EQ("", lookup("t:x"));
+  ASSERT_EQ("", scan("t:", "t;"));
+  ASSERT_TRUE(reir_leveldb_precommit_xct(&h_));
+  ASSERT_EQ("9", lookup("t:x"));
+}
+
+}  // namespace reir
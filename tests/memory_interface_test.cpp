@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <gtest/gtest.h>
+#include "reir/engine/memory_interface.hpp"
+
+namespace reir {
+
+namespace {
+
+bool insert(MemoryHandle& h, const std::string& key, const std::string& value) {
+  return reir_memory_insert(&h, key.data(), key.size(), value.data(), value.size());
+}
+
+std::string key_of(int i) {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "t:%08d", i);
+  return buf;
+}
+
+// keys in [from, to), comma separated
+std::string scan(MemoryHandle& h, const std::string& from, const std::string& to) {
+  std::string keys;
+  auto* c = reir_memory_generate_cursor(&h, from.data(), from.size(), to.data(), to.size());
+  for (bool valid = reir_memory_cursor_is_valid(c); valid; valid = reir_memory_cursor_next(c)) {
+    keys.append(reir_memory_cursor_get_key(c), reir_memory_cursor_get_key_length(c));
+    keys += ",";
+  }
+  reir_memory_cursor_destroy(c);
+  return keys;
+}
+
+}  // anonymous namespace
+
+TEST(memory_interface, empty) {
+  MemoryHandle h;
+  ASSERT_EQ("", scan(h, "", "\xff"));
+  char value[4];
+  ASSERT_FALSE(reir_memory_lookup(&h, "a", 1, value, sizeof(value)));
+}
+
+TEST(memory_interface, insert_lookup_scan) {
+  MemoryHandle h;
+  ASSERT_TRUE(insert(h, "t:b", "2"));
+  ASSERT_TRUE(insert(h, "t:a", "1"));
+  ASSERT_TRUE(insert(h, "u:a", "3"));
+  ASSERT_FALSE(insert(h, "t:a", "4"));
+  char value[2] = {};
+  ASSERT_TRUE(reir_memory_lookup(&h, "t:a", 3, value, 1));
+  ASSERT_EQ('1', value[0]);
+  ASSERT_EQ("t:a,t:b,", scan(h, "t:", "t;"));
+  ASSERT_EQ("t:b,u:a,", scan(h, "t:b", "\xff"));
+}
+
+TEST(memory_interface, overwrite) {
+  MemoryHandle h;
+  ASSERT_TRUE(insert(h, "t:a", "1"));
+  ASSERT_TRUE(insert(h, "t:c", "3"));
+  auto* c = reir_memory_generate_cursor(&h, "t:", 2, "t;", 2);
+  ASSERT_TRUE(reir_memory_overwrite(&h, "t:a", 3, "5", 1));
+  ASSERT_TRUE(reir_memory_overwrite(&h, "t:b", 3, "2", 1));
+  ASSERT_EQ(std::string("t:a"), std::string(reir_memory_cursor_get_key(c), 3));
+  ASSERT_EQ('5', *reir_memory_cursor_get_value(c));
+  ASSERT_TRUE(reir_memory_cursor_next(c));
+  ASSERT_EQ(std::string("t:b"), std::string(reir_memory_cursor_get_key(c), 3));
+  reir_memory_cursor_destroy(c);
+  ASSERT_EQ("t:a,t:b,t:c,", scan(h, "t:", "t;"));
+}
+
+TEST(memory_interface, many_keys_stay_ordered) {
+  MemoryHandle h;
+  std::vector<int> keys;
+  for (int i = 0; i < 20000; ++i) {
+    keys.push_back(i);
+  }
+  std::mt19937 rng(42);
+  std::shuffle(keys.begin(), keys.end(), rng);
+  for (int k : keys) {
+    ASSERT_TRUE(insert(h, key_of(k), std::to_string(k)));
+  }
+  ASSERT_EQ(20000, h.tree.size());
+  for (int k : keys) {
+    const auto* found = h.tree.find(key_of(k));
+    ASSERT_NE(nullptr, found);
+    ASSERT_EQ(std::to_string(k), *found);
+  }
+  const auto from = key_of(1000);
+  const auto to = key_of(3000);
+  auto* c = reir_memory_generate_cursor(&h, from.data(), from.size(), to.data(), to.size());
+  int expected = 1000;
+  for (bool valid = reir_memory_cursor_is_valid(c); valid; valid = reir_memory_cursor_next(c)) {
+    ASSERT_EQ(key_of(expected),
+              std::string(reir_memory_cursor_get_key(c), reir_memory_cursor_get_key_length(c)));
+    ++expected;
+  }
+  ASSERT_EQ(3000, expected);
+  reir_memory_cursor_destroy(c);
+}
+
+TEST(memory_interface, insert_while_scanning) {
+  MemoryHandle h;
+  for (int i = 0; i < 100; i += 2) {
+    ASSERT_TRUE(insert(h, key_of(i), "v"));
+  }
+  const auto from = key_of(0);
+  const auto to = key_of(100);
+  auto* c = reir_memory_generate_cursor(&h, from.data(), from.size(), to.data(), to.size());
+  int seen = 0;
+  for (bool valid = reir_memory_cursor_is_valid(c); valid; valid = reir_memory_cursor_next(c)) {
+    const std::string value(reir_memory_cursor_get_value(c), reir_memory_cursor_get_value_length(c));
+    // splits the leaves under the cursor, and the odd keys come after it
+    const int at = std::stoi(std::string(reir_memory_cursor_get_key(c) + 2, 8));
+    if (at % 2 == 0) {
+      ASSERT_TRUE(insert(h, key_of(at + 1), "w"));
+      ASSERT_TRUE(insert(h, key_of(at + 1000), "x"));
+    }
+    ASSERT_EQ(at % 2 == 0 ? "v" : "w", value);
+    ++seen;
+  }
+  reir_memory_cursor_destroy(c);
+  ASSERT_EQ(100, seen);
+}
+
+}  // namespace reir
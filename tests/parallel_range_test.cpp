@@ -0,0 +1,71 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "reir/engine/parallel_range.hpp"
+
+namespace reir {
+
+TEST(parallel_range, nodes_own_their_iterations) {
+  ParallelRange range(-5, 20, 2, 3);
+  std::vector<int> seen(25);
+  for (uint16_t node = 0; node < 3; ++node) {
+    int64_t first;
+    int64_t count;
+    while (range.take(node, &first, &count)) {
+      ASSERT_LE(count, 2);
+      for (int64_t k = 0; k < count; ++k) {
+        const int64_t i = first + k * 3;
+        ASSERT_EQ(node, ((i % 3) + 3) % 3) << i;
+        ++seen[i + 5];
+      }
+    }
+    EXPECT_TRUE(range.done_on(node));
+  }
+  EXPECT_TRUE(range.done());
+  EXPECT_EQ(std::vector<int>(25, 1), seen);
+}
+
+TEST(parallel_range, more_nodes_than_workers) {
+  // workers on two of the four nodes, as when no idle worker was found on the
+  // others. once done with their own, they take the rest
+  ParallelRange range(0, 1000, 3, 4);
+  std::vector<std::atomic<int>> seen(1000);
+  for (auto& s : seen) {
+    s = 0;
+  }
+  std::vector<std::thread> workers;
+  for (uint16_t node = 0; node < 2; ++node) {
+    workers.emplace_back([&, node] {
+      int64_t first;
+      int64_t count;
+      while (range.take(node, &first, &count)) {
+        for (int64_t k = 0; k < count; ++k) {
+          ++seen[first + k * 4];
+        }
+      }
+      while (range.take_any(node, &first, &count)) {
+        for (int64_t k = 0; k < count; ++k) {
+          ++seen[first + k * 4];
+        }
+      }
+    });
+  }
+  for (auto& w : workers) {
+    w.join();
+  }
+  EXPECT_TRUE(range.done());
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(1, seen[i].load()) << i;
+  }
+}
+
+TEST(parallel_range, empty) {
+  ParallelRange range(5, 5, 10, 2);
+  int64_t first;
+  int64_t count;
+  EXPECT_TRUE(range.done());
+  EXPECT_FALSE(range.take_any(1, &first, &count));
+}
+
+}  // namespace reir
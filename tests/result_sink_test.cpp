@@ -0,0 +1,72 @@
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "reir/exec/result_sink.hpp"
+
+namespace reir {
+
+TEST(result_sink, buffer_keeps_rows) {
+  BufferSink sink;
+  for (uint64_t i = 0; i < 100; ++i) {
+    uint64_t row[2] = {i, i * i};
+    ASSERT_TRUE(sink.consume(reinterpret_cast<const char*>(row), sizeof(row)));
+  }
+  ASSERT_EQ(100, sink.size());
+  for (uint64_t i = 0; i < 100; ++i) {
+    auto r = sink.row(i);
+    ASSERT_EQ(16, r.length);
+    ASSERT_EQ(i * i, reinterpret_cast<const uint64_t*>(r.data)[1]);
+  }
+}
+
+TEST(result_sink, buffer_capacity_stops) {
+  BufferSink sink(24);
+  uint64_t v = 1;
+  ASSERT_TRUE(sink.consume(reinterpret_cast<const char*>(&v), sizeof(v)));
+  ASSERT_TRUE(sink.consume(reinterpret_cast<const char*>(&v), sizeof(v)));
+  ASSERT_TRUE(sink.consume(reinterpret_cast<const char*>(&v), sizeof(v)));
+  ASSERT_FALSE(sink.consume(reinterpret_cast<const char*>(&v), sizeof(v)));
+  ASSERT_EQ(3, sink.size());
+}
+
+TEST(result_sink, ring_streams_in_order) {
+  // much smaller than the result, the producer has to wait for the consumer
+  RingSink sink(128);
+  const uint64_t rows = 100000;
+  std::thread producer([&] {
+    for (uint64_t i = 0; i < rows; ++i) {
+      uint64_t row[3] = {i, i + 1, i + 2};
+      // odd rows are shorter, to wrap at different offsets
+      sink.consume(reinterpret_cast<const char*>(row), i % 2 ? 8 : sizeof(row));
+    }
+    sink.finish();
+  });
+  std::vector<char> row;
+  uint64_t expected = 0;
+  while (sink.pop(row)) {
+    ASSERT_EQ(expected % 2 ? 8 : 24, row.size());
+    ASSERT_EQ(expected, reinterpret_cast<const uint64_t*>(row.data())[0]);
+    ++expected;
+  }
+  producer.join();
+  ASSERT_EQ(rows, expected);
+}
+
+TEST(result_sink, ring_cancel_stops_producer) {
+  RingSink sink(64);
+  uint64_t produced = 0;
+  std::thread producer([&] {
+    uint64_t v = 0;
+    while (sink.consume(reinterpret_cast<const char*>(&v), sizeof(v))) {
+      ++produced;
+    }
+    sink.finish();
+  });
+  std::vector<char> row;
+  ASSERT_TRUE(sink.pop(row));
+  sink.cancel();
+  producer.join();
+  ASSERT_LE(1, produced);
+}
+
+}  // namespace reir
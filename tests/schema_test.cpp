@@ -44,5 +44,68 @@ TEST(schema, serdes) {
   std::cout << a << std::endl;
 }
 
+TEST(schema, storage_serdes) {
+  Schema a("warehouse", {
+      Attribute("wid", AttrType("int"), Attribute::AttrProperty::KEY),
+      Attribute("ytd", AttrType("int"), Attribute::AttrProperty::NONE),
+  }, StorageKind::ARRAY, 100);
+  std::string buf;
+  a.serialize(buf);
+  Schema b;
+  b.deserialize(buf);
+  ASSERT_EQ(a, b);
+  ASSERT_EQ(StorageKind::ARRAY, b.storage());
+  ASSERT_EQ(100, b.storage_size());
+
+  Schema c("history", {Attribute("hid", AttrType("int"), Attribute::AttrProperty::KEY)});
+  c.serialize(buf);
+  b.deserialize(buf);
+  ASSERT_EQ(StorageKind::MASSTREE, b.storage());
+  ASSERT_NE(a, c);
+}
+
+TEST(schema, partition_key_first) {
+  Schema a("district", {
+      Attribute("did", AttrType("int"), Attribute::AttrProperty::KEY),
+      Attribute("name", AttrType("int"), Attribute::AttrProperty::NONE),
+      Attribute("wid", AttrType("int"),
+                Attribute::AttrProperty(Attribute::AttrProperty::KEY | Attribute::AttrProperty::PARTITION)),
+  });
+  ASSERT_EQ(2, a.partition_column());
+  ASSERT_EQ((std::vector<size_t>{2, 0}), a.key_columns());
+  ASSERT_EQ(0, a.key_offset(2));
+  ASSERT_EQ(8, a.key_offset(0));
+
+  std::string buf;
+  a.serialize(buf);
+  Schema b;
+  b.deserialize(buf);
+  ASSERT_EQ(a, b);
+}
+
+TEST(schema, index_schema) {
+  Schema a("order", {
+      Attribute("oid", AttrType("int"), Attribute::AttrProperty::KEY),
+      Attribute("cid", AttrType("int"), Attribute::AttrProperty::NONE),
+      Attribute("wid", AttrType("int"),
+                Attribute::AttrProperty(Attribute::AttrProperty::KEY | Attribute::AttrProperty::PARTITION)),
+  });
+  IndexDef index{"order_customer", "order", {2, 1}};
+  // the indexed columns, then what is left of the primary key
+  ASSERT_EQ((std::vector<size_t>{2, 1, 0}), a.index_columns(index));
+  auto entry = a.index_schema(index);
+  ASSERT_EQ("order_customer:", entry.get_key_prefix());
+  ASSERT_EQ(3, entry.columns());
+  ASSERT_EQ(-1, entry.partition_column());
+  ASSERT_EQ(8, entry.key_offset(1));
+  ASSERT_EQ(0, entry.get_fixed_value_length());
+
+  std::string buf;
+  index.serialize(buf);
+  IndexDef b;
+  b.deserialize(buf);
+  ASSERT_EQ(index, b);
+  ASSERT_THROW(a.index_schema(IndexDef{"bad", "order", {7}}), std::runtime_error);
+}
 
 }  // namespace reir
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include "reir/exec/sorter.hpp"
+
+namespace reir {
+
+namespace {
+std::vector<std::vector<uint64_t>> drain(RowSorter& s) {
+  std::vector<std::vector<uint64_t>> ret;
+  std::vector<uint64_t> rec(s.record_words());
+  while (s.next(rec.data())) {
+    ret.push_back(rec);
+  }
+  return ret;
+}
+}  // namespace
+
+TEST(sorter, in_memory_is_stable) {
+  RowSorter s(1, 1);
+  std::mt19937_64 rand(1);
+  std::vector<std::vector<uint64_t>> expected;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    expected.push_back({rand() % 100, i});
+    s.add(expected.back().data());
+  }
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const std::vector<uint64_t>& a, const std::vector<uint64_t>& b) { return a[0] < b[0]; });
+  ASSERT_EQ(expected, drain(s));
+  ASSERT_EQ(0, s.spilled_runs());
+}
+
+TEST(sorter, multi_word_key) {
+  RowSorter s(2, 0);
+  uint64_t records[][2] = {{2, 1}, {1, 1ULL << 63}, {1, 5}, {0, 7}};
+  for (auto* r : records) {
+    s.add(r);
+  }
+  std::vector<std::vector<uint64_t>> expected{{0, 7}, {1, 5}, {1, 1ULL << 63}, {2, 1}};
+  ASSERT_EQ(expected, drain(s));
+}
+
+TEST(sorter, top_n) {
+  RowSorter s(1, 0, 10);
+  std::vector<uint64_t> keys;
+  std::mt19937_64 rand(2);
+  for (int i = 0; i < 10000; ++i) {
+    keys.push_back(rand());
+    s.add(&keys.back());
+  }
+  std::sort(keys.begin(), keys.end());
+  auto out = drain(s);
+  ASSERT_EQ(10, out.size());
+  for (size_t i = 0; i < out.size(); ++i) {
+    ASSERT_EQ(keys[i], out[i][0]);
+  }
+}
+
+TEST(sorter, spill_and_merge) {
+  // 16 records per run
+  RowSorter s(1, 1, 0, 16 * 2 * sizeof(uint64_t));
+  std::mt19937_64 rand(3);
+  std::vector<std::vector<uint64_t>> expected;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    expected.push_back({rand() % 50, i});
+    s.add(expected.back().data());
+  }
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const std::vector<uint64_t>& a, const std::vector<uint64_t>& b) { return a[0] < b[0]; });
+  auto out = drain(s);
+  ASSERT_LT(1, s.spilled_runs());
+  ASSERT_EQ(expected, out);
+}
+
+}  // namespace reir
@@ -0,0 +1,57 @@
+#include <sstream>
+#include <string>
+#include <gtest/gtest.h>
+#include "reir/exec/statement_profile.hpp"
+
+namespace reir {
+
+TEST(statement_profile, nesting) {
+  StatementProfile p;
+  bool leaf;
+  auto* txn = p.enter("transaction", 1);
+  ASSERT_EQ(txn, p.enter_body());
+  auto* scan = p.enter("scan t", 2);
+  ASSERT_EQ(scan, p.enter_body());
+  auto* emit = p.enter("emit", 3);
+  ASSERT_EQ(emit, p.leave(&leaf));
+  EXPECT_TRUE(leaf);
+  ASSERT_EQ(scan, p.leave(&leaf));
+  EXPECT_FALSE(leaf);
+  ASSERT_EQ(txn, p.leave(&leaf));
+  EXPECT_FALSE(leaf);
+  ASSERT_EQ(3U, p.size());
+  EXPECT_EQ(nullptr, p.enter_body());
+  EXPECT_THROW(p.leave(&leaf), std::runtime_error);
+}
+
+TEST(statement_profile, print) {
+  StatementProfile p;
+  bool leaf;
+  auto* scan = p.enter("scan t", 2);
+  auto* emit = p.enter("emit", 3);
+  p.leave(&leaf);
+  p.leave(&leaf);
+  auto* insert = p.enter("insert u", 5);
+  p.leave(&leaf);
+  scan->calls = 1;
+  scan->rows = 10;
+  scan->cycles = 300;
+  emit->calls = emit->rows = 10;
+  emit->cycles = 200;
+  insert->calls = insert->rows = 1;
+  insert->cycles = 100;
+
+  std::stringstream out;
+  p.print(out);
+  std::string header, line;
+  std::getline(out, header);
+  EXPECT_NE(std::string::npos, header.find("cycles"));
+  std::getline(out, line);
+  EXPECT_NE(std::string::npos, line.find("75.0  scan t")) << line;
+  std::getline(out, line);
+  EXPECT_NE(std::string::npos, line.find("50.0    emit")) << line;
+  std::getline(out, line);
+  EXPECT_NE(std::string::npos, line.find("25.0  insert u")) << line;
+}
+
+}  // namespace reir
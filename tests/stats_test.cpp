@@ -0,0 +1,184 @@
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "reir/engine/stats.hpp"
+
+namespace reir {
+
+TEST(stats, buckets_cover_their_values) {
+  for (uint64_t v : {0ULL, 1ULL, 31ULL, 32ULL, 63ULL, 64ULL, 1000ULL, 123456789ULL, (1ULL << 40) - 1}) {
+    const auto b = LatencyHistogram::bucket_of(v);
+    ASSERT_LE(v, LatencyHistogram::highest_of(b)) << v;
+    if (0 < b) {
+      ASSERT_LT(LatencyHistogram::highest_of(b - 1), v) << v;
+    }
+    // within about 3%
+    ASSERT_LE(LatencyHistogram::highest_of(b) - v, v / 32) << v;
+  }
+  EXPECT_EQ(LatencyHistogram::kBuckets - 1, LatencyHistogram::bucket_of(1ULL << 50));
+}
+
+TEST(stats, percentiles) {
+  LatencyHistogram h;
+  EXPECT_EQ(0U, h.percentile(99));
+  for (uint64_t i = 1; i <= 1000; ++i) {
+    h.record(i * 1000);
+  }
+  EXPECT_EQ(1000U, h.count());
+  EXPECT_EQ(1000000U, h.max());
+  EXPECT_DOUBLE_EQ(500500.0, h.mean());
+  EXPECT_NEAR(500000.0, h.percentile(50), 500000.0 / 32);
+  EXPECT_NEAR(990000.0, h.percentile(99), 990000.0 / 32);
+  EXPECT_EQ(1000000U, h.percentile(100));
+
+  LatencyHistogram other;
+  other.record(5000000);
+  h.merge(other);
+  EXPECT_EQ(1001U, h.count());
+  EXPECT_EQ(5000000U, h.percentile(100));
+}
+
+TEST(stats, nothing_recorded_outside_a_scope) {
+  stats_xct_begin();
+  stats_xct_committed();
+  stats_rows_read(3);
+  EXPECT_EQ(0U, stats_snapshot().count("outside"));
+}
+
+TEST(stats, threads_are_merged_on_read) {
+  {
+    StatsScope scope("merged");
+    auto* procedure = stats_current_procedure();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([procedure] {
+        StatsScope worker(procedure);
+        for (int i = 0; i < 100; ++i) {
+          stats_xct_begin();
+          stats_rows_read(2);
+          stats_rows_written();
+          if (i % 10 == 0) {
+            stats_xct_aborted("race");
+            stats_xct_retried();
+            stats_xct_begin();
+          }
+          stats_xct_committed();
+          stats_xct_durable();
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+  stats_xct_begin();
+  stats_xct_committed();  // after the scope, not counted
+
+  const auto s = stats_snapshot()["merged"];
+  EXPECT_EQ(400U, s.commits);
+  EXPECT_EQ(40U, s.retries);
+  EXPECT_EQ(40U, s.total_aborts());
+  EXPECT_EQ(40U, s.aborts.at("race"));
+  EXPECT_EQ(800U, s.rows_read);
+  EXPECT_EQ(400U, s.rows_written);
+  EXPECT_EQ(400U, s.begin_to_commit.count());
+  EXPECT_EQ(400U, s.commit_to_durable.count());
+
+  std::stringstream out;
+  print_stats(out);
+  EXPECT_NE(std::string::npos, out.str().find("procedure merged")) << out.str();
+  EXPECT_NE(std::string::npos, out.str().find("aborted by race: 40")) << out.str();
+
+  stats_reset();
+  EXPECT_EQ(0U, stats_snapshot()["merged"].commits);
+}
+
+TEST(stats, threads_name_their_procedure) {
+  stats_set_procedure("ignored");  // outside of a scope
+  {
+    StatsScope scope("mix");
+    auto* procedure = stats_current_procedure();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([t, procedure] {
+        StatsScope worker(procedure);
+        for (int i = 0; i < 10; ++i) {
+          stats_set_procedure(t % 2 == 0 ? "even" : "odd");
+          stats_xct_begin();
+          stats_xct_committed();
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    stats_set_procedure("even");
+    {
+      StatsScope nested("nested");
+      stats_rows_written();  // a new scope drops the name
+    }
+    stats_rows_written();  // and so does closing one
+  }
+  auto s = stats_snapshot();
+  EXPECT_EQ(0U, s.count("ignored"));
+  EXPECT_EQ(20U, s["even"].commits);
+  EXPECT_EQ(20U, s["odd"].commits);
+  EXPECT_EQ(20U, s["odd"].begin_to_commit.count());
+  EXPECT_EQ(0U, s["mix"].commits);
+  EXPECT_EQ(0U, s["even"].rows_written);
+  EXPECT_EQ(1U, s["nested"].rows_written);
+  EXPECT_EQ(1U, s["mix"].rows_written);
+}
+
+TEST(stats, scopes_belong_to_their_thread) {
+  {
+    StatsScope scope("caller");
+    // a thread that was not handed the procedure records nothing
+    std::thread([] {
+      EXPECT_EQ(nullptr, stats_current_procedure());
+      stats_rows_written();
+    }).join();
+
+    // scopes of other threads come and go in any order without touching this one
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([t] {
+        StatsScope own(t % 2 == 0 ? "left" : "right");
+        for (int i = 0; i < 100; ++i) {
+          stats_set_procedure("named");
+          StatsScope nested("nested_in_thread");
+          stats_rows_read();
+        }
+        stats_rows_written();
+      });
+    }
+    stats_rows_written();
+    for (auto& t : threads) {
+      t.join();
+    }
+    stats_rows_written();
+  }
+  auto s = stats_snapshot();
+  EXPECT_EQ(2U, s["caller"].rows_written);
+  EXPECT_EQ(2U, s["left"].rows_written);
+  EXPECT_EQ(2U, s["right"].rows_written);
+  EXPECT_EQ(400U, s["nested_in_thread"].rows_read);
+  EXPECT_EQ(0U, s["named"].rows_read);
+}
+
+TEST(stats, scopes_nest) {
+  {
+    StatsScope outer("outer");
+    {
+      StatsScope inner("inner");
+      stats_rows_written();
+    }
+    stats_rows_written(2);
+  }
+  auto s = stats_snapshot();
+  EXPECT_EQ(1U, s["inner"].rows_written);
+  EXPECT_EQ(2U, s["outer"].rows_written);
+}
+
+}  // namespace reir
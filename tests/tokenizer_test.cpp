@@ -122,6 +122,26 @@ TEST(tokenizer, multibyte_symbols) {
   EXPECT_EQ(PERCENT_EQUAL, tokens[8].type);
 }
 
+TEST(tokenizer, rows) {
+  auto tokens = tokenize("abc\n  def 12\n\nx");
+  ASSERT_EQ(4U, tokens.size()) << tokens;
+  EXPECT_EQ(1, tokens[0].row);
+  EXPECT_EQ(2, tokens[1].row);
+  EXPECT_EQ(IDENTIFIER, tokens[1].type);
+  EXPECT_EQ(2, tokens[2].row);
+  EXPECT_EQ(4, tokens[3].row);
+}
+
+TEST(tokenizer, contextual_keywords) {
+  // keywords only where they start a statement, the parser decides
+  std::string s {"aggregate join sort parallel"};
+  auto tokens = tokenize(s);
+  ASSERT_EQ(4U, tokens.size()) << tokens;
+  for (const auto& t : tokens) {
+    EXPECT_EQ(IDENTIFIER, t.type) << t;
+  }
+}
+
 TEST(tokenizer, invalid_token) {
   ASSERT_THROW(tokenize("\"hello\"12dfs12"), std::runtime_error);{
   ASSERT_THROW(tokenize("1e12"), std::runtime_error);
@@ -0,0 +1,91 @@
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "reir/engine/trace.hpp"
+
+namespace reir {
+
+namespace {
+
+size_t count(const std::string& s, const std::string& what) {
+  size_t n = 0;
+  for (size_t pos = s.find(what); pos != std::string::npos; pos = s.find(what, pos + 1)) {
+    ++n;
+  }
+  return n;
+}
+
+}  // anonymous namespace
+
+TEST(trace, levels) {
+  std::ostringstream out;
+  set_trace_sink(&out);
+  set_trace_level(TraceLevel::kWarn);
+  REIR_TRACE_INFO("skipped %d", 1);
+  REIR_TRACE_WARN("kept %d", 2);
+  REIR_TRACE_ERROR("kept %s", "too");
+  trace_flush();
+  set_trace_sink(&std::cout);
+  set_trace_level(TraceLevel::kInfo);
+  const auto s = out.str();
+  ASSERT_EQ(std::string::npos, s.find("skipped"));
+  ASSERT_NE(std::string::npos, s.find("kept 2"));
+  ASSERT_NE(std::string::npos, s.find("kept too"));
+  // in the order they were traced
+  ASSERT_LT(s.find("kept 2"), s.find("kept too"));
+}
+
+TEST(trace, compiled_out) {
+  int evaluated = 0;
+  REIR_TRACE_DEBUG("%d", ++evaluated);
+#if REIR_TRACE_MIN_LEVEL <= 0
+  ASSERT_EQ(1, evaluated);
+#else
+  ASSERT_EQ(0, evaluated);
+#endif
+}
+
+TEST(trace, threads) {
+  std::ostringstream out;
+  set_trace_sink(&out);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([t] {
+      for (int i = 0; i < 100; ++i) {
+        REIR_TRACE_INFO("thread %d message %d", t, i);
+      }
+    });
+  }
+  for (auto& th : threads) {
+    th.join();
+  }
+  trace_flush();
+  set_trace_sink(&std::cout);
+  const auto s = out.str();
+  ASSERT_EQ(400, count(s, "message"));
+  ASSERT_EQ(100, count(s, "thread 3 "));
+}
+
+TEST(trace, full_ring_drops) {
+  std::ostringstream out;
+  set_trace_sink(&out);
+  const uint64_t before = trace_dropped();
+  // more than a ring holds, faster than the drain thread wakes up
+  std::thread([] {
+    for (int i = 0; i < 5000; ++i) {
+      REIR_TRACE_INFO("flood %d", i);
+    }
+  }).join();
+  trace_flush();
+  set_trace_sink(&std::cout);
+  const auto s = out.str();
+  const uint64_t dropped = trace_dropped() - before;
+  ASSERT_EQ(5000u, count(s, "flood") + dropped);
+  if (dropped != 0) {
+    ASSERT_NE(std::string::npos, s.find("messages dropped"));
+  }
+}
+
+}  // namespace reir